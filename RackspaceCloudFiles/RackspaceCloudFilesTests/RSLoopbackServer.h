@@ -0,0 +1,40 @@
+//
+//  RSLoopbackServer.h
+//  RackspaceCloudFilesTests
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** The RSLoopbackServer class puts RSStubServer behind a real HTTP/1.1 listener on 127.0.0.1.
+ *
+ *  Requests to it go through sockets like requests to the API, so opening connections and keeping
+ *  them alive cost what they would on a network with no latency.  Each request is answered by
+ *  RSStubServer, and URLs to the stub in the response headers are rewritten to point back at the
+ *  listener.  Connections are kept alive unless the client asks to close them.  Request bodies must
+ *  have a Content-Length.
+ */
+@interface RSLoopbackServer : NSObject
+
+/** The port the server listens on, or 0 if it isn't listening */
+@property (nonatomic, readonly) NSUInteger port;
+
+/** The v1.0 authentication URL */
+@property (nonatomic, strong, readonly) NSURL *authURL;
+
+/** The number of connections accepted since the server started */
+@property (nonatomic, readonly) NSUInteger connectionCount;
+
+/** The number of requests answered since the server started */
+@property (nonatomic, readonly) NSUInteger requestCount;
+
+/** Starts listening on a free port.
+ *  @return `YES` if the server is listening
+ */
+- (BOOL)start;
+
+/** Stops listening and closes every open connection */
+- (void)stop;
+
+@end
@@ -0,0 +1,282 @@
+//
+//  RSLoopbackServer.m
+//  RackspaceCloudFilesTests
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSLoopbackServer.h"
+#import "RSStubServer.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <errno.h>
+#include <unistd.h>
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+#define kRSLoopbackReadSize 16384
+
+@interface RSLoopbackServer ()
+
+@property (nonatomic, readwrite) NSUInteger port;
+@property (nonatomic, strong, readwrite) NSURL *authURL;
+@property (nonatomic, readwrite) NSUInteger connectionCount;
+@property (nonatomic, readwrite) NSUInteger requestCount;
+@property (nonatomic, assign) dispatch_source_t listenSource;
+@property (nonatomic, strong) NSMutableSet *openSockets;
+
+- (void)acceptConnection:(int)listenSocket;
+- (BOOL)answerRequestInBuffer:(NSMutableData *)buffer socket:(int)connectionSocket;
+- (BOOL)writeData:(NSData *)data toSocket:(int)connectionSocket;
+
+@end
+
+@implementation RSLoopbackServer
+
+@synthesize port, authURL, connectionCount, requestCount, listenSource, openSockets;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.openSockets = [[NSMutableSet alloc] init];
+    }
+    return self;
+
+}
+
+- (void)dealloc {
+
+    [self stop];
+
+}
+
+#pragma mark - Listening
+
+- (BOOL)start {
+
+    int listenSocket = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (listenSocket < 0) {
+        return NO;
+    }
+
+    int yes = 1;
+    setsockopt(listenSocket, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+
+    // port 0 lets the system pick a free one, which getsockname reports back
+    struct sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_len = sizeof(address);
+    address.sin_family = AF_INET;
+    address.sin_port = 0;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    socklen_t length = sizeof(address);
+
+    if (bind(listenSocket, (struct sockaddr *)&address, sizeof(address)) != 0 || listen(listenSocket, SOMAXCONN) != 0 || getsockname(listenSocket, (struct sockaddr *)&address, &length) != 0) {
+        close(listenSocket);
+        return NO;
+    }
+
+    self.port = ntohs(address.sin_port);
+    self.authURL = [NSURL URLWithString:$S(@"http://127.0.0.1:%lu/v1.0", (unsigned long)self.port)];
+
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, listenSocket, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+    __weak RSLoopbackServer *weakSelf = self;
+
+    dispatch_source_set_event_handler(source, ^{
+        [weakSelf acceptConnection:listenSocket];
+    });
+
+    dispatch_source_set_cancel_handler(source, ^{
+        close(listenSocket);
+    });
+
+    self.listenSource = source;
+    dispatch_resume(source);
+
+    return YES;
+
+}
+
+- (void)stop {
+
+    if (self.listenSource) {
+        dispatch_source_cancel(self.listenSource);
+        dispatch_release(self.listenSource);
+        self.listenSource = NULL;
+    }
+
+    // shutting a socket down wakes its source with end of file, and the source closes it
+    @synchronized (self) {
+        for (NSNumber *openSocket in self.openSockets) {
+            shutdown([openSocket intValue], SHUT_RDWR);
+        }
+    }
+
+    self.port = 0;
+
+}
+
+- (void)acceptConnection:(int)listenSocket {
+
+    int connectionSocket = accept(listenSocket, NULL, NULL);
+    if (connectionSocket < 0) {
+        return;
+    }
+
+    int yes = 1;
+    setsockopt(connectionSocket, SOL_SOCKET, SO_NOSIGPIPE, &yes, sizeof(yes));
+    setsockopt(connectionSocket, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+    NSNumber *key = [NSNumber numberWithInt:connectionSocket];
+
+    @synchronized (self) {
+        self.connectionCount++;
+        [self.openSockets addObject:key];
+    }
+
+    // a connection's requests are read and answered in order by its own source, and the sources
+    // of different connections run concurrently
+    NSMutableData *buffer = [[NSMutableData alloc] init];
+    dispatch_source_t source = dispatch_source_create(DISPATCH_SOURCE_TYPE_READ, connectionSocket, 0, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0));
+
+    dispatch_source_set_event_handler(source, ^{
+
+        char bytes[kRSLoopbackReadSize];
+        ssize_t count = read(connectionSocket, bytes, sizeof(bytes));
+
+        if (count <= 0) {
+            dispatch_source_cancel(source);
+            return;
+        }
+
+        [buffer appendBytes:bytes length:count];
+
+        while ([self answerRequestInBuffer:buffer socket:connectionSocket]) {
+        }
+
+    });
+
+    dispatch_source_set_cancel_handler(source, ^{
+
+        @synchronized (self) {
+            [self.openSockets removeObject:key];
+        }
+        close(connectionSocket);
+        dispatch_release(source);
+
+    });
+
+    dispatch_resume(source);
+
+}
+
+#pragma mark - Requests
+
+- (BOOL)answerRequestInBuffer:(NSMutableData *)buffer socket:(int)connectionSocket {
+
+    NSRange headEnd = [buffer rangeOfData:[NSData dataWithBytes:"\r\n\r\n" length:4] options:0 range:NSMakeRange(0, [buffer length])];
+    if (headEnd.location == NSNotFound) {
+        return NO;
+    }
+
+    NSString *head = [[NSString alloc] initWithData:[buffer subdataWithRange:NSMakeRange(0, headEnd.location)] encoding:NSISOLatin1StringEncoding];
+    NSArray *lines = [head componentsSeparatedByString:@"\r\n"];
+    NSArray *requestLine = [[lines objectAtIndex:0] componentsSeparatedByString:@" "];
+
+    if ([requestLine count] != 3) {
+        shutdown(connectionSocket, SHUT_RDWR);
+        return NO;
+    }
+
+    NSString *stubHost = [[RSStubServer authURL] host];
+    NSMutableURLRequest *request = [NSMutableURLRequest requestWithURL:[NSURL URLWithString:$S(@"http://%@%@", stubHost, [requestLine objectAtIndex:1])]];
+    [request setHTTPMethod:[requestLine objectAtIndex:0]];
+
+    for (NSUInteger i = 1; i < [lines count]; i++) {
+
+        NSString *line = [lines objectAtIndex:i];
+        NSRange colon = [line rangeOfString:@":"];
+
+        if (colon.location != NSNotFound) {
+            NSString *value = [[line substringFromIndex:NSMaxRange(colon)] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+            [request addValue:value forHTTPHeaderField:[line substringToIndex:colon.location]];
+        }
+
+    }
+
+    NSUInteger bodyStart = NSMaxRange(headEnd);
+    NSUInteger bodyLength = (NSUInteger)[[request valueForHTTPHeaderField:@"Content-Length"] longLongValue];
+
+    if ([buffer length] < bodyStart + bodyLength) {
+        return NO;
+    }
+
+    NSData *body = [buffer subdataWithRange:NSMakeRange(bodyStart, bodyLength)];
+    [buffer replaceBytesInRange:NSMakeRange(0, bodyStart + bodyLength) withBytes:NULL length:0];
+
+    NSData *data = nil;
+    NSHTTPURLResponse *response = [RSStubServer answerRequest:request body:body data:&data];
+
+    @synchronized (self) {
+        self.requestCount++;
+    }
+
+    if (!response) {
+        shutdown(connectionSocket, SHUT_RDWR);
+        return NO;
+    }
+
+    NSString *stubPrefix = $S(@"http://%@", stubHost);
+    NSString *loopbackPrefix = $S(@"http://127.0.0.1:%lu", (unsigned long)self.port);
+    NSMutableString *responseHead = [NSMutableString stringWithFormat:@"HTTP/1.1 %ld %@\r\n", (long)[response statusCode], [[NSHTTPURLResponse localizedStringForStatusCode:[response statusCode]] capitalizedString]];
+
+    [[response allHeaderFields] enumerateKeysAndObjectsUsingBlock:^(id key, id value, BOOL *stop) {
+        [responseHead appendFormat:@"%@: %@\r\n", key, [value stringByReplacingOccurrencesOfString:stubPrefix withString:loopbackPrefix]];
+    }];
+    [responseHead appendString:@"\r\n"];
+
+    NSMutableData *message = [NSMutableData dataWithData:[responseHead dataUsingEncoding:NSUTF8StringEncoding]];
+    if (data) {
+        [message appendData:data];
+    }
+
+    BOOL keepAlive = ![[[request valueForHTTPHeaderField:@"Connection"] lowercaseString] isEqualToString:@"close"];
+
+    if (![self writeData:message toSocket:connectionSocket] || !keepAlive) {
+        shutdown(connectionSocket, SHUT_RDWR);
+        return NO;
+    }
+
+    return YES;
+
+}
+
+- (BOOL)writeData:(NSData *)data toSocket:(int)connectionSocket {
+
+    const char *bytes = [data bytes];
+    NSUInteger remaining = [data length];
+
+    while (remaining > 0) {
+
+        ssize_t written = write(connectionSocket, bytes, remaining);
+
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return NO;
+        }
+
+        bytes += written;
+        remaining -= written;
+
+    }
+
+    return YES;
+
+}
+
+@end
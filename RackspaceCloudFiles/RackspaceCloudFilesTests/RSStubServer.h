@@ -0,0 +1,100 @@
+//
+//  RSStubServer.h
+//  RackspaceCloudFilesTests
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSClient;
+
+/** The RSStubServer class stands in for the Cloud Files API inside the test process.
+ *
+ *  Once started, it answers every request to its hosts through the URL loading system, so a RSClient
+ *  pointed at authURL works without a network connection.  It implements the v1.0 auth handshake,
+ *  account, container, and object GET/HEAD/PUT/POST/DELETE with metadata, listings with limit, marker,
+ *  prefix, and delimiter, ranges and conditional requests, dynamic and static large objects, bulk
+ *  delete, archive extraction, and the CDN management API.  Everything is kept in memory.
+ *
+ *  Latency, bandwidth, and errors can be injected to measure how the SDK behaves under them.
+ */
+@interface RSStubServer : NSURLProtocol
+
+/** Registers the server with the URL loading system and resets it */
++ (void)start;
+
+/** Unregisters the server */
++ (void)stop;
+
+/** Points a client's transport at the server.  A NSURLSession doesn't consult protocols registered
+ *  with the URL loading system, so clients whose transport uses one must be prepared before their
+ *  first request.
+ */
++ (void)prepareClient:(RSClient *)client;
+
+/** Removes every container and restores the default settings */
++ (void)reset;
+
+/** Answers a request directly, without the URL loading system, so the server can sit behind a real
+ *  socket.  Latency and bandwidth limits are not applied.
+ *  @param request A request to one of the server's hosts
+ *  @param body The request body
+ *  @param data On return, the response body, which is nil for a HEAD request
+ *  @return The response, or nil if an injected error drops the connection
+ */
++ (NSHTTPURLResponse *)answerRequest:(NSURLRequest *)request body:(NSData *)body data:(NSData **)data;
+
+/** The v1.0 authentication URL */
++ (NSURL *)authURL;
+
+/** The username the server accepts */
++ (NSString *)username;
+
+/** The API key the server accepts */
++ (NSString *)apiKey;
+
+/** Delays every response by this many seconds.  Defaults to 0. */
++ (void)setLatency:(NSTimeInterval)latency;
+
+/** Limits request and response bodies to this many bytes per second each.  Defaults to 0, which is unlimited. */
++ (void)setBandwidth:(unsigned long long)bytesPerSecond;
+
+/** Fails this fraction of storage and CDN requests at random.
+ *  @param errorRate A fraction between 0 and 1
+ *  @param statusCode The status code to fail with, or 0 to drop the connection instead
+ */
++ (void)setErrorRate:(double)errorRate statusCode:(NSInteger)statusCode;
+
+/** Fails the next storage and CDN requests.
+ *  @param count The number of requests to fail
+ *  @param statusCode The status code to fail with, or 0 to drop the connection instead
+ */
++ (void)failNextRequests:(NSUInteger)count statusCode:(NSInteger)statusCode;
+
+/** Whether bulk delete and archive extraction are available.  Defaults to `YES`. */
++ (void)setBulkOperationsEnabled:(BOOL)enabled;
+
+/** Makes the current auth token invalid, so the next request gets a 401 */
++ (void)expireAuthToken;
+
+/** Stores an object directly, without a request
+ *  @param data The object's data
+ *  @param name The object's name
+ *  @param containerName The container, which is created if needed
+ */
++ (void)setData:(NSData *)data forObject:(NSString *)name inContainer:(NSString *)containerName;
+
+/** The number of requests answered since the server was reset, including authentication */
++ (NSUInteger)requestCount;
+
+/** The number of request body bytes received since the server was reset */
++ (unsigned long long)bytesReceived;
+
+/** The number of authentication requests answered since the server was reset */
++ (NSUInteger)authenticationCount;
+
+/** The number of CDN purge requests answered since the server was reset */
++ (NSUInteger)purgeCount;
+
+@end
@@ -0,0 +1,1335 @@
+//
+//  RSStubServer.m
+//  RackspaceCloudFilesTests
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSStubServer.h"
+#import "RSClient.h"
+#import <CommonCrypto/CommonDigest.h>
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+#define kRSStubHost @"stub.cloudfiles.local"
+#define kRSStubCDNHost @"cdn.stub.cloudfiles.local"
+#define kRSStubAccountPath @"/v1/AUTH_stub"
+#define kRSStubUsername @"stub"
+#define kRSStubApiKey @"stub-api-key"
+#define kRSStubListingLimit 10000
+#define kRSStubChunkSize 1048576
+#define kRSStubDefaultTTL 259200
+
+static NSString *RSStubMD5(NSData *data) {
+
+    unsigned char digest[CC_MD5_DIGEST_LENGTH];
+    CC_MD5([data bytes], (CC_LONG)[data length], digest);
+
+    NSMutableString *hex = [[NSMutableString alloc] initWithCapacity:CC_MD5_DIGEST_LENGTH * 2];
+    for (NSUInteger i = 0; i < CC_MD5_DIGEST_LENGTH; i++) {
+        [hex appendFormat:@"%02x", digest[i]];
+    }
+    return hex;
+
+}
+
+static NSString *RSStubHTTPDate(NSDate *date) {
+
+    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+    [formatter setLocale:[[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"]];
+    [formatter setTimeZone:[NSTimeZone timeZoneWithAbbreviation:@"GMT"]];
+    [formatter setDateFormat:@"EEE, dd MMM yyyy HH:mm:ss 'GMT'"];
+    return [formatter stringFromDate:date];
+
+}
+
+static NSString *RSStubListingDate(NSDate *date) {
+
+    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+    [formatter setLocale:[[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"]];
+    [formatter setTimeZone:[NSTimeZone timeZoneWithAbbreviation:@"GMT"]];
+    [formatter setDateFormat:@"yyyy-MM-dd'T'HH:mm:ss.SSSSSS"];
+    return [formatter stringFromDate:date];
+
+}
+
+static NSString *RSStubDecode(NSString *string) {
+
+    NSString *decoded = [string stringByReplacingPercentEscapesUsingEncoding:NSUTF8StringEncoding];
+    return decoded ? decoded : string;
+
+}
+
+static NSData *RSStubRequestBody(NSURLRequest *request) {
+
+    if ([request HTTPBody]) {
+        return [request HTTPBody];
+    }
+
+    NSInputStream *stream = [request HTTPBodyStream];
+    NSMutableData *body = [[NSMutableData alloc] init];
+
+    if (stream) {
+
+        uint8_t buffer[65536];
+        NSInteger length = 0;
+
+        [stream open];
+        while ((length = [stream read:buffer maxLength:sizeof(buffer)]) > 0) {
+            [body appendBytes:buffer length:length];
+        }
+        [stream close];
+
+    }
+
+    return body;
+
+}
+
+static NSComparisonResult (^RSStubCompareNames)(id, id) = ^NSComparisonResult(id a, id b) {
+    return [a compare:b options:NSLiteralSearch];
+};
+
+#pragma mark - Model
+
+@interface RSStubObject : NSObject
+
+@property (nonatomic, strong) NSData *data;
+@property (nonatomic, strong) NSString *etag;
+@property (nonatomic, strong) NSString *contentType;
+@property (nonatomic, strong) NSString *contentEncoding;
+@property (nonatomic, strong) NSDate *lastModified;
+@property (nonatomic, strong) NSMutableDictionary *metadata;
+@property (nonatomic, strong) NSString *manifest;
+@property (nonatomic, strong) NSArray *segments;
+
+@end
+
+@implementation RSStubObject
+
+@synthesize data, etag, contentType, contentEncoding, lastModified, metadata, manifest, segments;
+
+@end
+
+@interface RSStubContainer : NSObject
+
+@property (nonatomic, strong) NSMutableDictionary *objects;
+@property (nonatomic, strong) NSMutableDictionary *metadata;
+@property (nonatomic) BOOL cdnKnown;
+@property (nonatomic) BOOL cdnEnabled;
+@property (nonatomic) BOOL logRetention;
+@property (nonatomic) NSUInteger ttl;
+
+@end
+
+@implementation RSStubContainer
+
+@synthesize objects, metadata, cdnKnown, cdnEnabled, logRetention, ttl;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.objects = [[NSMutableDictionary alloc] init];
+        self.metadata = [[NSMutableDictionary alloc] init];
+        self.ttl = kRSStubDefaultTTL;
+    }
+    return self;
+
+}
+
+@end
+
+@interface RSStubResponse : NSObject
+
+@property (nonatomic) NSInteger statusCode;
+@property (nonatomic, strong) NSMutableDictionary *headers;
+@property (nonatomic, strong) NSData *data;
+@property (nonatomic) BOOL dropped;
+
++ (RSStubResponse *)responseWithStatus:(NSInteger)statusCode;
++ (RSStubResponse *)responseWithStatus:(NSInteger)statusCode JSONObject:(id)object;
+
+@end
+
+@implementation RSStubResponse
+
+@synthesize statusCode, headers, data, dropped;
+
++ (RSStubResponse *)responseWithStatus:(NSInteger)statusCode {
+
+    RSStubResponse *response = [[RSStubResponse alloc] init];
+    response.statusCode = statusCode;
+    response.headers = [[NSMutableDictionary alloc] init];
+    return response;
+
+}
+
++ (RSStubResponse *)responseWithStatus:(NSInteger)statusCode JSONObject:(id)object {
+
+    RSStubResponse *response = [RSStubResponse responseWithStatus:statusCode];
+    response.data = [NSJSONSerialization dataWithJSONObject:object options:0 error:nil];
+    [response.headers setObject:@"application/json; charset=utf-8" forKey:@"Content-Type"];
+    return response;
+
+}
+
+@end
+
+#pragma mark - State
+
+// everything below is only touched on RSStubQueue
+static dispatch_queue_t RSStubQueue;
+static NSMutableDictionary *RSStubContainers;
+static NSString *RSStubToken;
+static NSUInteger RSStubTokenSerial;
+static NSTimeInterval RSStubLatency;
+static unsigned long long RSStubBandwidth;
+static double RSStubErrorRate;
+static NSInteger RSStubErrorStatus;
+static NSUInteger RSStubFailuresRemaining;
+static NSInteger RSStubFailureStatus;
+static BOOL RSStubBulkEnabled;
+static NSUInteger RSStubRequestCount;
+static unsigned long long RSStubBytesReceived;
+static NSUInteger RSStubAuthenticationCount;
+static NSUInteger RSStubPurgeCount;
+
+@interface RSStubServer ()
+
+@property (strong) NSThread *clientThread;
+@property BOOL stopped;
+
++ (RSStubResponse *)responseForRequest:(NSURLRequest *)request body:(NSData *)body;
++ (RSStubResponse *)authenticationResponse:(NSURLRequest *)request;
++ (RSStubResponse *)accountResponse:(NSURLRequest *)request query:(NSDictionary *)query body:(NSData *)body;
++ (RSStubResponse *)containerResponse:(NSURLRequest *)request name:(NSString *)name query:(NSDictionary *)query body:(NSData *)body;
++ (RSStubResponse *)objectResponse:(NSURLRequest *)request container:(RSStubContainer *)container name:(NSString *)name query:(NSDictionary *)query body:(NSData *)body;
++ (RSStubResponse *)cdnResponse:(NSURLRequest *)request containerName:(NSString *)containerName objectName:(NSString *)objectName query:(NSDictionary *)query;
++ (NSArray *)listingOfNames:(NSArray *)names query:(NSDictionary *)query;
++ (RSStubResponse *)listingResponse:(NSArray *)entries query:(NSDictionary *)query;
++ (NSData *)bodyOfObject:(RSStubObject *)object etag:(NSString **)etag;
++ (NSDictionary *)metadataFromRequest:(NSURLRequest *)request prefix:(NSString *)prefix;
++ (RSStubResponse *)bulkDelete:(NSData *)body;
++ (RSStubResponse *)extractArchive:(NSData *)body intoContainer:(NSString *)containerName;
++ (NSString *)cdnURIForContainer:(NSString *)name scheme:(NSString *)scheme suffix:(NSString *)suffix;
+
+- (void)sendResponse:(RSStubResponse *)stubResponse latency:(NSTimeInterval)latency bandwidth:(unsigned long long)bandwidth requestLength:(NSUInteger)requestLength;
+- (void)performOnClientThread:(void (^)())block;
+- (void)performBlock:(void (^)())block;
+
+@end
+
+@implementation RSStubServer
+
+@synthesize clientThread, stopped;
+
+#pragma mark - Configuration
+
++ (void)initialize {
+
+    if (self == [RSStubServer class]) {
+        RSStubQueue = dispatch_queue_create("com.rackspace.cloudfiles.stubserver", DISPATCH_QUEUE_SERIAL);
+        RSStubContainers = [[NSMutableDictionary alloc] init];
+    }
+
+}
+
++ (void)start {
+
+    [self reset];
+    [NSURLProtocol registerClass:self];
+
+}
+
++ (void)stop {
+
+    [NSURLProtocol unregisterClass:self];
+
+}
+
++ (void)prepareClient:(RSClient *)client {
+
+    if ([client.transport isKindOfClass:[RSSessionTransport class]]) {
+        [(RSSessionTransport *)client.transport setProtocolClasses:[NSArray arrayWithObject:self]];
+    }
+
+}
+
++ (void)reset {
+
+    dispatch_sync(RSStubQueue, ^{
+        [RSStubContainers removeAllObjects];
+        RSStubToken = nil;
+        RSStubLatency = 0;
+        RSStubBandwidth = 0;
+        RSStubErrorRate = 0;
+        RSStubErrorStatus = 0;
+        RSStubFailuresRemaining = 0;
+        RSStubFailureStatus = 0;
+        RSStubBulkEnabled = YES;
+        RSStubRequestCount = 0;
+        RSStubBytesReceived = 0;
+        RSStubAuthenticationCount = 0;
+        RSStubPurgeCount = 0;
+    });
+
+}
+
++ (NSHTTPURLResponse *)answerRequest:(NSURLRequest *)request body:(NSData *)body data:(NSData **)data {
+
+    __block RSStubResponse *stubResponse = nil;
+
+    dispatch_sync(RSStubQueue, ^{
+        stubResponse = [RSStubServer responseForRequest:request body:body];
+    });
+
+    if (stubResponse.dropped) {
+        return nil;
+    }
+
+    NSData *responseData = [[request HTTPMethod] isEqualToString:@"HEAD"] ? nil : stubResponse.data;
+
+    if (![stubResponse.headers objectForKey:@"Content-Length"]) {
+        [stubResponse.headers setObject:$S(@"%lu", (unsigned long)[responseData length]) forKey:@"Content-Length"];
+    }
+
+    if (data) {
+        *data = responseData;
+    }
+
+    return [[NSHTTPURLResponse alloc] initWithURL:[request URL] statusCode:stubResponse.statusCode HTTPVersion:@"HTTP/1.1" headerFields:stubResponse.headers];
+
+}
+
++ (NSURL *)authURL {
+    return [NSURL URLWithString:$S(@"http://%@/v1.0", kRSStubHost)];
+}
+
++ (NSString *)username {
+    return kRSStubUsername;
+}
+
++ (NSString *)apiKey {
+    return kRSStubApiKey;
+}
+
++ (void)setLatency:(NSTimeInterval)latency {
+    dispatch_sync(RSStubQueue, ^{
+        RSStubLatency = latency;
+    });
+}
+
++ (void)setBandwidth:(unsigned long long)bytesPerSecond {
+    dispatch_sync(RSStubQueue, ^{
+        RSStubBandwidth = bytesPerSecond;
+    });
+}
+
++ (void)setErrorRate:(double)errorRate statusCode:(NSInteger)statusCode {
+    dispatch_sync(RSStubQueue, ^{
+        RSStubErrorRate = errorRate;
+        RSStubErrorStatus = statusCode;
+    });
+}
+
++ (void)failNextRequests:(NSUInteger)count statusCode:(NSInteger)statusCode {
+    dispatch_sync(RSStubQueue, ^{
+        RSStubFailuresRemaining = count;
+        RSStubFailureStatus = statusCode;
+    });
+}
+
++ (void)setBulkOperationsEnabled:(BOOL)enabled {
+    dispatch_sync(RSStubQueue, ^{
+        RSStubBulkEnabled = enabled;
+    });
+}
+
++ (void)expireAuthToken {
+    dispatch_sync(RSStubQueue, ^{
+        RSStubToken = nil;
+    });
+}
+
++ (void)setData:(NSData *)data forObject:(NSString *)name inContainer:(NSString *)containerName {
+
+    dispatch_sync(RSStubQueue, ^{
+
+        RSStubContainer *container = [RSStubContainers objectForKey:containerName];
+        if (!container) {
+            container = [[RSStubContainer alloc] init];
+            [RSStubContainers setObject:container forKey:containerName];
+        }
+
+        RSStubObject *object = [[RSStubObject alloc] init];
+        object.data = data;
+        object.etag = RSStubMD5(data);
+        object.contentType = @"application/octet-stream";
+        object.lastModified = [NSDate date];
+        object.metadata = [[NSMutableDictionary alloc] init];
+        [container.objects setObject:object forKey:name];
+
+    });
+
+}
+
++ (NSUInteger)requestCount {
+    __block NSUInteger count = 0;
+    dispatch_sync(RSStubQueue, ^{
+        count = RSStubRequestCount;
+    });
+    return count;
+}
+
++ (unsigned long long)bytesReceived {
+    __block unsigned long long bytes = 0;
+    dispatch_sync(RSStubQueue, ^{
+        bytes = RSStubBytesReceived;
+    });
+    return bytes;
+}
+
++ (NSUInteger)authenticationCount {
+    __block NSUInteger count = 0;
+    dispatch_sync(RSStubQueue, ^{
+        count = RSStubAuthenticationCount;
+    });
+    return count;
+}
+
++ (NSUInteger)purgeCount {
+    __block NSUInteger count = 0;
+    dispatch_sync(RSStubQueue, ^{
+        count = RSStubPurgeCount;
+    });
+    return count;
+}
+
+#pragma mark - NSURLProtocol
+
++ (BOOL)canInitWithRequest:(NSURLRequest *)request {
+
+    NSString *host = [[request URL] host];
+    return [host isEqualToString:kRSStubHost] || [host isEqualToString:kRSStubCDNHost];
+
+}
+
++ (NSURLRequest *)canonicalRequestForRequest:(NSURLRequest *)request {
+
+    return request;
+
+}
+
+- (void)startLoading {
+
+    self.clientThread = [NSThread currentThread];
+    self.stopped = NO;
+
+    NSURLRequest *request = self.request;
+
+    // bodies are read and responses paced off the loading thread, so slow responses don't hold up others
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+
+        NSData *body = RSStubRequestBody(request);
+
+        __block RSStubResponse *stubResponse = nil;
+        __block NSTimeInterval latency = 0;
+        __block unsigned long long bandwidth = 0;
+
+        dispatch_sync(RSStubQueue, ^{
+            stubResponse = [RSStubServer responseForRequest:request body:body];
+            latency = RSStubLatency;
+            bandwidth = RSStubBandwidth;
+        });
+
+        [self sendResponse:stubResponse latency:latency bandwidth:bandwidth requestLength:[body length]];
+
+    });
+
+}
+
+- (void)stopLoading {
+
+    self.stopped = YES;
+
+}
+
+- (void)sendResponse:(RSStubResponse *)stubResponse latency:(NSTimeInterval)latency bandwidth:(unsigned long long)bandwidth requestLength:(NSUInteger)requestLength {
+
+    NSTimeInterval delay = latency + (bandwidth > 0 ? (double)requestLength / bandwidth : 0);
+    if (delay > 0) {
+        [NSThread sleepForTimeInterval:delay];
+    }
+
+    if (stubResponse.dropped) {
+        [self performOnClientThread:^{
+            [self.client URLProtocol:self didFailWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorNetworkConnectionLost userInfo:nil]];
+        }];
+        return;
+    }
+
+    NSData *data = [[self.request HTTPMethod] isEqualToString:@"HEAD"] ? nil : stubResponse.data;
+
+    if (![stubResponse.headers objectForKey:@"Content-Length"]) {
+        [stubResponse.headers setObject:$S(@"%lu", (unsigned long)[data length]) forKey:@"Content-Length"];
+    }
+
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:[self.request URL] statusCode:stubResponse.statusCode HTTPVersion:@"HTTP/1.1" headerFields:stubResponse.headers];
+
+    [self performOnClientThread:^{
+        [self.client URLProtocol:self didReceiveResponse:response cacheStoragePolicy:NSURLCacheStorageNotAllowed];
+    }];
+
+    NSUInteger length = [data length];
+    NSUInteger chunkSize = bandwidth > 0 ? (NSUInteger)MAX(bandwidth / 20, 1) : kRSStubChunkSize;
+
+    for (NSUInteger offset = 0; offset < length && !self.stopped; offset += chunkSize) {
+
+        NSData *chunk = [data subdataWithRange:NSMakeRange(offset, MIN(chunkSize, length - offset))];
+
+        if (bandwidth > 0) {
+            [NSThread sleepForTimeInterval:(double)[chunk length] / bandwidth];
+        }
+
+        [self performOnClientThread:^{
+            [self.client URLProtocol:self didLoadData:chunk];
+        }];
+
+    }
+
+    [self performOnClientThread:^{
+        [self.client URLProtocolDidFinishLoading:self];
+    }];
+
+}
+
+- (void)performOnClientThread:(void (^)())block {
+
+    [self performSelector:@selector(performBlock:) onThread:self.clientThread withObject:[block copy] waitUntilDone:NO];
+
+}
+
+- (void)performBlock:(void (^)())block {
+
+    if (!self.stopped) {
+        block();
+    }
+
+}
+
+#pragma mark - Routing
+
++ (RSStubResponse *)responseForRequest:(NSURLRequest *)request body:(NSData *)body {
+
+    RSStubRequestCount++;
+    RSStubBytesReceived += [body length];
+
+    NSURL *url = [request URL];
+    NSString *path = RSStubDecode(CFBridgingRelease(CFURLCopyPath((__bridge CFURLRef)url)));
+
+    if ([[url host] isEqualToString:kRSStubHost] && [path isEqualToString:@"/v1.0"]) {
+        return [self authenticationResponse:request];
+    }
+
+    if (!RSStubToken || ![[request valueForHTTPHeaderField:@"X-Auth-Token"] isEqualToString:RSStubToken]) {
+        return [RSStubResponse responseWithStatus:401];
+    }
+
+    NSInteger injectedStatus = -1;
+
+    if (RSStubFailuresRemaining > 0) {
+        RSStubFailuresRemaining--;
+        injectedStatus = RSStubFailureStatus;
+    } else if (RSStubErrorRate > 0 && (double)arc4random() / UINT32_MAX < RSStubErrorRate) {
+        injectedStatus = RSStubErrorStatus;
+    }
+
+    if (injectedStatus == 0) {
+        RSStubResponse *response = [RSStubResponse responseWithStatus:0];
+        response.dropped = YES;
+        return response;
+    } else if (injectedStatus > 0) {
+        return [RSStubResponse responseWithStatus:injectedStatus];
+    }
+
+    if (![path hasPrefix:kRSStubAccountPath]) {
+        return [RSStubResponse responseWithStatus:404];
+    }
+
+    NSMutableDictionary *query = [[NSMutableDictionary alloc] init];
+
+    for (NSString *pair in [[url query] componentsSeparatedByString:@"&"]) {
+
+        if ([pair length] == 0) {
+            continue;
+        }
+
+        NSRange equals = [pair rangeOfString:@"="];
+        if (equals.location == NSNotFound) {
+            [query setObject:@"" forKey:RSStubDecode(pair)];
+        } else {
+            [query setObject:RSStubDecode([pair substringFromIndex:NSMaxRange(equals)]) forKey:RSStubDecode([pair substringToIndex:equals.location])];
+        }
+
+    }
+
+    // what's left is "", "container", or "container/object"
+    NSString *rest = [path substringFromIndex:[kRSStubAccountPath length]];
+    if ([rest hasPrefix:@"/"]) {
+        rest = [rest substringFromIndex:1];
+    }
+
+    NSString *containerName = rest;
+    NSString *objectName = nil;
+    NSRange slash = [rest rangeOfString:@"/"];
+
+    if (slash.location != NSNotFound) {
+        containerName = [rest substringToIndex:slash.location];
+        objectName = [rest substringFromIndex:NSMaxRange(slash)];
+        if ([objectName length] == 0) {
+            objectName = nil;
+        }
+    }
+
+    if ([[url host] isEqualToString:kRSStubCDNHost]) {
+        return [self cdnResponse:request containerName:containerName objectName:objectName query:query];
+    }
+
+    if ([containerName length] == 0) {
+        return [self accountResponse:request query:query body:body];
+    }
+
+    if (!objectName) {
+        return [self containerResponse:request name:containerName query:query body:body];
+    }
+
+    RSStubContainer *container = [RSStubContainers objectForKey:containerName];
+    if (!container) {
+        return [RSStubResponse responseWithStatus:404];
+    }
+
+    return [self objectResponse:request container:container name:objectName query:query body:body];
+
+}
+
++ (RSStubResponse *)authenticationResponse:(NSURLRequest *)request {
+
+    RSStubAuthenticationCount++;
+
+    if (![[request valueForHTTPHeaderField:@"X-Auth-User"] isEqualToString:kRSStubUsername] || ![[request valueForHTTPHeaderField:@"X-Auth-Key"] isEqualToString:kRSStubApiKey]) {
+        return [RSStubResponse responseWithStatus:401];
+    }
+
+    RSStubTokenSerial++;
+    RSStubToken = $S(@"stub-token-%lu", (unsigned long)RSStubTokenSerial);
+
+    RSStubResponse *response = [RSStubResponse responseWithStatus:204];
+    [response.headers setObject:RSStubToken forKey:@"X-Auth-Token"];
+    [response.headers setObject:$S(@"http://%@%@", kRSStubHost, kRSStubAccountPath) forKey:@"X-Storage-Url"];
+    [response.headers setObject:$S(@"http://%@%@", kRSStubCDNHost, kRSStubAccountPath) forKey:@"X-Cdn-Management-Url"];
+    return response;
+
+}
+
+#pragma mark - Account
+
++ (RSStubResponse *)accountResponse:(NSURLRequest *)request query:(NSDictionary *)query body:(NSData *)body {
+
+    NSString *method = [request HTTPMethod];
+
+    if ([method isEqualToString:@"POST"]) {
+        // without the bulk middleware, this is an account metadata update
+        return RSStubBulkEnabled && [query objectForKey:@"bulk-delete"] ? [self bulkDelete:body] : [RSStubResponse responseWithStatus:204];
+    }
+
+    unsigned long long bytesUsed = 0;
+    for (RSStubContainer *container in [RSStubContainers allValues]) {
+        for (RSStubObject *object in [container.objects allValues]) {
+            bytesUsed += [object.data length];
+        }
+    }
+
+    if ([method isEqualToString:@"HEAD"]) {
+        RSStubResponse *response = [RSStubResponse responseWithStatus:204];
+        [response.headers setObject:$S(@"%lu", (unsigned long)[RSStubContainers count]) forKey:@"X-Account-Container-Count"];
+        [response.headers setObject:$S(@"%llu", bytesUsed) forKey:@"X-Account-Bytes-Used"];
+        return response;
+    }
+
+    if (![method isEqualToString:@"GET"]) {
+        return [RSStubResponse responseWithStatus:405];
+    }
+
+    NSMutableArray *entries = [[NSMutableArray alloc] init];
+
+    for (id entry in [self listingOfNames:[RSStubContainers allKeys] query:query]) {
+
+        if ([entry isKindOfClass:[NSDictionary class]]) {
+            [entries addObject:entry];
+            continue;
+        }
+
+        RSStubContainer *container = [RSStubContainers objectForKey:entry];
+        unsigned long long bytes = 0;
+        for (RSStubObject *object in [container.objects allValues]) {
+            bytes += [object.data length];
+        }
+
+        [entries addObject:[NSDictionary dictionaryWithObjectsAndKeys:entry, @"name", [NSNumber numberWithUnsignedInteger:[container.objects count]], @"count", [NSNumber numberWithUnsignedLongLong:bytes], @"bytes", nil]];
+
+    }
+
+    RSStubResponse *response = [self listingResponse:entries query:query];
+    [response.headers setObject:$S(@"%lu", (unsigned long)[RSStubContainers count]) forKey:@"X-Account-Container-Count"];
+    [response.headers setObject:$S(@"%llu", bytesUsed) forKey:@"X-Account-Bytes-Used"];
+    return response;
+
+}
+
++ (RSStubResponse *)bulkDelete:(NSData *)body {
+
+    NSString *text = [[NSString alloc] initWithData:body encoding:NSUTF8StringEncoding];
+    NSUInteger deleted = 0;
+    NSUInteger notFound = 0;
+    NSMutableArray *errors = [[NSMutableArray alloc] init];
+
+    for (NSString *line in [text componentsSeparatedByString:@"\n"]) {
+
+        NSString *path = RSStubDecode([line stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]]);
+        if ([path hasPrefix:@"/"]) {
+            path = [path substringFromIndex:1];
+        }
+        if ([path length] == 0) {
+            continue;
+        }
+
+        NSRange slash = [path rangeOfString:@"/"];
+        NSString *containerName = slash.location == NSNotFound ? path : [path substringToIndex:slash.location];
+        NSString *objectName = slash.location == NSNotFound ? nil : [path substringFromIndex:NSMaxRange(slash)];
+        RSStubContainer *container = [RSStubContainers objectForKey:containerName];
+
+        if (objectName) {
+            if ([container.objects objectForKey:objectName]) {
+                [container.objects removeObjectForKey:objectName];
+                deleted++;
+            } else {
+                notFound++;
+            }
+        } else if (!container) {
+            notFound++;
+        } else if ([container.objects count] > 0) {
+            [errors addObject:[NSArray arrayWithObjects:$S(@"/%@", path), @"409 Conflict", nil]];
+        } else {
+            [RSStubContainers removeObjectForKey:containerName];
+            deleted++;
+        }
+
+    }
+
+    NSDictionary *result = [NSDictionary dictionaryWithObjectsAndKeys:
+                            [NSNumber numberWithUnsignedInteger:deleted], @"Number Deleted",
+                            [NSNumber numberWithUnsignedInteger:notFound], @"Number Not Found",
+                            [errors count] > 0 ? @"400 Bad Request" : @"200 OK", @"Response Status",
+                            @"", @"Response Body",
+                            errors, @"Errors",
+                            nil];
+
+    return [RSStubResponse responseWithStatus:200 JSONObject:result];
+
+}
+
+#pragma mark - Containers
+
++ (RSStubResponse *)containerResponse:(NSURLRequest *)request name:(NSString *)name query:(NSDictionary *)query body:(NSData *)body {
+
+    NSString *method = [request HTTPMethod];
+    RSStubContainer *container = [RSStubContainers objectForKey:name];
+
+    if ([method isEqualToString:@"PUT"]) {
+
+        if (RSStubBulkEnabled && [query objectForKey:@"extract-archive"]) {
+            return [self extractArchive:body intoContainer:name];
+        }
+
+        BOOL created = container == nil;
+        if (created) {
+            container = [[RSStubContainer alloc] init];
+            [RSStubContainers setObject:container forKey:name];
+        }
+        [container.metadata addEntriesFromDictionary:[self metadataFromRequest:request prefix:@"X-Container-Meta-"]];
+
+        return [RSStubResponse responseWithStatus:created ? 201 : 202];
+
+    }
+
+    if (!container) {
+        return [RSStubResponse responseWithStatus:404];
+    }
+
+    if ([method isEqualToString:@"POST"]) {
+        [container.metadata addEntriesFromDictionary:[self metadataFromRequest:request prefix:@"X-Container-Meta-"]];
+        return [RSStubResponse responseWithStatus:204];
+    }
+
+    if ([method isEqualToString:@"DELETE"]) {
+        if ([container.objects count] > 0) {
+            return [RSStubResponse responseWithStatus:409];
+        }
+        [RSStubContainers removeObjectForKey:name];
+        return [RSStubResponse responseWithStatus:204];
+    }
+
+    unsigned long long bytes = 0;
+    for (RSStubObject *object in [container.objects allValues]) {
+        bytes += [object.data length];
+    }
+
+    RSStubResponse *response = nil;
+
+    if ([method isEqualToString:@"HEAD"]) {
+
+        response = [RSStubResponse responseWithStatus:204];
+
+    } else if ([method isEqualToString:@"GET"]) {
+
+        NSMutableArray *entries = [[NSMutableArray alloc] init];
+
+        for (id entry in [self listingOfNames:[container.objects allKeys] query:query]) {
+
+            if ([entry isKindOfClass:[NSDictionary class]]) {
+                [entries addObject:entry];
+                continue;
+            }
+
+            RSStubObject *object = [container.objects objectForKey:entry];
+            [entries addObject:[NSDictionary dictionaryWithObjectsAndKeys:
+                                entry, @"name",
+                                object.etag, @"hash",
+                                [NSNumber numberWithUnsignedInteger:[object.data length]], @"bytes",
+                                object.contentType, @"content_type",
+                                RSStubListingDate(object.lastModified), @"last_modified",
+                                nil]];
+
+        }
+
+        response = [self listingResponse:entries query:query];
+
+    } else {
+        return [RSStubResponse responseWithStatus:405];
+    }
+
+    [response.headers setObject:$S(@"%lu", (unsigned long)[container.objects count]) forKey:@"X-Container-Object-Count"];
+    [response.headers setObject:$S(@"%llu", bytes) forKey:@"X-Container-Bytes-Used"];
+    for (NSString *key in container.metadata) {
+        [response.headers setObject:[container.metadata objectForKey:key] forKey:$S(@"X-Container-Meta-%@", key)];
+    }
+
+    return response;
+
+}
+
++ (RSStubResponse *)extractArchive:(NSData *)body intoContainer:(NSString *)containerName {
+
+    RSStubContainer *container = [RSStubContainers objectForKey:containerName];
+    if (!container) {
+        container = [[RSStubContainer alloc] init];
+        [RSStubContainers setObject:container forKey:containerName];
+    }
+
+    const char *bytes = [body bytes];
+    NSUInteger length = [body length];
+    NSUInteger offset = 0;
+    NSUInteger created = 0;
+    NSString *longName = nil;
+
+    while (offset + 512 <= length && bytes[offset] != 0) {
+
+        const char *header = bytes + offset;
+        NSString *name = [[NSString alloc] initWithBytes:header length:strnlen(header, 100) encoding:NSUTF8StringEncoding];
+        NSString *prefix = strncmp(header + 257, "ustar", 5) == 0 ? [[NSString alloc] initWithBytes:header + 345 length:strnlen(header + 345, 155) encoding:NSUTF8StringEncoding] : @"";
+        unsigned long long size = strtoull([[[NSString alloc] initWithBytes:header + 124 length:strnlen(header + 124, 12) encoding:NSASCIIStringEncoding] UTF8String], NULL, 8);
+        char type = header[156];
+        NSUInteger dataOffset = offset + 512;
+
+        if (dataOffset + size > length) {
+            return [RSStubResponse responseWithStatus:400];
+        }
+
+        if (type == 'L') {
+
+            // a GNU long name applies to the entry after it
+            longName = [[NSString alloc] initWithBytes:bytes + dataOffset length:strnlen(bytes + dataOffset, (size_t)size) encoding:NSUTF8StringEncoding];
+
+        } else {
+
+            if (type == '0' || type == 0) {
+
+                NSString *objectName = longName ? longName : ([prefix length] > 0 ? $S(@"%@/%@", prefix, name) : name);
+                NSData *data = [body subdataWithRange:NSMakeRange(dataOffset, (NSUInteger)size)];
+
+                RSStubObject *object = [[RSStubObject alloc] init];
+                object.data = data;
+                object.etag = RSStubMD5(data);
+                object.contentType = @"application/octet-stream";
+                object.lastModified = [NSDate date];
+                object.metadata = [[NSMutableDictionary alloc] init];
+                [container.objects setObject:object forKey:objectName];
+                created++;
+
+            }
+
+            longName = nil;
+
+        }
+
+        offset = dataOffset + (NSUInteger)((size + 511) / 512) * 512;
+
+    }
+
+    NSDictionary *result = [NSDictionary dictionaryWithObjectsAndKeys:
+                            [NSNumber numberWithUnsignedInteger:created], @"Number Files Created",
+                            @"201 Created", @"Response Status",
+                            @"", @"Response Body",
+                            [NSArray array], @"Errors",
+                            nil];
+
+    return [RSStubResponse responseWithStatus:200 JSONObject:result];
+
+}
+
+#pragma mark - Objects
+
++ (RSStubResponse *)objectResponse:(NSURLRequest *)request container:(RSStubContainer *)container name:(NSString *)name query:(NSDictionary *)query body:(NSData *)body {
+
+    NSString *method = [request HTTPMethod];
+    RSStubObject *object = [container.objects objectForKey:name];
+
+    if ([method isEqualToString:@"PUT"]) {
+
+        RSStubObject *newObject = [[RSStubObject alloc] init];
+        newObject.lastModified = [NSDate date];
+        newObject.metadata = [NSMutableDictionary dictionaryWithDictionary:[self metadataFromRequest:request prefix:@"X-Object-Meta-"]];
+        newObject.contentType = [request valueForHTTPHeaderField:@"Content-Type"] ? [request valueForHTTPHeaderField:@"Content-Type"] : @"application/octet-stream";
+        newObject.contentEncoding = [request valueForHTTPHeaderField:@"Content-Encoding"];
+
+        if ([query objectForKey:@"multipart-manifest"]) {
+
+            NSArray *manifest = [NSJSONSerialization JSONObjectWithData:body options:0 error:nil];
+            NSMutableArray *segments = [[NSMutableArray alloc] init];
+            NSMutableString *etags = [[NSMutableString alloc] init];
+
+            if (![manifest isKindOfClass:[NSArray class]]) {
+                return [RSStubResponse responseWithStatus:400];
+            }
+
+            for (NSDictionary *segment in manifest) {
+
+                NSString *segmentPath = [segment objectForKey:@"path"];
+                if ([segmentPath hasPrefix:@"/"]) {
+                    segmentPath = [segmentPath substringFromIndex:1];
+                }
+
+                NSRange slash = [segmentPath rangeOfString:@"/"];
+                RSStubObject *segmentObject = slash.location == NSNotFound ? nil : [[[RSStubContainers objectForKey:[segmentPath substringToIndex:slash.location]] objects] objectForKey:[segmentPath substringFromIndex:NSMaxRange(slash)]];
+
+                if (!segmentObject || ([segment objectForKey:@"etag"] && ![[segment objectForKey:@"etag"] isEqualToString:segmentObject.etag])) {
+                    return [RSStubResponse responseWithStatus:400];
+                }
+
+                [segments addObject:segmentPath];
+                [etags appendString:segmentObject.etag];
+
+            }
+
+            newObject.segments = segments;
+            newObject.data = [NSData data];
+            newObject.etag = $S(@"\"%@\"", RSStubMD5([etags dataUsingEncoding:NSUTF8StringEncoding]));
+
+        } else {
+
+            NSString *expectedETag = [request valueForHTTPHeaderField:@"ETag"];
+
+            newObject.data = body;
+            newObject.etag = RSStubMD5(body);
+            newObject.manifest = [request valueForHTTPHeaderField:@"X-Object-Manifest"];
+
+            if (expectedETag && [expectedETag caseInsensitiveCompare:newObject.etag] != NSOrderedSame) {
+                return [RSStubResponse responseWithStatus:422];
+            }
+
+        }
+
+        [container.objects setObject:newObject forKey:name];
+
+        RSStubResponse *response = [RSStubResponse responseWithStatus:201];
+        [response.headers setObject:newObject.etag forKey:@"ETag"];
+        [response.headers setObject:RSStubHTTPDate(newObject.lastModified) forKey:@"Last-Modified"];
+        return response;
+
+    }
+
+    if (!object) {
+        return [RSStubResponse responseWithStatus:404];
+    }
+
+    if ([method isEqualToString:@"POST"]) {
+        object.metadata = [NSMutableDictionary dictionaryWithDictionary:[self metadataFromRequest:request prefix:@"X-Object-Meta-"]];
+        return [RSStubResponse responseWithStatus:202];
+    }
+
+    if ([method isEqualToString:@"DELETE"]) {
+        [container.objects removeObjectForKey:name];
+        return [RSStubResponse responseWithStatus:204];
+    }
+
+    if (![method isEqualToString:@"GET"] && ![method isEqualToString:@"HEAD"]) {
+        return [RSStubResponse responseWithStatus:405];
+    }
+
+    NSString *etag = nil;
+    NSData *data = [self bodyOfObject:object etag:&etag];
+    NSString *ifMatch = [request valueForHTTPHeaderField:@"If-Match"];
+    NSString *ifNoneMatch = [request valueForHTTPHeaderField:@"If-None-Match"];
+
+    RSStubResponse *response = nil;
+
+    if (ifMatch && ![ifMatch isEqualToString:@"*"] && ![ifMatch isEqualToString:etag]) {
+        return [RSStubResponse responseWithStatus:412];
+    }
+
+    if (ifNoneMatch && [ifNoneMatch isEqualToString:etag]) {
+
+        response = [RSStubResponse responseWithStatus:304];
+
+    } else {
+
+        NSString *range = [request valueForHTTPHeaderField:@"Range"];
+        unsigned long long total = [data length];
+
+        if ([range hasPrefix:@"bytes="] && [range rangeOfString:@","].location == NSNotFound && [method isEqualToString:@"GET"]) {
+
+            NSArray *bounds = [[range substringFromIndex:6] componentsSeparatedByString:@"-"];
+            NSString *first = [bounds objectAtIndex:0];
+            NSString *last = [bounds count] > 1 ? [bounds objectAtIndex:1] : @"";
+            unsigned long long start = 0;
+            unsigned long long end = total > 0 ? total - 1 : 0;
+
+            if ([first length] == 0) {
+                unsigned long long suffix = strtoull([last UTF8String], NULL, 10);
+                start = suffix < total ? total - suffix : 0;
+            } else {
+                start = strtoull([first UTF8String], NULL, 10);
+                if ([last length] > 0) {
+                    end = MIN(strtoull([last UTF8String], NULL, 10), end);
+                }
+            }
+
+            if (start >= total || start > end) {
+                response = [RSStubResponse responseWithStatus:416];
+                [response.headers setObject:$S(@"bytes */%llu", total) forKey:@"Content-Range"];
+                return response;
+            }
+
+            response = [RSStubResponse responseWithStatus:206];
+            response.data = [data subdataWithRange:NSMakeRange((NSUInteger)start, (NSUInteger)(end - start + 1))];
+            [response.headers setObject:$S(@"bytes %llu-%llu/%llu", start, end, total) forKey:@"Content-Range"];
+
+        } else {
+
+            response = [RSStubResponse responseWithStatus:200];
+            response.data = data;
+
+        }
+
+        [response.headers setObject:$S(@"%lu", (unsigned long)[response.data length]) forKey:@"Content-Length"];
+
+    }
+
+    [response.headers setObject:etag forKey:@"ETag"];
+    [response.headers setObject:object.contentType forKey:@"Content-Type"];
+    if (object.contentEncoding) {
+        [response.headers setObject:object.contentEncoding forKey:@"Content-Encoding"];
+    }
+    [response.headers setObject:RSStubHTTPDate(object.lastModified) forKey:@"Last-Modified"];
+    [response.headers setObject:@"bytes" forKey:@"Accept-Ranges"];
+
+    if (object.manifest) {
+        [response.headers setObject:object.manifest forKey:@"X-Object-Manifest"];
+    }
+    if (object.segments) {
+        [response.headers setObject:@"True" forKey:@"X-Static-Large-Object"];
+    }
+    for (NSString *key in object.metadata) {
+        [response.headers setObject:[object.metadata objectForKey:key] forKey:$S(@"X-Object-Meta-%@", key)];
+    }
+
+    return response;
+
+}
+
++ (NSData *)bodyOfObject:(RSStubObject *)object etag:(NSString **)etag {
+
+    NSArray *segmentPaths = object.segments;
+
+    // a dynamic manifest is every object under its prefix, in name order
+    if (object.manifest) {
+
+        NSRange slash = [object.manifest rangeOfString:@"/"];
+        NSString *containerName = slash.location == NSNotFound ? object.manifest : [object.manifest substringToIndex:slash.location];
+        NSString *prefix = slash.location == NSNotFound ? @"" : [object.manifest substringFromIndex:NSMaxRange(slash)];
+        NSMutableArray *paths = [[NSMutableArray alloc] init];
+
+        for (NSString *name in [[[[RSStubContainers objectForKey:containerName] objects] allKeys] sortedArrayUsingComparator:RSStubCompareNames]) {
+            if ([name hasPrefix:prefix]) {
+                [paths addObject:$S(@"%@/%@", containerName, name)];
+            }
+        }
+
+        segmentPaths = paths;
+
+    }
+
+    if (!segmentPaths) {
+        *etag = object.etag;
+        return object.data;
+    }
+
+    NSMutableData *data = [[NSMutableData alloc] init];
+    NSMutableString *etags = [[NSMutableString alloc] init];
+
+    for (NSString *segmentPath in segmentPaths) {
+
+        NSRange slash = [segmentPath rangeOfString:@"/"];
+        RSStubObject *segment = [[[RSStubContainers objectForKey:[segmentPath substringToIndex:slash.location]] objects] objectForKey:[segmentPath substringFromIndex:NSMaxRange(slash)]];
+
+        if (segment) {
+            [data appendData:segment.data];
+            [etags appendString:segment.etag];
+        }
+
+    }
+
+    *etag = object.segments ? object.etag : $S(@"\"%@\"", RSStubMD5([etags dataUsingEncoding:NSUTF8StringEncoding]));
+    return data;
+
+}
+
++ (NSDictionary *)metadataFromRequest:(NSURLRequest *)request prefix:(NSString *)prefix {
+
+    NSMutableDictionary *metadata = [[NSMutableDictionary alloc] init];
+    NSDictionary *headers = [request allHTTPHeaderFields];
+
+    for (NSString *key in headers) {
+        if ([key length] > [prefix length] && [[key substringToIndex:[prefix length]] caseInsensitiveCompare:prefix] == NSOrderedSame) {
+            [metadata setObject:[headers objectForKey:key] forKey:[key substringFromIndex:[prefix length]]];
+        }
+    }
+
+    return metadata;
+
+}
+
+#pragma mark - Listings
+
++ (NSArray *)listingOfNames:(NSArray *)names query:(NSDictionary *)query {
+
+    NSString *prefix = [query objectForKey:@"prefix"] ? [query objectForKey:@"prefix"] : @"";
+    NSString *marker = [query objectForKey:@"marker"];
+    NSString *endMarker = [query objectForKey:@"end_marker"];
+    NSString *delimiter = [query objectForKey:@"delimiter"];
+    NSUInteger limit = [query objectForKey:@"limit"] ? MIN((NSUInteger)[[query objectForKey:@"limit"] integerValue], kRSStubListingLimit) : kRSStubListingLimit;
+
+    NSMutableArray *entries = [[NSMutableArray alloc] init];
+    NSString *lastSubdir = nil;
+
+    for (NSString *name in [names sortedArrayUsingComparator:RSStubCompareNames]) {
+
+        if ([entries count] >= limit) {
+            break;
+        }
+
+        if ([marker length] > 0 && [name compare:marker options:NSLiteralSearch] != NSOrderedDescending) {
+            continue;
+        }
+
+        // a marker that is a pseudo-directory continues after everything in it
+        if ([delimiter length] > 0 && [marker hasSuffix:delimiter] && [name hasPrefix:marker]) {
+            continue;
+        }
+
+        if ([endMarker length] > 0 && [name compare:endMarker options:NSLiteralSearch] != NSOrderedAscending) {
+            break;
+        }
+
+        if (![name hasPrefix:prefix]) {
+            continue;
+        }
+
+        if ([delimiter length] > 0) {
+
+            NSRange found = [name rangeOfString:delimiter options:NSLiteralSearch range:NSMakeRange([prefix length], [name length] - [prefix length])];
+
+            if (found.location != NSNotFound) {
+
+                NSString *subdir = [name substringToIndex:NSMaxRange(found)];
+                if (![subdir isEqualToString:lastSubdir]) {
+                    [entries addObject:[NSDictionary dictionaryWithObject:subdir forKey:@"subdir"]];
+                    lastSubdir = subdir;
+                }
+                continue;
+
+            }
+
+        }
+
+        [entries addObject:name];
+
+    }
+
+    return entries;
+
+}
+
++ (RSStubResponse *)listingResponse:(NSArray *)entries query:(NSDictionary *)query {
+
+    if ([[query objectForKey:@"format"] isEqualToString:@"json"]) {
+        return [RSStubResponse responseWithStatus:200 JSONObject:entries];
+    }
+
+    if ([entries count] == 0) {
+        return [RSStubResponse responseWithStatus:204];
+    }
+
+    NSMutableString *text = [[NSMutableString alloc] init];
+    for (id entry in entries) {
+        [text appendFormat:@"%@\n", [entry isKindOfClass:[NSDictionary class]] ? [entry objectForKey:@"subdir"] : [entry objectForKey:@"name"]];
+    }
+
+    RSStubResponse *response = [RSStubResponse responseWithStatus:200];
+    response.data = [text dataUsingEncoding:NSUTF8StringEncoding];
+    [response.headers setObject:@"text/plain; charset=utf-8" forKey:@"Content-Type"];
+    return response;
+
+}
+
+#pragma mark - CDN
+
++ (NSString *)cdnURIForContainer:(NSString *)name scheme:(NSString *)scheme suffix:(NSString *)suffix {
+
+    NSString *digest = RSStubMD5([name dataUsingEncoding:NSUTF8StringEncoding]);
+    return $S(@"%@://%@%@.cdn.stub.local", scheme, [digest substringToIndex:12], suffix);
+
+}
+
++ (RSStubResponse *)cdnResponse:(NSURLRequest *)request containerName:(NSString *)containerName objectName:(NSString *)objectName query:(NSDictionary *)query {
+
+    NSString *method = [request HTTPMethod];
+
+    if ([containerName length] == 0) {
+
+        if ([method isEqualToString:@"HEAD"]) {
+            return [RSStubResponse responseWithStatus:204];
+        }
+
+        NSMutableArray *names = [[NSMutableArray alloc] init];
+        BOOL enabledOnly = [[query objectForKey:@"enabled_only"] isEqualToString:@"true"];
+
+        for (NSString *name in RSStubContainers) {
+            RSStubContainer *container = [RSStubContainers objectForKey:name];
+            if (container.cdnKnown && (container.cdnEnabled || !enabledOnly)) {
+                [names addObject:name];
+            }
+        }
+
+        NSMutableArray *entries = [[NSMutableArray alloc] init];
+
+        for (NSString *name in [self listingOfNames:names query:query]) {
+            RSStubContainer *container = [RSStubContainers objectForKey:name];
+            [entries addObject:[NSDictionary dictionaryWithObjectsAndKeys:
+                                name, @"name",
+                                [NSNumber numberWithBool:container.cdnEnabled], @"cdn_enabled",
+                                [NSNumber numberWithUnsignedInteger:container.ttl], @"ttl",
+                                [NSNumber numberWithBool:container.logRetention], @"log_retention",
+                                [self cdnURIForContainer:name scheme:@"http" suffix:@""], @"cdn_uri",
+                                [self cdnURIForContainer:name scheme:@"https" suffix:@""], @"cdn_ssl_uri",
+                                [self cdnURIForContainer:name scheme:@"http" suffix:@".stream"], @"cdn_streaming_uri",
+                                nil]];
+        }
+
+        return [self listingResponse:entries query:query];
+
+    }
+
+    RSStubContainer *container = [RSStubContainers objectForKey:containerName];
+
+    if (!container) {
+        return [RSStubResponse responseWithStatus:404];
+    }
+
+    if ([method isEqualToString:@"PUT"] && !objectName) {
+
+        BOOL created = !container.cdnKnown;
+        container.cdnKnown = YES;
+        container.cdnEnabled = YES;
+        if ([request valueForHTTPHeaderField:@"X-TTL"]) {
+            container.ttl = [[request valueForHTTPHeaderField:@"X-TTL"] integerValue];
+        }
+
+        RSStubResponse *response = [RSStubResponse responseWithStatus:created ? 201 : 202];
+        [response.headers setObject:[self cdnURIForContainer:containerName scheme:@"http" suffix:@""] forKey:@"X-CDN-URI"];
+        [response.headers setObject:[self cdnURIForContainer:containerName scheme:@"https" suffix:@""] forKey:@"X-CDN-SSL-URI"];
+        [response.headers setObject:[self cdnURIForContainer:containerName scheme:@"http" suffix:@".stream"] forKey:@"X-CDN-STREAMING-URI"];
+        return response;
+
+    }
+
+    if (!container.cdnKnown) {
+        return [RSStubResponse responseWithStatus:404];
+    }
+
+    if ([method isEqualToString:@"DELETE"]) {
+        if (objectName && ![container.objects objectForKey:objectName]) {
+            return [RSStubResponse responseWithStatus:404];
+        }
+        RSStubPurgeCount++;
+        return [RSStubResponse responseWithStatus:204];
+    }
+
+    if (objectName) {
+        return [RSStubResponse responseWithStatus:405];
+    }
+
+    if ([method isEqualToString:@"POST"]) {
+
+        if ([request valueForHTTPHeaderField:@"X-TTL"]) {
+            container.ttl = [[request valueForHTTPHeaderField:@"X-TTL"] integerValue];
+        }
+        if ([request valueForHTTPHeaderField:@"X-CDN-Enabled"]) {
+            container.cdnEnabled = [[request valueForHTTPHeaderField:@"X-CDN-Enabled"] caseInsensitiveCompare:@"True"] == NSOrderedSame;
+        }
+        if ([request valueForHTTPHeaderField:@"X-Log-Retention"]) {
+            container.logRetention = [[request valueForHTTPHeaderField:@"X-Log-Retention"] caseInsensitiveCompare:@"True"] == NSOrderedSame;
+        }
+        return [RSStubResponse responseWithStatus:202];
+
+    }
+
+    if ([method isEqualToString:@"HEAD"]) {
+
+        RSStubResponse *response = [RSStubResponse responseWithStatus:204];
+        [response.headers setObject:container.cdnEnabled ? @"True" : @"False" forKey:@"X-CDN-Enabled"];
+        [response.headers setObject:$S(@"%lu", (unsigned long)container.ttl) forKey:@"X-TTL"];
+        [response.headers setObject:container.logRetention ? @"True" : @"False" forKey:@"X-Log-Retention"];
+        [response.headers setObject:[self cdnURIForContainer:containerName scheme:@"http" suffix:@""] forKey:@"X-CDN-URI"];
+        [response.headers setObject:[self cdnURIForContainer:containerName scheme:@"https" suffix:@""] forKey:@"X-CDN-SSL-URI"];
+        [response.headers setObject:[self cdnURIForContainer:containerName scheme:@"http" suffix:@".stream"] forKey:@"X-CDN-STREAMING-URI"];
+        return response;
+
+    }
+
+    return [RSStubResponse responseWithStatus:405];
+
+}
+
+@end
@@ -0,0 +1,43 @@
+//
+//  RSStubTransport.h
+//  RackspaceCloudFilesTests
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSTransport.h"
+
+/** The RSStubTransport class answers every request itself, without the URL loading system, so tests
+ *  can see exactly what a client sends and when.
+ *
+ *  Each request is answered after delay with statusCode, responseHeaders, and responseBody.  The
+ *  transport records the requests it was given in order and the most requests it had in flight at
+ *  once.  It has no limit of its own on connections per host, so any limit it sees comes from the client.
+ */
+@interface RSStubTransport : RSTransport
+
+/** How long each request takes to answer, in seconds.  Defaults to 0.05. */
+@property (nonatomic) NSTimeInterval delay;
+
+/** The status code of every response.  Defaults to 200. */
+@property (nonatomic) NSInteger statusCode;
+
+/** If set, returns the status code for each request in place of statusCode.  Executes as the request is sent. */
+@property (nonatomic, copy) NSInteger (^statusCodeHandler)(NSURLRequest *request);
+
+/** The body of every response.  Defaults to an empty JSON array. */
+@property (nonatomic, strong) NSData *responseBody;
+
+/** Headers added to every response besides Content-Length */
+@property (nonatomic, strong) NSDictionary *responseHeaders;
+
+/** The requests sent so far, in the order they were sent */
+@property (nonatomic, strong, readonly) NSArray *sentRequests;
+
+/** The number of requests in flight now */
+@property (nonatomic, readonly) NSUInteger inFlightCount;
+
+/** The most requests that were in flight at once */
+@property (nonatomic, readonly) NSUInteger maxInFlightCount;
+
+@end
@@ -0,0 +1,88 @@
+//
+//  RSStubTransport.m
+//  RackspaceCloudFilesTests
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSStubTransport.h"
+#import "RSConnection.h"
+
+@interface RSStubTransport ()
+
+@property (nonatomic, strong) NSMutableArray *requests;
+@property (nonatomic, readwrite) NSUInteger inFlightCount;
+@property (nonatomic, readwrite) NSUInteger maxInFlightCount;
+
+@end
+
+@implementation RSStubTransport
+
+@synthesize delay, statusCode, statusCodeHandler, responseBody, responseHeaders, requests, inFlightCount, maxInFlightCount;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.maxConnectionsPerHost = 0;
+        self.delay = 0.05;
+        self.statusCode = 200;
+        self.responseBody = [@"[]" dataUsingEncoding:NSUTF8StringEncoding];
+        self.requests = [[NSMutableArray alloc] init];
+    }
+    return self;
+
+}
+
+- (NSArray *)sentRequests {
+
+    @synchronized (self) {
+        return [NSArray arrayWithArray:self.requests];
+    }
+
+}
+
+- (void)resumeTask:(RSTransportTask *)task {
+
+    @synchronized (self) {
+        [self.requests addObject:task.request];
+        self.inFlightCount++;
+        self.maxInFlightCount = MAX(self.maxInFlightCount, self.inFlightCount);
+    }
+
+    NSInteger code = self.statusCodeHandler ? self.statusCodeHandler(task.request) : self.statusCode;
+    NSData *body = code == 304 ? [NSData data] : self.responseBody;
+
+    NSMutableDictionary *headers = [NSMutableDictionary dictionaryWithDictionary:self.responseHeaders];
+    [headers setObject:[NSString stringWithFormat:@"%lu", (unsigned long)[body length]] forKey:@"Content-Length"];
+
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:[task.request URL] statusCode:code HTTPVersion:@"HTTP/1.1" headerFields:headers];
+    RSConnection *connection = task.connection;
+
+    // a cancelled request is still counted until it would have finished, as a real one would be
+    NSBlockOperation *answer = [[NSBlockOperation alloc] init];
+    __weak NSBlockOperation *weakAnswer = answer;
+
+    [answer addExecutionBlock:^{
+        if (!weakAnswer.isCancelled) {
+            [connection connection:nil didReceiveResponse:response];
+            [connection connection:nil didReceiveData:body];
+            [connection connectionDidFinishLoading:nil];
+        }
+    }];
+
+    task.handle = answer;
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(self.delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+
+        // the slot is free before the client hears about it, as it would be on a real connection
+        @synchronized (self) {
+            self.inFlightCount--;
+        }
+        [task.queue addOperation:answer];
+
+    });
+
+}
+
+@end
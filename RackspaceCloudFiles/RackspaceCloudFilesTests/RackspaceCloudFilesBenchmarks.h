@@ -0,0 +1,12 @@
+//
+//  RackspaceCloudFilesBenchmarks.h
+//  RackspaceCloudFilesTests
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <SenTestingKit/SenTestingKit.h>
+
+@interface RackspaceCloudFilesBenchmarks : SenTestCase
+
+@end
@@ -0,0 +1,1420 @@
+//
+//  RackspaceCloudFilesBenchmarks.m
+//  RackspaceCloudFilesTests
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RackspaceCloudFilesBenchmarks.h"
+#import "RSClient.h"
+#import "RSStubServer.h"
+#import "RSLoopbackServer.h"
+#import <mach/mach.h>
+
+#define kRSBenchmarkTimeout 600
+#define kRSBenchmarkContainer @"RSCloudFilesSDK-Benchmark"
+#define kRSBenchmarkMaxTransferBytes 268435456ULL
+
+// results are logged one per line as "benchmark name=... key=value ..." so they can be
+// collected from the test output with grep, and appended as JSON lines to the file named by
+// the RS_BENCHMARK_OUTPUT environment variable, or RackspaceCloudFilesBenchmarks.jsonl in the
+// temporary directory.  Everything that talks to the API runs against RSStubServer.
+
+@implementation RackspaceCloudFilesBenchmarks
+
+#pragma mark - Utilities
+
+- (void)setUp {
+    [super setUp];
+    [RSStubServer start];
+}
+
+- (void)tearDown {
+    [RSStubServer stop];
+    [super tearDown];
+}
+
+- (void)reportBenchmark:(NSString *)name metrics:(NSDictionary *)metrics {
+    
+    NSMutableString *line = [[NSMutableString alloc] initWithFormat:@"benchmark name=%@", name];
+    for (NSString *key in [[metrics allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+        [line appendFormat:@" %@=%@", key, [metrics objectForKey:key]];
+    }
+    NSLog(@"%@", line);
+    
+    NSString *path = [[[NSProcessInfo processInfo] environment] objectForKey:@"RS_BENCHMARK_OUTPUT"];
+    if (!path) {
+        path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RackspaceCloudFilesBenchmarks.jsonl"];
+    }
+    
+    NSMutableDictionary *record = [NSMutableDictionary dictionaryWithDictionary:metrics];
+    [record setObject:name forKey:@"name"];
+    [record setObject:[NSNumber numberWithDouble:[[NSDate date] timeIntervalSince1970]] forKey:@"timestamp"];
+    
+    NSMutableData *json = [NSMutableData dataWithData:[NSJSONSerialization dataWithJSONObject:record options:0 error:nil]];
+    [json appendData:[@"\n" dataUsingEncoding:NSUTF8StringEncoding]];
+    
+    if (![[NSFileManager defaultManager] fileExistsAtPath:path]) {
+        [[NSFileManager defaultManager] createFileAtPath:path contents:nil attributes:nil];
+    }
+    NSFileHandle *handle = [NSFileHandle fileHandleForWritingAtPath:path];
+    [handle seekToEndOfFile];
+    [handle writeData:json];
+    [handle closeFile];
+    
+}
+
+- (BOOL)waitForSemaphore:(dispatch_semaphore_t)semaphore {
+    
+    // handlers run on the client's completionQueue, so the test thread can simply block.  The
+    // semaphore is released once it's signaled; after a timeout a late handler may still signal it.
+    BOOL finished = dispatch_semaphore_wait(semaphore, dispatch_time(DISPATCH_TIME_NOW, kRSBenchmarkTimeout * NSEC_PER_SEC)) == 0;
+    STAssertTrue(finished, @"benchmark timed out");
+    if (finished) {
+        dispatch_release(semaphore);
+    }
+    return finished;
+    
+}
+
+- (RSClient *)stubClient {
+    RSClient *client = [[RSClient alloc] initWithAuthURL:[RSStubServer authURL] username:[RSStubServer username] apiKey:[RSStubServer apiKey]];
+    [RSStubServer prepareClient:client];
+    return client;
+}
+
+- (RSContainer *)createContainerWithClient:(RSClient *)client {
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    RSContainer *container = [[RSContainer alloc] init];
+    container.name = kRSBenchmarkContainer;
+    
+    [client createContainer:container success:^{
+        dispatch_semaphore_signal(semaphore);
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        STFail(@"Create container failed.");
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    [self waitForSemaphore:semaphore];
+    return container;
+    
+}
+
+- (unsigned long long)residentMemory {
+    
+    struct task_basic_info info;
+    mach_msg_type_number_t count = TASK_BASIC_INFO_COUNT;
+    
+    if (task_info(mach_task_self(), TASK_BASIC_INFO, (task_info_t)&info, &count) != KERN_SUCCESS) {
+        return 0;
+    }
+    return info.resident_size;
+    
+}
+
+- (unsigned long long)peakResidentMemoryDuring:(void (^)())block {
+    
+    // sampled rather than read from the kernel's high water mark, so a run can be measured on its own
+    __block unsigned long long peak = [self residentMemory];
+    dispatch_queue_t queue = dispatch_queue_create("com.rackspace.cloudfiles.benchmarks.memory", DISPATCH_QUEUE_SERIAL);
+    dispatch_source_t timer = dispatch_source_create(DISPATCH_SOURCE_TYPE_TIMER, 0, 0, queue);
+    
+    dispatch_source_set_timer(timer, dispatch_time(DISPATCH_TIME_NOW, 0), 10 * NSEC_PER_MSEC, NSEC_PER_MSEC);
+    dispatch_source_set_event_handler(timer, ^{
+        peak = MAX(peak, [self residentMemory]);
+    });
+    dispatch_resume(timer);
+    
+    block();
+    
+    dispatch_source_cancel(timer);
+    dispatch_sync(queue, ^{
+        peak = MAX(peak, [self residentMemory]);
+    });
+    dispatch_release(timer);
+    dispatch_release(queue);
+    
+    return peak;
+    
+}
+
+- (NSString *)writeFileWithLength:(unsigned long long)length {
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"RSBenchmark-%llu", length]];
+    NSMutableData *chunk = [NSMutableData dataWithLength:1048576];
+    
+    // random bytes, so nothing along the way can compress them
+    uint32_t *words = [chunk mutableBytes];
+    for (NSUInteger i = 0; i < [chunk length] / sizeof(uint32_t); i++) {
+        words[i] = arc4random();
+    }
+    
+    [[NSFileManager defaultManager] createFileAtPath:path contents:nil attributes:nil];
+    NSFileHandle *handle = [NSFileHandle fileHandleForWritingAtPath:path];
+    
+    for (unsigned long long written = 0; written < length; written += [chunk length]) {
+        @autoreleasepool {
+            [handle writeData:[chunk subdataWithRange:NSMakeRange(0, (NSUInteger)MIN([chunk length], length - written))]];
+        }
+    }
+    
+    [handle closeFile];
+    return path;
+    
+}
+
+- (NSData *)objectListingWithCount:(NSUInteger)count {
+    
+    NSMutableString *json = [[NSMutableString alloc] initWithString:@"["];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        [json appendFormat:@"%@{\"name\": \"photos/2011/IMG_%06lu.jpg\", \"hash\": \"d41d8cd98f00b204e9800998ecf8427e\", \"bytes\": %llu, \"content_type\": \"image/jpeg\", \"last_modified\": \"2011-11-01T18:24:37.512230\"}", i > 0 ? @", " : @"", (unsigned long)i, (unsigned long long)i * 1024];
+    }
+    
+    [json appendString:@"]"];
+    return [json dataUsingEncoding:NSUTF8StringEncoding];
+    
+}
+
+- (void)benchmarkListingDecodeWithCount:(NSUInteger)count {
+    
+    NSData *data = [self objectListingWithCount:count];
+    RSContainer *parent = [[RSContainer alloc] init];
+    
+    NSDate *start = [NSDate date];
+    NSArray *dictionaries = [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingAllowFragments error:nil];
+    NSArray *kvcObjects = [RSStorageObject arrayFromJSONDictionaries:dictionaries parent:parent];
+    NSTimeInterval kvcTime = -[start timeIntervalSinceNow];
+    
+    start = [NSDate date];
+    NSArray *decodedObjects = [RSStorageObject arrayFromJSONData:data parent:parent error:nil];
+    NSTimeInterval decoderTime = -[start timeIntervalSinceNow];
+    
+    STAssertEquals([decodedObjects count], [kvcObjects count], @"both paths should decode every entry");
+    
+    [self reportBenchmark:@"listing-decode" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                      [NSNumber numberWithUnsignedInteger:count], @"entries",
+                                                      @"kvc", @"path",
+                                                      [NSNumber numberWithDouble:kvcTime], @"seconds",
+                                                      nil]];
+    [self reportBenchmark:@"listing-decode" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                      [NSNumber numberWithUnsignedInteger:count], @"entries",
+                                                      @"decoder", @"path",
+                                                      [NSNumber numberWithDouble:decoderTime], @"seconds",
+                                                      [NSNumber numberWithDouble:kvcTime / decoderTime], @"speedup",
+                                                      nil]];
+    
+}
+
+#pragma mark - Listing Decoder
+
+- (void)testListingDecoder {
+    
+    NSString *json = @"[{\"name\": \"a\\\"b\\u00e9\", \"bytes\": 12, \"hash\": \"abc\", \"added_later\": {\"nested\": [1, null]}, \"content_type\": \"text/plain\", \"last_modified\": \"2011-11-01T18:24:37.512230\"}, {\"subdir\": \"photos/\"}]";
+    
+    NSError *error = nil;
+    NSArray *objects = [RSStorageObject arrayFromJSONData:[json dataUsingEncoding:NSUTF8StringEncoding] parent:nil error:&error];
+    
+    STAssertNil(error, @"listing should decode");
+    STAssertEquals([objects count], (NSUInteger)2, @"listing should have two entries");
+    
+    RSStorageObject *first = [objects objectAtIndex:0];
+    STAssertEqualObjects(first.name, @"a\"bé", @"escapes should be decoded");
+    STAssertEquals(first.bytes, 12ULL, @"bytes should be decoded");
+    STAssertEqualObjects(first.hash, @"abc", @"hash should be decoded");
+    STAssertEqualObjects(first.content_type, @"text/plain", @"content type should be decoded");
+    STAssertEqualObjects([[objects objectAtIndex:1] name], @"photos/", @"subdirectories should be named");
+    
+    STAssertNil([RSStorageObject arrayFromJSONData:[@"[{\"name\": " dataUsingEncoding:NSUTF8StringEncoding] parent:nil error:&error], @"truncated listing should not decode");
+    STAssertNotNil(error, @"truncated listing should return an error");
+    
+    // sizes past 4 GB survive, and sizes past 64 bits are rejected instead of wrapping
+    objects = [RSStorageObject arrayFromJSONData:[@"[{\"name\": \"big\", \"bytes\": 5000000000}]" dataUsingEncoding:NSUTF8StringEncoding] parent:nil error:nil];
+    STAssertEquals([[objects lastObject] bytes], 5000000000ULL, @"sizes over 4 GB should be decoded");
+    
+    error = nil;
+    STAssertNil([RSStorageObject arrayFromJSONData:[@"[{\"name\": \"huge\", \"bytes\": 99999999999999999999}]" dataUsingEncoding:NSUTF8StringEncoding] parent:nil error:&error], @"an overflowing size should not decode");
+    STAssertNotNil(error, @"an overflowing size should return an error");
+    
+    RSCDNContainer *container = [[RSCDNContainer alloc] initWithJSONDictionary:[NSDictionary dictionaryWithObject:@"http://c0.cdn.example.com" forKey:@"cdn_uri"]];
+    STAssertTrue([container.cdn_uri isKindOfClass:[NSURL class]], @"CDN URIs set with KVC should be URLs");
+    
+}
+
+- (void)testListingDecodePerformance {
+    
+    [self benchmarkListingDecodeWithCount:10000];
+    [self benchmarkListingDecodeWithCount:100000];
+    
+}
+
+#pragma mark - Instrumentation
+
+- (void)testLatencyHistogram {
+    
+    RSLatencyHistogram *histogram = [[RSLatencyHistogram alloc] init];
+    
+    // 1ms through 1000ms, so the true p50 is 500ms and the true p99 is 990ms
+    for (NSUInteger i = 1; i <= 1000; i++) {
+        [histogram recordValue:i / 1000.0];
+    }
+    
+    STAssertEquals(histogram.count, 1000ULL, @"every value should be counted");
+    STAssertEqualsWithAccuracy(histogram.max, 1.0, 0.000001, @"max should be exact");
+    STAssertEqualsWithAccuracy([histogram valueAtPercentile:0.50], 0.5, 0.5 * 0.19, @"p50 should be within a bucket");
+    STAssertEqualsWithAccuracy([histogram valueAtPercentile:0.99], 0.99, 0.99 * 0.19, @"p99 should be within a bucket");
+    
+    [histogram reset];
+    STAssertEquals(histogram.count, 0ULL, @"reset should discard every value");
+    
+}
+
+- (void)testLatencyHistogramPerformance {
+    
+    RSLatencyHistogram *histogram = [[RSLatencyHistogram alloc] init];
+    NSUInteger iterations = 1000000;
+    
+    NSDate *start = [NSDate date];
+    dispatch_apply(iterations, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        [histogram recordValue:(i % 5000) / 1000.0];
+    });
+    NSTimeInterval seconds = -[start timeIntervalSinceNow];
+    
+    STAssertEquals(histogram.count, (unsigned long long)iterations, @"concurrent recording should not lose values");
+    
+    [self reportBenchmark:@"histogram-record" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                        [NSNumber numberWithUnsignedInteger:iterations], @"values",
+                                                        [NSNumber numberWithDouble:seconds], @"seconds",
+                                                        [NSNumber numberWithDouble:seconds * 1e9 / iterations], @"ns_per_value",
+                                                        nil]];
+    
+}
+
+#pragma mark - Checksums
+
+- (void)testChecksum {
+    
+    NSData *data = [@"This is a test." dataUsingEncoding:NSUTF8StringEncoding];
+    RSChecksum *checksum = [[RSChecksum alloc] init];
+    
+    STAssertEqualObjects([checksum hexDigest], @"d41d8cd98f00b204e9800998ecf8427e", @"empty digest should match");
+    
+    [checksum updateWithData:[data subdataWithRange:NSMakeRange(0, 4)]];
+    [checksum updateWithData:[data subdataWithRange:NSMakeRange(4, [data length] - 4)]];
+    
+    STAssertEqualObjects([checksum hexDigest], [RSChecksum MD5OfData:data], @"incremental digest should match a one-call digest");
+    STAssertTrue([RSChecksum ETag:[[RSChecksum MD5OfData:data] uppercaseString] matchesMD5:[checksum hexDigest]], @"ETags should match ignoring case");
+    STAssertFalse([RSChecksum ETag:nil matchesMD5:[checksum hexDigest]], @"a missing ETag should never match");
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSChecksumTest.txt"];
+    [data writeToFile:path atomically:YES];
+    
+    STAssertEqualObjects([RSChecksum MD5OfFileAtPath:path], [checksum hexDigest], @"file digest should match");
+    STAssertEqualObjects([[RSChecksum MD5sOfFilesAtPaths:[NSArray arrayWithObjects:path, @"/nonexistent", nil]] allKeys], [NSArray arrayWithObject:path], @"unreadable files should be left out");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+}
+
+- (void)testParallelHashingPerformance {
+    
+    NSUInteger count = 32;
+    unsigned long long length = 16777216;
+    NSString *path = [self writeFileWithLength:length];
+    NSMutableArray *paths = [[NSMutableArray alloc] initWithCapacity:count];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        NSString *copyPath = [NSString stringWithFormat:@"%@-%lu", path, (unsigned long)i];
+        [[NSFileManager defaultManager] removeItemAtPath:copyPath error:nil];
+        [[NSFileManager defaultManager] copyItemAtPath:path toPath:copyPath error:nil];
+        [paths addObject:copyPath];
+    }
+    
+    NSDate *start = [NSDate date];
+    for (NSString *copyPath in paths) {
+        [RSChecksum MD5OfFileAtPath:copyPath];
+    }
+    NSTimeInterval serialTime = -[start timeIntervalSinceNow];
+    
+    start = [NSDate date];
+    NSDictionary *digests = [RSChecksum MD5sOfFilesAtPaths:paths];
+    NSTimeInterval parallelTime = -[start timeIntervalSinceNow];
+    
+    STAssertEquals([digests count], count, @"every file should be hashed");
+    
+    [self reportBenchmark:@"hash-files" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                  [NSNumber numberWithUnsignedInteger:count], @"files",
+                                                  [NSNumber numberWithUnsignedLongLong:length], @"bytes",
+                                                  [NSNumber numberWithUnsignedInteger:[[NSProcessInfo processInfo] activeProcessorCount]], @"cores",
+                                                  [NSNumber numberWithDouble:count * length / serialTime / 1048576], @"serial_mb_per_second",
+                                                  [NSNumber numberWithDouble:count * length / parallelTime / 1048576], @"parallel_mb_per_second",
+                                                  nil]];
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    for (NSString *copyPath in paths) {
+        [[NSFileManager defaultManager] removeItemAtPath:copyPath error:nil];
+    }
+    
+}
+
+#pragma mark - Compression
+
+- (void)testGzipRoundTrip {
+    
+    NSData *data = [self objectListingWithCount:10000];
+    NSData *encoded = [RSGzip gzipData:data level:kRSDefaultCompressionLevel];
+    
+    STAssertTrue([RSGzip isGzipData:encoded], @"encoded data should start with the gzip magic number");
+    STAssertFalse([RSGzip isGzipData:data], @"plain data should not look like gzip");
+    STAssertEqualObjects([RSGzip gunzipData:encoded error:nil], data, @"decoded data should match");
+    
+    // a stream read in small pieces and decoded in small pieces should still round trip
+    RSGzipInputStream *stream = [[RSGzipInputStream alloc] initWithStream:[NSInputStream inputStreamWithData:data] level:1];
+    NSMutableData *streamed = [[NSMutableData alloc] init];
+    uint8_t buffer[1000];
+    NSInteger length;
+    
+    [stream open];
+    while ((length = [stream read:buffer maxLength:sizeof(buffer)]) > 0) {
+        [streamed appendBytes:buffer length:length];
+    }
+    [stream close];
+    
+    STAssertEquals((unsigned long long)[streamed length], stream.bytesProduced, @"every produced byte should be read");
+    
+    RSGzip *decoder = [[RSGzip alloc] init];
+    NSMutableData *decoded = [[NSMutableData alloc] init];
+    for (NSUInteger offset = 0; offset < [streamed length]; offset += 777) {
+        [decoded appendData:[decoder decodeData:[streamed subdataWithRange:NSMakeRange(offset, MIN(777, [streamed length] - offset))] error:nil]];
+    }
+    
+    STAssertTrue([decoder finished], @"the whole gzip stream should be decoded");
+    STAssertEqualObjects(decoded, data, @"streamed data should round trip");
+    
+    NSError *error = nil;
+    uint8_t corrupt[] = { 0x1f, 0x8b, 0x08, 0x00, 0xde, 0xad, 0xbe, 0xef, 0x00, 0x03, 0xff, 0xff, 0xff, 0xff };
+    STAssertNil([RSGzip gunzipData:[NSData dataWithBytes:corrupt length:sizeof(corrupt)] error:&error], @"corrupt data should not decode");
+    STAssertEquals([error code], EDECOMPRESSIONFAILURE, @"corrupt data should report a decompression failure");
+    
+    NSSet *types = [NSSet setWithObjects:@"application/json", @"text/", nil];
+    STAssertTrue([RSGzip contentType:@"application/json; charset=utf-8" matchesTypes:types], @"parameters should be ignored");
+    STAssertTrue([RSGzip contentType:@"text/csv" matchesTypes:types], @"prefix entries should match");
+    STAssertFalse([RSGzip contentType:@"image/jpeg" matchesTypes:types], @"other types should not match");
+    
+}
+
+- (void)testCompressedTransfer {
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    
+    // a large JSON listing stands in for the logs and exports that compression is meant for
+    NSData *data = [self objectListingWithCount:100000];
+    NSString *sourcePath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSBenchmark-compressible.json"];
+    NSString *destinationPath = [sourcePath stringByAppendingPathExtension:@"download"];
+    [data writeToFile:sourcePath atomically:YES];
+    
+    NSArray *bandwidths = [NSArray arrayWithObjects:[NSNumber numberWithUnsignedLongLong:1048576], [NSNumber numberWithUnsignedLongLong:10485760], [NSNumber numberWithUnsignedLongLong:0], nil];
+    NSArray *levels = [NSArray arrayWithObjects:[NSNumber numberWithInt:0], [NSNumber numberWithInt:1], [NSNumber numberWithInt:6], [NSNumber numberWithInt:9], nil];
+    
+    for (NSNumber *bandwidth in bandwidths) {
+        
+        [RSStubServer setBandwidth:[bandwidth unsignedLongLongValue]];
+        
+        for (NSNumber *level in levels) {
+            
+            // level 0 means compression is off
+            container.compressedContentTypes = [level intValue] > 0 ? [NSSet setWithObject:@"application/json"] : nil;
+            container.compressionLevel = [level intValue];
+            
+            RSStorageObject *object = [[RSStorageObject alloc] init];
+            object.name = [NSString stringWithFormat:@"compressed/level-%@.json", level];
+            object.content_type = @"application/json";
+            
+            dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+            __block BOOL succeeded = NO;
+            __block unsigned long long wireBytes = 0;
+            NSDate *start = [NSDate date];
+            
+            [container uploadObject:object fromFile:sourcePath success:^{
+                succeeded = YES;
+                dispatch_semaphore_signal(semaphore);
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                STFail(@"Compressed upload failed.");
+                dispatch_semaphore_signal(semaphore);
+            }];
+            
+            if (![self waitForSemaphore:semaphore] || !succeeded) {
+                break;
+            }
+            
+            NSTimeInterval uploadSeconds = -[start timeIntervalSinceNow];
+            
+            semaphore = dispatch_semaphore_create(0);
+            succeeded = NO;
+            start = [NSDate date];
+            
+            [object writeObjectDataToFile:destinationPath atomically:YES progress:^(unsigned long long bytesReceived, unsigned long long totalBytes) {
+                wireBytes = bytesReceived;
+            } success:^{
+                succeeded = YES;
+                dispatch_semaphore_signal(semaphore);
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                STFail(@"Compressed download failed.");
+                dispatch_semaphore_signal(semaphore);
+            }];
+            
+            if (![self waitForSemaphore:semaphore] || !succeeded) {
+                break;
+            }
+            
+            NSTimeInterval downloadSeconds = -[start timeIntervalSinceNow];
+            
+            STAssertEqualObjects([NSData dataWithContentsOfFile:destinationPath], data, @"downloaded object should be decoded");
+            
+            [self reportBenchmark:@"compressed-transfer" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                                   [NSNumber numberWithUnsignedInteger:[data length]], @"bytes",
+                                                                   [NSNumber numberWithUnsignedLongLong:wireBytes], @"bytes_on_wire",
+                                                                   [NSNumber numberWithDouble:(double)wireBytes / [data length]], @"ratio",
+                                                                   level, @"level",
+                                                                   bandwidth, @"bandwidth",
+                                                                   [NSNumber numberWithDouble:uploadSeconds], @"upload_seconds",
+                                                                   [NSNumber numberWithDouble:downloadSeconds], @"download_seconds",
+                                                                   nil]];
+            
+            [[NSFileManager defaultManager] removeItemAtPath:destinationPath error:nil];
+            
+        }
+        
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath:sourcePath error:nil];
+    
+}
+
+#pragma mark - Bandwidth
+
+- (void)testTokenBucket {
+    
+    RSTokenBucket *bucket = [[RSTokenBucket alloc] initWithRate:1048576];
+    NSDate *start = [NSDate date];
+    
+    // the first quarter second is already in the bucket, so 1.25 MB takes about a second
+    for (NSUInteger i = 0; i < 80; i++) {
+        [bucket consume:16384];
+    }
+    
+    NSTimeInterval elapsed = -[start timeIntervalSinceNow];
+    STAssertTrue(elapsed > 0.9 && elapsed < 1.5, @"consuming should follow the rate");
+    
+    [bucket charge:524288];
+    STAssertTrue([bucket delay] > 0.4, @"charging past the bucket should leave it in debt");
+    
+    bucket.rate = 0;
+    STAssertEquals([bucket delay], 0.0, @"an unlimited bucket is never in debt");
+    
+}
+
+- (void)testBandwidthScheduler {
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    unsigned long long limit = 2097152;
+    unsigned long long length = 4194304;
+    NSUInteger count = 2;
+    NSString *path = [self writeFileWithLength:length];
+    
+    client.bandwidthScheduler = [[RSBandwidthScheduler alloc] init];
+    client.bandwidthScheduler.maxBytesPerSecond = limit;
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block NSUInteger remaining = count;
+    NSMutableArray *finishTimes = [[NSMutableArray alloc] init];
+    NSDate *start = [NSDate date];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        
+        RSStorageObject *object = [[RSStorageObject alloc] init];
+        object.name = [NSString stringWithFormat:@"throttled/%lu", (unsigned long)i];
+        object.content_type = @"application/octet-stream";
+        
+        [container uploadObject:object fromFile:path success:^{
+            [finishTimes addObject:[NSNumber numberWithDouble:-[start timeIntervalSinceNow]]];
+            if (--remaining == 0) {
+                dispatch_semaphore_signal(semaphore);
+            }
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            STFail(@"Throttled upload failed.");
+            if (--remaining == 0) {
+                dispatch_semaphore_signal(semaphore);
+            }
+        }];
+        
+    }
+    
+    // an interactive request in the middle of the uploads shouldn't wait for them
+    [NSThread sleepForTimeInterval:0.5];
+    
+    dispatch_semaphore_t metadataSemaphore = dispatch_semaphore_create(0);
+    NSDate *metadataStart = [NSDate date];
+    __block NSTimeInterval metadataSeconds = 0;
+    
+    [client getAccountMetadata:^{
+        metadataSeconds = -[metadataStart timeIntervalSinceNow];
+        dispatch_semaphore_signal(metadataSemaphore);
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        STFail(@"Metadata request failed.");
+        dispatch_semaphore_signal(metadataSemaphore);
+    }];
+    
+    if (![self waitForSemaphore:metadataSemaphore] || ![self waitForSemaphore:semaphore] || [finishTimes count] < count) {
+        return;
+    }
+    
+    NSTimeInterval seconds = -[start timeIntervalSinceNow];
+    double first = [[finishTimes objectAtIndex:0] doubleValue];
+    double last = [[finishTimes lastObject] doubleValue];
+    
+    STAssertTrue(seconds > 0.8 * count * length / limit, @"uploads together should stay under the limit");
+    STAssertTrue(first > 0.8 * last, @"uploads sharing the limit should finish close together");
+    STAssertTrue(metadataSeconds < 1.0, @"interactive requests should not wait behind bulk transfers");
+    
+    [self reportBenchmark:@"bandwidth-scheduler" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                          [NSNumber numberWithUnsignedInteger:count], @"transfers",
+                                                          [NSNumber numberWithUnsignedLongLong:length], @"bytes",
+                                                          [NSNumber numberWithUnsignedLongLong:limit], @"limit",
+                                                          [NSNumber numberWithDouble:count * length / seconds], @"bytes_per_second",
+                                                          [NSNumber numberWithDouble:first / last], @"fairness",
+                                                          [NSNumber numberWithDouble:metadataSeconds], @"interactive_seconds",
+                                                          nil]];
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+}
+
+#pragma mark - Stub Server
+
+- (void)testAuthenticationColdStart {
+    
+    [RSStubServer setLatency:0.05];
+    
+    NSUInteger runs = 20;
+    RSInstrumentation *instrumentation = [[RSInstrumentation alloc] init];
+    RSLatencyHistogram *firstRequest = [[RSLatencyHistogram alloc] init];
+    
+    // each run is a new client, so its first request has to authenticate before it can be sent
+    for (NSUInteger i = 0; i < runs; i++) {
+        
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        RSClient *client = [self stubClient];
+        client.instrumentation = instrumentation;
+        NSDate *start = [NSDate date];
+        
+        [client getAccountMetadata:^{
+            [firstRequest recordValue:-[start timeIntervalSinceNow]];
+            dispatch_semaphore_signal(semaphore);
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            STFail(@"Get account metadata failed.");
+            dispatch_semaphore_signal(semaphore);
+        }];
+        
+        if (![self waitForSemaphore:semaphore]) {
+            return;
+        }
+        
+    }
+    
+    STAssertEquals([RSStubServer authenticationCount], runs, @"every new client should authenticate once");
+    
+    [self reportBenchmark:@"auth-cold-start" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                       [NSNumber numberWithUnsignedInteger:runs], @"runs",
+                                                       [NSNumber numberWithDouble:0.05], @"latency",
+                                                       [firstRequest snapshot], @"first_request",
+                                                       [[instrumentation latencyHistogramForOperationType:RSOperationTypeAuthenticate] snapshot], @"auth",
+                                                       [[instrumentation queueWaitHistogramForOperationType:RSOperationTypeHead] snapshot], @"head_queue_wait",
+                                                       [[instrumentation latencyHistogramForOperationType:RSOperationTypeHead] snapshot], @"head",
+                                                       nil]];
+    
+}
+
+- (void)testListingThroughStubServer {
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    NSData *data = [@"x" dataUsingEncoding:NSUTF8StringEncoding];
+    NSUInteger count = 50000;
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        [RSStubServer setData:data forObject:[NSString stringWithFormat:@"photos/2011/IMG_%06lu.jpg", (unsigned long)i] inContainer:kRSBenchmarkContainer];
+    }
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block NSUInteger listed = 0;
+    __block NSUInteger pages = 0;
+    NSDate *start = [NSDate date];
+    
+    [container getAllObjects:^(NSArray *objects, BOOL *stop) {
+        listed += [objects count];
+        pages++;
+    } success:^{
+        dispatch_semaphore_signal(semaphore);
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        STFail(@"Listing failed.");
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    if (![self waitForSemaphore:semaphore]) {
+        return;
+    }
+    
+    NSTimeInterval seconds = -[start timeIntervalSinceNow];
+    STAssertEquals(listed, count, @"every object should be listed");
+    
+    [self reportBenchmark:@"listing-stub" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                    [NSNumber numberWithUnsignedInteger:count], @"entries",
+                                                    [NSNumber numberWithUnsignedInteger:pages], @"pages",
+                                                    [NSNumber numberWithDouble:seconds], @"seconds",
+                                                    [NSNumber numberWithDouble:count / seconds], @"entries_per_second",
+                                                    nil]];
+    
+}
+
+- (void)testListingIndexPerformance {
+    
+    RSListingIndex *index = [[RSListingIndex alloc] init];
+    NSUInteger count = 200000;
+    NSMutableArray *page = [[NSMutableArray alloc] init];
+    NSDate *start = [NSDate date];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        RSStorageObject *object = [[RSStorageObject alloc] init];
+        object.name = [NSString stringWithFormat:@"logs/%03lu/%06lu.gz", (unsigned long)(i % 1000), (unsigned long)i];
+        [page addObject:object];
+        if ([page count] == 10000) {
+            [index addObjects:page];
+            [page removeAllObjects];
+        }
+    }
+    
+    NSTimeInterval insertSeconds = -[start timeIntervalSinceNow];
+    
+    start = [NSDate date];
+    NSUInteger queries = 1000;
+    for (NSUInteger i = 0; i < queries; i++) {
+        [index objectsWithPrefix:[NSString stringWithFormat:@"logs/%03lu/", (unsigned long)i] limit:0];
+    }
+    NSTimeInterval querySeconds = -[start timeIntervalSinceNow];
+    
+    [self reportBenchmark:@"listing-index" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                     [NSNumber numberWithUnsignedInteger:count], @"entries",
+                                                     [NSNumber numberWithDouble:count / insertSeconds], @"inserts_per_second",
+                                                     [NSNumber numberWithDouble:querySeconds / queries * 1000000], @"prefix_query_us",
+                                                     nil]];
+    
+}
+
+- (NSArray *)openDirectory:(NSString *)path browser:(RSContainerBrowser *)browser {
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block NSArray *children = nil;
+    
+    [browser childrenOfDirectory:path success:^(NSArray *directoryChildren) {
+        children = directoryChildren;
+        dispatch_semaphore_signal(semaphore);
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        STFail(@"Opening %@ failed.", path);
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    return [self waitForSemaphore:semaphore] ? children : nil;
+    
+}
+
+- (void)testBrowseDirectoryPerformance {
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    NSData *data = [@"x" dataUsingEncoding:NSUTF8StringEncoding];
+    NSUInteger directories = 50;
+    NSUInteger files = 1000;
+    
+    for (NSUInteger i = 0; i < directories; i++) {
+        for (NSUInteger j = 0; j < files; j++) {
+            [RSStubServer setData:data forObject:[NSString stringWithFormat:@"browse/dir-%02lu/file-%04lu", (unsigned long)i, (unsigned long)j] inContainer:kRSBenchmarkContainer];
+        }
+    }
+    
+    RSContainerBrowser *browser = [[RSContainerBrowser alloc] initWithContainer:container];
+    
+    NSDate *start = [NSDate date];
+    [self openDirectory:@"browse" browser:browser];
+    NSTimeInterval topSeconds = -[start timeIntervalSinceNow];
+    
+    start = [NSDate date];
+    [self openDirectory:@"browse/dir-07" browser:browser];
+    NSTimeInterval openSeconds = -[start timeIntervalSinceNow];
+    
+    start = [NSDate date];
+    [self openDirectory:@"browse/dir-07" browser:browser];
+    NSTimeInterval cachedSeconds = -[start timeIntervalSinceNow];
+    
+    [self reportBenchmark:@"browse-directory" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                        [NSNumber numberWithUnsignedInteger:directories * files], @"objects",
+                                                        [NSNumber numberWithDouble:topSeconds * 1000], @"top_level_ms",
+                                                        [NSNumber numberWithDouble:openSeconds * 1000], @"open_ms",
+                                                        [NSNumber numberWithDouble:cachedSeconds * 1000], @"indexed_open_ms",
+                                                        nil]];
+    
+}
+
+- (void)benchmarkPurgeQueue:(RSPurgeQueue *)queue name:(NSString *)name container:(RSCDNContainer *)container files:(NSUInteger)files repeats:(NSUInteger)repeats {
+    
+    NSUInteger baseline = [RSStubServer purgeCount];
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block NSUInteger remaining = files * repeats;
+    __block NSUInteger failures = 0;
+    NSDate *start = [NSDate date];
+    
+    // a release touches each file a few times, in no particular order
+    for (NSUInteger repeat = 0; repeat < repeats; repeat++) {
+        for (NSUInteger i = 0; i < files; i++) {
+            
+            RSStorageObject *object = [[RSStorageObject alloc] init];
+            object.name = [NSString stringWithFormat:@"release/file-%05lu", (unsigned long)((i * 7919 + repeat) % files)];
+            
+            [queue purgeObject:object inContainer:container success:^{
+                if (--remaining == 0) {
+                    dispatch_semaphore_signal(semaphore);
+                }
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                failures++;
+                if (--remaining == 0) {
+                    dispatch_semaphore_signal(semaphore);
+                }
+            }];
+            
+        }
+    }
+    
+    if (![self waitForSemaphore:semaphore]) {
+        return;
+    }
+    
+    NSTimeInterval seconds = -[start timeIntervalSinceNow];
+    
+    [self reportBenchmark:@"purge-queue" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                   name, @"mode",
+                                                   [NSNumber numberWithUnsignedInteger:files], @"files",
+                                                   [NSNumber numberWithUnsignedInteger:failures], @"failures",
+                                                   [NSNumber numberWithUnsignedInteger:queue.purgesRequested], @"purges_requested",
+                                                   [NSNumber numberWithUnsignedInteger:queue.purgeRequestsSent], @"requests_sent",
+                                                   [NSNumber numberWithUnsignedInteger:[RSStubServer purgeCount] - baseline], @"purges_answered",
+                                                   [NSNumber numberWithDouble:seconds], @"seconds",
+                                                   nil]];
+    
+}
+
+- (void)testPurgeQueue {
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    NSUInteger files = 2000;
+    NSData *data = [@"x" dataUsingEncoding:NSUTF8StringEncoding];
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block RSCDNContainer *cdnContainer = nil;
+    
+    [client cdnEnableContainer:container success:^(RSCDNContainer *enabledContainer) {
+        cdnContainer = enabledContainer;
+        dispatch_semaphore_signal(semaphore);
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        STFail(@"CDN enable failed.");
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    if (![self waitForSemaphore:semaphore]) {
+        return;
+    }
+    
+    for (NSUInteger i = 0; i < files; i++) {
+        [RSStubServer setData:data forObject:[NSString stringWithFormat:@"release/file-%05lu", (unsigned long)i] inContainer:kRSBenchmarkContainer];
+    }
+    
+    // every purge is sent as soon as it can be, which is what purging each file directly does
+    RSPurgeQueue *immediate = [[RSPurgeQueue alloc] initWithClient:client];
+    immediate.coalescingWindow = 0;
+    immediate.containerPurgeThreshold = 0;
+    immediate.maxPurgesPerSecond = 0;
+    [self benchmarkPurgeQueue:immediate name:@"immediate" container:cdnContainer files:files repeats:3];
+    
+    // a small release stays below the threshold, so only the duplicates go
+    RSPurgeQueue *coalesced = [[RSPurgeQueue alloc] initWithClient:client];
+    coalesced.coalescingWindow = 0.5;
+    coalesced.maxPurgesPerSecond = 50;
+    [self benchmarkPurgeQueue:coalesced name:@"coalesced-small" container:cdnContainer files:50 repeats:3];
+    
+    coalesced = [[RSPurgeQueue alloc] initWithClient:client];
+    coalesced.coalescingWindow = 0.5;
+    coalesced.maxPurgesPerSecond = 50;
+    [self benchmarkPurgeQueue:coalesced name:@"coalesced" container:cdnContainer files:files repeats:3];
+    
+    // the CDN refuses the first few purges, and the queue backs off until it takes them
+    RSPurgeQueue *rateLimited = [[RSPurgeQueue alloc] initWithClient:client];
+    rateLimited.coalescingWindow = 0.5;
+    rateLimited.maxPurgesPerSecond = 50;
+    rateLimited.retryPolicy.baseDelay = 0.05;
+    [RSStubServer failNextRequests:3 statusCode:498];
+    [self benchmarkPurgeQueue:rateLimited name:@"rate-limited" container:cdnContainer files:50 repeats:3];
+    
+}
+
+- (void)testSmallObjectThroughput {
+    
+    [RSStubServer setLatency:0.01];
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    NSUInteger count = 500;
+    NSMutableData *data = [NSMutableData dataWithLength:1024];
+    NSMutableArray *objects = [[NSMutableArray alloc] initWithCapacity:count];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        RSStorageObject *object = [[RSStorageObject alloc] init];
+        object.name = [NSString stringWithFormat:@"small/%06lu", (unsigned long)i];
+        object.content_type = @"application/octet-stream";
+        object.data = data;
+        [objects addObject:object];
+    }
+    
+    // every request is issued at once, so the client's request limit sets the pace
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block NSUInteger remaining = count;
+    NSDate *start = [NSDate date];
+    
+    for (RSStorageObject *object in objects) {
+        [container uploadObject:object success:^{
+            if (--remaining == 0) {
+                dispatch_semaphore_signal(semaphore);
+            }
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            STFail(@"Upload failed.");
+            if (--remaining == 0) {
+                dispatch_semaphore_signal(semaphore);
+            }
+        }];
+    }
+    
+    if (![self waitForSemaphore:semaphore]) {
+        return;
+    }
+    
+    NSTimeInterval putSeconds = -[start timeIntervalSinceNow];
+    
+    semaphore = dispatch_semaphore_create(0);
+    remaining = count;
+    start = [NSDate date];
+    
+    for (RSStorageObject *object in objects) {
+        [object getObjectData:^{
+            if (--remaining == 0) {
+                dispatch_semaphore_signal(semaphore);
+            }
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            STFail(@"Download failed.");
+            if (--remaining == 0) {
+                dispatch_semaphore_signal(semaphore);
+            }
+        }];
+    }
+    
+    if (![self waitForSemaphore:semaphore]) {
+        return;
+    }
+    
+    NSTimeInterval getSeconds = -[start timeIntervalSinceNow];
+    
+    [self reportBenchmark:@"small-objects" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                     [NSNumber numberWithUnsignedInteger:count], @"objects",
+                                                     [NSNumber numberWithUnsignedInteger:[data length]], @"bytes",
+                                                     [NSNumber numberWithDouble:0.01], @"latency",
+                                                     [NSNumber numberWithUnsignedInteger:client.maxConcurrentRequests], @"max_concurrent_requests",
+                                                     [NSNumber numberWithDouble:count / putSeconds], @"put_per_second",
+                                                     [NSNumber numberWithDouble:count / getSeconds], @"get_per_second",
+                                                     nil]];
+    
+}
+
+- (NSArray *)transportObjectsInContainer:(RSContainer *)container count:(NSUInteger)count {
+    
+    NSData *data = [NSMutableData dataWithLength:256];
+    NSMutableArray *objects = [[NSMutableArray alloc] initWithCapacity:count];
+    
+    for (NSUInteger i = 0; i < count; i++) {
+        RSStorageObject *object = [[RSStorageObject alloc] init];
+        object.name = [NSString stringWithFormat:@"pool/%06lu", (unsigned long)i];
+        object.content_type = @"application/octet-stream";
+        object.data = data;
+        object.parent = container;
+        [objects addObject:object];
+    }
+    
+    return objects;
+    
+}
+
+- (NSTimeInterval)timeRequestsForObjects:(NSArray *)objects send:(void (^)(RSStorageObject *object, void (^finished)(BOOL succeeded)))send {
+    
+    // finished must be called on one serial queue, since it counts down without a lock
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block NSUInteger remaining = [objects count];
+    NSDate *start = [NSDate date];
+    
+    void (^finished)(BOOL) = ^(BOOL succeeded) {
+        STAssertTrue(succeeded, @"request failed");
+        if (--remaining == 0) {
+            dispatch_semaphore_signal(semaphore);
+        }
+    };
+    
+    for (RSStorageObject *object in objects) {
+        send(object, finished);
+    }
+    
+    if (![self waitForSemaphore:semaphore]) {
+        return 0;
+    }
+    
+    return -[start timeIntervalSinceNow];
+    
+}
+
+- (void)reportTransport:(NSString *)name server:(RSLoopbackServer *)server objects:(NSUInteger)count putSeconds:(NSTimeInterval)putSeconds getSeconds:(NSTimeInterval)getSeconds {
+    
+    [self reportBenchmark:@"transport" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                 name, @"transport",
+                                                 [NSNumber numberWithUnsignedInteger:count], @"objects",
+                                                 [NSNumber numberWithDouble:count / putSeconds], @"put_per_second",
+                                                 [NSNumber numberWithDouble:count / getSeconds], @"get_per_second",
+                                                 [NSNumber numberWithUnsignedInteger:server.requestCount], @"requests",
+                                                 [NSNumber numberWithUnsignedInteger:server.connectionCount], @"connections",
+                                                 nil]];
+    
+}
+
+- (void)benchmarkSmallObjectsWithTransport:(RSTransport *)transport name:(NSString *)name {
+    
+    RSLoopbackServer *server = [[RSLoopbackServer alloc] init];
+    STAssertTrue([server start], @"loopback server should start");
+    
+    RSClient *client = [[RSClient alloc] initWithAuthURL:server.authURL username:[RSStubServer username] apiKey:[RSStubServer apiKey]];
+    client.transport = transport;
+    
+    RSContainer *container = [self createContainerWithClient:client];
+    NSUInteger count = 10000;
+    NSArray *objects = [self transportObjectsInContainer:container count:count];
+    
+    [transport resetStatistics];
+    
+    NSTimeInterval putSeconds = [self timeRequestsForObjects:objects send:^(RSStorageObject *object, void (^finished)(BOOL)) {
+        [container uploadObject:object success:^{
+            finished(YES);
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            finished(NO);
+        }];
+    }];
+    
+    NSTimeInterval getSeconds = [self timeRequestsForObjects:objects send:^(RSStorageObject *object, void (^finished)(BOOL)) {
+        [object getObjectData:^{
+            finished(YES);
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            finished(NO);
+        }];
+    }];
+    
+    STAssertEquals(transport.requestCount, count * 2, @"every request should go through the transport");
+    
+    [self reportTransport:name server:server objects:count putSeconds:putSeconds getSeconds:getSeconds];
+    [server stop];
+    
+}
+
+- (void)benchmarkSmallObjectsWithAsynchronousRequests {
+    
+    // the path the SDK used to take: one sendAsynchronousRequest per request, every request
+    // started at once, and connections left entirely to the URL loading system
+    RSLoopbackServer *server = [[RSLoopbackServer alloc] init];
+    STAssertTrue([server start], @"loopback server should start");
+    
+    RSClient *client = [[RSClient alloc] initWithAuthURL:server.authURL username:[RSStubServer username] apiKey:[RSStubServer apiKey]];
+    RSContainer *container = [self createContainerWithClient:client];
+    NSUInteger count = 10000;
+    NSArray *objects = [self transportObjectsInContainer:container count:count];
+    
+    NSOperationQueue *queue = [[NSOperationQueue alloc] init];
+    [queue setMaxConcurrentOperationCount:1];
+    
+    NSTimeInterval putSeconds = [self timeRequestsForObjects:objects send:^(RSStorageObject *object, void (^finished)(BOOL)) {
+        [NSURLConnection sendAsynchronousRequest:[container uploadObjectRequest:object] queue:queue completionHandler:^(NSURLResponse *response, NSData *data, NSError *error) {
+            finished([(NSHTTPURLResponse *)response statusCode] == 201);
+        }];
+    }];
+    
+    NSTimeInterval getSeconds = [self timeRequestsForObjects:objects send:^(RSStorageObject *object, void (^finished)(BOOL)) {
+        [NSURLConnection sendAsynchronousRequest:[object getObjectDataRequest] queue:queue completionHandler:^(NSURLResponse *response, NSData *data, NSError *error) {
+            finished([(NSHTTPURLResponse *)response statusCode] == 200);
+        }];
+    }];
+    
+    [self reportTransport:@"sendasynchronousrequest" server:server objects:count putSeconds:putSeconds getSeconds:getSeconds];
+    [server stop];
+    
+}
+
+- (void)testTransports {
+    
+    // every transport talks to the stub through a real socket on the loopback interface, so the
+    // cost of opening connections shows up, and the server counts how many were opened
+    [self benchmarkSmallObjectsWithAsynchronousRequests];
+    
+    [RSStubServer reset];
+    [self benchmarkSmallObjectsWithTransport:[[RSTransport alloc] init] name:@"urlconnection"];
+    
+    if ([RSSessionTransport isAvailable]) {
+        [RSStubServer reset];
+        [self benchmarkSmallObjectsWithTransport:[[RSSessionTransport alloc] init] name:@"session"];
+    }
+    
+}
+
+- (void)benchmarkTransferWithLength:(unsigned long long)length container:(RSContainer *)container {
+    
+    NSString *sourcePath = [self writeFileWithLength:length];
+    RSStorageObject *object = [[RSStorageObject alloc] init];
+    object.name = [NSString stringWithFormat:@"large/%llu", length];
+    object.content_type = @"application/octet-stream";
+    
+    __block NSTimeInterval uploadSeconds = 0;
+    __block BOOL uploaded = NO;
+    unsigned long long baseline = [self residentMemory];
+    
+    unsigned long long uploadPeak = [self peakResidentMemoryDuring:^{
+        
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        NSDate *start = [NSDate date];
+        
+        [container uploadObject:object fromFile:sourcePath success:^{
+            uploaded = YES;
+            dispatch_semaphore_signal(semaphore);
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            STFail(@"Upload from file failed.");
+            dispatch_semaphore_signal(semaphore);
+        }];
+        
+        [self waitForSemaphore:semaphore];
+        uploadSeconds = -[start timeIntervalSinceNow];
+        
+    }];
+    
+    [[NSFileManager defaultManager] removeItemAtPath:sourcePath error:nil];
+    
+    if (!uploaded) {
+        return;
+    }
+    
+    [self reportBenchmark:@"large-upload" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                    [NSNumber numberWithUnsignedLongLong:length], @"bytes",
+                                                    [NSNumber numberWithDouble:uploadSeconds], @"seconds",
+                                                    [NSNumber numberWithDouble:length / uploadSeconds / 1048576], @"mb_per_second",
+                                                    [NSNumber numberWithLongLong:(long long)(uploadPeak - MIN(uploadPeak, baseline))], @"peak_rss_growth",
+                                                    nil]];
+    
+    NSString *destinationPath = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"RSBenchmark-%llu.download", length]];
+    NSArray *rangeCounts = [NSArray arrayWithObjects:[NSNumber numberWithUnsignedInteger:1], [NSNumber numberWithUnsignedInteger:4], [NSNumber numberWithUnsignedInteger:8], [NSNumber numberWithUnsignedInteger:16], nil];
+    
+    for (NSNumber *ranges in rangeCounts) {
+        
+        RSRangedDownload *download = [[RSRangedDownload alloc] initWithObject:object path:destinationPath];
+        download.rangeSize = (length + [ranges unsignedIntegerValue] - 1) / [ranges unsignedIntegerValue];
+        download.maxConcurrentRanges = [ranges unsignedIntegerValue];
+        
+        [[NSFileManager defaultManager] removeItemAtPath:destinationPath error:nil];
+        [[NSFileManager defaultManager] removeItemAtPath:download.journalPath error:nil];
+        
+        __block NSTimeInterval downloadSeconds = 0;
+        baseline = [self residentMemory];
+        
+        unsigned long long downloadPeak = [self peakResidentMemoryDuring:^{
+            
+            dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+            NSDate *start = [NSDate date];
+            
+            [download start:^{
+                dispatch_semaphore_signal(semaphore);
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                STFail(@"Ranged download failed.");
+                dispatch_semaphore_signal(semaphore);
+            }];
+            
+            [self waitForSemaphore:semaphore];
+            downloadSeconds = -[start timeIntervalSinceNow];
+            
+        }];
+        
+        [self reportBenchmark:@"large-download" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                          [NSNumber numberWithUnsignedLongLong:length], @"bytes",
+                                                          ranges, @"ranges",
+                                                          [NSNumber numberWithDouble:downloadSeconds], @"seconds",
+                                                          [NSNumber numberWithDouble:length / downloadSeconds / 1048576], @"mb_per_second",
+                                                          [NSNumber numberWithLongLong:(long long)(downloadPeak - MIN(downloadPeak, baseline))], @"peak_rss_growth",
+                                                          nil]];
+        
+        [[NSFileManager defaultManager] removeItemAtPath:destinationPath error:nil];
+        [[NSFileManager defaultManager] removeItemAtPath:download.journalPath error:nil];
+        
+    }
+    
+}
+
+- (void)testLargeTransferThroughput {
+    
+    // the stub keeps objects in memory, so the largest size is capped; set RS_BENCHMARK_MAX_BYTES to change it
+    NSString *limit = [[[NSProcessInfo processInfo] environment] objectForKey:@"RS_BENCHMARK_MAX_BYTES"];
+    unsigned long long maxLength = limit ? strtoull([limit UTF8String], NULL, 10) : kRSBenchmarkMaxTransferBytes;
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    
+    for (unsigned long long length = 1048576; length <= maxLength; length *= 16) {
+        @autoreleasepool {
+            [self benchmarkTransferWithLength:length container:container];
+        }
+        [RSStubServer setData:[NSData data] forObject:[NSString stringWithFormat:@"large/%llu", length] inContainer:kRSBenchmarkContainer];
+    }
+    
+}
+
+- (void)testCancelDownload {
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    unsigned long long length = 8388608;
+    
+    NSMutableData *data = [NSMutableData dataWithLength:(NSUInteger)length];
+    [RSStubServer setData:data forObject:@"cancel/large.bin" inContainer:kRSBenchmarkContainer];
+    
+    // slow enough that the download is still running when it's cancelled
+    [RSStubServer setBandwidth:1048576];
+    
+    RSStorageObject *object = [[RSStorageObject alloc] init];
+    object.name = @"cancel/large.bin";
+    object.parent = container;
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSBenchmark-cancel.bin"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+    dispatch_semaphore_t started = dispatch_semaphore_create(0);
+    dispatch_semaphore_t finished = dispatch_semaphore_create(0);
+    __block BOOL receiving = NO;
+    __block unsigned long long bytesReceived = 0;
+    
+    RSOperation *operation = [object writeObjectDataToFile:path atomically:YES progress:^(unsigned long long received, unsigned long long totalBytes) {
+        bytesReceived = received;
+        if (!receiving) {
+            receiving = YES;
+            dispatch_semaphore_signal(started);
+        }
+    } success:^{
+        dispatch_semaphore_signal(finished);
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        dispatch_semaphore_signal(finished);
+    }];
+    
+    if (![self waitForSemaphore:started]) {
+        return;
+    }
+    
+    NSDate *start = [NSDate date];
+    [operation cancel];
+    
+    if (![self waitForSemaphore:finished]) {
+        return;
+    }
+    
+    NSTimeInterval cancelSeconds = -[start timeIntervalSinceNow];
+    unsigned long long bytesAtCancel = bytesReceived;
+    
+    [self reportBenchmark:@"cancel-download" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                       [NSNumber numberWithUnsignedLongLong:length], @"bytes",
+                                                       [NSNumber numberWithUnsignedLongLong:bytesAtCancel], @"bytes_received",
+                                                       [NSNumber numberWithDouble:cancelSeconds * 1000], @"cancel_ms",
+                                                       nil]];
+    
+    [RSStubServer setBandwidth:0];
+    
+}
+
+- (void)testSkipUnchangedUploads {
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    NSString *path = [self writeFileWithLength:65536];
+    NSUInteger count = 100;
+    
+    for (NSUInteger pass = 0; pass < 2; pass++) {
+        
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        __block NSUInteger remaining = count;
+        __block NSUInteger uploadedCount = 0;
+        unsigned long long bytesBefore = [RSStubServer bytesReceived];
+        NSUInteger requestsBefore = [RSStubServer requestCount];
+        NSDate *start = [NSDate date];
+        
+        for (NSUInteger i = 0; i < count; i++) {
+            
+            RSStorageObject *object = [[RSStorageObject alloc] init];
+            object.name = [NSString stringWithFormat:@"unchanged/%06lu", (unsigned long)i];
+            object.content_type = @"application/octet-stream";
+            
+            [container uploadObjectIfChanged:object fromFile:path progress:nil success:^(BOOL uploaded) {
+                if (uploaded) {
+                    uploadedCount++;
+                }
+                if (--remaining == 0) {
+                    dispatch_semaphore_signal(semaphore);
+                }
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                STFail(@"Upload failed.");
+                if (--remaining == 0) {
+                    dispatch_semaphore_signal(semaphore);
+                }
+            }];
+            
+        }
+        
+        if (![self waitForSemaphore:semaphore]) {
+            break;
+        }
+        
+        [self reportBenchmark:@"upload-if-changed" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                             [NSNumber numberWithUnsignedInteger:pass], @"pass",
+                                                             [NSNumber numberWithUnsignedInteger:count], @"objects",
+                                                             [NSNumber numberWithUnsignedInteger:uploadedCount], @"uploaded",
+                                                             [NSNumber numberWithUnsignedInteger:[RSStubServer requestCount] - requestsBefore], @"requests",
+                                                             [NSNumber numberWithUnsignedLongLong:[RSStubServer bytesReceived] - bytesBefore], @"bytes_sent",
+                                                             [NSNumber numberWithDouble:-[start timeIntervalSinceNow]], @"seconds",
+                                                             nil]];
+        
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+}
+
+- (void)testContentAddressedSegments {
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    unsigned long long length = 33554432;
+    unsigned long long segmentSize = 1048576;
+    NSString *path = [self writeFileWithLength:length];
+    
+    // the second build differs from the first in two segments
+    for (NSUInteger build = 0; build < 2; build++) {
+        
+        if (build > 0) {
+            NSFileHandle *handle = [NSFileHandle fileHandleForUpdatingAtPath:path];
+            NSData *patch = [@"a few changed bytes" dataUsingEncoding:NSUTF8StringEncoding];
+            [handle seekToFileOffset:3 * segmentSize + 100];
+            [handle writeData:patch];
+            [handle seekToFileOffset:17 * segmentSize + 100];
+            [handle writeData:patch];
+            [handle closeFile];
+        }
+        
+        RSStorageObject *object = [[RSStorageObject alloc] init];
+        object.name = [NSString stringWithFormat:@"builds/%lu.bin", (unsigned long)build];
+        object.content_type = @"application/octet-stream";
+        
+        RSSegmentedUpload *upload = [[RSSegmentedUpload alloc] initWithContainer:container object:object path:path];
+        upload.segmentSize = segmentSize;
+        upload.contentAddressed = YES;
+        
+        dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+        __block BOOL succeeded = NO;
+        unsigned long long bytesBefore = [RSStubServer bytesReceived];
+        NSDate *start = [NSDate date];
+        
+        [upload start:^{
+            succeeded = YES;
+            dispatch_semaphore_signal(semaphore);
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            STFail(@"Content-addressed upload failed.");
+            dispatch_semaphore_signal(semaphore);
+        }];
+        
+        if (![self waitForSemaphore:semaphore] || !succeeded) {
+            break;
+        }
+        
+        unsigned long long bytesSent = [RSStubServer bytesReceived] - bytesBefore;
+        
+        if (build > 0) {
+            STAssertEquals(upload.reusedBytes, length - 2 * segmentSize, @"unchanged segments should be reused");
+            STAssertTrue(bytesSent < 3 * segmentSize, @"only the changed segments and the manifest should be sent");
+        }
+        
+        [self reportBenchmark:@"content-addressed-upload" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                                    [NSNumber numberWithUnsignedInteger:build], @"build",
+                                                                    [NSNumber numberWithUnsignedLongLong:length], @"bytes",
+                                                                    [NSNumber numberWithUnsignedLongLong:segmentSize], @"segment_size",
+                                                                    [NSNumber numberWithUnsignedLongLong:upload.reusedBytes], @"reused_bytes",
+                                                                    [NSNumber numberWithUnsignedLongLong:bytesSent], @"bytes_sent",
+                                                                    [NSNumber numberWithDouble:-[start timeIntervalSinceNow]], @"seconds",
+                                                                    nil]];
+        
+    }
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+}
+
+- (void)testRetriesThroughInjectedErrors {
+    
+    RSClient *client = [self stubClient];
+    RSContainer *container = [self createContainerWithClient:client];
+    
+    RSStorageObject *object = [[RSStorageObject alloc] init];
+    object.name = @"flaky.txt";
+    object.content_type = @"text/plain";
+    object.data = [@"This is a test." dataUsingEncoding:NSUTF8StringEncoding];
+    
+    NSUInteger requestsBefore = [RSStubServer requestCount];
+    [RSStubServer failNextRequests:2 statusCode:503];
+    
+    dispatch_semaphore_t semaphore = dispatch_semaphore_create(0);
+    __block BOOL succeeded = NO;
+    NSDate *start = [NSDate date];
+    
+    [container uploadObject:object success:^{
+        succeeded = YES;
+        dispatch_semaphore_signal(semaphore);
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        dispatch_semaphore_signal(semaphore);
+    }];
+    
+    if (![self waitForSemaphore:semaphore]) {
+        return;
+    }
+    
+    STAssertTrue(succeeded, @"upload should succeed once the injected errors are retried");
+    STAssertEquals([RSStubServer requestCount] - requestsBefore, (NSUInteger)3, @"upload should take two retries");
+    
+    [self reportBenchmark:@"retry-503" metrics:[NSDictionary dictionaryWithObjectsAndKeys:
+                                                 [NSNumber numberWithUnsignedInteger:2], @"injected_failures",
+                                                 [NSNumber numberWithDouble:-[start timeIntervalSinceNow]], @"seconds",
+                                                 nil]];
+    
+}
+
+@end
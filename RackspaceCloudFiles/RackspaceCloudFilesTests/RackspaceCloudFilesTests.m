@@ -8,10 +8,22 @@
 
 #import "RackspaceCloudFilesTests.h"
 #import "RSClient.h"
+#import "RSStubServer.h"
+#import "RSStubTransport.h"
+
+static void *RSFractionCompletedContext = &RSFractionCompletedContext;
+
+@interface RackspaceCloudFilesTests ()
+
+@property (nonatomic, strong) NSMutableArray *observedFractions;
+@property (nonatomic) BOOL observedOffCompletionQueue;
+
+@end
 
 @implementation RackspaceCloudFilesTests
 
 @synthesize client, container, object, waiting, timeoutFailureString;
+@synthesize observedFractions, observedOffCompletionQueue;
 
 #pragma mark - Utilities
 
@@ -41,6 +53,20 @@
     self.waiting = NO;
 }
 
+- (void)observeValueForKeyPath:(NSString *)keyPath ofObject:(id)observed change:(NSDictionary *)change context:(void *)context {
+    
+    if (context != RSFractionCompletedContext) {
+        [super observeValueForKeyPath:keyPath ofObject:observed change:change context:context];
+        return;
+    }
+    
+    if ([NSOperationQueue currentQueue] != self.client.completionQueue) {
+        self.observedOffCompletionQueue = YES;
+    }
+    [self.observedFractions addObject:[change objectForKey:NSKeyValueChangeNewKey]];
+    
+}
+
 - (void)createContainer:(void (^)(RSContainer *))successHandler {
     
     RSContainer *c = [[RSContainer alloc] init];
@@ -141,8 +167,20 @@
     NSString *username = [settings valueForKey:@"username"];
     NSString *apiKey = [settings valueForKey:@"api_key"];
     
+    // run against an in-process stand-in for the API instead of a real account
+    if ([[settings valueForKey:@"use_stub_server"] boolValue]) {
+        [RSStubServer start];
+        url = [RSStubServer authURL];
+        username = [RSStubServer username];
+        apiKey = [RSStubServer apiKey];
+    }
+    
     self.client = [[RSClient alloc] initWithAuthURL:url username:username apiKey:apiKey];
     
+    if ([[settings valueForKey:@"use_stub_server"] boolValue]) {
+        [RSStubServer prepareClient:self.client];
+    }
+    
     [self createContainer:^(RSContainer *c) {
         [self loadContainer:^{        
             [self createObject:^(RSStorageObject *o) {
@@ -171,6 +209,7 @@
     }];
     
     [self waitForTestCompletion];    
+    [RSStubServer stop];
     [super tearDown];
     
 }
@@ -189,6 +228,63 @@
     
 }
 
+- (void)testReauthenticationAfterExpiredToken {
+    
+    [self.client authenticate:^{
+        
+        // simulate a token that the API no longer accepts
+        self.client.authToken = @"expired";
+        
+        [self.client getAccountMetadata:^{
+            [self stopWaiting];
+            STAssertFalse([self.client.authToken isEqualToString:@"expired"], @"Client should have a new auth token");
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"Request should be resent after authenticating again.");
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"Authentication failed.");
+    }];
+    
+}
+
+- (void)testFailedAuthenticationFinishesOperation {
+    
+    RSClient *rejected = [[RSClient alloc] initWithAuthURL:self.client.authURL username:self.client.username apiKey:@"not-the-api-key"];
+    rejected.transport = self.client.transport;
+    [RSStubServer prepareClient:rejected];
+    
+    // the parent holds on to its child only until the child finishes
+    RSOperation *parent = [[RSOperation alloc] initWithClient:rejected];
+    __block __weak RSOperation *weakOperation = nil;
+    
+    @autoreleasepool {
+        
+        RSOperation *operation = [rejected getContainers:^(NSArray *containers, NSError *jsonError) {
+            [self stopWaiting];
+            STFail(@"a request should not succeed without authenticating");
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            
+            STAssertEquals([response statusCode], (NSInteger)401, @"the failure should carry the authentication response");
+            
+            // the connection reports itself finished after this handler returns
+            [rejected.completionQueue addOperationWithBlock:^{
+                [self stopWaiting];
+                STAssertNil(weakOperation, @"an operation whose authentication failed should finish and be let go of");
+                STAssertNotNil(parent, @"the parent should still be alive");
+            }];
+            
+        }];
+        
+        [parent addOperation:operation];
+        weakOperation = operation;
+        
+    }
+    
+}
+
 - (void)testGetAccountMetadata {
     
     [self.client getAccountMetadata:^{
@@ -213,6 +309,231 @@
     
 }
 
+- (void)testConcurrentRequestLimit {
+    
+    // the stub transport has no limit of its own, so only the client keeps requests in line
+    RSTransport *networkTransport = self.client.transport;
+    RSStubTransport *stubTransport = [[RSStubTransport alloc] init];
+    self.client.transport = stubTransport;
+    self.client.maxConcurrentRequests = 2;
+    __block NSUInteger remaining = 6;
+    
+    for (NSUInteger i = 0; i < 6; i++) {
+        
+        [self.client getContainers:^(NSArray *containers, NSError *jsonError) {
+            
+            STAssertFalse([NSThread isMainThread], @"handlers should not execute on the main thread");
+            if (--remaining == 0) {
+                self.client.transport = networkTransport;
+                [self stopWaiting];
+                STAssertEquals([stubTransport.sentRequests count], (NSUInteger)6, @"every request should be sent");
+                STAssertEquals(stubTransport.maxInFlightCount, (NSUInteger)2, @"no more than maxConcurrentRequests should be in flight");
+            }
+            
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            self.client.transport = networkTransport;
+            [self stopWaiting];
+            STFail(@"Get Containers failed.");
+        }];
+        
+    }
+    
+}
+
+- (void)testCancelWaitingPagedListing {
+    
+    // the first request holds the only slot, so the listing waits in line when it's cancelled
+    RSTransport *networkTransport = self.client.transport;
+    RSStubTransport *stubTransport = [[RSStubTransport alloc] init];
+    stubTransport.delay = 0.5;
+    self.client.transport = stubTransport;
+    self.client.maxConcurrentRequests = 1;
+    __block BOOL blockerFinished = NO;
+    
+    [self.client getContainers:^(NSArray *containers, NSError *jsonError) {
+        blockerFinished = YES;
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        blockerFinished = YES;
+    }];
+    
+    RSOperation *operation = [self.container getAllObjects:^(NSArray *objects, BOOL *stop) {
+        STFail(@"a cancelled listing should not deliver pages");
+    } success:^{
+        self.client.transport = networkTransport;
+        [self stopWaiting];
+        STFail(@"a cancelled listing should not succeed");
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        self.client.transport = networkTransport;
+        [self stopWaiting];
+        STAssertEquals([error code], (NSInteger)NSURLErrorCancelled, @"the listing should fail as cancelled");
+        STAssertFalse(blockerFinished, @"a waiting listing should fail as soon as it's cancelled, not when a slot frees up");
+        STAssertEquals([stubTransport.sentRequests count], (NSUInteger)1, @"the listing should never be sent");
+    }];
+    
+    [operation cancel];
+    
+}
+
+- (void)testCancelSegmentedUpload {
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-cancel.dat"];
+    [[NSMutableData dataWithLength:65536 * 3] writeToFile:path atomically:YES];
+    
+    RSStorageObject *o = [[RSStorageObject alloc] init];
+    o.name = @"cancelled.dat";
+    
+    RSSegmentedUpload *upload = [[RSSegmentedUpload alloc] initWithContainer:self.container object:o path:path];
+    upload.segmentSize = 65536;
+    upload.maxConcurrentSegments = 2;
+    
+    // one segment goes out and the other waits for the only slot.  the upload is cancelled as soon
+    // as the first segment is sent.
+    RSTransport *networkTransport = self.client.transport;
+    RSStubTransport *stubTransport = [[RSStubTransport alloc] init];
+    self.client.transport = stubTransport;
+    self.client.maxConcurrentRequests = 1;
+    __block NSUInteger segmentsSent = 0;
+    __block NSUInteger failures = 0;
+    
+    stubTransport.statusCodeHandler = ^NSInteger(NSURLRequest *request) {
+        if ([request HTTPBodyStream] && segmentsSent++ == 0) {
+            [self.client.completionQueue addOperationWithBlock:^{
+                [upload.operation cancel];
+            }];
+        }
+        return 201;
+    };
+    
+    [upload start:^{
+        self.client.transport = networkTransport;
+        [self stopWaiting];
+        STFail(@"a cancelled upload should not succeed");
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        
+        failures++;
+        STAssertEquals([error code], (NSInteger)NSURLErrorCancelled, @"the upload should fail as cancelled");
+        
+        // anything still to come would arrive within the stub's delay
+        dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.2 * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+            self.client.transport = networkTransport;
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+            [self stopWaiting];
+            STAssertEquals(failures, (NSUInteger)1, @"the failure handler should execute once");
+            STAssertEquals(segmentsSent, (NSUInteger)1, @"no segment should be sent after the upload is cancelled");
+        });
+        
+    }];
+    
+}
+
+- (void)testCancelRetryInProgress {
+    
+    // the first attempt is answered after 0.05 seconds, and the retry would go 0.5 seconds later
+    RSTransport *networkTransport = self.client.transport;
+    RSStubTransport *stubTransport = [[RSStubTransport alloc] init];
+    stubTransport.statusCode = 503;
+    stubTransport.responseHeaders = [NSDictionary dictionaryWithObject:@"0.5" forKey:@"Retry-After"];
+    self.client.transport = stubTransport;
+    self.client.circuitBreaker = nil;
+    
+    RSOperation *operation = [self.client getContainers:^(NSArray *containers, NSError *jsonError) {
+        self.client.transport = networkTransport;
+        [self stopWaiting];
+        STFail(@"a cancelled request should not succeed");
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        self.client.transport = networkTransport;
+        [self stopWaiting];
+        STAssertEquals([error code], (NSInteger)NSURLErrorCancelled, @"the request should fail as cancelled");
+        STAssertEquals([stubTransport.sentRequests count], (NSUInteger)1, @"the retry should not be sent");
+    }];
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.2 * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [operation cancel];
+    });
+    
+}
+
+- (void)testQueuedOperationPriority {
+    
+    // the first request holds the only slot while the other two wait, and the last one is moved ahead
+    RSTransport *networkTransport = self.client.transport;
+    RSStubTransport *stubTransport = [[RSStubTransport alloc] init];
+    stubTransport.delay = 0.2;
+    self.client.transport = stubTransport;
+    self.client.maxConcurrentRequests = 1;
+    __block NSUInteger remaining = 3;
+    
+    void (^finished)() = ^{
+        if (--remaining == 0) {
+            self.client.transport = networkTransport;
+            [self stopWaiting];
+            NSArray *requests = stubTransport.sentRequests;
+            STAssertEquals([requests count], (NSUInteger)3, @"every request should be sent");
+            STAssertEqualObjects([[requests objectAtIndex:1] HTTPMethod], @"GET", @"the raised listing should be sent before the metadata request");
+            STAssertEqualObjects([[requests objectAtIndex:2] HTTPMethod], @"HEAD", @"the metadata request should be sent last");
+        }
+    };
+    
+    void (^failed)(NSHTTPURLResponse*, NSData*, NSError*) = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        STFail(@"request failed");
+        finished();
+    };
+    
+    [self.client getContainers:^(NSArray *containers, NSError *jsonError) {
+        finished();
+    } failure:failed];
+    
+    [self.client getContainerMetadata:self.container success:^{
+        finished();
+    } failure:failed];
+    
+    RSOperation *listing = [self.container getObjects:^(NSArray *objects, NSError *jsonError) {
+        finished();
+    } failure:failed];
+    
+    listing.queuePriority = NSOperationQueuePriorityHigh;
+    
+}
+
+- (void)testFractionCompletedOfSeveralChildren {
+    
+    RSOperation *parent = [[RSOperation alloc] initWithClient:self.client];
+    RSOperation *first = [[RSOperation alloc] initWithClient:self.client];
+    RSOperation *second = [[RSOperation alloc] initWithClient:self.client];
+    RSConnection *firstConnection = [[RSConnection alloc] initWithRequestHandler:nil];
+    RSConnection *secondConnection = [[RSConnection alloc] initWithRequestHandler:nil];
+    
+    [parent addOperation:first];
+    [parent addOperation:second];
+    [first addConnection:firstConnection];
+    [second addConnection:secondConnection];
+    
+    self.observedFractions = [NSMutableArray array];
+    self.observedOffCompletionQueue = NO;
+    [parent addObserver:self forKeyPath:@"fractionCompleted" options:NSKeyValueObservingOptionNew context:RSFractionCompletedContext];
+    
+    [first child:firstConnection didTransferBytes:50 ofTotal:100];
+    [second child:secondConnection didTransferBytes:25 ofTotal:100];
+    [first child:firstConnection didTransferBytes:100 ofTotal:100];
+    
+    // the finished child is let go of, and its bytes stay in the parent's counts
+    [first connectionFinished:firstConnection];
+    
+    // changes are posted on the completion queue, so they're all in once this runs
+    [self.client.completionQueue addOperationWithBlock:^{
+        
+        [parent removeObserver:self forKeyPath:@"fractionCompleted" context:RSFractionCompletedContext];
+        [self stopWaiting];
+        
+        STAssertEquals(parent.completedBytes, (unsigned long long)125, @"the parent should count the bytes of every child");
+        STAssertEquals(parent.totalBytes, (unsigned long long)200, @"the parent should count the totals of every child");
+        STAssertEqualsWithAccuracy([[self.observedFractions lastObject] doubleValue], 0.625, 0.0001, @"observers should see the latest fraction");
+        STAssertFalse(self.observedOffCompletionQueue, @"changes should be posted on the completion queue");
+        
+    }];
+    
+}
+
 - (void)testGetContainerMetadata {
     
     [self.client getContainerMetadata:self.container success:^{
@@ -224,6 +545,129 @@
     
 }
 
+- (void)testMetadataCache {
+    
+    self.client.metadataCache = [[RSMetadataCache alloc] init];
+    self.client.metadataCache.maxAge = 60;
+    
+    [self.client getContainerMetadata:self.container success:^{
+        [self.client getContainerMetadata:self.container success:^{
+            
+            STAssertEquals(self.client.metadataCache.missCount, (NSUInteger)1, @"first request should miss the cache");
+            STAssertEquals(self.client.metadataCache.hitCount, (NSUInteger)1, @"second request should be answered from the cache");
+            
+            // writing to the container should invalidate its metadata
+            [self.container uploadObject:self.object success:^{
+                [self.client getContainerMetadata:self.container success:^{
+                    [self stopWaiting];
+                    STAssertEquals(self.client.metadataCache.missCount, (NSUInteger)2, @"metadata should be retrieved again after a write");
+                } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                    [self stopWaiting];
+                    STFail(@"Get container metadata failed");
+                }];
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                [self stopWaiting];
+                STFail(@"Upload object failed");
+            }];
+            
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"Get container metadata failed");
+        }];
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"Get container metadata failed");
+    }];
+    
+}
+
+- (void)testMetadataCacheRefetchesAfterEviction {
+    
+    RSTransport *networkTransport = self.client.transport;
+    RSStubTransport *stubTransport = [[RSStubTransport alloc] init];
+    RSMetadataCache *cache = [[RSMetadataCache alloc] init];
+    
+    stubTransport.responseHeaders = [NSDictionary dictionaryWithObject:@"\"listing\"" forKey:@"ETag"];
+    self.client.transport = stubTransport;
+    self.client.metadataCache = cache;
+    
+    // the cached listing is discarded while the conditional request is in flight, so its 304 can't be answered
+    stubTransport.statusCodeHandler = ^NSInteger(NSURLRequest *request) {
+        if ([request valueForHTTPHeaderField:@"If-None-Match"]) {
+            [cache removeAllEntries];
+            return 304;
+        }
+        return 200;
+    };
+    
+    [self.client getContainers:^(NSArray *containers, NSError *jsonError) {
+        [self.client getContainers:^(NSArray *containers, NSError *jsonError) {
+            
+            self.client.transport = networkTransport;
+            self.client.metadataCache = nil;
+            [self stopWaiting];
+            
+            NSArray *requests = stubTransport.sentRequests;
+            STAssertEquals([requests count], (NSUInteger)3, @"a 304 without a cached response should be asked again");
+            STAssertNil([[requests lastObject] valueForHTTPHeaderField:@"If-None-Match"], @"the request should be sent again without the condition");
+            
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            self.client.transport = networkTransport;
+            self.client.metadataCache = nil;
+            [self stopWaiting];
+            STFail(@"a 304 for an evicted entry should not fail: %i", [response statusCode]);
+        }];
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        self.client.transport = networkTransport;
+        self.client.metadataCache = nil;
+        [self stopWaiting];
+        STFail(@"Get Containers failed.");
+    }];
+    
+}
+
+- (void)testCircuitBreaker {
+    
+    // one failure opens the breaker for the storage host, so the next request is never sent
+    self.client.retryPolicy = nil;
+    self.client.circuitBreaker.failureThreshold = 1;
+    
+    NSURLRequest *request = [self.client getContainerMetadataRequest:self.container];
+    NSHTTPURLResponse *response = [[NSHTTPURLResponse alloc] initWithURL:[request URL] statusCode:503 HTTPVersion:@"HTTP/1.1" headerFields:nil];
+    [self.client.circuitBreaker recordResponse:response error:nil forRequest:request];
+    
+    [self.client getContainerMetadata:self.container success:^{
+        [self stopWaiting];
+        STFail(@"Request should not be sent while the circuit breaker is open");
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STAssertEquals([error code], (NSInteger)ECIRCUITOPEN, @"request should fail with ECIRCUITOPEN");
+        [self.client.circuitBreaker reset];
+    }];
+    
+}
+
+- (void)testInstrumentation {
+    
+    self.client.instrumentation = [[RSInstrumentation alloc] init];
+    
+    [self.client getContainers:^(NSArray *containers, NSError *jsonError) {
+        
+        // the record is added once the success handler returns
+        [self.client.completionQueue addOperationWithBlock:^{
+            [self stopWaiting];
+            NSDictionary *list = [[self.client.instrumentation snapshot] objectForKey:@"list"];
+            STAssertEquals([[list objectForKey:@"requests"] integerValue], (NSInteger)1, @"the listing should be recorded");
+            STAssertTrue([[[list objectForKey:@"latency"] objectForKey:@"p50"] doubleValue] > 0, @"the listing should be timed");
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"Get containers failed");
+    }];
+    
+}
+
 - (void)testPurgeCDNContainer {
     
     [self cdnEnableContainer:^(RSCDNContainer *cdnContainer) {
@@ -251,6 +695,114 @@
     
 }
 
+- (void)testPurgeQueueCoalescesPurges {
+    
+    [self cdnEnableContainer:^(RSCDNContainer *cdnContainer) {
+        
+        RSTransport *networkTransport = self.client.transport;
+        RSStubTransport *stubTransport = [[RSStubTransport alloc] init];
+        stubTransport.statusCode = 204;
+        self.client.transport = stubTransport;
+        
+        RSPurgeQueue *queue = [[RSPurgeQueue alloc] initWithClient:self.client];
+        queue.coalescingWindow = 0.2;
+        queue.maxPurgesPerSecond = 0;
+        
+        // a release over the threshold touches each file twice, and becomes a single purge of the container
+        NSUInteger files = kRSDefaultPurgeContainerThreshold + 50;
+        __block NSUInteger remaining = files * 2;
+        __block NSUInteger failures = 0;
+        
+        void (^finished)() = ^{
+            self.client.transport = networkTransport;
+            [self stopWaiting];
+            STAssertEquals(failures, (NSUInteger)0, @"every purge should succeed");
+            STAssertEquals(queue.purgeRequestsSent, (NSUInteger)1, @"the release should be sent as one request");
+            STAssertEquals([stubTransport.sentRequests count], (NSUInteger)1, @"the release should be sent as one request");
+            STAssertEqualObjects([[[stubTransport.sentRequests lastObject] URL] lastPathComponent], cdnContainer.name, @"the container should be purged");
+        };
+        
+        for (NSUInteger repeat = 0; repeat < 2; repeat++) {
+            for (NSUInteger i = 0; i < files; i++) {
+                
+                RSStorageObject *o = [[RSStorageObject alloc] init];
+                o.name = [NSString stringWithFormat:@"release/file-%05lu", (unsigned long)i];
+                
+                [queue purgeObject:o inContainer:cdnContainer success:^{
+                    if (--remaining == 0) {
+                        finished();
+                    }
+                } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                    failures++;
+                    if (--remaining == 0) {
+                        finished();
+                    }
+                }];
+                
+            }
+        }
+        
+    }];
+    
+}
+
+- (void)testPurgeQueueRetriesRateLimitedPurges {
+    
+    [self cdnEnableContainer:^(RSCDNContainer *cdnContainer) {
+        
+        // the CDN refuses the first few purges, and the queue backs off until it takes them
+        RSTransport *networkTransport = self.client.transport;
+        RSStubTransport *stubTransport = [[RSStubTransport alloc] init];
+        __block NSUInteger refusals = 3;
+        stubTransport.statusCodeHandler = ^NSInteger(NSURLRequest *request) {
+            if (refusals > 0) {
+                refusals--;
+                return 498;
+            }
+            return 204;
+        };
+        self.client.transport = stubTransport;
+        self.client.circuitBreaker = nil;
+        
+        RSPurgeQueue *queue = [[RSPurgeQueue alloc] initWithClient:self.client];
+        queue.coalescingWindow = 0;
+        queue.maxPurgesPerSecond = 0;
+        queue.retryPolicy.baseDelay = 0.05;
+        
+        NSUInteger files = 5;
+        __block NSUInteger remaining = files;
+        __block NSUInteger failures = 0;
+        
+        void (^finished)() = ^{
+            self.client.transport = networkTransport;
+            [self stopWaiting];
+            STAssertEquals(failures, (NSUInteger)0, @"every refused purge should be sent again until it's taken");
+            STAssertEquals([stubTransport.sentRequests count], files + 3, @"every refused purge should be sent again");
+            STAssertEquals(queue.purgeRequestsSent, files + 3, @"purges sent again should be counted");
+        };
+        
+        for (NSUInteger i = 0; i < files; i++) {
+            
+            RSStorageObject *o = [[RSStorageObject alloc] init];
+            o.name = [NSString stringWithFormat:@"release/file-%05lu", (unsigned long)i];
+            
+            [queue purgeObject:o inContainer:cdnContainer success:^{
+                if (--remaining == 0) {
+                    finished();
+                }
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                failures++;
+                if (--remaining == 0) {
+                    finished();
+                }
+            }];
+            
+        }
+        
+    }];
+    
+}
+
 - (void)testUpdateCDNContainer {
     
     [self cdnEnableContainer:^(RSCDNContainer *cdnContainer) {
@@ -285,40 +837,423 @@
     
 }
 
-
-- (void)testGetObjectData {
-    
-    self.object.data = nil; // clear out the data to make sure we're getting it from the API
+- (void)testGetAllObjects {
     
-    [self.object getObjectData:^{
+    // a page size of one makes the listing follow the marker past test.txt to an empty page
+    RSPagedListing *listing = [[RSPagedListing alloc] initWithClient:self.client modelClass:[RSStorageObject class] parent:self.container requestHandler:^NSURLRequest *(NSUInteger limit, NSString *marker) {
         
-        [self stopWaiting];
-        STAssertNotNil(object.data, @"object data should not be nil");
+        NSMutableDictionary *params = [NSMutableDictionary dictionaryWithObject:[NSString stringWithFormat:@"%lu", (unsigned long)limit] forKey:@"limit"];
+        if (marker) {
+            [params setObject:marker forKey:@"marker"];
+        }
+        return [self.container getObjectsRequest:params];
         
+    }];
+    listing.pageSize = 1;
+    
+    __block NSUInteger pages = 0;
+    
+    [listing start:^(NSArray *objects, BOOL *stop) {
+        pages++;
+    } success:^{
+        [self stopWaiting];
+        STAssertEquals(pages, (NSUInteger)2, @"listing should follow the marker to a second page");
+        STAssertEquals(listing.count, (NSUInteger)1, @"listing should return the test object once");
     } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
-        
         [self stopWaiting];
-        STFail(@"get object data failed");
-        
+        STFail(@"Get all objects failed");
     }];
     
 }
 
-- (void)testGetObjectMetadata {
+- (void)testListingQueryEscaping {
     
-    self.object.metadata = [[NSMutableDictionary alloc] initWithCapacity:1];
-    [self.object.metadata setValue:@"Mike" forKey:@"Name"];
+    [self stopWaiting];
     
-    [self.object updateMetadata:^{
-        
-        // let's clear it out, and then get it to make sure it comes back from the API                
-        [self.object.metadata removeAllObjects];
-        
-        [self.object getMetadata:^{
-            
-            [self stopWaiting];
-            STAssertEqualObjects([self.object.metadata valueForKey:@"Name"], @"Mike", @"Object metadata should be set");            
-            
+    // a marker containing the characters that separate query parameters must not change the query
+    NSDictionary *params = [NSDictionary dictionaryWithObjectsAndKeys:@"a&b=c+d?e #f", @"marker", @"2", @"limit", nil];
+    NSString *query = @"limit=2&marker=a%26b%3Dc%2Bd%3Fe%20%23f";
+    
+    STAssertEqualObjects([RSClient queryStringWithParameters:params], query, @"parameters should be sorted and fully escaped");
+    STAssertEqualObjects([[[self.container getObjectsRequest:params] URL] query], [@"format=json&" stringByAppendingString:query], @"listing requests should escape their parameters");
+    
+}
+
+- (void)testListingIndex {
+    
+    [self stopWaiting];
+    
+    RSListingIndex *index = [[RSListingIndex alloc] init];
+    NSUInteger count = 1000;
+    NSMutableArray *page = [[NSMutableArray alloc] init];
+    
+    // pages arrive in order, then a straggler lands in the middle
+    for (NSUInteger i = 0; i < count; i++) {
+        RSStorageObject *o = [[RSStorageObject alloc] init];
+        o.name = [NSString stringWithFormat:@"logs/%03lu/%06lu.gz", (unsigned long)(i % 20), (unsigned long)i];
+        [page addObject:o];
+        if ([page count] == 100) {
+            [index addObjects:page];
+            [page removeAllObjects];
+        }
+    }
+    
+    STAssertEquals(index.count, count, @"every object should be indexed");
+    
+    RSStorageObject *extra = [[RSStorageObject alloc] init];
+    extra.name = @"logs/005/extra.gz";
+    [index addObjects:[NSArray arrayWithObject:extra]];
+    
+    NSUInteger found = 0;
+    for (NSUInteger i = 0; i < 20; i++) {
+        found += [[index objectsWithPrefix:[NSString stringWithFormat:@"logs/%03lu/", (unsigned long)i] limit:0] count];
+    }
+    
+    STAssertEquals(found, count + 1, @"prefix queries should cover every object");
+    STAssertEqualObjects([[[index objectsWithPrefix:@"logs/005/" limit:0] lastObject] name], @"logs/005/extra.gz", @"inserted names should be in order");
+    STAssertEquals([[index objectsAfterMarker:@"logs/001/" endMarker:@"logs/003/" limit:0] count], (NSUInteger)100, @"range should stop before the end marker");
+    STAssertEquals([[index objectsWithPrefix:@"logs/" limit:10] count], (NSUInteger)10, @"limit should be honored");
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-index.plist"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+    RSListingIndex *saved = [[RSListingIndex alloc] initWithPath:path];
+    [saved addObjects:[index objectsWithPrefix:@"logs/005/" limit:0]];
+    STAssertTrue([saved save], @"index should be written");
+    
+    RSListingIndex *loaded = [[RSListingIndex alloc] initWithPath:path];
+    STAssertEquals(loaded.count, saved.count, @"saved index should be read back");
+    STAssertNotNil([loaded objectNamed:@"logs/005/extra.gz"], @"saved objects should be found by name");
+    
+    RSStorageObject *large = [[RSStorageObject alloc] init];
+    large.name = @"logs/005/large.gz";
+    large.bytes = 5000000000ULL;
+    [saved addObjects:[NSArray arrayWithObject:large]];
+    STAssertTrue([saved save], @"index should be written");
+    loaded = [[RSListingIndex alloc] initWithPath:path];
+    STAssertEquals([loaded objectNamed:@"logs/005/large.gz"].bytes, large.bytes, @"sizes over 4 GB should be read back whole");
+    
+    // a damaged record makes the whole file unusable
+    NSDictionary *damaged = [NSDictionary dictionaryWithObjectsAndKeys:
+                             [NSNumber numberWithInteger:1], @"version",
+                             [NSArray arrayWithObjects:
+                              [NSArray arrayWithObjects:@"logs/a.gz", [NSNumber numberWithInt:1], @"", @"", @"", nil],
+                              [NSArray arrayWithObjects:@"logs/b.gz", @"1", nil],
+                              nil], @"objects",
+                             nil];
+    [[NSPropertyListSerialization dataWithPropertyList:damaged format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil] writeToFile:path atomically:YES];
+    loaded = [[RSListingIndex alloc] initWithPath:path];
+    STAssertEquals(loaded.count, (NSUInteger)0, @"an index with a damaged record should start empty");
+    
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+}
+
+- (void)testBrowseDirectory {
+    
+    // the last name would split or end the query string if prefixes weren't escaped
+    NSArray *names = [NSArray arrayWithObjects:@"browse/dir-00/file-0", @"browse/dir-00/file-1", @"browse/dir-01/file-0", @"browse/dir-01/file-1", @"browse/dir-01/file-2", @"browse/a&b+c=d #%/readme.txt", nil];
+    NSMutableArray *objects = [[NSMutableArray alloc] initWithCapacity:[names count]];
+    RSContainerBrowser *browser = [[RSContainerBrowser alloc] initWithContainer:self.container];
+    __block NSUInteger remaining = [names count];
+    
+    void (^finished)() = ^{
+        [self.container deleteObjects:objects success:^{
+            [self stopWaiting];
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"delete browsed objects failed");
+        }];
+    };
+    
+    void (^failed)(NSHTTPURLResponse *, NSData *, NSError *) = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"open directory failed: %ld", (long)[response statusCode]);
+    };
+    
+    void (^browse)() = ^{
+        
+        [browser childrenOfDirectory:@"browse" success:^(NSArray *top) {
+            
+            STAssertEquals([top count], (NSUInteger)3, @"the top level should list only directories");
+            STAssertTrue([[top objectAtIndex:0] subdirectory], @"directories should be marked");
+            
+            [browser childrenOfDirectory:@"browse/a&b+c=d #%" success:^(NSArray *special) {
+                
+                STAssertEquals([special count], (NSUInteger)1, @"prefixes should be escaped");
+                STAssertEqualObjects([[special lastObject] name], @"browse/a&b+c=d #%/readme.txt", @"prefixes should be escaped");
+                
+                [browser childrenOfDirectory:@"browse/dir-01" success:^(NSArray *children) {
+                    
+                    STAssertEquals([children count], (NSUInteger)3, @"a directory should list its objects");
+                    
+                    // a listed directory is answered from the index, so nothing reaches the transport
+                    RSTransport *networkTransport = self.client.transport;
+                    RSStubTransport *stubTransport = [[RSStubTransport alloc] init];
+                    stubTransport.statusCode = 500;
+                    self.client.transport = stubTransport;
+                    
+                    [browser childrenOfDirectory:@"browse/dir-01" success:^(NSArray *cached) {
+                        
+                        self.client.transport = networkTransport;
+                        STAssertEquals([cached count], (NSUInteger)3, @"a directory should be answered from the index");
+                        STAssertEquals([stubTransport.sentRequests count], (NSUInteger)0, @"an indexed directory should not take a request");
+                        STAssertEquals([[browser indexedObjectsWithPrefix:@"browse/dir-01/file-" limit:0] count], (NSUInteger)3, @"prefix queries should be answered from the index");
+                        finished();
+                        
+                    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                        self.client.transport = networkTransport;
+                        failed(response, data, error);
+                    }];
+                    
+                } failure:failed];
+                
+            } failure:failed];
+            
+        } failure:failed];
+        
+    };
+    
+    for (NSString *name in names) {
+        
+        RSStorageObject *o = [[RSStorageObject alloc] init];
+        o.name = name;
+        o.content_type = @"text/plain";
+        o.data = [@"x" dataUsingEncoding:NSUTF8StringEncoding];
+        [objects addObject:o];
+        
+        [self.container uploadObject:o success:^{
+            if (--remaining == 0) {
+                browse();
+            }
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"upload object to browse failed: %ld", (long)[response statusCode]);
+        }];
+        
+    }
+    
+}
+
+- (void)testGetObjectData {
+    
+    self.object.data = nil; // clear out the data to make sure we're getting it from the API
+    
+    [self.object getObjectData:^{
+        
+        [self stopWaiting];
+        STAssertNotNil(object.data, @"object data should not be nil");
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        
+        [self stopWaiting];
+        STFail(@"get object data failed");
+        
+    }];
+    
+}
+
+- (void)testWriteObjectDataToFile {
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-download.txt"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+    [self.object writeObjectDataToFile:path atomically:YES success:^{
+        
+        [self stopWaiting];
+        NSString *contents = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
+        STAssertEqualObjects(contents, @"This is a test.", @"downloaded file should contain the object data");
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        
+        [self stopWaiting];
+        STFail(@"write object data to file failed");
+        
+    }];
+    
+}
+
+- (void)testWriteCompressedObjectDataToFile {
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-compressed.txt"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+    NSMutableString *text = [NSMutableString string];
+    for (NSUInteger i = 0; i < 1000; i++) {
+        [text appendString:@"This is a test. "];
+    }
+    
+    RSStorageObject *o = [[RSStorageObject alloc] init];
+    o.name = @"compressed.txt";
+    o.content_type = @"text/plain";
+    o.data = [text dataUsingEncoding:NSUTF8StringEncoding];
+    
+    self.container.compressedContentTypes = [NSSet setWithObject:@"text/"];
+    
+    // the download is checked against the uncompressed MD5 stored with the object
+    [self.container uploadObject:o success:^{
+        
+        [o writeObjectDataToFile:path atomically:YES success:^{
+            
+            NSString *contents = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
+            STAssertEqualObjects(contents, text, @"downloaded file should contain the decoded object data");
+            
+            [self.container deleteObject:o success:^{
+                [self stopWaiting];
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                [self stopWaiting];
+                STFail(@"delete compressed object failed");
+            }];
+            
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"write compressed object data to file failed");
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"upload compressed object failed");
+    }];
+    
+}
+
+- (void)testRangedDownload {
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-ranged.txt"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+    RSRangedDownload *download = [[RSRangedDownload alloc] initWithObject:self.object path:path];
+    download.rangeSize = 4;
+    download.maxConcurrentRanges = 2;
+    
+    [download start:^{
+        
+        [self stopWaiting];
+        NSString *contents = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
+        STAssertEqualObjects(contents, @"This is a test.", @"ranges should be reassembled in order");
+        STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:download.journalPath], @"journal should be removed");
+        STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:download.downloadPath], @"download file should be moved into place");
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        
+        [self stopWaiting];
+        STFail(@"ranged download failed: %i", [response statusCode]);
+        
+    }];
+    
+}
+
+- (void)testRangedDownloadIgnoresTornJournalLine {
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-torn.txt"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+    RSRangedDownload *download = [[RSRangedDownload alloc] initWithObject:self.object path:path];
+    download.rangeSize = 4;
+    
+    // a crash while range 17 was being recorded left only "1" behind, which must not count as range 1
+    NSString *md5 = [RSChecksum MD5OfData:[@"This is a test." dataUsingEncoding:NSUTF8StringEncoding]];
+    NSString *journal = [NSString stringWithFormat:@"%@ 15 4\n0\n1", md5];
+    [journal writeToFile:download.journalPath atomically:YES encoding:NSUTF8StringEncoding error:nil];
+    [[@"This" dataUsingEncoding:NSUTF8StringEncoding] writeToFile:download.downloadPath atomically:YES];
+    
+    [download start:^{
+        
+        [self stopWaiting];
+        NSString *contents = [NSString stringWithContentsOfFile:path encoding:NSUTF8StringEncoding error:nil];
+        STAssertEqualObjects(contents, @"This is a test.", @"a torn journal line should be fetched again");
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        
+        [self stopWaiting];
+        STFail(@"resumed ranged download failed: %@", error);
+        
+    }];
+    
+}
+
+- (void)testCancelDownload {
+    
+    RSStorageObject *o = [[RSStorageObject alloc] init];
+    o.name = @"cancel.bin";
+    o.data = [NSMutableData dataWithLength:4194304];
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-cancel.bin"];
+    [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+    
+    [self.container uploadObject:o success:^{
+        
+        // slow enough that the download is still running when it's cancelled
+        [RSStubServer setBandwidth:1048576];
+        
+        __block RSOperation *operation = nil;
+        __block BOOL cancelled = NO;
+        __block unsigned long long bytesAtCancel = 0;
+        __block unsigned long long bytesReceived = 0;
+        
+        // handlers run on the completion queue, like this one, so the operation is set before the first progress
+        operation = [o writeObjectDataToFile:path atomically:YES progress:^(unsigned long long received, unsigned long long totalBytes) {
+            
+            bytesReceived = received;
+            if (!cancelled) {
+                cancelled = YES;
+                bytesAtCancel = received;
+                [operation cancel];
+            }
+            
+        } success:^{
+            [RSStubServer setBandwidth:0];
+            [self stopWaiting];
+            STFail(@"a cancelled download should not succeed");
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            
+            STAssertTrue(operation.isCancelled, @"operation should be cancelled");
+            STAssertEqualObjects([error domain], NSURLErrorDomain, @"the download should fail as cancelled");
+            STAssertEquals([error code], (NSInteger)NSURLErrorCancelled, @"the download should fail as cancelled");
+            STAssertTrue(operation.fractionCompleted < 1.0, @"operation should not report completion");
+            STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:[path stringByAppendingPathExtension:@"download"]], @"partial file should be removed");
+            STAssertFalse([[NSFileManager defaultManager] fileExistsAtPath:path], @"nothing should be written to the destination");
+            
+            // anything still to come would arrive within half a second
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(0.5 * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                
+                [RSStubServer setBandwidth:0];
+                STAssertEquals(bytesReceived, bytesAtCancel, @"no data should arrive after cancelling");
+                STAssertTrue(bytesAtCancel < [o.data length], @"download should stop before the end");
+                
+                [self.container deleteObject:o success:^{
+                    [self stopWaiting];
+                } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                    [self stopWaiting];
+                    STFail(@"delete cancelled object failed");
+                }];
+                
+            });
+            
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"upload object to cancel failed: %ld", (long)[response statusCode]);
+    }];
+    
+}
+
+- (void)testGetObjectMetadata {
+    
+    self.object.metadata = [[NSMutableDictionary alloc] initWithCapacity:1];
+    [self.object.metadata setValue:@"Mike" forKey:@"Name"];
+    
+    [self.object updateMetadata:^{
+        
+        // let's clear it out, and then get it to make sure it comes back from the API                
+        [self.object.metadata removeAllObjects];
+        
+        [self.object getMetadata:^{
+            
+            [self stopWaiting];
+            STAssertEqualObjects([self.object.metadata valueForKey:@"Name"], @"Mike", @"Object metadata should be set");            
+            
         } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
             [self stopWaiting];
             STFail(@"get object metadata failed");
@@ -344,6 +1279,317 @@
     
 }
 
+- (void)testUploadObjectFromFile {
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-upload.dat"];
+    NSMutableData *fileData = [NSMutableData dataWithLength:kRSDefaultChunkSize * 4 + 17];
+    [fileData writeToFile:path atomically:YES];
+    
+    RSStorageObject *o = [[RSStorageObject alloc] init];
+    o.name = @"upload.dat";
+    
+    __block unsigned long long progress = 0;
+    
+    [self.container uploadObject:o fromFile:path progress:^(unsigned long long bytesSent, unsigned long long totalBytes) {
+        progress = bytesSent;
+    } success:^{
+        
+        STAssertEquals(progress, (unsigned long long)[fileData length], @"progress should reach the file size");
+        STAssertEquals(o.bytes, (unsigned long long)[fileData length], @"object bytes should be the file size");
+        STAssertNotNil(o.etag, @"uploaded object should have an etag");
+        
+        [self.container deleteObject:o success:^{
+            [self stopWaiting];
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"delete uploaded object failed");
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"upload object from file failed: %i", [response statusCode]);
+    }];
+    
+}
+
+- (void)testUploadObjectIfChanged {
+    
+    [self.container uploadObjectIfChanged:self.object success:^(BOOL uploaded) {
+        
+        STAssertFalse(uploaded, @"an unchanged object should not be uploaded");
+        self.object.data = [@"This is a changed test." dataUsingEncoding:NSUTF8StringEncoding];
+        
+        [self.container uploadObjectIfChanged:self.object success:^(BOOL uploaded) {
+            [self stopWaiting];
+            STAssertTrue(uploaded, @"a changed object should be uploaded");
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"upload changed object failed: %ld", (long)[response statusCode]);
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"upload unchanged object failed: %ld", (long)[response statusCode]);
+    }];
+    
+}
+
+- (void)testUploadObjectIfChangedFromFile {
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-unchanged.dat"];
+    [[NSMutableData dataWithLength:65536] writeToFile:path atomically:YES];
+    
+    RSStorageObject *o = [[RSStorageObject alloc] init];
+    o.name = @"unchanged.dat";
+    
+    // the first upload stores the file, and the second finds it already there
+    [self.container uploadObjectIfChanged:o fromFile:path progress:nil success:^(BOOL uploaded) {
+        
+        STAssertTrue(uploaded, @"an object that isn't stored yet should be uploaded");
+        
+        [self.container uploadObjectIfChanged:o fromFile:path progress:nil success:^(BOOL uploaded) {
+            
+            STAssertFalse(uploaded, @"an unchanged file should not be uploaded");
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+            
+            [self.container deleteObject:o success:^{
+                [self stopWaiting];
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                [self stopWaiting];
+                STFail(@"delete unchanged object failed");
+            }];
+            
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"upload unchanged file failed: %ld", (long)[response statusCode]);
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"upload new file failed: %ld", (long)[response statusCode]);
+    }];
+    
+}
+
+- (void)testObjectNameWithQueryCharacters {
+    
+    RSStorageObject *o = [[RSStorageObject alloc] init];
+    o.name = @"a?b c#d.txt";
+    o.content_type = @"text/plain";
+    o.data = [@"This is a test." dataUsingEncoding:NSUTF8StringEncoding];
+    
+    // ? and # are part of the name, not the start of a query or fragment
+    [self.container uploadObject:o success:^{
+        
+        o.data = nil;
+        
+        [o getObjectData:^{
+            
+            NSString *contents = [[NSString alloc] initWithData:o.data encoding:NSUTF8StringEncoding];
+            STAssertEqualObjects(contents, @"This is a test.", @"object data should come back under the same name");
+            
+            [self.container deleteObject:o success:^{
+                [self stopWaiting];
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                [self stopWaiting];
+                STFail(@"delete object with query characters failed");
+            }];
+            
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"get object with query characters failed: %ld", (long)[response statusCode]);
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"upload object with query characters failed: %ld", (long)[response statusCode]);
+    }];
+    
+}
+
+- (void)testUploadLargeObject {
+    
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-large.dat"];
+    NSMutableData *fileData = [NSMutableData dataWithLength:65536 * 3 + 100];
+    [fileData writeToFile:path atomically:YES];
+    
+    RSStorageObject *o = [[RSStorageObject alloc] init];
+    o.name = @"large.dat";
+    
+    RSSegmentedUpload *upload = [[RSSegmentedUpload alloc] initWithContainer:self.container object:o path:path];
+    upload.segmentSize = 65536;
+    upload.maxConcurrentSegments = 2;
+    
+    [upload start:^{
+        
+        STAssertEquals(o.bytes, (unsigned long long)[fileData length], @"large object bytes should be the file size");
+        
+        // clean up the manifest, the segments, and the segment container
+        RSContainer *segments = [[RSContainer alloc] init];
+        segments.name = upload.segmentContainerName;
+        segments.parent = self.client;
+        
+        [self.container deleteObject:o success:^{
+            [segments getObjects:^(NSArray *objects, NSError *jsonError) {
+                
+                STAssertEquals([objects count], (NSUInteger)4, @"file should be uploaded in four segments");
+                
+                __block NSUInteger remaining = [objects count];
+                for (RSStorageObject *segment in objects) {
+                    [segments deleteObject:segment success:^{
+                        if (--remaining == 0) {
+                            [self.client deleteContainer:segments success:^{
+                                [self stopWaiting];
+                            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                                [self stopWaiting];
+                                STFail(@"delete segment container failed");
+                            }];
+                        }
+                    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                        [self stopWaiting];
+                        STFail(@"delete segment failed");
+                    }];
+                }
+                
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                [self stopWaiting];
+                STFail(@"list segments failed");
+            }];
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"delete large object failed");
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"upload large object failed: %i", [response statusCode]);
+    }];
+    
+}
+
+- (void)testUploadFilesAndDeleteObjects {
+    
+    NSMutableDictionary *files = [NSMutableDictionary dictionary];
+    NSMutableArray *objects = [NSMutableArray array];
+    
+    for (NSUInteger i = 0; i < 3; i++) {
+        
+        NSString *name = [NSString stringWithFormat:@"batch/%lu.txt", (unsigned long)i];
+        NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[NSString stringWithFormat:@"batch-%lu.txt", (unsigned long)i]];
+        [@"This is a test." writeToFile:path atomically:YES encoding:NSUTF8StringEncoding error:nil];
+        [files setObject:path forKey:name];
+        
+        RSStorageObject *batchObject = [[RSStorageObject alloc] init];
+        batchObject.name = name;
+        [objects addObject:batchObject];
+        
+    }
+    
+    [self.container uploadFiles:files success:^{
+        
+        [self.container deleteObjects:objects success:^{
+            [self stopWaiting];
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"Delete objects failed");
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"Upload files failed");
+    }];
+    
+}
+
+- (void)testDirectorySync {
+    
+    NSString *directory = [NSTemporaryDirectory() stringByAppendingPathComponent:@"sync"];
+    [[NSFileManager defaultManager] removeItemAtPath:directory error:nil];
+    [[NSFileManager defaultManager] createDirectoryAtPath:[directory stringByAppendingPathComponent:@"nested"] withIntermediateDirectories:YES attributes:nil error:nil];
+    [@"This is a test." writeToFile:[directory stringByAppendingPathComponent:@"test.txt"] atomically:YES encoding:NSUTF8StringEncoding error:nil];
+    [@"This is another test." writeToFile:[directory stringByAppendingPathComponent:@"nested/other.txt"] atomically:YES encoding:NSUTF8StringEncoding error:nil];
+    
+    [self.container syncDirectory:directory success:^{
+        
+        // a second sync of the same directory should have nothing to do
+        RSDirectorySync *sync = [[RSDirectorySync alloc] initWithContainer:self.container directory:directory];
+        sync.dryRun = YES;
+        
+        [sync start:^{
+            [self stopWaiting];
+            STAssertEquals([sync.uploadNames count], (NSUInteger)0, @"unchanged files should not be uploaded");
+            STAssertEquals([sync.deleteNames count], (NSUInteger)0, @"synced objects should not be deleted");
+            STAssertEquals(sync.unchangedCount, (NSUInteger)2, @"both files should be unchanged");
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"Dry run sync failed");
+        }];
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self stopWaiting];
+        STFail(@"Sync directory failed");
+    }];
+    
+}
+
+- (void)testTransferManagerResumesFromJournal {
+    
+    NSString *journalPath = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-transfers.journal"];
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"RSCloudFilesSDK-Test-transfer.dat"];
+    [[NSMutableData dataWithLength:65536] writeToFile:path atomically:YES];
+    [[NSFileManager defaultManager] removeItemAtPath:journalPath error:nil];
+    
+    // queued but never resumed, as if the process died before the transfer started
+    RSTransferManager *crashed = [[RSTransferManager alloc] initWithClient:self.client journalPath:journalPath];
+    [crashed uploadFile:path toObject:@"journaled.dat" inContainer:self.container.name priority:0];
+    [crashed uploadFile:path toObject:@"urgent.dat" inContainer:self.container.name priority:10];
+    crashed = nil;
+    
+    RSTransferManager *manager = [[RSTransferManager alloc] initWithClient:self.client journalPath:journalPath];
+    NSArray *transfers = [manager transfers];
+    
+    STAssertEquals([transfers count], (NSUInteger)2, @"both transfers should be read back from the journal");
+    STAssertEqualObjects([[transfers objectAtIndex:0] objectName], @"urgent.dat", @"the higher priority transfer should start first");
+    
+    __block NSUInteger remaining = [transfers count];
+    
+    manager.maxConcurrentTransfers = 1;
+    manager.completionHandler = ^(RSTransfer *transfer) {
+        
+        STAssertEquals(transfer.state, RSTransferStateCompleted, @"resumed transfer should complete");
+        
+        if (--remaining > 0) {
+            return;
+        }
+        
+        STAssertEquals([[manager transfers] count], (NSUInteger)0, @"completed transfers should leave the queue");
+        
+        RSTransferManager *reopened = [[RSTransferManager alloc] initWithClient:self.client journalPath:journalPath];
+        STAssertEquals([[reopened transfers] count], (NSUInteger)0, @"completed transfers should leave the journal");
+        
+        [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        [[NSFileManager defaultManager] removeItemAtPath:journalPath error:nil];
+        
+        NSMutableArray *objects = [[NSMutableArray alloc] initWithCapacity:[transfers count]];
+        for (RSTransfer *finished in transfers) {
+            RSStorageObject *o = [[RSStorageObject alloc] init];
+            o.name = finished.objectName;
+            [objects addObject:o];
+        }
+        
+        [self.container deleteObjects:objects success:^{
+            [self stopWaiting];
+        } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+            [self stopWaiting];
+            STFail(@"delete transferred objects failed");
+        }];
+        
+    };
+    
+    [manager resume];
+    
+}
+
 - (void)testCDNEnableContainer {
     
     [self cdnEnableContainer:^(RSCDNContainer *cdnContainer) { 
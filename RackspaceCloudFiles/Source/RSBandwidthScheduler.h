@@ -0,0 +1,67 @@
+//
+//  RSBandwidthScheduler.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSConnection, RSTokenBucket;
+
+#define kRSDefaultMaxConcurrentBulkRequests 4
+
+/** The RSBandwidthScheduler class shares a client's bandwidth between bulk transfers and keeps
+ *  interactive requests responsive while they run.
+ *
+ *  Requests are in one of two classes.  Bulk requests are object uploads and downloads, including
+ *  segments and ranges; everything else, such as metadata and listing requests, is interactive.
+ *  Waiting interactive requests are always sent before waiting bulk requests, and bulk requests never
+ *  take more than maxConcurrentBulkRequests of the client's request slots, so a metadata call never
+ *  waits behind gigabytes of uploads.
+ *
+ *  Bulk traffic is limited by token buckets: one for the client as a whole and one per transfer.
+ *  Upload bodies are paced as they are sent, in small pieces that take turns at the client's bucket,
+ *  so concurrent uploads share the limit fairly.  A download can't be slowed once it has started, so
+ *  the bytes it receives are charged to the buckets and the next bulk request waits until they
+ *  recover; ranged downloads and segmented uploads are paced range by range this way.  Interactive
+ *  requests are never throttled.  Limits can be changed while transfers are running.
+ */
+@interface RSBandwidthScheduler : NSObject
+
+/** The number of bytes per second all bulk transfers together may use.  0 means no limit, which is the default. */
+@property (nonatomic) unsigned long long maxBytesPerSecond;
+
+/** The number of bytes per second each transfer may use.  0 means no limit, which is the default. */
+@property (nonatomic) unsigned long long maxBytesPerSecondPerTransfer;
+
+/** The maximum number of bulk requests in flight at once.  Defaults to `kRSDefaultMaxConcurrentBulkRequests`.
+ *  Keep it below the client's maxConcurrentRequests so interactive requests always have a free slot.
+ */
+@property (nonatomic) NSUInteger maxConcurrentBulkRequests;
+
+/** Returns a new token bucket for a transfer made of several requests, such as a ranged download
+ *  or a segmented upload.  Set it as the tokenBucket of each of the transfer's connections so they
+ *  share the per-transfer limit.
+ */
+- (RSTokenBucket *)tokenBucketForTransfer;
+
+/** Returns `YES` if a connection can be sent now.  Interactive connections always can.
+ *  @param connection The connection waiting to be sent
+ *  @param delay Set to how long to wait before asking again, if the connection has to wait for its buckets
+ */
+- (BOOL)canStartConnection:(RSConnection *)connection delay:(NSTimeInterval *)delay;
+
+/** Records that a connection was sent.  RSClient calls this. */
+- (void)connectionStarted:(RSConnection *)connection;
+
+/** Records that a connection finished.  RSClient calls this. */
+- (void)connectionFinished:(RSConnection *)connection;
+
+/** Returns a body stream for a bulk connection that is paced by its buckets.  RSConnection calls this. */
+- (NSInputStream *)throttledStream:(NSInputStream *)stream forConnection:(RSConnection *)connection;
+
+/** Charges bytes a bulk connection received to its buckets.  RSConnection calls this. */
+- (void)connection:(RSConnection *)connection didReceiveBytes:(NSUInteger)bytes;
+
+@end
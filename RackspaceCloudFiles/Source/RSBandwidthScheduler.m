@@ -0,0 +1,169 @@
+//
+//  RSBandwidthScheduler.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSBandwidthScheduler.h"
+#import "RSTokenBucket.h"
+#import "RSThrottledInputStream.h"
+#import "RSConnection.h"
+
+@interface RSBandwidthScheduler ()
+
+@property (nonatomic, strong) RSTokenBucket *globalBucket;
+@property (nonatomic, strong) NSCountedSet *activeBuckets;
+@property (nonatomic) NSUInteger activeBulkCount;
+
+- (NSArray *)bucketsForConnection:(RSConnection *)connection;
+
+@end
+
+@implementation RSBandwidthScheduler
+
+@synthesize maxBytesPerSecond, maxBytesPerSecondPerTransfer, maxConcurrentBulkRequests, globalBucket, activeBuckets, activeBulkCount;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.maxConcurrentBulkRequests = kRSDefaultMaxConcurrentBulkRequests;
+        self.globalBucket = [[RSTokenBucket alloc] initWithRate:0];
+        self.activeBuckets = [[NSCountedSet alloc] init];
+    }
+    return self;
+
+}
+
+#pragma mark - Limits
+
+- (void)setMaxBytesPerSecond:(unsigned long long)bytesPerSecond {
+
+    @synchronized (self) {
+        maxBytesPerSecond = bytesPerSecond;
+        self.globalBucket.rate = bytesPerSecond;
+    }
+
+}
+
+- (void)setMaxBytesPerSecondPerTransfer:(unsigned long long)bytesPerSecond {
+
+    // transfers already running pick up the new limit on their next read
+    @synchronized (self) {
+        maxBytesPerSecondPerTransfer = bytesPerSecond;
+        for (RSTokenBucket *bucket in self.activeBuckets) {
+            bucket.rate = bytesPerSecond;
+        }
+    }
+
+}
+
+- (RSTokenBucket *)tokenBucketForTransfer {
+
+    @synchronized (self) {
+        return [[RSTokenBucket alloc] initWithRate:self.maxBytesPerSecondPerTransfer];
+    }
+
+}
+
+- (NSArray *)bucketsForConnection:(RSConnection *)connection {
+
+    // a transfer waits on its own limit before it queues up for the shared one, so a slow
+    // transfer never holds up the others
+    return connection.tokenBucket ? [NSArray arrayWithObjects:connection.tokenBucket, self.globalBucket, nil] : [NSArray arrayWithObject:self.globalBucket];
+
+}
+
+#pragma mark - Scheduling
+
+- (BOOL)canStartConnection:(RSConnection *)connection delay:(NSTimeInterval *)delay {
+
+    if (!connection.bulk) {
+        return YES;
+    }
+
+    @synchronized (self) {
+
+        if (self.maxConcurrentBulkRequests > 0 && self.activeBulkCount >= self.maxConcurrentBulkRequests) {
+            return NO;
+        }
+
+        NSTimeInterval wait = 0;
+        for (RSTokenBucket *bucket in [self bucketsForConnection:connection]) {
+            wait = MAX(wait, [bucket delay]);
+        }
+
+        if (wait > 0) {
+            if (delay) {
+                *delay = wait;
+            }
+            return NO;
+        }
+
+        return YES;
+
+    }
+
+}
+
+- (void)connectionStarted:(RSConnection *)connection {
+
+    if (!connection.bulk) {
+        return;
+    }
+
+    @synchronized (self) {
+
+        self.activeBulkCount++;
+
+        if (!connection.tokenBucket) {
+            connection.tokenBucket = [[RSTokenBucket alloc] initWithRate:self.maxBytesPerSecondPerTransfer];
+        } else if (connection.tokenBucket.rate != self.maxBytesPerSecondPerTransfer) {
+            connection.tokenBucket.rate = self.maxBytesPerSecondPerTransfer;
+        }
+
+        [self.activeBuckets addObject:connection.tokenBucket];
+
+    }
+
+}
+
+- (void)connectionFinished:(RSConnection *)connection {
+
+    if (!connection.bulk) {
+        return;
+    }
+
+    @synchronized (self) {
+        self.activeBulkCount--;
+        [self.activeBuckets removeObject:connection.tokenBucket];
+    }
+
+}
+
+#pragma mark - Traffic
+
+- (NSInputStream *)throttledStream:(NSInputStream *)stream forConnection:(RSConnection *)connection {
+
+    if (!stream || !connection.bulk) {
+        return stream;
+    }
+
+    return [[RSThrottledInputStream alloc] initWithStream:stream tokenBuckets:[self bucketsForConnection:connection]];
+
+}
+
+- (void)connection:(RSConnection *)connection didReceiveBytes:(NSUInteger)bytes {
+
+    if (!connection.bulk) {
+        return;
+    }
+
+    for (RSTokenBucket *bucket in [self bucketsForConnection:connection]) {
+        [bucket charge:bytes];
+    }
+
+}
+
+@end
@@ -0,0 +1,65 @@
+//
+//  RSBulkDelete.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSClient, RSOperation;
+
+#define kRSDefaultBulkDeleteBatchSize 10000
+#define kRSDefaultMaxConcurrentDeletes 8
+
+/** The RSBulkDelete class deletes many objects or containers with as few requests as possible.
+ *
+ *  Paths are sent to the bulk delete middleware in batches of batchSize, so each request deletes
+ *  thousands of objects.  If the cluster does not have bulk delete enabled, RSBulkDelete falls back
+ *  to individual DELETE requests, keeping up to maxConcurrentDeletes of them in flight at once.
+ *
+ *  Paths that no longer exist are counted in numberNotFound rather than treated as errors.  If any
+ *  other path can't be deleted, the failure handler receives an error with the code `EBULKFAILURE`
+ *  whose userInfo holds the failed paths and their status lines under `RSBulkErrorsKey`.
+ */
+@interface RSBulkDelete : NSObject
+
+/** The client used to send requests */
+@property (nonatomic, strong, readonly) RSClient *client;
+
+/** The paths to delete, in the form `container/object` or `container` */
+@property (nonatomic, strong, readonly) NSArray *paths;
+
+/** The maximum number of paths sent in one bulk delete request.  Defaults to `kRSDefaultBulkDeleteBatchSize`. */
+@property (nonatomic) NSUInteger batchSize;
+
+/** The maximum number of DELETE requests in flight when bulk delete is not available.
+ *  Defaults to `kRSDefaultMaxConcurrentDeletes`.
+ */
+@property (nonatomic) NSUInteger maxConcurrentDeletes;
+
+/** The number of paths deleted so far */
+@property (nonatomic, readonly) NSUInteger numberDeleted;
+
+/** The number of paths that did not exist */
+@property (nonatomic, readonly) NSUInteger numberNotFound;
+
+/** The operation the delete requests are part of.  Cancelling it stops the deletes. */
+@property (nonatomic, strong, readonly) RSOperation *operation;
+
+/** Executes after each batch or individual delete */
+@property (nonatomic, copy) void (^progressHandler)(NSUInteger pathsCompleted, NSUInteger totalPaths);
+
+/** Creates a bulk delete.
+ *  @param client The client used to send requests
+ *  @param paths The paths to delete, in the form `container/object` or `container`
+ */
+- (id)initWithClient:(RSClient *)client paths:(NSArray *)paths;
+
+/** Deletes the paths.
+ *  @param successHandler Executes if every path was deleted or did not exist
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)start:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+@end
@@ -0,0 +1,290 @@
+//
+//  RSBulkDelete.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSBulkDelete.h"
+#import "RSClient.h"
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+@interface RSBulkDelete ()
+
+@property (nonatomic, strong, readwrite) RSClient *client;
+@property (nonatomic, strong, readwrite) NSArray *paths;
+@property (nonatomic, readwrite) NSUInteger numberDeleted;
+@property (nonatomic, readwrite) NSUInteger numberNotFound;
+@property (nonatomic, strong, readwrite) RSOperation *operation;
+
+@property (nonatomic) NSUInteger nextPath;
+@property (nonatomic) NSUInteger activeDeletes;
+@property (nonatomic, strong) NSMutableArray *errors;
+@property (nonatomic) BOOL failed;
+@property (nonatomic, copy) void (^successHandler)();
+@property (nonatomic, copy) void (^failureHandler)(NSHTTPURLResponse*, NSData*, NSError*);
+
+- (NSURLRequest *)bulkDeleteRequest:(NSRange)range;
+- (BOOL)receiveBatchResult:(NSHTTPURLResponse *)response data:(NSData *)data range:(NSRange)range;
+- (void)deleteNextBatch;
+- (void)deleteNextPaths;
+- (void)deletePath:(NSString *)path;
+- (void)finish;
+- (void)reportProgress;
+- (void)failWithResponse:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error;
+
+@end
+
+@implementation RSBulkDelete
+
+@synthesize client, paths, batchSize, maxConcurrentDeletes, numberDeleted, numberNotFound, operation, progressHandler;
+@synthesize nextPath, activeDeletes, errors, failed, successHandler, failureHandler;
+
+- (id)initWithClient:(RSClient *)aClient paths:(NSArray *)somePaths {
+
+    self = [super init];
+    if (self) {
+        self.client = aClient;
+        self.paths = somePaths;
+        self.batchSize = kRSDefaultBulkDeleteBatchSize;
+        self.maxConcurrentDeletes = kRSDefaultMaxConcurrentDeletes;
+        self.operation = [[RSOperation alloc] initWithClient:aClient];
+    }
+    return self;
+
+}
+
+#pragma mark - Bulk Delete
+
+- (NSURLRequest *)bulkDeleteRequest:(NSRange)range {
+
+    // the body is one URL-encoded path per line
+    NSMutableString *body = [[NSMutableString alloc] init];
+
+    for (NSString *path in [self.paths subarrayWithRange:range]) {
+        [body appendFormat:@"/%@\n", [path stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding]];
+    }
+
+    NSData *bodyData = [body dataUsingEncoding:NSUTF8StringEncoding];
+
+    NSMutableURLRequest *request = [self.client storageRequest:@"" parameters:[NSDictionary dictionaryWithObject:@"true" forKey:@"bulk-delete"] httpMethod:@"POST"];
+    [request setValue:@"text/plain" forHTTPHeaderField:@"Content-Type"];
+    [request setValue:@"application/json" forHTTPHeaderField:@"Accept"];
+    [request setValue:$S(@"%lu", (unsigned long)[bodyData length]) forHTTPHeaderField:@"Content-Length"];
+    [request setHTTPBody:bodyData];
+
+    return request;
+
+}
+
+- (RSOperation *)start:(void (^)())aSuccessHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))aFailureHandler {
+
+    self.successHandler = aSuccessHandler;
+    self.failureHandler = aFailureHandler;
+    self.failed = NO;
+    self.nextPath = 0;
+    self.activeDeletes = 0;
+    self.numberDeleted = 0;
+    self.numberNotFound = 0;
+    self.errors = [[NSMutableArray alloc] init];
+
+    // a cancelled operation stays cancelled, so starting again needs a new one
+    if (self.operation.isCancelled) {
+        self.operation = [[RSOperation alloc] initWithClient:self.client];
+    }
+
+    [self deleteNextBatch];
+
+    return self.operation;
+
+}
+
+- (BOOL)receiveBatchResult:(NSHTTPURLResponse *)response data:(NSData *)data range:(NSRange)range {
+
+    id result = [data length] > 0 ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+
+    // without the bulk middleware, the POST is taken as an account metadata update and
+    // succeeds with an empty body
+    if (![result isKindOfClass:[NSDictionary class]] || ![result objectForKey:@"Number Deleted"]) {
+        return NO;
+    }
+
+    self.numberDeleted += [[result objectForKey:@"Number Deleted"] unsignedIntegerValue];
+    self.numberNotFound += [[result objectForKey:@"Number Not Found"] unsignedIntegerValue];
+
+    NSArray *batchErrors = [result objectForKey:@"Errors"];
+    NSString *status = [result objectForKey:@"Response Status"];
+
+    if ([batchErrors count] > 0) {
+        [self.errors addObjectsFromArray:batchErrors];
+    } else if (status && ![status hasPrefix:@"2"]) {
+
+        // the whole batch was rejected, for example because it had too many paths
+        NSString *description = $S(@"Bulk delete failed: %@ %@", status, [result objectForKey:@"Response Body"]);
+        NSError *bulkError = [[NSError alloc] initWithDomain:RSErrorDomain code:EBULKFAILURE userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]];
+        [self failWithResponse:response data:data error:bulkError];
+        return YES;
+
+    }
+
+    self.nextPath = NSMaxRange(range);
+    [self reportProgress];
+    [self deleteNextBatch];
+
+    return YES;
+
+}
+
+- (void)deleteNextBatch {
+
+    if (self.failed) {
+        return;
+    }
+
+    if (self.nextPath >= [self.paths count]) {
+        [self finish];
+        return;
+    }
+
+    NSRange range = NSMakeRange(self.nextPath, MIN(self.batchSize, [self.paths count] - self.nextPath));
+
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        return [self bulkDeleteRequest:range];
+    }];
+
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        if (![self receiveBatchResult:response data:data range:range]) {
+            [self deleteNextPaths];
+        }
+    };
+
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        if ([self receiveBatchResult:response data:data range:range]) {
+            return;
+        }
+
+        NSInteger status = [response statusCode];
+
+        if (status == 400 || status == 404 || status == 405 || status == 501) {
+            [self deleteNextPaths];
+        } else {
+            [self failWithResponse:response data:data error:error];
+        }
+
+    };
+
+    [self.operation addConnection:connection];
+    [self.client sendConnection:connection];
+
+}
+
+#pragma mark - Individual Deletes
+
+- (void)deleteNextPaths {
+
+    if (self.failed) {
+        return;
+    }
+
+    if (self.nextPath >= [self.paths count] && self.activeDeletes == 0) {
+        [self finish];
+        return;
+    }
+
+    while (self.activeDeletes < self.maxConcurrentDeletes && self.nextPath < [self.paths count]) {
+
+        NSString *path = [self.paths objectAtIndex:self.nextPath];
+        self.nextPath++;
+        self.activeDeletes++;
+        [self deletePath:path];
+
+    }
+
+}
+
+- (void)deletePath:(NSString *)path {
+
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        return [self.client storageRequest:$S(@"/%@", path) httpMethod:@"DELETE"];
+    }];
+
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        self.activeDeletes--;
+        self.numberDeleted++;
+
+        [self reportProgress];
+        [self deleteNextPaths];
+
+    };
+
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        self.activeDeletes--;
+
+        // the remaining paths would all be cancelled too, so they aren't listed as errors
+        if ([[error domain] isEqualToString:NSURLErrorDomain] && [error code] == NSURLErrorCancelled) {
+            [self failWithResponse:response data:data error:error];
+            return;
+        }
+
+        if ([response statusCode] == 404) {
+            self.numberNotFound++;
+        } else {
+            NSString *status = response ? $S(@"%ld %@", (long)[response statusCode], [NSHTTPURLResponse localizedStringForStatusCode:[response statusCode]]) : [error localizedDescription];
+            [self.errors addObject:[NSArray arrayWithObjects:$S(@"/%@", path), status, nil]];
+        }
+
+        [self reportProgress];
+        [self deleteNextPaths];
+
+    };
+
+    [self.operation addConnection:connection];
+    [self.client sendConnection:connection];
+
+}
+
+#pragma mark - Completion
+
+- (void)finish {
+
+    if ([self.errors count] > 0) {
+
+        NSString *description = $S(@"%lu of %lu paths could not be deleted", (unsigned long)[self.errors count], (unsigned long)[self.paths count]);
+        NSDictionary *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:description, NSLocalizedDescriptionKey, [self.errors copy], RSBulkErrorsKey, nil];
+        [self failWithResponse:nil data:nil error:[[NSError alloc] initWithDomain:RSErrorDomain code:EBULKFAILURE userInfo:userInfo]];
+        return;
+
+    }
+
+    if (self.successHandler) {
+        self.successHandler();
+    }
+
+}
+
+- (void)reportProgress {
+
+    if (self.progressHandler) {
+        self.progressHandler(self.numberDeleted + self.numberNotFound + [self.errors count], [self.paths count]);
+    }
+
+}
+
+- (void)failWithResponse:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error {
+
+    if (self.failed) {
+        return;
+    }
+    self.failed = YES;
+
+    if (self.failureHandler) {
+        self.failureHandler(response, data, error);
+    }
+
+}
+
+@end
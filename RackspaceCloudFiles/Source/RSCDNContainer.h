@@ -8,7 +8,7 @@
 
 #import "RSModel.h"
 
-@class RSStorageObject;
+@class RSStorageObject, RSOperation;
 
 /** The RSCDNContainer class represents a CDN-enabled container in your Cloud Files account.  
  *  A container is a storage compartment for your data and provides a way for you
@@ -67,6 +67,6 @@
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)purgeCDNObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)purgeCDNObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 @end
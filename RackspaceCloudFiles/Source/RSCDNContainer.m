@@ -24,6 +24,68 @@
     return self;
 }
 
+#pragma mark - Listing
+
+- (void)setValue:(id)value forKey:(NSString *)key {
+    
+    // containers made from JSON dictionaries get their URIs as strings
+    BOOL uri = [key isEqualToString:@"cdn_uri"] || [key isEqualToString:@"cdn_ssl_uri"] || [key isEqualToString:@"cdn_streaming_uri"];
+    
+    if (uri && [value isKindOfClass:[NSString class]]) {
+        value = [NSURL URLWithString:value];
+    }
+    
+    [super setValue:value forKey:key];
+    
+}
+
+- (void)setListingString:(NSString *)value forKey:(RSListingKey)key {
+    
+    switch (key) {
+        case RSListingKeyName:
+            self.name = value;
+            break;
+        case RSListingKeyCDNURI:
+            self.cdn_uri = [NSURL URLWithString:value];
+            break;
+        case RSListingKeyCDNSSLURI:
+            self.cdn_ssl_uri = [NSURL URLWithString:value];
+            break;
+        case RSListingKeyCDNStreamingURI:
+            self.cdn_streaming_uri = [NSURL URLWithString:value];
+            break;
+        case RSListingKeyCDNEnabled:
+        case RSListingKeyLogRetention:
+            // some deployments send these as strings, such as "True"
+            [self setListingNumber:[value boolValue] forKey:key];
+            break;
+        case RSListingKeyTTL:
+            [self setListingNumber:[value longLongValue] forKey:key];
+            break;
+        default:
+            break;
+    }
+    
+}
+
+- (void)setListingNumber:(long long)value forKey:(RSListingKey)key {
+    
+    switch (key) {
+        case RSListingKeyCDNEnabled:
+            self.cdn_enabled = value != 0;
+            break;
+        case RSListingKeyLogRetention:
+            self.log_retention = value != 0;
+            break;
+        case RSListingKeyTTL:
+            self.ttl = (NSInteger)value;
+            break;
+        default:
+            break;
+    }
+    
+}
+
 - (NSURLRequest *)purgeCDNObjectRequest:(RSStorageObject *)object {
     
     return [self.client cdnRequest:$S(@"/%@/%@", self.name, object.name) httpMethod:@"DELETE"];
@@ -38,9 +100,9 @@
     
 }
 
-- (void)purgeCDNObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)purgeCDNObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self.client sendAsynchronousRequest:@selector(purgeCDNObjectRequest:) object:object sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self.client sendAsynchronousRequest:@selector(purgeCDNObjectRequest:) object:object sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         if (successHandler) {
             successHandler();        
         }
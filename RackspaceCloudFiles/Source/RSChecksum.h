@@ -0,0 +1,59 @@
+//
+//  RSChecksum.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** The RSChecksum class computes the MD5 digests Cloud Files uses as ETags.
+ *
+ *  An instance computes a digest incrementally, so data can be hashed as it is read for an upload or
+ *  written by a download instead of in a second pass.  The class methods hash data and files in one
+ *  call, and can hash many files at once on every core.
+ */
+@interface RSChecksum : NSObject
+
+/** Adds data to the digest
+ *  @param data The next bytes of the data being hashed
+ */
+- (void)updateWithData:(NSData *)data;
+
+/** Adds bytes to the digest
+ *  @param bytes The next bytes of the data being hashed
+ *  @param length The number of bytes
+ */
+- (void)updateWithBytes:(const void *)bytes length:(NSUInteger)length;
+
+/** Returns the digest of everything added so far as a lowercase hex string.  More data can still be added afterwards. */
+- (NSString *)hexDigest;
+
+/** Discards everything added so far */
+- (void)reset;
+
+/** Returns the MD5 of data as a lowercase hex string */
++ (NSString *)MD5OfData:(NSData *)data;
+
+/** Returns the MD5 of a file's contents as a lowercase hex string, or `nil` if the file can't be read */
++ (NSString *)MD5OfFileAtPath:(NSString *)path;
+
+/** Returns the MD5 of part of a file's contents as a lowercase hex string, or `nil` if the file can't be read
+ *  @param path The path of the file on the local filesystem
+ *  @param offset The offset of the first byte to hash
+ *  @param length The number of bytes to hash.  Hashing stops early at the end of the file.
+ */
++ (NSString *)MD5OfFileAtPath:(NSString *)path offset:(unsigned long long)offset length:(unsigned long long)length;
+
+/** Hashes many files at once, using every core.  Blocks until every file is hashed, so call it off the main thread.
+ *  @param paths The paths of the files on the local filesystem
+ *  @return The MD5 of each file as a lowercase hex string, keyed by path.  Files that can't be read are left out.
+ */
++ (NSDictionary *)MD5sOfFilesAtPaths:(NSArray *)paths;
+
+/** Returns `YES` if an ETag from Cloud Files matches an MD5, ignoring case and any quotes around the ETag.
+ *  The ETag of a large object manifest is not the MD5 of its data and never matches.
+ */
++ (BOOL)ETag:(NSString *)etag matchesMD5:(NSString *)md5;
+
+@end
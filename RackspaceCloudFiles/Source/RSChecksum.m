@@ -0,0 +1,180 @@
+//
+//  RSChecksum.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSChecksum.h"
+#import <CommonCrypto/CommonDigest.h>
+#import <fcntl.h>
+#import <unistd.h>
+
+#define kRSChecksumBufferSize 1048576
+
+static NSString *RSHexString(const unsigned char *bytes, NSUInteger length) {
+
+    static const char digits[] = "0123456789abcdef";
+    char hex[length * 2];
+
+    for (NSUInteger i = 0; i < length; i++) {
+        hex[i * 2] = digits[bytes[i] >> 4];
+        hex[i * 2 + 1] = digits[bytes[i] & 0x0f];
+    }
+
+    return [[NSString alloc] initWithBytes:hex length:length * 2 encoding:NSASCIIStringEncoding];
+
+}
+
+@interface RSChecksum () {
+    CC_MD5_CTX md5;
+}
+
+@end
+
+@implementation RSChecksum
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        CC_MD5_Init(&md5);
+    }
+    return self;
+
+}
+
+- (void)updateWithData:(NSData *)data {
+
+    [self updateWithBytes:[data bytes] length:[data length]];
+
+}
+
+- (void)updateWithBytes:(const void *)bytes length:(NSUInteger)length {
+
+    CC_MD5_Update(&md5, bytes, (CC_LONG)length);
+
+}
+
+- (NSString *)hexDigest {
+
+    // finishing a copy leaves this digest open for more data
+    CC_MD5_CTX finished = md5;
+    unsigned char digest[CC_MD5_DIGEST_LENGTH];
+    CC_MD5_Final(digest, &finished);
+    return RSHexString(digest, CC_MD5_DIGEST_LENGTH);
+
+}
+
+- (void)reset {
+
+    CC_MD5_Init(&md5);
+
+}
+
+#pragma mark - One Call
+
++ (NSString *)MD5OfData:(NSData *)data {
+
+    unsigned char digest[CC_MD5_DIGEST_LENGTH];
+    CC_MD5([data bytes], (CC_LONG)[data length], digest);
+    return RSHexString(digest, CC_MD5_DIGEST_LENGTH);
+
+}
+
++ (NSString *)MD5OfFileAtPath:(NSString *)path {
+
+    return [self MD5OfFileAtPath:path offset:0 length:ULLONG_MAX];
+
+}
+
++ (NSString *)MD5OfFileAtPath:(NSString *)path offset:(unsigned long long)offset length:(unsigned long long)length {
+
+    int fd = open([path fileSystemRepresentation], O_RDONLY);
+
+    if (fd < 0) {
+        return nil;
+    }
+
+    // we read the range front to back exactly once, so ask for aggressive read-ahead
+    fcntl(fd, F_RDAHEAD, 1);
+
+    void *buffer = malloc(kRSChecksumBufferSize);
+    CC_MD5_CTX context;
+    CC_MD5_Init(&context);
+
+    ssize_t result = 0;
+    unsigned long long remaining = length;
+
+    while (remaining > 0 && (result = pread(fd, buffer, (size_t)MIN(remaining, kRSChecksumBufferSize), (off_t)offset)) > 0) {
+        CC_MD5_Update(&context, buffer, (CC_LONG)result);
+        offset += result;
+        remaining -= result;
+    }
+
+    free(buffer);
+    close(fd);
+
+    if (result < 0) {
+        return nil;
+    }
+
+    unsigned char digest[CC_MD5_DIGEST_LENGTH];
+    CC_MD5_Final(digest, &context);
+    return RSHexString(digest, CC_MD5_DIGEST_LENGTH);
+
+}
+
++ (NSDictionary *)MD5sOfFilesAtPaths:(NSArray *)paths {
+
+    NSUInteger count = [paths count];
+    NSMutableArray *sizes = [[NSMutableArray alloc] initWithCapacity:count];
+
+    for (NSString *path in paths) {
+        [sizes addObject:[NSNumber numberWithUnsignedLongLong:[[[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil] fileSize]]];
+    }
+
+    // the largest files go first, so one big file left for last doesn't run on a single core
+    NSMutableArray *order = [[NSMutableArray alloc] initWithCapacity:count];
+    for (NSUInteger i = 0; i < count; i++) {
+        [order addObject:[NSNumber numberWithUnsignedInteger:i]];
+    }
+    [order sortUsingComparator:^NSComparisonResult(NSNumber *a, NSNumber *b) {
+        return [[sizes objectAtIndex:[b unsignedIntegerValue]] compare:[sizes objectAtIndex:[a unsignedIntegerValue]]];
+    }];
+
+    __strong NSString **digests = (__strong NSString **)calloc(MAX(count, 1), sizeof(NSString *));
+
+    dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+        @autoreleasepool {
+            NSUInteger index = [[order objectAtIndex:i] unsignedIntegerValue];
+            digests[index] = [RSChecksum MD5OfFileAtPath:[paths objectAtIndex:index]];
+        }
+    });
+
+    NSMutableDictionary *results = [[NSMutableDictionary alloc] initWithCapacity:count];
+
+    for (NSUInteger i = 0; i < count; i++) {
+        if (digests[i]) {
+            [results setObject:digests[i] forKey:[paths objectAtIndex:i]];
+        }
+        digests[i] = nil;
+    }
+
+    free(digests);
+    return results;
+
+}
+
++ (BOOL)ETag:(NSString *)etag matchesMD5:(NSString *)md5 {
+
+    // Swift quotes the ETags of some ordinary objects as well as large object manifests
+    if ([etag length] >= 2 && [etag hasPrefix:@"\""] && [etag hasSuffix:@"\""]) {
+        etag = [etag substringWithRange:NSMakeRange(1, [etag length] - 2)];
+    }
+
+    return etag && md5 && [etag caseInsensitiveCompare:md5] == NSOrderedSame;
+
+}
+
+@end
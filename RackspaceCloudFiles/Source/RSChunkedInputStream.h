@@ -0,0 +1,46 @@
+//
+//  RSChunkedInputStream.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kRSDefaultChunkSize 65536
+
+/** The RSChunkedInputStream class is an input stream that reads a file from the local filesystem
+ *  in fixed-size chunks.  It is used as the HTTP body stream for uploads so that only one chunk of
+ *  the file is held in memory at a time, no matter how large the file is.
+ */
+@interface RSChunkedInputStream : NSInputStream
+
+/** The number of bytes read from the file at a time */
+@property (nonatomic, readonly) NSUInteger chunkSize;
+
+/** The total number of bytes the stream will produce */
+@property (nonatomic, readonly) unsigned long long length;
+
+/** The number of bytes read from the file so far */
+@property (nonatomic, readonly) unsigned long long bytesRead;
+
+/** Executes each time a chunk is read from the file, on the thread reading the stream.  The chunk
+ *  is only valid for the duration of the call; copy it if you need to keep it.
+ */
+@property (nonatomic, copy) void (^chunkHandler)(NSData *chunk);
+
+/** Creates a stream that reads the file at the given path.
+ *  @param path The path for the file on the local filesystem
+ *  @param chunkSize The number of bytes to read from the file at a time
+ */
+- (id)initWithFileAtPath:(NSString *)path chunkSize:(NSUInteger)chunkSize;
+
+/** Creates a stream that reads part of the file at the given path.
+ *  @param path The path for the file on the local filesystem
+ *  @param offset The offset in the file of the first byte to read
+ *  @param length The number of bytes to read
+ *  @param chunkSize The number of bytes to read from the file at a time
+ */
+- (id)initWithFileAtPath:(NSString *)path offset:(unsigned long long)offset length:(unsigned long long)length chunkSize:(NSUInteger)chunkSize;
+
+@end
@@ -0,0 +1,198 @@
+//
+//  RSChunkedInputStream.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSChunkedInputStream.h"
+
+@interface RSChunkedInputStream () {
+    uint8_t *chunk;
+    NSUInteger chunkLength;
+    NSUInteger chunkOffset;
+    NSStreamStatus status;
+    NSError *error;
+    __weak id <NSStreamDelegate> delegate;
+    unsigned long long offset;
+}
+
+@property (nonatomic, strong) NSInputStream *fileStream;
+
+- (BOOL)readNextChunk;
+
+@end
+
+@implementation RSChunkedInputStream
+
+@synthesize chunkSize, length, bytesRead, chunkHandler, fileStream;
+
+- (id)initWithFileAtPath:(NSString *)path chunkSize:(NSUInteger)aChunkSize {
+
+    unsigned long long fileSize = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil] fileSize];
+    return [self initWithFileAtPath:path offset:0 length:fileSize chunkSize:aChunkSize];
+
+}
+
+- (id)initWithFileAtPath:(NSString *)path offset:(unsigned long long)anOffset length:(unsigned long long)aLength chunkSize:(NSUInteger)aChunkSize {
+
+    self = [super init];
+    if (self) {
+        self.fileStream = [[NSInputStream alloc] initWithFileAtPath:path];
+        chunkSize = aChunkSize > 0 ? aChunkSize : kRSDefaultChunkSize;
+        offset = anOffset;
+        length = aLength;
+        chunk = malloc(chunkSize);
+        status = NSStreamStatusNotOpen;
+    }
+    return self;
+
+}
+
+- (void)dealloc {
+    free(chunk);
+}
+
+#pragma mark - Reading
+
+// the file is read a full chunk at a time, and the chunk is handed out in as many read:maxLength:
+// calls as the reader needs.  we never keep more than one chunk around.
+- (BOOL)readNextChunk {
+
+    NSUInteger filled = 0;
+    NSUInteger wanted = (NSUInteger)MIN((unsigned long long)chunkSize, length - bytesRead);
+
+    while (filled < wanted) {
+
+        NSInteger result = [self.fileStream read:chunk + filled maxLength:wanted - filled];
+
+        if (result < 0) {
+            error = [self.fileStream streamError];
+            status = NSStreamStatusError;
+            return NO;
+        } else if (result == 0) {
+            break;
+        }
+
+        filled += result;
+    }
+
+    chunkLength = filled;
+    chunkOffset = 0;
+
+    if (filled == 0) {
+        status = NSStreamStatusAtEnd;
+        return NO;
+    }
+
+    bytesRead += filled;
+
+    if (self.chunkHandler) {
+        self.chunkHandler([NSData dataWithBytesNoCopy:chunk length:filled freeWhenDone:NO]);
+    }
+
+    return YES;
+
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)len {
+
+    if (status != NSStreamStatusOpen) {
+        return status == NSStreamStatusError ? -1 : 0;
+    }
+
+    if (chunkOffset >= chunkLength && ![self readNextChunk]) {
+        return status == NSStreamStatusError ? -1 : 0;
+    }
+
+    NSUInteger count = MIN(len, chunkLength - chunkOffset);
+    memcpy(buffer, chunk + chunkOffset, count);
+    chunkOffset += count;
+
+    return count;
+
+}
+
+- (BOOL)getBuffer:(uint8_t **)buffer length:(NSUInteger *)len {
+    return NO;
+}
+
+- (BOOL)hasBytesAvailable {
+    return status == NSStreamStatusOpen;
+}
+
+#pragma mark - NSStream
+
+- (void)open {
+
+    if (status != NSStreamStatusNotOpen) {
+        return;
+    }
+
+    [self.fileStream open];
+
+    if (offset > 0) {
+        [self.fileStream setProperty:[NSNumber numberWithUnsignedLongLong:offset] forKey:NSStreamFileCurrentOffsetKey];
+    }
+
+    if ([self.fileStream streamStatus] == NSStreamStatusError) {
+        error = [self.fileStream streamError];
+        status = NSStreamStatusError;
+    } else {
+        status = NSStreamStatusOpen;
+    }
+
+}
+
+- (void)close {
+    [self.fileStream close];
+    status = NSStreamStatusClosed;
+}
+
+- (NSStreamStatus)streamStatus {
+    return status;
+}
+
+- (NSError *)streamError {
+    return error;
+}
+
+- (id <NSStreamDelegate>)delegate {
+    return delegate;
+}
+
+- (void)setDelegate:(id <NSStreamDelegate>)aDelegate {
+    delegate = aDelegate;
+}
+
+- (void)scheduleInRunLoop:(NSRunLoop *)runLoop forMode:(NSString *)mode {
+}
+
+- (void)removeFromRunLoop:(NSRunLoop *)runLoop forMode:(NSString *)mode {
+}
+
+- (id)propertyForKey:(NSString *)key {
+    return nil;
+}
+
+- (BOOL)setProperty:(id)property forKey:(NSString *)key {
+    return NO;
+}
+
+#pragma mark - CFReadStream bridging
+
+// NSURLConnection treats HTTP body streams as CFReadStreams, so these private methods must
+// exist on NSInputStream subclasses.  the stream is always readable, so there is nothing
+// to schedule and no client callbacks are needed.
+
+- (void)_scheduleInCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode {
+}
+
+- (void)_unscheduleFromCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode {
+}
+
+- (BOOL)_setCFClientFlags:(CFOptionFlags)flags callback:(CFReadStreamClientCallBack)callback context:(CFStreamClientContext *)context {
+    return NO;
+}
+
+@end
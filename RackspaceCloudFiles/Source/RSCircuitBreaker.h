@@ -0,0 +1,47 @@
+//
+//  RSCircuitBreaker.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kRSDefaultCircuitBreakerFailureThreshold 5
+#define kRSDefaultCircuitBreakerResetTimeout 30.0
+
+/** The RSCircuitBreaker class stops requests from being sent to a host that keeps failing.
+ *
+ *  Each host starts out closed, and requests are sent normally.  After failureThreshold
+ *  consecutive failures (transport errors or 5xx responses), the host is opened, and requests to it
+ *  fail immediately with the error code `ECIRCUITOPEN` instead of adding to its load.  Once
+ *  resetTimeout seconds have passed, a single trial request is let through.  If it succeeds, the
+ *  host is closed again; if it fails, the host stays open for another resetTimeout.
+ */
+@interface RSCircuitBreaker : NSObject
+
+/** The number of consecutive failures that opens a host.  Defaults to `kRSDefaultCircuitBreakerFailureThreshold`. */
+@property (nonatomic) NSUInteger failureThreshold;
+
+/** How long a host stays open before a trial request is sent, in seconds.
+ *  Defaults to `kRSDefaultCircuitBreakerResetTimeout`.
+ */
+@property (nonatomic) NSTimeInterval resetTimeout;
+
+/** Returns `NO` if the request's host is open and the request should not be sent */
+- (BOOL)allowsRequest:(NSURLRequest *)request;
+
+/** Records the outcome of a request that was sent.
+ *  @param response The response, or nil if none was received
+ *  @param error The transport error, or nil
+ *  @param request The request that was sent
+ */
+- (void)recordResponse:(NSHTTPURLResponse *)response error:(NSError *)error forRequest:(NSURLRequest *)request;
+
+/** Returns `YES` if requests to the host are currently being refused */
+- (BOOL)isOpenForHost:(NSString *)host;
+
+/** Closes every host */
+- (void)reset;
+
+@end
@@ -0,0 +1,133 @@
+//
+//  RSCircuitBreaker.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSCircuitBreaker.h"
+
+@interface RSCircuitState : NSObject
+
+@property (nonatomic) NSUInteger failures;
+@property (nonatomic, strong) NSDate *openUntil;
+@property (nonatomic) BOOL trialInFlight;
+
+@end
+
+@implementation RSCircuitState
+
+@synthesize failures, openUntil, trialInFlight;
+
+@end
+
+@interface RSCircuitBreaker ()
+
+@property (nonatomic, strong) NSMutableDictionary *states;
+
+- (RSCircuitState *)stateForHost:(NSString *)host;
+
+@end
+
+@implementation RSCircuitBreaker
+
+@synthesize failureThreshold, resetTimeout, states;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.failureThreshold = kRSDefaultCircuitBreakerFailureThreshold;
+        self.resetTimeout = kRSDefaultCircuitBreakerResetTimeout;
+        self.states = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+
+}
+
+- (RSCircuitState *)stateForHost:(NSString *)host {
+
+    NSString *key = host ? [host lowercaseString] : @"";
+    RSCircuitState *state = [self.states objectForKey:key];
+
+    if (!state) {
+        state = [[RSCircuitState alloc] init];
+        [self.states setObject:state forKey:key];
+    }
+
+    return state;
+
+}
+
+- (BOOL)allowsRequest:(NSURLRequest *)request {
+
+    @synchronized (self) {
+
+        RSCircuitState *state = [self stateForHost:[[request URL] host]];
+
+        if (!state.openUntil) {
+            return YES;
+        }
+
+        // half open: once the timeout passes, one request finds out whether the host recovered
+        if ([state.openUntil timeIntervalSinceNow] <= 0 && !state.trialInFlight) {
+            state.trialInFlight = YES;
+            return YES;
+        }
+
+        return NO;
+
+    }
+
+}
+
+- (void)recordResponse:(NSHTTPURLResponse *)response error:(NSError *)error forRequest:(NSURLRequest *)request {
+
+    // a cancelled request says nothing about the host
+    if ([[error domain] isEqualToString:NSURLErrorDomain] && [error code] == NSURLErrorCancelled) {
+        @synchronized (self) {
+            [self stateForHost:[[request URL] host]].trialInFlight = NO;
+        }
+        return;
+    }
+
+    BOOL failed = (error && !response) || [response statusCode] >= 500;
+
+    @synchronized (self) {
+
+        RSCircuitState *state = [self stateForHost:[[request URL] host]];
+        state.trialInFlight = NO;
+
+        if (!failed) {
+            state.failures = 0;
+            state.openUntil = nil;
+            return;
+        }
+
+        state.failures++;
+
+        if (state.openUntil || state.failures >= self.failureThreshold) {
+            state.openUntil = [NSDate dateWithTimeIntervalSinceNow:self.resetTimeout];
+        }
+
+    }
+
+}
+
+- (BOOL)isOpenForHost:(NSString *)host {
+
+    @synchronized (self) {
+        return [self stateForHost:host].openUntil != nil;
+    }
+
+}
+
+- (void)reset {
+
+    @synchronized (self) {
+        [self.states removeAllObjects];
+    }
+
+}
+
+@end
@@ -10,11 +10,45 @@
 #import "RSContainer.h"
 #import "RSCDNContainer.h"
 #import "RSStorageObject.h"
+#import "RSConnection.h"
+#import "RSOperation.h"
+#import "RSChunkedInputStream.h"
+#import "RSSegmentedUpload.h"
+#import "RSRangedDownload.h"
+#import "RSPagedListing.h"
+#import "RSBulkDelete.h"
+#import "RSTarArchive.h"
+#import "RSMetadataCache.h"
+#import "RSRetryPolicy.h"
+#import "RSCircuitBreaker.h"
+#import "RSDirectorySync.h"
+#import "RSInstrumentation.h"
+#import "RSLatencyHistogram.h"
+#import "RSChecksum.h"
+#import "RSTransferManager.h"
+#import "RSGzip.h"
+#import "RSGzipInputStream.h"
+#import "RSTokenBucket.h"
+#import "RSThrottledInputStream.h"
+#import "RSBandwidthScheduler.h"
+#import "RSTransport.h"
+#import "RSSessionTransport.h"
+#import "RSPurgeQueue.h"
+#import "RSListingIndex.h"
+#import "RSContainerBrowser.h"
 
 #define kRSDefaultTTL 259200
+#define kRSDefaultMaxConcurrentRequests 8
+#define kRSDefaultAuthTokenLifetime 82800
 
 #define EAUTHFAILURE 1 /* Authentication failed */
+#define ECHECKSUMFAILURE 2 /* Data did not match its MD5 checksum */
+#define ERANGEFAILURE 3 /* A ranged request did not return the requested range */
+#define EBULKFAILURE 4 /* Some paths in a bulk request failed */
+#define ECIRCUITOPEN 5 /* The host has been failing, so the request was not sent */
+#define EDECOMPRESSIONFAILURE 6 /* A compressed response could not be decoded */
 static NSString *RSErrorDomain = @"RSErrorDomain";
+static NSString *RSBulkErrorsKey = @"RSBulkErrors"; /* NSArray of [path, status] pairs */
 
 /** Rackspace API provider types */
 typedef enum {
@@ -35,6 +69,9 @@ typedef enum {
  Once you have created your object, you can optionally authenticate before performing any operations.  
  If you do not authenticate, the client will authenticate for you before performing any other 
  API operations. 
+ 
+ Every asynchronous API operation returns a RSOperation, which you can use to cancel the operation, 
+ change its priority, or observe its progress.  You can ignore it if you don't need any of these.
  */
 @interface RSClient : RSModel
 
@@ -60,6 +97,22 @@ typedef enum {
  */
 @property (nonatomic, strong) NSString *authToken;
 
+/** The date the auth token expires.  If the authentication API doesn't say when the token expires,
+ *  it is assumed to be valid for authTokenLifetime seconds.
+ */
+@property (nonatomic, strong) NSDate *authTokenExpiration;
+
+/** The number of seconds an auth token is assumed to be valid for if the authentication API doesn't
+ *  return an X-Auth-Token-Expires header.  Defaults to `kRSDefaultAuthTokenLifetime` (23 hours).
+ */
+@property (nonatomic) NSTimeInterval authTokenLifetime;
+
+/** If `YES`, the auth token is stored in the keychain after authenticating, and a new client for the
+ *  same username and auth URL uses the stored token until it expires instead of authenticating again.
+ *  Defaults to `NO`.  Linking against Security.framework is required.
+ */
+@property (nonatomic) BOOL cachesAuthToken;
+
 /** Base URL string for the Cloud Files Storage API */
 @property (nonatomic, strong) NSString *storageURL;
 
@@ -72,6 +125,53 @@ typedef enum {
 /** The total number of bytes stored in this account */
 @property (nonatomic) NSUInteger totalBytesUsed;
 
+/** The number of bytes read from disk at a time when streaming a file upload.  Defaults to
+ *  `kRSDefaultChunkSize`.  Memory used by a streamed upload is bounded by this value.
+ */
+@property (nonatomic) NSUInteger chunkSize;
+
+/** The queue that response handling, parsing, and success and failure handlers execute on.  By default
+ *  this is a serial background queue owned by the client, so handlers do not execute on the main thread.
+ *  If you replace it, use a serial queue: the SDK assumes a client's handlers do not run concurrently.
+ */
+@property (nonatomic, strong) NSOperationQueue *completionQueue;
+
+/** The maximum number of requests in flight at once.  Additional requests wait in priority order
+ *  until a request finishes.  Defaults to `kRSDefaultMaxConcurrentRequests`; 0 means no limit.
+ */
+@property (nonatomic) NSUInteger maxConcurrentRequests;
+
+/** If set, metadata and listing responses are cached here and revalidated instead of retrieved
+ *  again, and writes sent through the client invalidate them.  Defaults to nil, which disables caching.
+ */
+@property (nonatomic, strong) RSMetadataCache *metadataCache;
+
+/** Decides which failed requests are sent again and when, and whether slow reads are hedged.
+ *  Defaults to a RSRetryPolicy with its default settings; nil disables retries.
+ */
+@property (nonatomic, strong) RSRetryPolicy *retryPolicy;
+
+/** If set, requests to a host that keeps failing fail immediately with `ECIRCUITOPEN` until the
+ *  host recovers.  Defaults to a RSCircuitBreaker with its default settings; nil disables it.
+ */
+@property (nonatomic, strong) RSCircuitBreaker *circuitBreaker;
+
+/** If set, every request the client sends is timed and counted here, broken down by operation type.
+ *  Defaults to nil, which disables instrumentation.
+ */
+@property (nonatomic, strong) RSInstrumentation *instrumentation;
+
+/** If set, bulk transfers are rate limited and share bandwidth fairly, and interactive requests are
+ *  sent ahead of them.  Defaults to nil, which leaves bandwidth unmanaged.
+ */
+@property (nonatomic, strong) RSBandwidthScheduler *bandwidthScheduler;
+
+/** Sends the client's requests, keeping connections to each host alive between them.  Defaults to
+ *  `+[RSTransport defaultTransport]`, which uses a NSURLSession where it's available.  Set this before
+ *  sending the first request; clients may share a transport to share its connections.
+ */
+@property (nonatomic, strong) RSTransport *transport;
+
 #pragma mark - Constructors
 
 /** Creates a RSClient object with the specified provider, username, and API key. 
@@ -90,7 +190,23 @@ typedef enum {
 
 #pragma mark - Common
 
-/** Returns a request to the Storage API with the given path and HTTP method 
+/** Returns a query string with the given parameters, in the form `key=value&key=value`.  Keys are
+ *  sorted, and keys and values are percent-escaped, so values may contain `&`, `=`, `+`, `#`, or `%`.
+ *  @param params The parameters.  Values that aren't strings are converted with their description.
+ */
++ (NSString *)queryStringWithParameters:(NSDictionary *)params;
+
+/** Returns a request to the Storage API with the given path, query parameters, and HTTP method.
+ *  The whole path is percent-escaped, including `?` and `#`, which are legal in object names, so
+ *  the query can only be given as parameters.
+ *  @param path The path in the API.  Example: /containers
+ *  @param params The query parameters, or nil.  See queryStringWithParameters:.
+ *  @param httpMethod The HTTP method to use
+ */
+- (NSMutableURLRequest *)storageRequest:(NSString *)path parameters:(NSDictionary *)params httpMethod:(NSString *)httpMethod;
+
+/** Returns a request to the Storage API with the given path and HTTP method, and no query.  The
+ *  whole path is percent-escaped, as for storageRequest:parameters:httpMethod:.
  *  @param path The path in the API.  Example: /containers
  *  @param httpMethod The HTTP method to use
  */
@@ -101,7 +217,16 @@ typedef enum {
  */
 - (NSMutableURLRequest *)storageRequest:(NSString *)path;
 
-/** Returns a request to the CDN Management API with the given path and HTTP method 
+/** Returns a request to the CDN Management API with the given path, query parameters, and HTTP
+ *  method.  The path is escaped as for storageRequest:parameters:httpMethod:.
+ *  @param path The path in the API.  Example: /containers
+ *  @param params The query parameters, or nil.  See queryStringWithParameters:.
+ *  @param httpMethod The HTTP method to use
+ */
+- (NSMutableURLRequest *)cdnRequest:(NSString *)path parameters:(NSDictionary *)params httpMethod:(NSString *)httpMethod;
+
+/** Returns a request to the CDN Management API with the given path and HTTP method, and no query.
+ *  The path is escaped as for storageRequest:parameters:httpMethod:.
  *  @param path The path in the API.  Example: /containers
  *  @param httpMethod The HTTP method to use
  */
@@ -119,7 +244,7 @@ typedef enum {
  *  @param successHandler A block that will be executed if the request is successfully executed and returns a HTTP response code in the 2xx block (200-299)
  *  @param failureHandler A block that will be executed if the request is not successfully executed or returns a HTTP response code outside of the 2xx block (for example, a 404 Not Found response)
  */
-- (void)sendAsynchronousRequest:(SEL)requestSelector object:(id)object sender:(id)sender successHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)sendAsynchronousRequest:(SEL)requestSelector object:(id)object sender:(id)sender successHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 /** Asynchronously sends a HTTP request with callbacks for success and failure responses.
  *  @param requestSelector A selector to retrieve the HTTP request to send
@@ -127,7 +252,30 @@ typedef enum {
  *  @param successHandler A block that will be executed if the request is successfully executed and returns a HTTP response code in the 2xx block (200-299)
  *  @param failureHandler A block that will be executed if the request is not successfully executed or returns a HTTP response code outside of the 2xx block (for example, a 404 Not Found response)
  */
-- (void)sendAsynchronousRequest:(SEL)requestSelector sender:(id)sender successHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)sendAsynchronousRequest:(SEL)requestSelector sender:(id)sender successHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Asynchronously sends a connection's request.  If the client hasn't been authenticated yet, it will
+ *  authenticate first and then build and send the request.  If maxConcurrentRequests are already in
+ *  flight, the connection waits until one finishes; waiting connections are sent in order of their
+ *  queuePriority.  Use this instead of sendAsynchronousRequest when you need progress reporting, a
+ *  streamed request body, or a priority other than normal.
+ *  @param connection The connection to send
+ */
+- (void)sendConnection:(RSConnection *)connection;
+
+/** Cancels a connection.  A connection waiting for a free slot leaves the line, and its failure handler
+ *  executes right away on the completionQueue with a `NSURLErrorCancelled` error.  RSOperation uses
+ *  this when it's cancelled.
+ *  @param connection The connection to cancel
+ */
+- (void)cancelConnection:(RSConnection *)connection;
+
+/** Changes the priority of a connection.  If the connection is waiting to be sent, it moves to the
+ *  back of the line for its new priority.  RSOperation uses this when its queuePriority changes.
+ *  @param priority The new priority
+ *  @param connection The connection
+ */
+- (void)setQueuePriority:(NSOperationQueuePriority)priority forConnection:(RSConnection *)connection;
 
 #pragma mark - Authentication
 
@@ -136,6 +284,11 @@ typedef enum {
 
 /** Authenticates with the API.  If you do not authenticate before performing any API operations,
  *  RSClient will authenticate for you.
+ *
+ *  Only one authentication request is sent at a time; if authentication is already in progress, the
+ *  handlers execute when it finishes.  If cachesAuthToken is `YES` and an unexpired token for this
+ *  account is in the keychain, no request is sent at all.  Requests that return 401 Unauthorized
+ *  cause the client to authenticate again and resend them once.
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
@@ -152,7 +305,7 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)getAccountMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)getAccountMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 #pragma mark Get Containers
 
@@ -169,7 +322,15 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)getContainers:(void (^)(NSArray *containers, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)getContainers:(void (^)(NSArray *containers, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Retrieves every container in your account, one page at a time.  The API returns at most
+ *  10,000 containers per request, so this follows the listing from page to page until it is complete.
+ *  @param pageHandler Executes for each page of containers, in order.  Set stop to `YES` to end the listing early.
+ *  @param successHandler Executes after the last page
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)getAllContainers:(void (^)(NSArray *containers, BOOL *stop))pageHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 #pragma mark Create Container
 
@@ -183,7 +344,7 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)createContainer:(RSContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)createContainer:(RSContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 #pragma mark Delete Container
 
@@ -197,7 +358,7 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)deleteContainer:(RSContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)deleteContainer:(RSContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 #pragma mark Get Container Metadata
 
@@ -211,7 +372,7 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)getContainerMetadata:(RSContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)getContainerMetadata:(RSContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 #pragma mark - CDN Services
 
@@ -227,7 +388,7 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)cdnEnableContainer:(RSContainer *)container success:(void (^)(RSCDNContainer *container))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)cdnEnableContainer:(RSContainer *)container success:(void (^)(RSCDNContainer *container))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 #pragma mark Get CDN Containers
 
@@ -244,7 +405,14 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)getCDNContainers:(void (^)(NSArray *containers, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)getCDNContainers:(void (^)(NSArray *containers, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Retrieves every CDN container in your account, one page at a time.
+ *  @param pageHandler Executes for each page of containers, in order.  Set stop to `YES` to end the listing early.
+ *  @param successHandler Executes after the last page
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)getAllCDNContainers:(void (^)(NSArray *containers, BOOL *stop))pageHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 #pragma mark Get CDN Container Metadata
 
@@ -258,7 +426,7 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)getCDNContainerMetadata:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)getCDNContainerMetadata:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 #pragma mark Purge CDN Container
 
@@ -278,7 +446,7 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)purgeCDNContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)purgeCDNContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 #pragma mark Update CDN Container
 
@@ -292,6 +460,6 @@ typedef enum {
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)updateCDNContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)updateCDNContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 @end
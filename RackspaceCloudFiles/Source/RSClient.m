@@ -8,19 +8,71 @@
 
 #import "RSClient.h"
 #import <objc/message.h>
+#import <Security/Security.h>
 
 #define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
 
+@interface RSClient ()
+
+@property (nonatomic, strong) NSMutableArray *pendingConnections;
+@property (nonatomic, strong) NSMutableSet *authenticatingConnections;
+@property (nonatomic) NSUInteger activeConnectionCount;
+@property (nonatomic) BOOL bandwidthWakeupScheduled;
+@property (nonatomic, strong) NSMutableArray *authenticationHandlers;
+
+- (NSURL *)URLWithBase:(NSString *)base path:(NSString *)path parameters:(NSDictionary *)params;
+- (NSDictionary *)listingParameters:(NSDictionary *)params limit:(NSUInteger)limit marker:(NSString *)marker;
+- (void)enqueueConnection:(RSConnection *)connection;
+- (BOOL)removeAuthenticatingConnection:(RSConnection *)connection;
+- (void)insertPendingConnection:(RSConnection *)connection;
+- (void)startPendingConnections;
+- (BOOL)shouldRetryConnection:(RSConnection *)connection error:(NSError *)error;
+- (void)scheduleHedgeForConnection:(RSConnection *)connection;
+- (void)hedgeConnection:(RSConnection *)connection;
+- (RSOperationType)operationTypeForRequest:(NSURLRequest *)request;
+- (BOOL)hasValidAuthToken;
+- (void)finishAuthentication:(BOOL)success response:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error;
+- (NSMutableDictionary *)authTokenKeychainQuery;
+- (BOOL)loadCachedAuthToken;
+- (void)saveCachedAuthToken;
+- (void)removeCachedAuthToken;
+
+@end
+
 @implementation RSClient
 
-@synthesize username, apiKey, authURL, authenticated, authToken, storageURL, cdnManagementURL;
-@synthesize containerCount, totalBytesUsed;
+@synthesize username, apiKey, authURL, authenticated, authToken, authTokenExpiration, authTokenLifetime, cachesAuthToken, storageURL, cdnManagementURL;
+@synthesize containerCount, totalBytesUsed, chunkSize, completionQueue, maxConcurrentRequests, metadataCache;
+@synthesize retryPolicy, circuitBreaker, instrumentation, bandwidthScheduler, transport;
+@synthesize pendingConnections, authenticatingConnections, activeConnectionCount, bandwidthWakeupScheduled, authenticationHandlers;
 
 #pragma mark - Constructors
 
-- (id)initWithProvider:(RSProviderType)provider username:(NSString *)aUsername apiKey:(NSString *)anApiKey {
+- (id)init {
     
     self = [super init];
+    if (self) {
+        self.chunkSize = kRSDefaultChunkSize;
+        self.maxConcurrentRequests = kRSDefaultMaxConcurrentRequests;
+        self.pendingConnections = [[NSMutableArray alloc] init];
+        self.authenticatingConnections = [[NSMutableSet alloc] init];
+        self.authenticationHandlers = [[NSMutableArray alloc] init];
+        self.authTokenLifetime = kRSDefaultAuthTokenLifetime;
+        self.retryPolicy = [[RSRetryPolicy alloc] init];
+        self.circuitBreaker = [[RSCircuitBreaker alloc] init];
+        self.transport = [RSTransport defaultTransport];
+        
+        self.completionQueue = [[NSOperationQueue alloc] init];
+        [self.completionQueue setMaxConcurrentOperationCount:1];
+        [self.completionQueue setName:@"com.rackspace.cloudfiles.completion"];
+    }
+    return self;
+    
+}
+
+- (id)initWithProvider:(RSProviderType)provider username:(NSString *)aUsername apiKey:(NSString *)anApiKey {
+    
+    self = [self init];
     if (self) {
         if (provider == RSProviderTypeRackspaceUS) {
             self.authURL = [NSURL URLWithString:@"https://auth.api.rackspacecloud.com/v1.0"];
@@ -36,7 +88,7 @@
 
 - (id)initWithAuthURL:(NSURL *)anAuthURL username:(NSString *)aUsername apiKey:(NSString *)anApiKey {
     
-    self = [super init];
+    self = [self init];
     if (self) {
         self.authURL = anAuthURL;
         self.username = aUsername;
@@ -49,9 +101,39 @@
 
 #pragma mark - Common
 
-- (NSMutableURLRequest *)storageRequest:(NSString *)path httpMethod:(NSString *)httpMethod {
++ (NSString *)queryStringWithParameters:(NSDictionary *)params {
+    
+    // stringByAddingPercentEscapesUsingEncoding: leaves the characters that separate query
+    // parameters alone, so a prefix or marker containing them would change the query
+    NSMutableArray *pairs = [[NSMutableArray alloc] initWithCapacity:[params count]];
+    
+    for (NSString *key in [[params allKeys] sortedArrayUsingSelector:@selector(compare:)]) {
+        
+        NSString *value = [NSString stringWithFormat:@"%@", [params objectForKey:key]];
+        NSString *escapedKey = CFBridgingRelease(CFURLCreateStringByAddingPercentEscapes(NULL, (__bridge CFStringRef)key, NULL, CFSTR("!*'();:@&=+$,/?#[]% "), kCFStringEncodingUTF8));
+        NSString *escapedValue = CFBridgingRelease(CFURLCreateStringByAddingPercentEscapes(NULL, (__bridge CFStringRef)value, NULL, CFSTR("!*'();:@&=+$,/?#[]% "), kCFStringEncodingUTF8));
+        [pairs addObject:$S(@"%@=%@", escapedKey, escapedValue)];
+        
+    }
     
-    NSURL *url = [NSURL URLWithString:$S(@"%@%@", self.storageURL, [path stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding])];    
+    return [pairs componentsJoinedByString:@"&"];
+    
+}
+
+- (NSURL *)URLWithBase:(NSString *)base path:(NSString *)path parameters:(NSDictionary *)params {
+    
+    // ? and # are legal in object names, so everything but the / between names is escaped and
+    // the query only ever comes from the parameters
+    NSString *escapedPath = CFBridgingRelease(CFURLCreateStringByAddingPercentEscapes(NULL, (__bridge CFStringRef)path, NULL, CFSTR("!*'();:@&=+$,?#[]% "), kCFStringEncodingUTF8));
+    NSString *queryString = [params count] > 0 ? $S(@"?%@", [RSClient queryStringWithParameters:params]) : @"";
+    
+    return [NSURL URLWithString:$S(@"%@%@%@", base, escapedPath, queryString)];
+    
+}
+
+- (NSMutableURLRequest *)storageRequest:(NSString *)path parameters:(NSDictionary *)params httpMethod:(NSString *)httpMethod {
+    
+    NSURL *url = [self URLWithBase:self.storageURL path:path parameters:params];
     NSMutableURLRequest *request = [[NSMutableURLRequest alloc] initWithURL:url];
     [request setHTTPMethod:httpMethod];
     [request addValue:self.authToken forHTTPHeaderField:@"X-Auth-Token"];
@@ -60,15 +142,21 @@
     
 }
 
+- (NSMutableURLRequest *)storageRequest:(NSString *)path httpMethod:(NSString *)httpMethod {
+    
+    return [self storageRequest:path parameters:nil httpMethod:httpMethod];
+    
+}
+
 - (NSMutableURLRequest *)storageRequest:(NSString *)path {
     
     return [self storageRequest:path httpMethod:@"GET"];
     
 }
 
-- (NSMutableURLRequest *)cdnRequest:(NSString *)path httpMethod:(NSString *)httpMethod {
+- (NSMutableURLRequest *)cdnRequest:(NSString *)path parameters:(NSDictionary *)params httpMethod:(NSString *)httpMethod {
     
-    NSURL *url = [NSURL URLWithString:$S(@"%@%@", self.cdnManagementURL, [path stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding])];    
+    NSURL *url = [self URLWithBase:self.cdnManagementURL path:path parameters:params];
     NSMutableURLRequest *request = [[NSMutableURLRequest alloc] initWithURL:url];
     [request setHTTPMethod:httpMethod];
     [request addValue:self.authToken forHTTPHeaderField:@"X-Auth-Token"];
@@ -77,52 +165,87 @@
     
 }
 
+- (NSMutableURLRequest *)cdnRequest:(NSString *)path httpMethod:(NSString *)httpMethod {
+    
+    return [self cdnRequest:path parameters:nil httpMethod:httpMethod];
+    
+}
+
 - (NSMutableURLRequest *)cdnRequest:(NSString *)path {
     
     return [self cdnRequest:path httpMethod:@"GET"];
     
 }
 
-- (void)sendAsynchronousRequest:(SEL)requestSelector object:(id)object sender:(id)sender successHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
-
-    // if the client hasn't been authenticated yet, this method will attempt to auth first,
-    // then send the request.  if auth retry fails, the failureHandler is called
+- (NSDictionary *)listingParameters:(NSDictionary *)params limit:(NSUInteger)limit marker:(NSString *)marker {
+    
+    NSMutableDictionary *listingParams = [[NSMutableDictionary alloc] initWithDictionary:params];
+    
+    if (limit) {
+        [listingParams setObject:$S(@"%lu", (unsigned long)limit) forKey:@"limit"];
+    }
+    
+    if (marker) {
+        [listingParams setObject:marker forKey:@"marker"];
+    }
+    
+    return listingParams;
     
+}
+
+- (RSOperation *)sendAsynchronousRequest:(SEL)requestSelector object:(id)object sender:(id)sender successHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+
     // this method takes a selector instead of an actual NSURLRequest object because if the
     // account isn't authenticated, the request will likely be an invalid URL,
     // such as "NULL/<path>".  after authentication, the selector is called again to create
     // a valid request
     
-    if (self.authenticated) {
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        return objc_msgSend(sender, requestSelector, object);
+    }];
+    connection.successHandler = successHandler;
+    connection.failureHandler = failureHandler;
+    
+    RSOperation *operation = [[RSOperation alloc] initWithClient:self];
+    [operation addConnection:connection];
+    [self sendConnection:connection];
+    return operation;
+    
+}
 
-        // TODO: make sure you're using the appropriate NSOperationQueue
-        [NSURLConnection sendAsynchronousRequest:objc_msgSend(sender, requestSelector, object) queue:[NSOperationQueue mainQueue] completionHandler:^(NSURLResponse *urlResponse, NSData *data, NSError *error) {    
+- (RSOperation *)sendAsynchronousRequest:(SEL)requestSelector sender:(id)sender successHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    return [self sendAsynchronousRequest:requestSelector object:nil sender:sender successHandler:successHandler failureHandler:failureHandler];
+    
+}
 
-            NSHTTPURLResponse *response = (NSHTTPURLResponse *)urlResponse;
-            
-            if (response.statusCode >= 200 && response.statusCode <= 299) {
-                if (successHandler) {
-                    successHandler(response, data, error);            
-                }
-            } else {  
-                
-                if (failureHandler) {
-                    failureHandler(response, data, error);
-                }
-            }
-            
-        }];
+- (void)sendConnection:(RSConnection *)connection {
+
+    // if the client hasn't been authenticated yet, this method will attempt to auth first,
+    // then send the request.  if auth retry fails, the connection fails with the auth response.
+    // a cancelled connection doesn't wait for auth, since enqueueing it fails it straight away.
+    
+    if ([self hasValidAuthToken] || connection.cancelled) {
+
+        [self enqueueConnection:connection];
         
     } else {
         
+        @synchronized (self.pendingConnections) {
+            [self.authenticatingConnections addObject:connection];
+        }
+        
+        // a connection cancelled in the meantime has already failed
         [self authenticate:^{
 
-            [self sendAsynchronousRequest:requestSelector object:object sender:self successHandler:successHandler failureHandler:failureHandler];
+            if ([self removeAuthenticatingConnection:connection]) {
+                [self sendConnection:connection];
+            }
             
         } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
             
-            if (failureHandler) {
-                failureHandler(response, data, error);
+            if ([self removeAuthenticatingConnection:connection]) {
+                [connection failWithResponse:response data:data error:error];
             }
             
         }];
@@ -131,9 +254,350 @@
     
 }
 
-- (void)sendAsynchronousRequest:(SEL)requestSelector sender:(id)sender successHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (BOOL)removeAuthenticatingConnection:(RSConnection *)connection {
     
-    [self sendAsynchronousRequest:requestSelector object:nil sender:sender successHandler:successHandler failureHandler:failureHandler];
+    @synchronized (self.pendingConnections) {
+        
+        if (![self.authenticatingConnections containsObject:connection]) {
+            return NO;
+        }
+        
+        [self.authenticatingConnections removeObject:connection];
+        return YES;
+        
+    }
+    
+}
+
+- (void)enqueueConnection:(RSConnection *)connection {
+    
+    connection.enqueueDate = [NSDate date];
+    
+    // a connection cancelled while it waited to be resent fails without waiting for a slot
+    if (connection.cancelled) {
+        [connection startOnQueue:self.completionQueue];
+        return;
+    }
+    
+    @synchronized (self.pendingConnections) {
+        [self insertPendingConnection:connection];
+    }
+    
+    [self startPendingConnections];
+    
+}
+
+- (void)insertPendingConnection:(RSConnection *)connection {
+    
+    // keep waiting connections sorted by priority, first in first out within a priority.  with a
+    // bandwidth scheduler, interactive requests go ahead of every bulk request.
+    BOOL classed = self.bandwidthScheduler != nil;
+    NSUInteger index = [self.pendingConnections count];
+    while (index > 0) {
+        RSConnection *previous = [self.pendingConnections objectAtIndex:index - 1];
+        if (classed && previous.bulk != connection.bulk) {
+            if (connection.bulk) {
+                break;
+            }
+        } else if (previous.queuePriority >= connection.queuePriority) {
+            break;
+        }
+        index--;
+    }
+    [self.pendingConnections insertObject:connection atIndex:index];
+    
+}
+
+- (void)setQueuePriority:(NSOperationQueuePriority)priority forConnection:(RSConnection *)connection {
+    
+    @synchronized (self.pendingConnections) {
+        
+        NSUInteger index = [self.pendingConnections indexOfObjectIdenticalTo:connection];
+        connection.queuePriority = priority;
+        
+        // a waiting connection goes to the back of its new priority
+        if (index != NSNotFound) {
+            [self.pendingConnections removeObjectAtIndex:index];
+            [self insertPendingConnection:connection];
+        }
+        
+    }
+    
+}
+
+- (void)cancelConnection:(RSConnection *)connection {
+    
+    BOOL wasWaiting = NO;
+    
+    @synchronized (self.pendingConnections) {
+        
+        NSUInteger index = [self.pendingConnections indexOfObjectIdenticalTo:connection];
+        
+        if (index != NSNotFound) {
+            [self.pendingConnections removeObjectAtIndex:index];
+            wasWaiting = YES;
+        } else if ([self.authenticatingConnections containsObject:connection]) {
+            [self.authenticatingConnections removeObject:connection];
+            wasWaiting = YES;
+        }
+        
+    }
+    
+    [connection cancel];
+    
+    // it never had a slot, so starting it only hands the cancellation to its failure handler
+    if (wasWaiting) {
+        [connection startOnQueue:self.completionQueue];
+    }
+    
+}
+
+- (void)startPendingConnections {
+    
+    NSMutableArray *ready = [[NSMutableArray alloc] init];
+    RSBandwidthScheduler *scheduler = self.bandwidthScheduler;
+    NSTimeInterval wakeup = 0;
+    
+    @synchronized (self.pendingConnections) {
+        
+        // a bulk request held back by the scheduler stays where it is, and the requests behind it can still go
+        NSUInteger index = 0;
+        
+        while ((self.maxConcurrentRequests == 0 || self.activeConnectionCount < self.maxConcurrentRequests) && index < [self.pendingConnections count]) {
+            
+            RSConnection *connection = [self.pendingConnections objectAtIndex:index];
+            NSTimeInterval delay = 0;
+            
+            if (scheduler && ![scheduler canStartConnection:connection delay:&delay]) {
+                if (delay > 0) {
+                    wakeup = wakeup > 0 ? MIN(wakeup, delay) : delay;
+                }
+                index++;
+                continue;
+            }
+            
+            [ready addObject:connection];
+            [self.pendingConnections removeObjectAtIndex:index];
+            [scheduler connectionStarted:connection];
+            self.activeConnectionCount++;
+            
+        }
+        
+        // requests waiting for their buckets to refill are looked at again once they have
+        if (wakeup > 0 && !self.bandwidthWakeupScheduled) {
+            
+            self.bandwidthWakeupScheduled = YES;
+            
+            dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(wakeup * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                @synchronized (self.pendingConnections) {
+                    self.bandwidthWakeupScheduled = NO;
+                }
+                [self startPendingConnections];
+            });
+            
+        }
+        
+    }
+    
+    for (RSConnection *connection in ready) {
+        
+        connection.finishHandler = ^BOOL(RSConnection *finishedConnection, NSError *error) {
+            
+            @synchronized (self.pendingConnections) {
+                self.activeConnectionCount--;
+                [scheduler connectionFinished:finishedConnection];
+            }
+            
+            // a 401 means the token expired or was revoked.  the first request to notice
+            // throws the token away, and every request that got a 401 with it is resent
+            // once, after a single new authentication request
+            BOOL reauthenticate = finishedConnection.response.statusCode == 401 && !finishedConnection.reauthenticated;
+            
+            if (reauthenticate) {
+                
+                @synchronized (self.authenticationHandlers) {
+                    if ([[finishedConnection.request valueForHTTPHeaderField:@"X-Auth-Token"] isEqualToString:self.authToken]) {
+                        self.authenticated = NO;
+                        [self removeCachedAuthToken];
+                    }
+                }
+                
+                finishedConnection.reauthenticated = YES;
+                [self sendConnection:finishedConnection];
+                
+            }
+            
+            // a 304 the metadata cache couldn't answer has nothing to hand to the success handler
+            BOOL refetch = !reauthenticate && !error && finishedConnection.response.statusCode == 304 && finishedConnection.metadataCache && !finishedConnection.unconditional;
+            
+            if (refetch) {
+                finishedConnection.unconditional = YES;
+                [self sendConnection:finishedConnection];
+            }
+            
+            BOOL retry = !reauthenticate && !refetch && [self shouldRetryConnection:finishedConnection error:error];
+            
+            if (retry) {
+                
+                NSTimeInterval delay = [self.retryPolicy delayForResponse:finishedConnection.response attempt:finishedConnection.retryCount];
+                finishedConnection.retryCount++;
+                
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                    [self sendConnection:finishedConnection];
+                });
+                
+            } else if (!error && finishedConnection.sent && !finishedConnection.dataHandler && !finishedConnection.bulk && finishedConnection.response.statusCode >= 200 && finishedConnection.response.statusCode <= 299 && [[finishedConnection.request HTTPMethod] isEqualToString:@"GET"]) {
+                
+                // only requests that could be hedged themselves are sampled, so long downloads
+                // don't push the hedge delay past every small read
+                [self.retryPolicy recordLatency:-[finishedConnection.startDate timeIntervalSinceNow]];
+                
+            }
+            
+            [self startPendingConnections];
+            return !reauthenticate && !refetch && !retry;
+            
+        };
+        
+        if (self.instrumentation) {
+            RSInstrumentation *clientInstrumentation = self.instrumentation;
+            connection.recordHandler = ^(RSRequestRecord *record) {
+                record.operationType = [self operationTypeForRequest:record.request];
+                [clientInstrumentation recordRequest:record];
+            };
+        } else {
+            connection.recordHandler = nil;
+        }
+        
+        connection.metadataCache = self.metadataCache;
+        connection.circuitBreaker = self.circuitBreaker;
+        connection.bandwidthScheduler = scheduler;
+        connection.transport = self.transport;
+        [connection startOnQueue:self.completionQueue];
+        [self scheduleHedgeForConnection:connection];
+        
+    }
+    
+}
+
+- (RSOperationType)operationTypeForRequest:(NSURLRequest *)request {
+    
+    NSString *method = [request HTTPMethod];
+    
+    if (self.cdnManagementURL && [[[request URL] absoluteString] hasPrefix:self.cdnManagementURL]) {
+        return RSOperationTypeCDN;
+    } else if ([method isEqualToString:@"HEAD"]) {
+        return RSOperationTypeHead;
+    } else if ([method isEqualToString:@"DELETE"]) {
+        return RSOperationTypeDelete;
+    } else if ([method isEqualToString:@"GET"]) {
+        return [[[request URL] query] rangeOfString:@"format=json"].location != NSNotFound ? RSOperationTypeList : RSOperationTypeGet;
+    } else {
+        return RSOperationTypePut;
+    }
+    
+}
+
+- (BOOL)shouldRetryConnection:(RSConnection *)connection error:(NSError *)error {
+    
+    if (!self.retryPolicy || connection.retriesDisabled) {
+        return NO;
+    }
+    
+    // a streamed body has already been handed to the dataHandler, so it can't be started over
+    NSInteger statusCode = connection.response.statusCode;
+    if (error && connection.dataHandler && statusCode >= 200 && statusCode <= 299) {
+        return NO;
+    }
+    
+    // a connection that broke partway through the body is retried like one that never got a response
+    NSHTTPURLResponse *response = error ? nil : connection.response;
+    return [self.retryPolicy shouldRetryRequest:connection.request response:response error:error attempt:connection.retryCount];
+    
+}
+
+- (void)scheduleHedgeForConnection:(RSConnection *)connection {
+    
+    // only buffered interactive GETs are hedged: a second copy of a streamed body or a write isn't
+    // safe, and a second copy of a bulk download would only compete with the first for bandwidth
+    if (!self.retryPolicy.hedgesReads || connection.hedged || connection.retryCount > 0 || connection.dataHandler || connection.bulk || ![[connection.request HTTPMethod] isEqualToString:@"GET"]) {
+        return;
+    }
+    
+    NSTimeInterval delay = [self.retryPolicy hedgeDelay];
+    
+    if (delay <= 0) {
+        return;
+    }
+    
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(delay * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [self.completionQueue addOperationWithBlock:^{
+            if (!connection.finished && !connection.cancelled && !connection.hedged && connection.retryCount == 0) {
+                [self hedgeConnection:connection];
+            }
+        }];
+    });
+    
+}
+
+- (void)hedgeConnection:(RSConnection *)connection {
+    
+    RSConnection *hedge = [[RSConnection alloc] initWithRequestHandler:connection.requestHandler];
+    hedge.queuePriority = NSOperationQueuePriorityHigh;
+    hedge.hedgedConnection = connection;
+    hedge.hedged = YES;
+    connection.hedged = YES;
+    connection.hedge = hedge;
+    
+    void (^successHandler)(NSHTTPURLResponse*, NSData*, NSError*) = connection.successHandler;
+    void (^failureHandler)(NSHTTPURLResponse*, NSData*, NSError*) = connection.failureHandler;
+    
+    // both copies finish on the serial completion queue, so these need no locking.  the first
+    // success answers and cancels the other copy, through the client so a copy still waiting
+    // gives up its place.  an HTTP error is an answer too, but a transport error only answers
+    // once the other copy has failed as well
+    __block BOOL answered = NO;
+    __block NSUInteger failures = 0;
+    __weak RSConnection *weakConnection = connection;
+    __weak RSConnection *weakHedge = hedge;
+    
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        if (!answered) {
+            answered = YES;
+            [self cancelConnection:weakHedge];
+            if (successHandler) {
+                successHandler(response, data, error);
+            }
+        }
+    };
+    
+    hedge.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        if (!answered) {
+            answered = YES;
+            [self cancelConnection:weakConnection];
+            if (successHandler) {
+                successHandler(response, data, error);
+            }
+        }
+    };
+    
+    void (^hedgedFailureHandler)(NSHTTPURLResponse*, NSData*, NSError*) = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        if (!answered && (response || ++failures == 2)) {
+            answered = YES;
+            [self cancelConnection:weakConnection];
+            [self cancelConnection:weakHedge];
+            if (failureHandler) {
+                failureHandler(response, data, error);
+            }
+        }
+    };
+    
+    connection.failureHandler = hedgedFailureHandler;
+    hedge.failureHandler = hedgedFailureHandler;
+    
+    // the hedge is part of the request's operation, so its bytes count and cancelling the operation reaches it
+    [connection.operation addConnection:hedge];
+    [self sendConnection:hedge];
     
 }
 
@@ -148,25 +612,69 @@
     
 }
 
+- (BOOL)hasValidAuthToken {
+    
+    return self.authenticated && (!self.authTokenExpiration || [self.authTokenExpiration timeIntervalSinceNow] > 0);
+    
+}
+
 - (void)authenticate:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    NSURLRequest *request = [self authenticationRequest];
-    [NSURLConnection sendAsynchronousRequest:request queue:[NSOperationQueue mainQueue] completionHandler:^(NSURLResponse *urlResponse, NSData *data, NSError *error) {    
-        
-        NSHTTPURLResponse *response = (NSHTTPURLResponse *)urlResponse;
+    void (^handler)(BOOL, NSHTTPURLResponse*, NSData*, NSError*) = ^(BOOL success, NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        if (success) {
+            if (successHandler) {
+                successHandler();
+            }
+        } else {
+            if (failureHandler) {
+                failureHandler(response, data, error);
+            }
+        }
+    };
+    
+    // if an authentication request is already in flight, its result is shared with every
+    // caller that asks in the meantime instead of sending another one
+    
+    BOOL inProgress = NO;
+    
+    @synchronized (self.authenticationHandlers) {
+        inProgress = [self.authenticationHandlers count] > 0;
+        [self.authenticationHandlers addObject:[handler copy]];
+    }
+    
+    if (inProgress) {
+        return;
+    }
+    
+    if (self.cachesAuthToken && [self loadCachedAuthToken]) {
+        [self.completionQueue addOperationWithBlock:^{
+            [self finishAuthentication:YES response:nil data:nil error:nil];
+        }];
+        return;
+    }
+    
+    // the authentication request goes through the client's transport, so it opens the connection
+    // to the auth host that later authentications reuse.  it's sent straight away rather than
+    // waiting in line, since every waiting request depends on it.
+    void (^completionHandler)(NSHTTPURLResponse*, NSData*, NSError*) = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         
         if (response.statusCode >= 200 && response.statusCode <= 299) {            
         
             NSDictionary *headers = [response allHeaderFields];
+            NSString *expires = [headers objectForKey:@"X-Auth-Token-Expires"];
+            
             self.authToken = [headers objectForKey:@"X-Auth-Token"];
             self.storageURL = [headers objectForKey:@"X-Storage-Url"];
             self.cdnManagementURL = [headers objectForKey:@"X-Cdn-Management-Url"];
+            self.authTokenExpiration = [NSDate dateWithTimeIntervalSinceNow:expires ? [expires doubleValue] : self.authTokenLifetime];
             self.authenticated = YES;
             
-            if (successHandler) {
-                successHandler();
+            if (self.cachesAuthToken) {
+                [self saveCachedAuthToken];
             }
             
+            [self finishAuthentication:YES response:response data:data error:error];
+            
         } else {
             
             // let's make a new NSError telling the user auth failed and provide the underlying
@@ -190,21 +698,114 @@
                 NSError *myError = [[NSError alloc] initWithDomain:RSErrorDomain
                                                        code:errCode userInfo:eDict];
 
-                if (failureHandler) {
-                    failureHandler(response, data, myError);
-                }
+                [self finishAuthentication:NO response:response data:data error:myError];
                 
             } else {
             
-                if (failureHandler) {
-                    failureHandler(response, data, error);
-                }
+                [self finishAuthentication:NO response:response data:data error:error];
                 
             }
             
         }
         
+    };
+    
+    NSURLRequest *request = [self authenticationRequest];
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        return request;
     }];
+    connection.successHandler = completionHandler;
+    connection.failureHandler = completionHandler;
+    connection.transport = self.transport;
+    
+    if (self.instrumentation) {
+        RSInstrumentation *clientInstrumentation = self.instrumentation;
+        connection.recordHandler = ^(RSRequestRecord *record) {
+            record.operationType = RSOperationTypeAuthenticate;
+            [clientInstrumentation recordRequest:record];
+        };
+    }
+    
+    [connection startOnQueue:self.completionQueue];
+    
+}
+
+- (void)finishAuthentication:(BOOL)success response:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error {
+    
+    NSArray *handlers = nil;
+    
+    @synchronized (self.authenticationHandlers) {
+        handlers = [NSArray arrayWithArray:self.authenticationHandlers];
+        [self.authenticationHandlers removeAllObjects];
+    }
+    
+    for (void (^handler)(BOOL, NSHTTPURLResponse*, NSData*, NSError*) in handlers) {
+        handler(success, response, data, error);
+    }
+    
+}
+
+#pragma mark - Auth Token Cache
+
+- (NSMutableDictionary *)authTokenKeychainQuery {
+    
+    return [NSMutableDictionary dictionaryWithObjectsAndKeys:
+            (__bridge id)kSecClassGenericPassword, (__bridge id)kSecClass,
+            @"com.rackspace.cloudfiles.authtoken", (__bridge id)kSecAttrService,
+            $S(@"%@@%@", self.username, self.authURL), (__bridge id)kSecAttrAccount, nil];
+    
+}
+
+- (BOOL)loadCachedAuthToken {
+    
+    NSMutableDictionary *query = [self authTokenKeychainQuery];
+    [query setObject:(__bridge id)kCFBooleanTrue forKey:(__bridge id)kSecReturnData];
+    [query setObject:(__bridge id)kSecMatchLimitOne forKey:(__bridge id)kSecMatchLimit];
+    
+    CFTypeRef result = NULL;
+    if (SecItemCopyMatching((__bridge CFDictionaryRef)query, &result) != errSecSuccess) {
+        return NO;
+    }
+    
+    NSDictionary *token = [NSKeyedUnarchiver unarchiveObjectWithData:(__bridge_transfer NSData *)result];
+    NSDate *expiration = [token objectForKey:@"expiration"];
+    
+    if (!expiration || [expiration timeIntervalSinceNow] <= 0) {
+        return NO;
+    }
+    
+    self.authToken = [token objectForKey:@"authToken"];
+    self.storageURL = [token objectForKey:@"storageURL"];
+    self.cdnManagementURL = [token objectForKey:@"cdnManagementURL"];
+    self.authTokenExpiration = expiration;
+    self.authenticated = YES;
+    
+    return YES;
+    
+}
+
+- (void)saveCachedAuthToken {
+    
+    NSMutableDictionary *token = [[NSMutableDictionary alloc] init];
+    [token setValue:self.authToken forKey:@"authToken"];
+    [token setValue:self.storageURL forKey:@"storageURL"];
+    [token setValue:self.cdnManagementURL forKey:@"cdnManagementURL"];
+    [token setValue:self.authTokenExpiration forKey:@"expiration"];
+    
+    [self removeCachedAuthToken];
+    
+    NSMutableDictionary *item = [self authTokenKeychainQuery];
+    [item setObject:[NSKeyedArchiver archivedDataWithRootObject:token] forKey:(__bridge id)kSecValueData];
+    [item setObject:(__bridge id)kSecAttrAccessibleAfterFirstUnlockThisDeviceOnly forKey:(__bridge id)kSecAttrAccessible];
+    SecItemAdd((__bridge CFDictionaryRef)item, NULL);
+    
+}
+
+- (void)removeCachedAuthToken {
+    
+    if (self.cachesAuthToken) {
+        SecItemDelete((__bridge CFDictionaryRef)[self authTokenKeychainQuery]);
+    }
     
 }
 
@@ -216,9 +817,9 @@
     
 }
 
-- (void)getAccountMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)getAccountMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(getAccountMetadataRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self sendAsynchronousRequest:@selector(getAccountMetadataRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
 
         NSDictionary *headers = [response allHeaderFields];
         
@@ -240,45 +841,41 @@
 
 - (NSURLRequest *)getContainersRequest {
     
-    return [self storageRequest:@"?format=json"];
+    return [self storageRequest:@"" parameters:[NSDictionary dictionaryWithObject:@"json" forKey:@"format"] httpMethod:@"GET"];
     
 }
 
 - (NSURLRequest *)getContainersRequestWithLimit:(NSUInteger)limit marker:(NSString *)marker {
     
-    NSString *path = @"?format=json";
-    
-    if (limit && marker) {
-        path = $S(@"?format=json&limit=%i&marker=%@", limit, marker);
-    }
-    
-    if (limit) {
-        path = $S(@"?format=json&marker=%@", [marker stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding]);
-    }
-    
-    if (marker) {
-        path = $S(@"?format=json&limit=%i", limit);
-    }
-    
-    return [self storageRequest:path];
+    return [self storageRequest:@"" parameters:[self listingParameters:[NSDictionary dictionaryWithObject:@"json" forKey:@"format"] limit:limit marker:marker] httpMethod:@"GET"];
     
 }
 
-- (void)getContainers:(void (^)(NSArray *containers, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)getContainers:(void (^)(NSArray *containers, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(getContainersRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self sendAsynchronousRequest:@selector(getContainersRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         
         NSError *jsonError = nil;
-        NSArray *containerDictionaries = [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingAllowFragments error:&jsonError];
+        NSArray *containers = [RSContainer arrayFromJSONData:data parent:self error:&jsonError];
                
         if (successHandler) {
-            successHandler([RSContainer arrayFromJSONDictionaries:containerDictionaries parent:self], jsonError);
+            successHandler(containers, jsonError);
         }
         
     } failureHandler:failureHandler];
     
 }
 
+- (RSOperation *)getAllContainers:(void (^)(NSArray *containers, BOOL *stop))pageHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    RSPagedListing *listing = [[RSPagedListing alloc] initWithClient:self modelClass:[RSContainer class] parent:self requestHandler:^NSURLRequest *(NSUInteger limit, NSString *marker) {
+        return [self getContainersRequestWithLimit:limit marker:marker];
+    }];
+    
+    return [listing start:pageHandler success:successHandler failure:failureHandler];
+    
+}
+
 #pragma mark - Create Container
 
 - (NSURLRequest *)createContainerRequest:(RSContainer *)container {
@@ -295,9 +892,9 @@
     
 }
 
-- (void)createContainer:(id)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)createContainer:(id)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(createContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {        
+    return [self sendAsynchronousRequest:@selector(createContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {        
         if (successHandler) {
             successHandler();        
         }
@@ -313,9 +910,9 @@
 
 }
 
-- (void)deleteContainer:(id)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)deleteContainer:(id)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(deleteContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {        
+    return [self sendAsynchronousRequest:@selector(deleteContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {        
         if (successHandler) {
             successHandler();        
         }
@@ -331,9 +928,9 @@
 
 }
 
-- (void)getContainerMetadata:(RSContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)getContainerMetadata:(RSContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(getContainerMetadataRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self sendAsynchronousRequest:@selector(getContainerMetadataRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         
         NSDictionary *headers = [response allHeaderFields];
         
@@ -357,47 +954,42 @@
 
 - (NSURLRequest *)getCDNContainersRequest {
     
-    return [self cdnRequest:@"?format=json"];
+    return [self cdnRequest:@"" parameters:[NSDictionary dictionaryWithObject:@"json" forKey:@"format"] httpMethod:@"GET"];
     
 }
 
 - (NSURLRequest *)getCDNContainersRequestWithLimit:(NSUInteger)limit marker:(NSString *)marker {
 
-    // TODO: DRY this up
-    
-    NSString *path = @"?format=json&enabled_only=true";
-    
-    if (limit && marker) {
-        path = $S(@"?format=json&enabled_only=true&limit=%i&marker=%@", limit, marker);
-    }
-    
-    if (limit) {
-        path = $S(@"?format=json&enabled_only=true&marker=%@", [marker stringByAddingPercentEscapesUsingEncoding:NSUTF8StringEncoding]);
-    }
-    
-    if (marker) {
-        path = $S(@"?format=json&enabled_only=true&limit=%i", limit);
-    }
-    
-    return [self cdnRequest:path];
+    NSDictionary *params = [NSDictionary dictionaryWithObjectsAndKeys:@"json", @"format", @"true", @"enabled_only", nil];
+    return [self cdnRequest:@"" parameters:[self listingParameters:params limit:limit marker:marker] httpMethod:@"GET"];
     
 }
 
-- (void)getCDNContainers:(void (^)(NSArray *containers, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)getCDNContainers:(void (^)(NSArray *containers, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(getCDNContainersRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self sendAsynchronousRequest:@selector(getCDNContainersRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         
         NSError *jsonError = nil;
-        NSArray *containerDictionaries = [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingAllowFragments error:&jsonError];
+        NSArray *containers = [RSCDNContainer arrayFromJSONData:data parent:self error:&jsonError];
         
         if (successHandler) {
-            successHandler([RSCDNContainer arrayFromJSONDictionaries:containerDictionaries parent:self], jsonError);
+            successHandler(containers, jsonError);
         }
         
     } failureHandler:failureHandler];
     
 }
 
+- (RSOperation *)getAllCDNContainers:(void (^)(NSArray *containers, BOOL *stop))pageHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    RSPagedListing *listing = [[RSPagedListing alloc] initWithClient:self modelClass:[RSCDNContainer class] parent:self requestHandler:^NSURLRequest *(NSUInteger limit, NSString *marker) {
+        return [self getCDNContainersRequestWithLimit:limit marker:marker];
+    }];
+    
+    return [listing start:pageHandler success:successHandler failure:failureHandler];
+    
+}
+
 #pragma mark - Get Container Metadata
 
 - (NSURLRequest *)getCDNContainerMetadataRequest:(RSCDNContainer *)container {
@@ -406,9 +998,9 @@
     
 }
 
-- (void)getCDNContainerMetadata:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)getCDNContainerMetadata:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(getCDNContainerMetadataRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self sendAsynchronousRequest:@selector(getCDNContainerMetadataRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         
         NSDictionary *headers = [response allHeaderFields];
         
@@ -437,13 +1029,14 @@
     
 }
 
-- (void)cdnEnableContainer:(RSContainer *)container success:(void (^)(RSCDNContainer *container))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)cdnEnableContainer:(RSContainer *)container success:(void (^)(RSCDNContainer *container))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(cdnEnableContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self sendAsynchronousRequest:@selector(cdnEnableContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         
         NSDictionary *headers = [response allHeaderFields];
 
         RSCDNContainer *cdnContainer = [[RSCDNContainer alloc] init];        
+        cdnContainer.parent = self;
         cdnContainer.name = container.name;
         cdnContainer.ttl = kRSDefaultTTL;
         cdnContainer.cdn_enabled = YES;
@@ -474,9 +1067,9 @@
     
 }
 
-- (void)updateCDNContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)updateCDNContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(cdnEnableContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self sendAsynchronousRequest:@selector(cdnEnableContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         if (successHandler) {
             successHandler();        
         }
@@ -500,9 +1093,9 @@
     
 }
 
-- (void)purgeCDNContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)purgeCDNContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self sendAsynchronousRequest:@selector(purgeCDNContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self sendAsynchronousRequest:@selector(purgeCDNContainerRequest:) object:container sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         if (successHandler) {
             successHandler();        
         }
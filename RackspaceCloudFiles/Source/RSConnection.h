@@ -0,0 +1,168 @@
+//
+//  RSConnection.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSMetadataCache, RSCircuitBreaker, RSRequestRecord, RSBandwidthScheduler, RSTokenBucket, RSTransport, RSOperation;
+
+/** The RSConnection class represents a single HTTP request sent to the Cloud Files API.
+ *
+ *  RSClient creates a connection for every API operation.  Because the client may need to
+ *  authenticate before the request can be sent, the connection builds its request lazily with
+ *  the requestHandler block.  The block is also used to recreate the body stream of a streamed
+ *  upload if the request has to be resent.
+ */
+@interface RSConnection : NSObject <NSURLConnectionDataDelegate>
+
+/** Returns the request to send.  Executes each time the connection starts. */
+@property (nonatomic, copy) NSURLRequest *(^requestHandler)();
+
+/** Executes if the request returns a HTTP response code in the 2xx block (200-299) */
+@property (nonatomic, copy) void (^successHandler)(NSHTTPURLResponse*, NSData*, NSError*);
+
+/** Executes if the request fails or returns a HTTP response code outside of the 2xx block */
+@property (nonatomic, copy) void (^failureHandler)(NSHTTPURLResponse*, NSData*, NSError*);
+
+/** Executes as the request body is sent.  totalBytes is 0 if the body length is unknown. */
+@property (nonatomic, copy) void (^uploadProgressHandler)(unsigned long long bytesSent, unsigned long long totalBytes);
+
+/** Executes as the response body is received.  totalBytes is 0 if the response has no Content-Length. */
+@property (nonatomic, copy) void (^downloadProgressHandler)(unsigned long long bytesReceived, unsigned long long totalBytes);
+
+/** If set, the body of a successful response is passed to this block as it arrives instead of
+ *  being collected in memory, and the success handler receives empty data.  Bodies of
+ *  unsuccessful responses are always collected so they can be passed to the failure handler.
+ */
+@property (nonatomic, copy) void (^dataHandler)(NSData *data);
+
+/** The priority of the request among requests waiting to be sent.  Defaults to `NSOperationQueuePriorityNormal`. */
+@property (nonatomic) NSOperationQueuePriority queuePriority;
+
+/** Executes once the request finishes, before the success or failure handler.  RSClient uses this
+ *  to send the next waiting request and to resend requests that failed because the auth token
+ *  expired.  Return `NO` to skip the success and failure handlers, for example because the request
+ *  will be resent.  The block is released after it executes.
+ */
+@property (nonatomic, copy) BOOL (^finishHandler)(RSConnection *connection, NSError *error);
+
+/** If set, executes after each attempt with its timing and traffic, once the success or failure
+ *  handler has returned.  RSClient uses this to feed its instrumentation.
+ */
+@property (nonatomic, copy) void (^recordHandler)(RSRequestRecord *record);
+
+/** When the request was handed to the client to wait for a free slot.  RSClient sets this. */
+@property (nonatomic, strong) NSDate *enqueueDate;
+
+/** If set, the connection answers metadata and listing requests from this cache when it can,
+ *  and records their responses in it.  RSClient sets this to its metadataCache.
+ */
+@property (nonatomic, strong) RSMetadataCache *metadataCache;
+
+/** If set, the request is not sent while the circuit breaker is open for its host, and its
+ *  outcome is recorded in the breaker.  RSClient sets this to its circuitBreaker.
+ */
+@property (nonatomic, strong) RSCircuitBreaker *circuitBreaker;
+
+/** Whether the request is a bulk transfer, such as an object upload or download, rather than an
+ *  interactive request such as a metadata or listing request.  Bulk requests are subject to the
+ *  client's bandwidthScheduler.  Defaults to `NO`.
+ */
+@property (nonatomic) BOOL bulk;
+
+/** The token bucket that limits this request's transfer rate, shared by every request of a transfer
+ *  made of several requests.  If not set, the bandwidth scheduler sets one when a bulk request is sent.
+ */
+@property (nonatomic, strong) RSTokenBucket *tokenBucket;
+
+/** If set, the body of a bulk request is paced by the scheduler, and the bytes of a bulk response
+ *  are charged to it.  RSClient sets this to its bandwidthScheduler.
+ */
+@property (nonatomic, strong) RSBandwidthScheduler *bandwidthScheduler;
+
+/** The transport that sends the request.  RSClient sets this to its transport; if not set, the
+ *  request is sent with `+[RSTransport sharedTransport]`.
+ */
+@property (nonatomic, strong) RSTransport *transport;
+
+/** The operation the request is part of.  The connection reports the progress of its request body,
+ *  or of its response body if the request has none, to the operation.  Set by `-[RSOperation addConnection:]`.
+ */
+@property (nonatomic, weak) RSOperation *operation;
+
+/** The duplicate the client sent to cut this request's latency, if any.  It is cancelled with this connection. */
+@property (nonatomic, weak) RSConnection *hedge;
+
+/** The request this connection duplicates, if it is a hedge.  The operation counts the progress of
+ *  both copies as one request.
+ */
+@property (nonatomic, strong) RSConnection *hedgedConnection;
+
+/** `YES` once the client has authenticated again and resent this request after a 401 response */
+@property (nonatomic) BOOL reauthenticated;
+
+/** The number of times the client has resent this request under its retry policy */
+@property (nonatomic) NSUInteger retryCount;
+
+/** `YES` if a duplicate of this request has been sent to cut its latency, or if this connection is that duplicate */
+@property (nonatomic) BOOL hedged;
+
+/** `YES` if the request is sent without the conditional headers the metadata cache would add.  RSClient
+ *  sets this to resend a request whose 304 Not Modified can't be answered because the cached response
+ *  was discarded while the request was in flight.
+ */
+@property (nonatomic) BOOL unconditional;
+
+/** `YES` if RSClient doesn't resend the request under its retry policy, because the sender decides
+ *  itself whether and when to send it again.  Defaults to `NO`.
+ */
+@property (nonatomic) BOOL retriesDisabled;
+
+/** When the request was most recently sent */
+@property (nonatomic, strong, readonly) NSDate *startDate;
+
+/** `YES` if the request went out over the network, rather than being answered from the metadata
+ *  cache or refused by the circuit breaker
+ */
+@property (nonatomic, readonly) BOOL sent;
+
+/** `YES` once the request has finished, failed, or been cancelled */
+@property (nonatomic, readonly) BOOL finished;
+
+/** `YES` once cancel has been called */
+@property (nonatomic, readonly) BOOL cancelled;
+
+/** The request that was most recently sent */
+@property (nonatomic, strong, readonly) NSURLRequest *request;
+
+/** The response to the request, once it has been received */
+@property (nonatomic, strong, readonly) NSHTTPURLResponse *response;
+
+/** Creates a connection that sends the request returned by the given block.
+ *  @param requestHandler Returns the request to send
+ */
+- (id)initWithRequestHandler:(NSURLRequest *(^)())requestHandler;
+
+/** Sends the request.  Delegate callbacks and handlers execute on the given queue.
+ *  @param queue The queue for delegate callbacks and handlers
+ */
+- (void)startOnQueue:(NSOperationQueue *)queue;
+
+/** Fails the connection without sending its request, for example because the client couldn't
+ *  authenticate.  The failure handler executes with the given arguments, and the connection is
+ *  reported finished to its operation.  Call this on the queue the handlers execute on.
+ *  @param response The response that caused the failure, if any
+ *  @param data The body of that response, if any
+ *  @param error The error that caused the failure, if any
+ */
+- (void)failWithResponse:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error;
+
+/** Stops the request.  The failure handler executes with a `NSURLErrorCancelled` error, unless the
+ *  request has already finished.
+ */
+- (void)cancel;
+
+@end
@@ -0,0 +1,338 @@
+//
+//  RSConnection.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSConnection.h"
+#import "RSMetadataCache.h"
+#import "RSCircuitBreaker.h"
+#import "RSInstrumentation.h"
+#import "RSBandwidthScheduler.h"
+#import "RSTransport.h"
+#import "RSOperation.h"
+#import "RSClient.h"
+
+@interface RSConnection ()
+
+@property (nonatomic, strong, readwrite) NSURLRequest *request;
+@property (nonatomic, strong, readwrite) NSHTTPURLResponse *response;
+@property (nonatomic, strong, readwrite) NSDate *startDate;
+@property (nonatomic, readwrite) BOOL finished;
+@property (nonatomic, strong) NSOperationQueue *queue;
+@property (nonatomic, readwrite) BOOL cancelled;
+@property (nonatomic, strong) RSTransportTask *task;
+@property (nonatomic, strong) NSMutableData *responseData;
+@property (nonatomic) unsigned long long bytesReceived;
+@property (nonatomic, readwrite) BOOL sent;
+@property (nonatomic, strong) NSDate *responseDate;
+@property (nonatomic) unsigned long long bytesSent;
+
+- (BOOL)isStreamingResponse;
+- (NSURLRequest *)throttledRequest:(NSURLRequest *)aRequest;
+- (void)finishOnQueueWithError:(NSError *)error;
+
+- (void)finishWithError:(NSError *)error;
+- (RSRequestRecord *)recordWithError:(NSError *)error;
+
+@end
+
+@implementation RSConnection
+
+@synthesize requestHandler, successHandler, failureHandler, uploadProgressHandler, downloadProgressHandler, dataHandler;
+@synthesize queuePriority, finishHandler, recordHandler, enqueueDate, metadataCache, circuitBreaker, bulk, tokenBucket, bandwidthScheduler, transport, operation, hedge, hedgedConnection, reauthenticated, retryCount, hedged, unconditional, retriesDisabled;
+@synthesize request, response, startDate, finished, queue, cancelled, task, responseData, bytesReceived, sent, responseDate, bytesSent;
+
+- (id)initWithRequestHandler:(NSURLRequest *(^)())aRequestHandler {
+
+    self = [super init];
+    if (self) {
+        self.requestHandler = aRequestHandler;
+    }
+    return self;
+
+}
+
+- (void)startOnQueue:(NSOperationQueue *)aQueue {
+
+    self.queue = aQueue;
+    self.request = self.requestHandler();
+    self.response = nil;
+    self.responseData = [[NSMutableData alloc] init];
+    self.bytesReceived = 0;
+    self.bytesSent = 0;
+    self.responseDate = nil;
+    self.startDate = [NSDate date];
+    self.finished = NO;
+    self.sent = NO;
+
+    if (self.cancelled) {
+        [self finishOnQueueWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+        return;
+    }
+
+    if (self.metadataCache) {
+
+        RSMetadataCacheEntry *entry = self.dataHandler ? nil : [self.metadataCache freshEntryForRequest:self.request];
+
+        if (entry) {
+            self.response = entry.response;
+            [self.responseData setData:entry.data];
+            [self finishOnQueueWithError:nil];
+            return;
+        }
+
+        if (!self.unconditional) {
+            self.request = [self.metadataCache prepareRequest:self.request];
+        }
+
+    }
+
+    if (self.circuitBreaker && ![self.circuitBreaker allowsRequest:self.request]) {
+        
+        NSString *description = [NSString stringWithFormat:@"Requests to %@ are failing, so the request was not sent", [[self.request URL] host]];
+        [self finishOnQueueWithError:[NSError errorWithDomain:RSErrorDomain code:ECIRCUITOPEN userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]]];
+        return;
+        
+    }
+
+    if (self.bandwidthScheduler && self.bulk) {
+        self.request = [self throttledRequest:self.request];
+    }
+
+    // the task holds on to us until we finish and hand it back, so the connection keeps itself
+    // alive for the duration of the request
+    self.sent = YES;
+    self.task = [(self.transport ? self.transport : [RSTransport sharedTransport]) startRequest:self.request connection:self queue:aQueue];
+
+}
+
+- (void)finishOnQueueWithError:(NSError *)error {
+
+    [self.queue addOperationWithBlock:^{
+        [self finishWithError:error];
+    }];
+
+}
+
+- (void)cancel {
+
+    self.cancelled = YES;
+    [self.hedge cancel];
+
+    if (self.task) {
+        [self.task cancel];
+        [self finishOnQueueWithError:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+    }
+
+}
+
+- (void)failWithResponse:(NSHTTPURLResponse *)aResponse data:(NSData *)data error:(NSError *)error {
+
+    // the request was never given a slot, so there's no finish handler to tell
+    self.finished = YES;
+    self.finishHandler = nil;
+
+    if (self.failureHandler) {
+        self.failureHandler(aResponse, data, error);
+    }
+
+    [self.operation connectionFinished:self];
+
+}
+
+- (NSURLRequest *)throttledRequest:(NSURLRequest *)aRequest {
+
+    NSInputStream *stream = [aRequest HTTPBodyStream];
+
+    // a body in memory is streamed too, so it can be paced.  the length is already in the headers.
+    if (!stream && [[aRequest HTTPBody] length] > 0 && [aRequest valueForHTTPHeaderField:@"Content-Length"]) {
+        stream = [NSInputStream inputStreamWithData:[aRequest HTTPBody]];
+    }
+
+    if (!stream) {
+        return aRequest;
+    }
+
+    NSMutableURLRequest *throttled = [aRequest mutableCopy];
+    [throttled setHTTPBodyStream:[self.bandwidthScheduler throttledStream:stream forConnection:self]];
+    return throttled;
+
+}
+
+- (BOOL)isStreamingResponse {
+    
+    return self.dataHandler && self.response.statusCode >= 200 && self.response.statusCode <= 299;
+    
+}
+
+- (void)finishWithError:(NSError *)error {
+
+    // a cancelled connection may still have a callback waiting on the queue
+    if (self.finished) {
+        return;
+    }
+    self.finished = YES;
+
+    // frees the task's slot so the next request to the host can go
+    [self.task finish];
+    self.task = nil;
+
+    if (self.circuitBreaker && self.sent) {
+        [self.circuitBreaker recordResponse:self.response error:error forRequest:self.request];
+    }
+    
+    // the finish handler may resend the request, which resets it, so the record is taken first
+    RSRequestRecord *record = self.recordHandler ? [self recordWithError:error] : nil;
+    void (^recordBlock)(RSRequestRecord *) = self.recordHandler;
+
+    // a 304 Not Modified is answered with the cached response.  if that response was discarded
+    // in the meantime the 304 is left as it is, so the finish handler can ask again without the condition
+    if (self.metadataCache && self.sent && !error) {
+
+        RSMetadataCacheEntry *entry = [self.metadataCache entryForRequest:self.request response:self.response data:self.responseData];
+
+        if (entry) {
+            self.response = entry.response;
+            [self.responseData setData:entry.data];
+        }
+
+    }
+
+    BOOL (^finishBlock)(RSConnection *, NSError *) = self.finishHandler;
+    self.finishHandler = nil;
+    if (finishBlock && !finishBlock(self, error)) {
+        if (record) {
+            recordBlock(record);
+        }
+        return;
+    }
+
+    NSDate *handlerStartDate = [NSDate date];
+
+    if (error == nil && self.response.statusCode >= 200 && self.response.statusCode <= 299) {
+        if (self.successHandler) {
+            self.successHandler(self.response, self.responseData, error);
+        }
+    } else {
+        if (self.failureHandler) {
+            self.failureHandler(self.response, self.responseData, error);
+        }
+    }
+
+    if (record) {
+        record.handlerTime = -[handlerStartDate timeIntervalSinceNow];
+        recordBlock(record);
+    }
+
+    [self.operation connectionFinished:self];
+
+}
+
+- (RSRequestRecord *)recordWithError:(NSError *)error {
+
+    NSDate *finishDate = [NSDate date];
+
+    RSRequestRecord *record = [[RSRequestRecord alloc] init];
+    record.request = self.request;
+    record.statusCode = self.response.statusCode;
+    record.error = error;
+    record.date = self.startDate;
+    record.queueWaitTime = self.enqueueDate ? MAX([self.startDate timeIntervalSinceDate:self.enqueueDate], 0) : 0;
+    record.timeToFirstByte = [(self.responseDate ? self.responseDate : finishDate) timeIntervalSinceDate:self.startDate];
+    record.latency = [finishDate timeIntervalSinceDate:self.startDate];
+    record.bytesSent = self.bytesSent;
+    record.bytesReceived = self.bytesReceived;
+    record.retryCount = self.retryCount;
+    record.fromCache = !self.sent && self.response != nil;
+
+    return record;
+
+}
+
+#pragma mark - NSURLConnectionDataDelegate
+
+- (void)connection:(NSURLConnection *)connection didReceiveResponse:(NSURLResponse *)urlResponse {
+
+    self.response = (NSHTTPURLResponse *)urlResponse;
+    self.responseDate = [NSDate date];
+    [self.responseData setLength:0];
+    self.bytesReceived = 0;
+
+}
+
+- (void)connection:(NSURLConnection *)connection didReceiveData:(NSData *)data {
+
+    // data that was already on the queue when the connection was cancelled is dropped
+    if (self.finished) {
+        return;
+    }
+
+    if ([self isStreamingResponse]) {
+        self.dataHandler(data);
+    } else {
+        [self.responseData appendData:data];
+    }
+    
+    self.bytesReceived += [data length];
+    
+    if (self.bandwidthScheduler) {
+        [self.bandwidthScheduler connection:self didReceiveBytes:[data length]];
+    }
+    
+    if (self.downloadProgressHandler) {
+        self.downloadProgressHandler(self.bytesReceived, MAX([self.response expectedContentLength], 0));
+    }
+
+    // a request with a body counts the body as its progress, so the response to an upload isn't added to it
+    if (self.operation && ![self.request HTTPBody] && ![self.request HTTPBodyStream]) {
+        [self.operation child:self didTransferBytes:self.bytesReceived ofTotal:MAX([self.response expectedContentLength], 0)];
+    }
+
+}
+
+- (void)connection:(NSURLConnection *)connection didSendBodyData:(NSInteger)bytesWritten totalBytesWritten:(NSInteger)totalBytesWritten totalBytesExpectedToWrite:(NSInteger)totalBytesExpectedToWrite {
+
+    self.bytesSent = totalBytesWritten;
+
+    if (self.uploadProgressHandler) {
+        self.uploadProgressHandler(totalBytesWritten, MAX(totalBytesExpectedToWrite, 0));
+    }
+
+    [self.operation child:self didTransferBytes:totalBytesWritten ofTotal:MAX(totalBytesExpectedToWrite, 0)];
+
+}
+
+- (NSInputStream *)connection:(NSURLConnection *)connection needNewBodyStream:(NSURLRequest *)originalRequest {
+
+    // a streamed body can't be rewound, so build a fresh request to get a new stream
+    NSURLRequest *newRequest = self.requestHandler();
+    
+    if (self.bandwidthScheduler && self.bulk) {
+        newRequest = [self throttledRequest:newRequest];
+    }
+    
+    return [newRequest HTTPBodyStream];
+
+}
+
+- (NSCachedURLResponse *)connection:(NSURLConnection *)connection willCacheResponse:(NSCachedURLResponse *)cachedResponse {
+
+    return nil;
+
+}
+
+- (void)connectionDidFinishLoading:(NSURLConnection *)connection {
+
+    [self finishWithError:nil];
+
+}
+
+- (void)connection:(NSURLConnection *)connection didFailWithError:(NSError *)error {
+
+    [self finishWithError:error];
+
+}
+
+@end
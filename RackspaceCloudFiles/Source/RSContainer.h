@@ -8,7 +8,7 @@
 
 #import "RSModel.h"
 
-@class RSStorageObject;
+@class RSStorageObject, RSOperation;
 
 /** The RSContainer class represents a container in your Cloud Files account.  
  *  A container is a storage compartment for your data and provides a way for you
@@ -20,7 +20,7 @@
 @interface RSContainer : RSModel
 
 /** The number of bytes used in the container */
-@property (nonatomic) NSUInteger bytes;
+@property (nonatomic) unsigned long long bytes;
 
 /** The number of files stored in the container */
 @property (nonatomic) NSUInteger count;
@@ -33,6 +33,32 @@
  */
 @property (nonatomic, strong) NSMutableDictionary *metadata;
 
+/** Uploads whose content type is in this set are gzip-encoded and stored with `Content-Encoding: gzip`.
+ *  An entry ending in `/` matches every type under it, so `text/` matches `text/csv`.  Defaults to nil,
+ *  which turns compression off.  Large objects uploaded in segments are never compressed.
+ *
+ *  Downloads of compressed objects are decoded as they arrive whatever this is set to, and objects
+ *  stored uncompressed are downloaded as they are.  Linking against libz is required.
+ *
+ *  A compressed object's ETag is the MD5 of its compressed bytes, which a download never sees once it
+ *  has been decoded.  So the MD5 of the uncompressed data is stored in the object's metadata under
+ *  `kRSUncompressedMD5MetadataKey` whenever it is known before the upload: always for data in memory,
+ *  and for a file when its MD5 is passed in.  Downloads to a file are checked against it, and compressed
+ *  objects stored without it are not verified.
+ */
+@property (nonatomic, strong) NSSet *compressedContentTypes;
+
+/** The gzip compression level for compressed uploads, from 1 for fastest to 9 for smallest.
+ *  Defaults to `kRSDefaultCompressionLevel`.
+ */
+@property (nonatomic) int compressionLevel;
+
+/** Whether uploadLargeObject: names segments after the MD5 of their contents, so segments that are
+ *  already in the segment container are reused across objects and versions instead of sent again.
+ *  Defaults to `NO`.  See RSSegmentedUpload's contentAddressed.
+ */
+@property (nonatomic) BOOL contentAddressedSegments;
+
 #pragma mark Get Objects
 
 /** Returns a request object that represents a request to retrieve a list of objects in the container */
@@ -49,6 +75,10 @@
  *  path: For a string value x, return the object names nested in the pseudo path (assuming preconditions are met - see below).
  *
  *  delimiter: For a character c, return all the object names nested in the container (without the need for the directory marker objects).
+ *
+ *  end_marker: For a string value x, return object names less in value than x.
+ *
+ *  Values are escaped, so they may contain any characters.
  *  @param params Request parameters
  */
 - (NSURLRequest *)getObjectsRequest:(NSDictionary *)params;
@@ -57,9 +87,26 @@
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)getObjects:(void (^)(NSArray *objects, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)getObjects:(void (^)(NSArray *objects, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
-/** Returns a request object that represents a request to upload a file into the container 
+/** Retrieves every object in the container, one page at a time.  The API returns at most
+ *  10,000 objects per request, so this follows the listing from page to page until it is complete.
+ *  @param pageHandler Executes for each page of objects, in order.  Set stop to `YES` to end the listing early.
+ *  @param successHandler Executes after the last page
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)getAllObjects:(void (^)(NSArray *objects, BOOL *stop))pageHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Retrieves every object in the container that matches the given parameters, one page at a time.
+ *  @param params Request parameters, as for getObjectsRequest:.  limit and marker are set for each page.
+ *  @param pageHandler Executes for each page of objects, in order.  Set stop to `YES` to end the listing early.
+ *  @param successHandler Executes after the last page
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)getAllObjects:(NSDictionary *)params page:(void (^)(NSArray *objects, BOOL *stop))pageHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Returns a request object that represents a request to upload a file into the container.  The MD5
+ *  of the object's data is sent as the ETag, so Cloud Files rejects the upload if it arrives corrupted.
  *  @param object The file to upload
  */
 - (NSURLRequest *)uploadObjectRequest:(RSStorageObject *)object;
@@ -69,15 +116,93 @@
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)uploadObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)uploadObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Returns a request object that represents a request to upload a file into the container from the
+ *  local filesystem.  The request body is streamed from the file in chunks of the client's chunkSize.
+ *  @param object The file to upload
+ *  @param path The path for the file's data on the local filesystem
+ */
+- (NSURLRequest *)uploadObjectRequest:(RSStorageObject *)object fromFile:(NSString *)path;
+
+/** Returns a request object that represents a request to upload a file into the container from the
+ *  local filesystem, with the file's MD5 sent as the ETag.
+ *  @param object The file to upload
+ *  @param path The path for the file's data on the local filesystem
+ *  @param md5 The MD5 of the file as a hex string, or `nil` if it isn't known
+ */
+- (NSURLRequest *)uploadObjectRequest:(RSStorageObject *)object fromFile:(NSString *)path md5:(NSString *)md5;
+
+/** Uploads a file into the container from the local filesystem.  The file is streamed from disk,
+ *  so only a small part of it is held in memory at any time.
+ *  @param object The file to upload
+ *  @param path The path for the file's data on the local filesystem
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)uploadObject:(RSStorageObject *)object fromFile:(NSString *)path success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
-/** Uploads a file into the container from the local filesystem.
+/** Uploads a file into the container from the local filesystem, reporting progress as the file is sent.
  *  @param object The file to upload
  *  @param path The path for the file's data on the local filesystem
+ *  @param progressHandler Executes as each chunk of the file is sent
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)uploadObject:(RSStorageObject *)object fromFile:(NSString *)path success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)uploadObject:(RSStorageObject *)object fromFile:(NSString *)path progress:(void (^)(unsigned long long bytesSent, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Uploads a file into the container from the local filesystem, verifying that it arrived intact.
+ *
+ *  If the MD5 is known, it is sent as the ETag and Cloud Files rejects a corrupted upload with a 422.
+ *  Otherwise the file is hashed as it is read for sending, and the failureHandler gets an
+ *  `ECHECKSUMFAILURE` error if the ETag Cloud Files returns doesn't match.  Either way the file is
+ *  only read once.
+ *  @param object The file to upload
+ *  @param path The path for the file's data on the local filesystem
+ *  @param md5 The MD5 of the file as a hex string, or `nil` to compute it during the upload
+ *  @param progressHandler Executes as each chunk of the file is sent
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)uploadObject:(RSStorageObject *)object fromFile:(NSString *)path md5:(NSString *)md5 progress:(void (^)(unsigned long long bytesSent, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Uploads a file into the container unless Cloud Files already has identical content under the same name.
+ *
+ *  The data that would be sent is compressed and hashed off the completion queue, and its MD5 is compared
+ *  to the object's hash, if it came from a listing, or else to the ETag returned by a HEAD request.  The
+ *  upload is skipped when they match, and otherwise sends the same body with the MD5 as its ETag.
+ *  @param object The file to upload
+ *  @param successHandler Executes if successful.  uploaded is `NO` if the upload was skipped.
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)uploadObjectIfChanged:(RSStorageObject *)object success:(void (^)(BOOL uploaded))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Uploads a file into the container from the local filesystem unless Cloud Files already has identical
+ *  content under the same name.
+ *
+ *  The file is hashed off the completion queue, and its MD5 is compared to the object's hash, if it came
+ *  from a listing, or else to the ETag returned by a HEAD request.  The upload is skipped when they match,
+ *  and otherwise sent with the MD5 as its ETag.  Objects the container compresses are always uploaded,
+ *  because their ETag is the MD5 of the compressed bytes.
+ *  @param object The file to upload
+ *  @param path The path for the file's data on the local filesystem
+ *  @param progressHandler Executes as each chunk of the file is sent
+ *  @param successHandler Executes if successful.  uploaded is `NO` if the upload was skipped.
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)uploadObjectIfChanged:(RSStorageObject *)object fromFile:(NSString *)path progress:(void (^)(unsigned long long bytesSent, unsigned long long totalBytes))progressHandler success:(void (^)(BOOL uploaded))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Uploads a file larger than the single object size limit into the container from the local filesystem.
+ *  The file is uploaded as a series of segments in parallel, followed by a manifest.  If a previous
+ *  upload of the same file was interrupted, the segments it already uploaded are reused.  Use
+ *  RSSegmentedUpload directly to configure the segment size, concurrency, or manifest type.
+ *  @param object The file to upload
+ *  @param path The path for the file's data on the local filesystem
+ *  @param progressHandler Executes as the file is sent
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)uploadLargeObject:(RSStorageObject *)object fromFile:(NSString *)path progress:(void (^)(unsigned long long bytesSent, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 /** Returns a request object that represents a request to delete a file in the container 
  *  @param object The file to delete
@@ -89,6 +214,54 @@
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)deleteObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)deleteObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+#pragma mark Batch Operations
+
+/** Deletes files in the container with the bulk delete middleware, thousands per request.  If bulk
+ *  delete is not available, the files are deleted with individual requests instead.
+ *  Files that no longer exist are not treated as errors.
+ *  @param objects The files to delete
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful.  If only some files could not be deleted, the error's
+ *  code is `EBULKFAILURE` and its userInfo lists them under `RSBulkErrorsKey`.
+ */
+- (RSOperation *)deleteObjects:(NSArray *)objects success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Deletes every file in the container.  Each page of the listing is deleted while the next page
+ *  is retrieved.  Once this succeeds, the container can be deleted.
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)deleteAllObjects:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Returns a request object that represents a request to upload a tar archive and extract its files into the container
+ *  @param path The path for the archive on the local filesystem
+ */
+- (NSURLRequest *)uploadArchiveRequest:(NSString *)path;
+
+/** Uploads a tar archive and creates an object in the container for each file in it.
+ *  @param path The path for the archive on the local filesystem
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful, or if archive extraction is not available
+ */
+- (RSOperation *)uploadArchive:(NSString *)path success:(void (^)(NSUInteger filesCreated))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Uploads many files from the local filesystem with a single request by packing them into a tar
+ *  archive.  If archive extraction is not available, the files are uploaded with individual requests instead.
+ *  @param files The paths for the files' data on the local filesystem, keyed by object name
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)uploadFiles:(NSDictionary *)files success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Makes the container mirror a directory on the local filesystem, uploading only files that are new
+ *  or changed and deleting objects that have no file.  Use RSDirectorySync directly to cache file
+ *  hashes between syncs or to see the plan without transferring anything.
+ *  @param path The directory to mirror
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)syncDirectory:(NSString *)path success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 @end
@@ -12,23 +12,54 @@
 
 #define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
 
+@interface RSContainer ()
+
+- (BOOL)compressesObject:(RSStorageObject *)object;
+- (NSURLRequest *)uploadObjectRequest:(RSStorageObject *)object body:(NSData *)body md5:(NSString *)md5 uncompressedMD5:(NSString *)uncompressedMD5;
+- (void)getETagOfObject:(RSStorageObject *)object operation:(RSOperation *)operation success:(void (^)(NSString *etag))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+@end
+
 @implementation RSContainer
 
-@synthesize bytes, count, name, metadata;
+@synthesize bytes, count, name, metadata, compressedContentTypes, compressionLevel, contentAddressedSegments;
 
 - (id)init {
     self = [super init];
     if (self) {
         self.metadata = [[NSMutableDictionary alloc] init];
+        self.compressionLevel = kRSDefaultCompressionLevel;
     }
     return self;
 }
 
+#pragma mark - Listing
+
+- (void)setListingString:(NSString *)value forKey:(RSListingKey)key {
+    
+    if (key == RSListingKeyName) {
+        self.name = value;
+    }
+    
+}
+
+- (void)setListingNumber:(long long)value forKey:(RSListingKey)key {
+    
+    if (key == RSListingKeyCount) {
+        // a count too large for NSUInteger on a 32-bit device is capped rather than wrapped
+        unsigned long long count = (unsigned long long)MAX(value, 0);
+        self.count = count > NSUIntegerMax ? NSUIntegerMax : (NSUInteger)count;
+    } else if (key == RSListingKeyBytes) {
+        self.bytes = (unsigned long long)MAX(value, 0);
+    }
+    
+}
+
 #pragma mark - Get Objects
 
 - (NSURLRequest *)getObjectsRequest {
     
-    return [self.client storageRequest:$S(@"/%@?format=json", self.name)];
+    return [self.client storageRequest:$S(@"/%@", self.name) parameters:[NSDictionary dictionaryWithObject:@"json" forKey:@"format"] httpMethod:@"GET"];
     
 }
 
@@ -38,49 +69,130 @@
 //delimiter: For a character c, return all the object names nested in the container (without the need for the directory marker objects).
 - (NSURLRequest *)getObjectsRequest:(NSDictionary *)params {
 
-    NSMutableString *paramString = [[NSMutableString alloc] initWithString:@"?format=json"];
+    NSMutableDictionary *query = [[NSMutableDictionary alloc] initWithDictionary:params];
+    [query setObject:@"json" forKey:@"format"];
     
-    for (NSString *key in params) {
-        
-        [paramString appendFormat:@"%@=%@", key, [params valueForKey:key]];
-        
-    }
-    
-    NSMutableURLRequest *request = [self.client storageRequest:$S(@"/%@%@", self.name, paramString)];
+    NSMutableURLRequest *request = [self.client storageRequest:$S(@"/%@", self.name) parameters:query httpMethod:@"GET"];
     return request;
 }
 
-- (void)getObjects:(void (^)(NSArray *objects, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)getObjects:(void (^)(NSArray *objects, NSError *jsonError))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self.client sendAsynchronousRequest:@selector(getObjectsRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    return [self.client sendAsynchronousRequest:@selector(getObjectsRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         
         NSError *jsonError = nil;
-        NSArray *dictionaries = [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingAllowFragments error:&jsonError];
+        NSArray *objects = [RSStorageObject arrayFromJSONData:data parent:self error:&jsonError];
         
         if (successHandler) {
-            successHandler([RSStorageObject arrayFromJSONDictionaries:dictionaries parent:self], jsonError);
+            successHandler(objects, jsonError);
         }
         
     } failureHandler:failureHandler];
     
 }
 
-- (NSURLRequest *)uploadObjectRequest:(RSStorageObject *)object {
+- (RSOperation *)getAllObjects:(void (^)(NSArray *objects, BOOL *stop))pageHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    return [self getAllObjects:nil page:pageHandler success:successHandler failure:failureHandler];
+    
+}
+
+- (RSOperation *)getAllObjects:(NSDictionary *)params page:(void (^)(NSArray *objects, BOOL *stop))pageHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    RSPagedListing *listing = [[RSPagedListing alloc] initWithClient:self.client modelClass:[RSStorageObject class] parent:self requestHandler:^NSURLRequest *(NSUInteger limit, NSString *marker) {
+        
+        NSMutableDictionary *pageParams = [[NSMutableDictionary alloc] initWithDictionary:params];
+        [pageParams setObject:$S(@"%lu", (unsigned long)limit) forKey:@"limit"];
+        if (marker) {
+            [pageParams setObject:marker forKey:@"marker"];
+        }
+        return [self getObjectsRequest:pageParams];
+        
+    }];
+    
+    return [listing start:pageHandler success:successHandler failure:failureHandler];
+    
+}
+
+- (NSMutableURLRequest *)putObjectRequest:(RSStorageObject *)object {
     
     NSMutableURLRequest *request = [self.client storageRequest:$S(@"/%@/%@", self.name, object.name) httpMethod:@"PUT"];
     
     for (NSString *key in object.metadata) {
-        [request addValue:[object.metadata valueForKey:key] forHTTPHeaderField:$S(@"X-Object-Meta-", key)];
+        [request addValue:[object.metadata valueForKey:key] forHTTPHeaderField:$S(@"X-Object-Meta-%@", key)];
+    }
+    
+    return request;
+}
+
+- (BOOL)compressesObject:(RSStorageObject *)object {
+    
+    return self.compressedContentTypes && [RSGzip contentType:object.content_type matchesTypes:self.compressedContentTypes];
+    
+}
+
+- (NSURLRequest *)uploadObjectRequest:(RSStorageObject *)object {
+    
+    if ([self compressesObject:object]) {
+        NSData *body = [RSGzip gzipData:object.data level:self.compressionLevel];
+        return [self uploadObjectRequest:object body:body md5:[RSChecksum MD5OfData:body] uncompressedMD5:[RSChecksum MD5OfData:object.data]];
+    }
+    
+    return [self uploadObjectRequest:object body:object.data md5:[RSChecksum MD5OfData:object.data] uncompressedMD5:nil];
+    
+}
+
+// body is what's stored, already compressed if the object is, and md5 is its digest
+- (NSURLRequest *)uploadObjectRequest:(RSStorageObject *)object body:(NSData *)body md5:(NSString *)md5 uncompressedMD5:(NSString *)uncompressedMD5 {
+    
+    NSMutableURLRequest *request = [self putObjectRequest:object];
+    
+    if (uncompressedMD5) {
+        [request addValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+        [request setValue:uncompressedMD5 forHTTPHeaderField:$S(@"X-Object-Meta-%@", kRSUncompressedMD5MetadataKey)];
     }
-    [request addValue:$S(@"%i", [object.data length]) forHTTPHeaderField:@"Content-Length"];
-    [request setHTTPBody:object.data];
+    
+    [request addValue:$S(@"%lu", (unsigned long)[body length]) forHTTPHeaderField:@"Content-Length"];
+    [request addValue:md5 forHTTPHeaderField:@"ETag"];
+    [request setHTTPBody:body];
         
     return request;
 }
 
-- (void)uploadObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (NSURLRequest *)uploadObjectRequest:(RSStorageObject *)object fromFile:(NSString *)path {
+    
+    return [self uploadObjectRequest:object fromFile:path md5:nil];
+    
+}
+
+- (NSURLRequest *)uploadObjectRequest:(RSStorageObject *)object fromFile:(NSString *)path md5:(NSString *)md5 {
+    
+    RSChunkedInputStream *stream = [[RSChunkedInputStream alloc] initWithFileAtPath:path chunkSize:self.client.chunkSize];
+    NSMutableURLRequest *request = [self putObjectRequest:object];
     
-    [self.client sendAsynchronousRequest:@selector(uploadObjectRequest:) object:object sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+    // the compressed length isn't known until the whole file is read, so a compressed body is
+    // sent chunked, and the MD5 of the file isn't the MD5 of what's stored
+    if ([self compressesObject:object]) {
+        [request addValue:@"gzip" forHTTPHeaderField:@"Content-Encoding"];
+        if (md5) {
+            [request setValue:md5 forHTTPHeaderField:$S(@"X-Object-Meta-%@", kRSUncompressedMD5MetadataKey)];
+        }
+        [request setHTTPBodyStream:[[RSGzipInputStream alloc] initWithStream:stream level:self.compressionLevel]];
+        return request;
+    }
+    
+    [request addValue:$S(@"%llu", stream.length) forHTTPHeaderField:@"Content-Length"];
+    if (md5) {
+        [request addValue:md5 forHTTPHeaderField:@"ETag"];
+    }
+    [request setHTTPBodyStream:stream];
+    
+    return request;
+}
+
+- (RSOperation *)uploadObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    return [self.client sendAsynchronousRequest:@selector(uploadObjectRequest:) object:object sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
         
         object.etag = [[response allHeaderFields] valueForKey:@"ETag"];        
         object.parent = self;
@@ -93,10 +205,227 @@
     
 }
 
-- (void)uploadObject:(RSStorageObject *)object fromFile:(NSString *)path success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)uploadObject:(RSStorageObject *)object fromFile:(NSString *)path success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    return [self uploadObject:object fromFile:path progress:nil success:successHandler failure:failureHandler];
+    
+}
+
+- (RSOperation *)uploadObject:(RSStorageObject *)object fromFile:(NSString *)path progress:(void (^)(unsigned long long bytesSent, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    return [self uploadObject:object fromFile:path md5:nil progress:progressHandler success:successHandler failure:failureHandler];
+    
+}
+
+- (RSOperation *)uploadObject:(RSStorageObject *)object fromFile:(NSString *)path md5:(NSString *)md5 progress:(void (^)(unsigned long long bytesSent, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    __block RSChecksum *checksum = nil;
+    
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        
+        NSURLRequest *request = [self uploadObjectRequest:object fromFile:path md5:md5];
+        
+        // without a digest to send, the body is hashed as the stream produces it.  a resend reads
+        // the file again from the start, so it gets a new checksum.
+        if (![request valueForHTTPHeaderField:@"ETag"]) {
+            
+            RSChecksum *running = [[RSChecksum alloc] init];
+            void (^chunkHandler)(NSData *) = ^(NSData *chunk) {
+                [running updateWithData:chunk];
+            };
+            
+            if ([[request HTTPBodyStream] isKindOfClass:[RSGzipInputStream class]]) {
+                [(RSGzipInputStream *)[request HTTPBodyStream] setChunkHandler:chunkHandler];
+            } else {
+                [(RSChunkedInputStream *)[request HTTPBodyStream] setChunkHandler:chunkHandler];
+            }
+            checksum = running;
+            
+        }
+        
+        return request;
+        
+    }];
+    
+    connection.bulk = YES;
+    connection.uploadProgressHandler = progressHandler;
+    
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        
+        NSString *etag = [[response allHeaderFields] valueForKey:@"ETag"];
+        
+        if (checksum && ![RSChecksum ETag:etag matchesMD5:[checksum hexDigest]]) {
+            
+            NSString *description = $S(@"Checksum mismatch for %@: sent %@, stored %@", object.name, [checksum hexDigest], etag);
+            NSError *checksumError = [[NSError alloc] initWithDomain:RSErrorDomain code:ECHECKSUMFAILURE userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]];
+            
+            if (failureHandler) {
+                failureHandler(response, data, checksumError);
+            }
+            return;
+            
+        }
+        
+        object.etag = etag;
+        object.bytes = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil] fileSize];
+        object.parent = self;
+        
+        if (successHandler) {
+            successHandler();
+        }
+        
+    };
+    connection.failureHandler = failureHandler;
+    
+    RSOperation *operation = [[RSOperation alloc] initWithClient:self.client];
+    [operation addConnection:connection];
+    [self.client sendConnection:connection];
+    
+    return operation;
+    
+}
+
+- (void)getETagOfObject:(RSStorageObject *)object operation:(RSOperation *)operation success:(void (^)(NSString *etag))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    // a hash from a listing saves the round trip
+    if (object.hash) {
+        successHandler(object.hash);
+        return;
+    }
+    
+    object.parent = self;
+    
+    [operation addOperation:[self.client sendAsynchronousRequest:@selector(getObjectMetadataRequest) sender:object successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        successHandler([[response allHeaderFields] valueForKey:@"ETag"]);
+    } failureHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        
+        if (response.statusCode == 404) {
+            successHandler(nil);
+        } else if (failureHandler) {
+            failureHandler(response, data, error);
+        }
+        
+    }]];
+    
+}
+
+- (RSOperation *)uploadObjectIfChanged:(RSStorageObject *)object success:(void (^)(BOOL uploaded))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    NSOperationQueue *completionQueue = self.client.completionQueue;
+    RSOperation *operation = [[RSOperation alloc] initWithClient:self.client];
+    BOOL compresses = [self compressesObject:object];
+    NSData *data = object.data;
+    
+    // the body is compressed and hashed once, off the completion queue, and the same body and
+    // digest are sent if the stored object differs.  the digest is of exactly what would be
+    // stored, compressed or not, so it compares with the ETag.
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        
+        NSData *body = compresses ? [RSGzip gzipData:data level:self.compressionLevel] : data;
+        NSString *md5 = [RSChecksum MD5OfData:body];
+        NSString *uncompressedMD5 = compresses ? [RSChecksum MD5OfData:data] : nil;
+        
+        [completionQueue addOperationWithBlock:^{
+            
+            [self getETagOfObject:object operation:operation success:^(NSString *etag) {
+                
+                if ([RSChecksum ETag:etag matchesMD5:md5]) {
+                    
+                    object.etag = etag;
+                    object.parent = self;
+                    
+                    if (successHandler) {
+                        successHandler(NO);
+                    }
+                    return;
+                    
+                }
+                
+                RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+                    return [self uploadObjectRequest:object body:body md5:md5 uncompressedMD5:uncompressedMD5];
+                }];
+                
+                connection.successHandler = ^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
+                    
+                    object.etag = [[response allHeaderFields] valueForKey:@"ETag"];
+                    object.parent = self;
+                    
+                    if (successHandler) {
+                        successHandler(YES);
+                    }
+                    
+                };
+                connection.failureHandler = failureHandler;
+                
+                [operation addConnection:connection];
+                [self.client sendConnection:connection];
+                
+            } failure:failureHandler];
+            
+        }];
+        
+    });
+    
+    return operation;
+    
+}
+
+- (RSOperation *)uploadObjectIfChanged:(RSStorageObject *)object fromFile:(NSString *)path progress:(void (^)(unsigned long long bytesSent, unsigned long long totalBytes))progressHandler success:(void (^)(BOOL uploaded))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    if ([self compressesObject:object]) {
+        return [self uploadObject:object fromFile:path md5:nil progress:progressHandler success:^{
+            if (successHandler) {
+                successHandler(YES);
+            }
+        } failure:failureHandler];
+    }
+    
+    NSOperationQueue *completionQueue = self.client.completionQueue;
+    RSOperation *operation = [[RSOperation alloc] initWithClient:self.client];
+    
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        
+        NSString *md5 = [RSChecksum MD5OfFileAtPath:path];
+        
+        [completionQueue addOperationWithBlock:^{
+            
+            [self getETagOfObject:object operation:operation success:^(NSString *etag) {
+                
+                if (md5 && [RSChecksum ETag:etag matchesMD5:md5]) {
+                    
+                    object.etag = etag;
+                    object.bytes = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil] fileSize];
+                    object.parent = self;
+                    
+                    if (successHandler) {
+                        successHandler(NO);
+                    }
+                    return;
+                    
+                }
+                
+                [operation addOperation:[self uploadObject:object fromFile:path md5:md5 progress:progressHandler success:^{
+                    if (successHandler) {
+                        successHandler(YES);
+                    }
+                } failure:failureHandler]];
+                
+            } failure:failureHandler];
+            
+        }];
+        
+    });
+    
+    return operation;
+    
+}
+
+- (RSOperation *)uploadLargeObject:(RSStorageObject *)object fromFile:(NSString *)path progress:(void (^)(unsigned long long bytesSent, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    object.data = [NSData dataWithContentsOfFile:path];
-    [self uploadObject:object success:successHandler failure:failureHandler];
+    RSSegmentedUpload *upload = [[RSSegmentedUpload alloc] initWithContainer:self object:object path:path];
+    upload.contentAddressed = self.contentAddressedSegments;
+    upload.progressHandler = progressHandler;
+    return [upload start:successHandler failure:failureHandler];
     
 }
 
@@ -106,9 +435,9 @@
     
 }
 
-- (void)deleteObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)deleteObject:(RSStorageObject *)object success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self.client sendAsynchronousRequest:@selector(deleteObjectRequest:) object:object sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {        
+    return [self.client sendAsynchronousRequest:@selector(deleteObjectRequest:) object:object sender:self successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {        
         if (successHandler) {
             successHandler();        
         }
@@ -116,5 +445,246 @@
     
 }
 
+#pragma mark - Batch Operations
+
+- (RSOperation *)deleteObjects:(NSArray *)objects success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    NSMutableArray *paths = [[NSMutableArray alloc] initWithCapacity:[objects count]];
+    for (RSStorageObject *object in objects) {
+        [paths addObject:$S(@"%@/%@", self.name, object.name)];
+    }
+    
+    RSBulkDelete *bulkDelete = [[RSBulkDelete alloc] initWithClient:self.client paths:paths];
+    return [bulkDelete start:successHandler failure:failureHandler];
+    
+}
+
+- (RSOperation *)deleteAllObjects:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    // each page is deleted while the next one is listed.  the listing continues from the last
+    // name on the previous page, so deleting that page doesn't disturb it.
+    __block NSUInteger activeDeletes = 0;
+    __block BOOL listed = NO;
+    __block BOOL failed = NO;
+    RSOperation *operation = [[RSOperation alloc] initWithClient:self.client];
+    
+    void (^fail)(NSHTTPURLResponse*, NSData*, NSError*) = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        if (!failed) {
+            failed = YES;
+            if (failureHandler) {
+                failureHandler(response, data, error);
+            }
+        }
+    };
+    
+    void (^finish)() = ^{
+        if (listed && activeDeletes == 0 && !failed && successHandler) {
+            successHandler();
+        }
+    };
+    
+    [operation addOperation:[self getAllObjects:^(NSArray *objects, BOOL *stop) {
+        
+        if (failed) {
+            *stop = YES;
+            return;
+        }
+        
+        if ([objects count] > 0) {
+            activeDeletes++;
+            [operation addOperation:[self deleteObjects:objects success:^{
+                activeDeletes--;
+                finish();
+            } failure:fail]];
+        }
+        
+    } success:^{
+        listed = YES;
+        finish();
+    } failure:fail]];
+    
+    return operation;
+    
+}
+
+- (NSURLRequest *)uploadArchiveRequest:(NSString *)path {
+    
+    RSChunkedInputStream *stream = [[RSChunkedInputStream alloc] initWithFileAtPath:path chunkSize:self.client.chunkSize];
+    
+    NSMutableURLRequest *request = [self.client storageRequest:$S(@"/%@", self.name) parameters:[NSDictionary dictionaryWithObject:@"tar" forKey:@"extract-archive"] httpMethod:@"PUT"];
+    [request setValue:@"application/x-tar" forHTTPHeaderField:@"Content-Type"];
+    [request setValue:@"application/json" forHTTPHeaderField:@"Accept"];
+    [request addValue:$S(@"%llu", stream.length) forHTTPHeaderField:@"Content-Length"];
+    [request setHTTPBodyStream:stream];
+    
+    return request;
+    
+}
+
+- (RSOperation *)sendArchive:(NSString *)path success:(void (^)(NSUInteger filesCreated))successHandler unavailable:(void (^)())unavailableHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    BOOL (^receiveResult)(NSHTTPURLResponse*, NSData*) = ^BOOL(NSHTTPURLResponse *response, NSData *data) {
+        
+        id result = [data length] > 0 ? [NSJSONSerialization JSONObjectWithData:data options:0 error:nil] : nil;
+        
+        // without the bulk middleware, the PUT is taken as a container update
+        if (![result isKindOfClass:[NSDictionary class]] || ![result objectForKey:@"Number Files Created"]) {
+            return NO;
+        }
+        
+        NSArray *errors = [result objectForKey:@"Errors"];
+        NSString *status = [result objectForKey:@"Response Status"];
+        
+        if ([errors count] > 0 || (status && ![status hasPrefix:@"2"])) {
+            
+            NSString *description = $S(@"Archive extraction failed: %@ %@", status, [result objectForKey:@"Response Body"]);
+            NSDictionary *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:description, NSLocalizedDescriptionKey, errors, RSBulkErrorsKey, nil];
+            if (failureHandler) {
+                failureHandler(response, data, [[NSError alloc] initWithDomain:RSErrorDomain code:EBULKFAILURE userInfo:userInfo]);
+            }
+            
+        } else if (successHandler) {
+            successHandler([[result objectForKey:@"Number Files Created"] unsignedIntegerValue]);
+        }
+        
+        return YES;
+        
+    };
+    
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        return [self uploadArchiveRequest:path];
+    }];
+    connection.bulk = YES;
+    
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        if (!receiveResult(response, data)) {
+            unavailableHandler();
+        }
+    };
+    
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        
+        if (receiveResult(response, data)) {
+            return;
+        }
+        
+        NSInteger status = [response statusCode];
+        
+        if (status == 400 || status == 404 || status == 405 || status == 501) {
+            unavailableHandler();
+        } else if (failureHandler) {
+            failureHandler(response, data, error);
+        }
+        
+    };
+    
+    RSOperation *operation = [[RSOperation alloc] initWithClient:self.client];
+    [operation addConnection:connection];
+    [self.client sendConnection:connection];
+    
+    return operation;
+    
+}
+
+- (RSOperation *)uploadArchive:(NSString *)path success:(void (^)(NSUInteger filesCreated))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    return [self sendArchive:path success:successHandler unavailable:^{
+        
+        NSError *bulkError = [[NSError alloc] initWithDomain:RSErrorDomain code:EBULKFAILURE userInfo:[NSDictionary dictionaryWithObject:@"Archive extraction is not available" forKey:NSLocalizedDescriptionKey]];
+        if (failureHandler) {
+            failureHandler(nil, nil, bulkError);
+        }
+        
+    } failure:failureHandler];
+    
+}
+
+- (RSOperation *)uploadFiles:(NSDictionary *)files success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    RSOperation *operation = [[RSOperation alloc] initWithClient:self.client];
+    
+    if ([files count] == 0) {
+        if (successHandler) {
+            successHandler();
+        }
+        return operation;
+    }
+    
+    NSString *archivePath = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSProcessInfo processInfo] globallyUniqueString]];
+    RSTarArchive *archive = [[RSTarArchive alloc] initWithPath:archivePath];
+    
+    for (NSString *objectName in files) {
+        
+        if (![archive addFileAtPath:[files objectForKey:objectName] name:objectName]) {
+            
+            [archive close];
+            [[NSFileManager defaultManager] removeItemAtPath:archivePath error:nil];
+            
+            NSString *description = $S(@"Could not read %@", [files objectForKey:objectName]);
+            if (failureHandler) {
+                failureHandler(nil, nil, [[NSError alloc] initWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]]);
+            }
+            return operation;
+            
+        }
+        
+    }
+    
+    [archive close];
+    
+    [operation addOperation:[self sendArchive:archivePath success:^(NSUInteger filesCreated) {
+        
+        [[NSFileManager defaultManager] removeItemAtPath:archivePath error:nil];
+        if (successHandler) {
+            successHandler();
+        }
+        
+    } unavailable:^{
+        
+        // upload the files one at a time instead.  the client limits how many are in flight.
+        [[NSFileManager defaultManager] removeItemAtPath:archivePath error:nil];
+        
+        __block NSUInteger remaining = [files count];
+        __block BOOL failed = NO;
+        
+        for (NSString *objectName in files) {
+            
+            RSStorageObject *object = [[RSStorageObject alloc] init];
+            object.name = objectName;
+            
+            [operation addOperation:[self uploadObject:object fromFile:[files objectForKey:objectName] success:^{
+                if (--remaining == 0 && !failed && successHandler) {
+                    successHandler();
+                }
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                if (!failed) {
+                    failed = YES;
+                    if (failureHandler) {
+                        failureHandler(response, data, error);
+                    }
+                }
+            }]];
+            
+        }
+        
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        
+        [[NSFileManager defaultManager] removeItemAtPath:archivePath error:nil];
+        if (failureHandler) {
+            failureHandler(response, data, error);
+        }
+        
+    }]];
+    
+    return operation;
+    
+}
+
+- (RSOperation *)syncDirectory:(NSString *)path success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    RSDirectorySync *sync = [[RSDirectorySync alloc] initWithContainer:self directory:path];
+    return [sync start:successHandler failure:failureHandler];
+    
+}
 
 @end
@@ -0,0 +1,73 @@
+//
+//  RSContainerBrowser.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSContainer, RSListingIndex, RSOperation;
+
+/** The RSContainerBrowser class browses a container as a tree of pseudo-directories, one level at a time.
+ *
+ *  Object names are split into directories by the delimiter.  Opening a directory lists only the objects
+ *  and pseudo-directories directly under its prefix, with the API's prefix and delimiter parameters, so a
+ *  folder in a container of millions of objects is a single small request.  Children are loaded lazily,
+ *  when a directory is opened.
+ *
+ *  Every level that has been listed is recorded in the browser's index, and opening it again is answered
+ *  from the index without a request until the level is reloaded.  Give the browser an index with a path
+ *  to keep what was listed between launches.
+ */
+@interface RSContainerBrowser : NSObject
+
+/** The container to browse */
+@property (nonatomic, strong, readonly) RSContainer *container;
+
+/** The index of listed objects and directory levels.  Defaults to an index kept in memory only. */
+@property (nonatomic, strong) RSListingIndex *index;
+
+/** The character that separates directories in object names.  Defaults to `/`. */
+@property (nonatomic, strong) NSString *delimiter;
+
+/** Creates a browser.
+ *  @param container The container to browse
+ */
+- (id)initWithContainer:(RSContainer *)container;
+
+/** Returns the prefix for a directory path: the path followed by the delimiter, or an empty string
+ *  for the top level.  A path that already ends with the delimiter is returned as is.
+ *  @param path The directory path, such as `photos/2011`, or nil or an empty string for the top level
+ */
+- (NSString *)prefixForDirectory:(NSString *)path;
+
+/** Returns the children of a directory from the index, or nil if it hasn't been listed.
+ *  @param path The directory path, or nil for the top level
+ */
+- (NSArray *)cachedChildrenOfDirectory:(NSString *)path;
+
+/** Retrieves the objects and pseudo-directories directly under a directory.  Pseudo-directories are
+ *  RSStorageObject objects whose subdirectory property is `YES`.  A directory that is already in the
+ *  index is answered from it without a request.
+ *  @param path The directory path, or nil for the top level
+ *  @param successHandler Executes with the children, sorted by name
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)childrenOfDirectory:(NSString *)path success:(void (^)(NSArray *children))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Lists a directory again even if it is in the index, and updates the index.
+ *  @param path The directory path, or nil for the top level
+ *  @param successHandler Executes with the children, sorted by name
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)reloadDirectory:(NSString *)path success:(void (^)(NSArray *children))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Returns the objects in the index whose names begin with a prefix, without a request.  Only objects
+ *  in directories that have been listed are found.
+ *  @param prefix The prefix
+ *  @param limit The maximum number of objects to return, or 0 for no limit
+ */
+- (NSArray *)indexedObjectsWithPrefix:(NSString *)prefix limit:(NSUInteger)limit;
+
+@end
@@ -0,0 +1,126 @@
+//
+//  RSContainerBrowser.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSContainerBrowser.h"
+#import "RSClient.h"
+
+@interface RSContainerBrowser ()
+
+@property (nonatomic, strong, readwrite) RSContainer *container;
+
+- (NSArray *)adoptObjects:(NSArray *)objects;
+
+@end
+
+@implementation RSContainerBrowser
+
+@synthesize container, index, delimiter;
+
+- (id)initWithContainer:(RSContainer *)aContainer {
+
+    self = [super init];
+    if (self) {
+        self.container = aContainer;
+        self.index = [[RSListingIndex alloc] init];
+        self.delimiter = @"/";
+    }
+    return self;
+
+}
+
+- (NSString *)prefixForDirectory:(NSString *)path {
+
+    if ([path length] == 0 || [path hasSuffix:self.delimiter]) {
+        return path ? path : @"";
+    }
+
+    return [path stringByAppendingString:self.delimiter];
+
+}
+
+- (NSArray *)adoptObjects:(NSArray *)objects {
+
+    // objects read back from a saved index don't know their container yet
+    for (RSStorageObject *object in objects) {
+        if (!object.parent) {
+            object.parent = self.container;
+        }
+    }
+
+    return objects;
+
+}
+
+#pragma mark - Browsing
+
+- (NSArray *)cachedChildrenOfDirectory:(NSString *)path {
+
+    return [self adoptObjects:[self.index childrenOfDirectory:[self prefixForDirectory:path] delimiter:self.delimiter]];
+
+}
+
+- (RSOperation *)childrenOfDirectory:(NSString *)path success:(void (^)(NSArray *children))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+
+    NSArray *children = [self cachedChildrenOfDirectory:path];
+
+    if (!children) {
+        return [self reloadDirectory:path success:successHandler failure:failureHandler];
+    }
+
+    // handlers always execute on the completion queue, even when no request is needed
+    RSOperation *operation = [[RSOperation alloc] initWithClient:self.container.client];
+
+    [self.container.client.completionQueue addOperationWithBlock:^{
+
+        if (operation.isCancelled) {
+            if (failureHandler) {
+                failureHandler(nil, nil, [NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]);
+            }
+        } else if (successHandler) {
+            successHandler(children);
+        }
+
+    }];
+
+    return operation;
+
+}
+
+- (RSOperation *)reloadDirectory:(NSString *)path success:(void (^)(NSArray *children))successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+
+    NSString *prefix = [self prefixForDirectory:path];
+    NSString *listingDelimiter = self.delimiter;
+    NSMutableArray *children = [[NSMutableArray alloc] init];
+
+    NSMutableDictionary *params = [NSMutableDictionary dictionaryWithObject:listingDelimiter forKey:@"delimiter"];
+    if ([prefix length] > 0) {
+        [params setObject:prefix forKey:@"prefix"];
+    }
+
+    return [self.container getAllObjects:params page:^(NSArray *objects, BOOL *stop) {
+
+        [children addObjectsFromArray:objects];
+
+    } success:^{
+
+        [self.index setChildren:children ofDirectory:prefix delimiter:listingDelimiter];
+
+        if (successHandler) {
+            successHandler([self adoptObjects:[self.index childrenOfDirectory:prefix delimiter:listingDelimiter]]);
+        }
+
+    } failure:failureHandler];
+
+}
+
+- (NSArray *)indexedObjectsWithPrefix:(NSString *)prefix limit:(NSUInteger)limit {
+
+    return [self adoptObjects:[self.index objectsWithPrefix:prefix limit:limit]];
+
+}
+
+@end
@@ -0,0 +1,90 @@
+//
+//  RSDirectorySync.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSContainer, RSOperation;
+
+#define kRSDefaultMaxConcurrentUploads 8
+#define kRSDefaultLargeObjectThreshold 5368709120ULL
+
+/** The RSDirectorySync class makes a container mirror a directory on the local filesystem.
+ *
+ *  Each file under the directory becomes an object named after its path relative to the directory.
+ *  A file is uploaded only if no object has its name, the object's size differs, or the object's hash
+ *  differs from the file's MD5.  Objects that have no file are deleted.
+ *
+ *  The MD5 of every file is remembered in hashCachePath along with the file's size and modification
+ *  date, so a file that hasn't changed since the last sync is never read again.  Only files whose
+ *  size matches their object and whose cached MD5 is missing or stale are hashed, on all cores at once.
+ *
+ *  Files larger than largeObjectThreshold are uploaded as segmented large objects.  Their hash in a
+ *  listing is not the MD5 of their content, so they are compared by size and modification date instead.
+ *
+ *  With dryRun set, the sync only works out what it would do: uploadNames, deleteNames, and uploadBytes
+ *  describe the plan, and nothing is sent.
+ */
+@interface RSDirectorySync : NSObject
+
+/** The container to update */
+@property (nonatomic, strong, readonly) RSContainer *container;
+
+/** The local directory to mirror */
+@property (nonatomic, strong, readonly) NSString *directory;
+
+/** If set, the MD5 of each file is cached in this file between syncs.  Defaults to nil. */
+@property (nonatomic, strong) NSString *hashCachePath;
+
+/** Whether objects that have no file in the directory are deleted.  Defaults to `YES`. */
+@property (nonatomic) BOOL deletesRemoteObjects;
+
+/** If `YES`, the plan is worked out but nothing is uploaded or deleted.  Defaults to `NO`. */
+@property (nonatomic) BOOL dryRun;
+
+/** The maximum number of files uploaded at once.  Defaults to `kRSDefaultMaxConcurrentUploads`. */
+@property (nonatomic) NSUInteger maxConcurrentUploads;
+
+/** Files larger than this many bytes are uploaded as segmented large objects.
+ *  Defaults to `kRSDefaultLargeObjectThreshold`, the largest object Cloud Files accepts in one request.
+ */
+@property (nonatomic) unsigned long long largeObjectThreshold;
+
+/** The names of the files that need uploading, once the plan is worked out */
+@property (nonatomic, strong, readonly) NSArray *uploadNames;
+
+/** The names of the objects that need deleting, once the plan is worked out */
+@property (nonatomic, strong, readonly) NSArray *deleteNames;
+
+/** The total size of the files that need uploading, once the plan is worked out */
+@property (nonatomic, readonly) unsigned long long uploadBytes;
+
+/** The number of files that already match their object */
+@property (nonatomic, readonly) NSUInteger unchangedCount;
+
+/** The number of files that had to be read to compute their MD5 */
+@property (nonatomic, readonly) NSUInteger hashedCount;
+
+/** The operation the sync's listing, uploads, and deletes are part of.  Cancelling it stops the sync. */
+@property (nonatomic, strong, readonly) RSOperation *operation;
+
+/** Executes as files are uploaded */
+@property (nonatomic, copy) void (^progressHandler)(unsigned long long bytesSent, unsigned long long totalBytes);
+
+/** Creates a sync.
+ *  @param container The container to update
+ *  @param directory The local directory to mirror
+ */
+- (id)initWithContainer:(RSContainer *)container directory:(NSString *)directory;
+
+/** Compares the directory to the container, and uploads and deletes the difference unless dryRun is set.
+ *  @param successHandler Executes if every file and object was brought up to date, or once the plan is worked out in a dry run
+ *  @param failureHandler Executes if not successful.  If some transfers failed, the error has the code
+ *  `EBULKFAILURE` and lists the failed paths under `RSBulkErrorsKey`.
+ */
+- (RSOperation *)start:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+@end
@@ -0,0 +1,506 @@
+//
+//  RSDirectorySync.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSDirectorySync.h"
+#import "RSClient.h"
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+/** A file found under the directory */
+@interface RSSyncFile : NSObject
+
+@property (nonatomic, strong) NSString *name;
+@property (nonatomic) unsigned long long size;
+@property (nonatomic) NSTimeInterval modificationTime;
+@property (nonatomic, strong) NSString *md5;
+
+@end
+
+@implementation RSSyncFile
+
+@synthesize name, size, modificationTime, md5;
+
+@end
+
+@interface RSDirectorySync ()
+
+@property (nonatomic, strong, readwrite) RSContainer *container;
+@property (nonatomic, strong, readwrite) NSString *directory;
+@property (nonatomic, strong, readwrite) NSArray *uploadNames;
+@property (nonatomic, strong, readwrite) NSArray *deleteNames;
+@property (nonatomic, readwrite) unsigned long long uploadBytes;
+@property (nonatomic, readwrite) NSUInteger unchangedCount;
+@property (nonatomic, readwrite) NSUInteger hashedCount;
+@property (nonatomic, strong, readwrite) RSOperation *operation;
+
+@property (nonatomic, strong) NSDictionary *hashCache;
+@property (nonatomic, strong) NSMutableDictionary *files;
+@property (nonatomic, strong) NSMutableDictionary *unmatchedFiles;
+@property (nonatomic, strong) NSMutableArray *unverifiedFiles;
+@property (nonatomic, strong) NSMutableArray *unverifiedHashes;
+@property (nonatomic, strong) NSMutableArray *uploads;
+@property (nonatomic, strong) NSMutableArray *deletes;
+@property (nonatomic) NSUInteger nextUpload;
+@property (nonatomic) NSUInteger activeUploads;
+@property (nonatomic) unsigned long long bytesSent;
+@property (nonatomic, strong) NSMutableArray *errors;
+@property (nonatomic) BOOL failed;
+@property (nonatomic, copy) void (^successHandler)();
+@property (nonatomic, copy) void (^failureHandler)(NSHTTPURLResponse*, NSData*, NSError*);
+
+- (void)loadHashCache;
+- (void)saveHashCache;
+- (void)scanDirectory;
+- (void)compareObjects:(NSArray *)objects;
+- (void)verifyHashes;
+- (void)planUpload:(RSSyncFile *)file;
+- (void)finishPlan;
+- (void)uploadNextFiles;
+- (void)uploadFile:(RSSyncFile *)file;
+- (void)deleteObjects;
+- (void)finish;
+- (void)failWithResponse:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error;
+
+@end
+
+@implementation RSDirectorySync
+
+@synthesize container, directory, hashCachePath, deletesRemoteObjects, dryRun, maxConcurrentUploads, largeObjectThreshold;
+@synthesize uploadNames, deleteNames, uploadBytes, unchangedCount, hashedCount, operation, progressHandler;
+@synthesize hashCache, files, unmatchedFiles, unverifiedFiles, unverifiedHashes, uploads, deletes;
+@synthesize nextUpload, activeUploads, bytesSent, errors, failed, successHandler, failureHandler;
+
+- (id)initWithContainer:(RSContainer *)aContainer directory:(NSString *)aDirectory {
+
+    self = [super init];
+    if (self) {
+        self.container = aContainer;
+        self.directory = aDirectory;
+        self.deletesRemoteObjects = YES;
+        self.maxConcurrentUploads = kRSDefaultMaxConcurrentUploads;
+        self.largeObjectThreshold = kRSDefaultLargeObjectThreshold;
+        self.operation = [[RSOperation alloc] initWithClient:aContainer.client];
+    }
+    return self;
+
+}
+
+- (RSOperation *)start:(void (^)())aSuccessHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))aFailureHandler {
+
+    self.successHandler = aSuccessHandler;
+    self.failureHandler = aFailureHandler;
+    self.failed = NO;
+    self.files = [[NSMutableDictionary alloc] init];
+    self.unverifiedFiles = [[NSMutableArray alloc] init];
+    self.unverifiedHashes = [[NSMutableArray alloc] init];
+    self.uploads = [[NSMutableArray alloc] init];
+    self.deletes = [[NSMutableArray alloc] init];
+    self.errors = [[NSMutableArray alloc] init];
+    self.uploadBytes = 0;
+    self.unchangedCount = 0;
+    self.hashedCount = 0;
+    self.nextUpload = 0;
+    self.activeUploads = 0;
+    self.bytesSent = 0;
+
+    // a cancelled operation stays cancelled, so starting again needs a new one
+    if (self.operation.isCancelled) {
+        self.operation = [[RSOperation alloc] initWithClient:self.container.client];
+    }
+
+    NSOperationQueue *completionQueue = self.container.client.completionQueue;
+
+    // walking a large tree takes a while, so it happens off the completion queue
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+
+        [self loadHashCache];
+        [self scanDirectory];
+
+        [completionQueue addOperationWithBlock:^{
+
+            self.unmatchedFiles = [self.files mutableCopy];
+
+            [self.operation addOperation:[self.container getAllObjects:^(NSArray *objects, BOOL *stop) {
+                [self compareObjects:objects];
+            } success:^{
+                [self verifyHashes];
+            } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+                [self failWithResponse:response data:data error:error];
+            }]];
+
+        }];
+
+    });
+
+    return self.operation;
+
+}
+
+#pragma mark - Hash Cache
+
+- (void)loadHashCache {
+
+    NSData *data = self.hashCachePath ? [NSData dataWithContentsOfFile:self.hashCachePath] : nil;
+    id cache = data ? [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil] : nil;
+
+    self.hashCache = [cache isKindOfClass:[NSDictionary class]] ? cache : nil;
+
+}
+
+- (void)saveHashCache {
+
+    if (!self.hashCachePath) {
+        return;
+    }
+
+    // each entry is [size, modification time, md5], so a changed file is recognized without reading it
+    NSMutableDictionary *cache = [[NSMutableDictionary alloc] initWithCapacity:[self.files count]];
+
+    for (RSSyncFile *file in [self.files allValues]) {
+        if (file.md5) {
+            NSArray *entry = [NSArray arrayWithObjects:[NSNumber numberWithUnsignedLongLong:file.size], [NSNumber numberWithDouble:file.modificationTime], file.md5, nil];
+            [cache setObject:entry forKey:file.name];
+        }
+    }
+
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:cache format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil];
+    [data writeToFile:self.hashCachePath atomically:YES];
+
+}
+
+#pragma mark - Planning
+
+- (void)scanDirectory {
+
+    NSFileManager *fileManager = [[NSFileManager alloc] init];
+    NSDirectoryEnumerator *enumerator = [fileManager enumeratorAtPath:self.directory];
+    NSString *relativePath = nil;
+
+    while ((relativePath = [enumerator nextObject])) {
+
+        @autoreleasepool {
+
+            NSDictionary *attributes = [enumerator fileAttributes];
+
+            if ([[attributes fileType] isEqualToString:NSFileTypeRegular]) {
+
+                RSSyncFile *file = [[RSSyncFile alloc] init];
+                file.name = relativePath;
+                file.size = [attributes fileSize];
+                file.modificationTime = [[attributes fileModificationDate] timeIntervalSince1970];
+
+                NSArray *cached = [self.hashCache objectForKey:relativePath];
+                if ([cached count] == 3 && [[cached objectAtIndex:0] unsignedLongLongValue] == file.size && [[cached objectAtIndex:1] doubleValue] == file.modificationTime) {
+                    file.md5 = [cached objectAtIndex:2];
+                }
+
+                [self.files setObject:file forKey:relativePath];
+
+            }
+
+        }
+
+    }
+
+    self.hashCache = nil;
+
+}
+
+- (void)compareObjects:(NSArray *)objects {
+
+    for (RSStorageObject *object in objects) {
+
+        RSSyncFile *file = [self.unmatchedFiles objectForKey:object.name];
+
+        if (!file) {
+            // pseudo-directory markers never have a file
+            if (self.deletesRemoteObjects && ![object.content_type isEqualToString:@"application/directory"]) {
+                [self.deletes addObject:object.name];
+            }
+            continue;
+        }
+
+        [self.unmatchedFiles removeObjectForKey:object.name];
+
+        if (file.size != object.bytes) {
+
+            [self planUpload:file];
+
+        } else if (file.size > self.largeObjectThreshold) {
+
+            // a large object's hash belongs to its manifest, not its content
+            NSDate *lastModified = object.last_modified_date;
+            if (lastModified && [lastModified timeIntervalSince1970] >= file.modificationTime) {
+                self.unchangedCount++;
+            } else {
+                [self planUpload:file];
+            }
+
+        } else if (file.md5) {
+
+            if ([file.md5 caseInsensitiveCompare:object.hash] == NSOrderedSame) {
+                self.unchangedCount++;
+            } else {
+                [self planUpload:file];
+            }
+
+        } else {
+
+            [self.unverifiedFiles addObject:file];
+            [self.unverifiedHashes addObject:object.hash ? object.hash : @""];
+
+        }
+
+    }
+
+}
+
+- (void)verifyHashes {
+
+    NSArray *candidates = [self.unverifiedFiles copy];
+    NSArray *hashes = [self.unverifiedHashes copy];
+    NSString *root = self.directory;
+    NSOperationQueue *completionQueue = self.container.client.completionQueue;
+
+    self.unverifiedFiles = nil;
+    self.unverifiedHashes = nil;
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+
+        NSUInteger count = [candidates count];
+        BOOL *matches = calloc(MAX(count, 1), sizeof(BOOL));
+        NSMutableArray *paths = [[NSMutableArray alloc] initWithCapacity:count];
+
+        for (RSSyncFile *file in candidates) {
+            [paths addObject:[root stringByAppendingPathComponent:file.name]];
+        }
+
+        NSDictionary *digests = [RSChecksum MD5sOfFilesAtPaths:paths];
+
+        for (NSUInteger i = 0; i < count; i++) {
+            RSSyncFile *file = [candidates objectAtIndex:i];
+            file.md5 = [digests objectForKey:[paths objectAtIndex:i]];
+            matches[i] = [RSChecksum ETag:[hashes objectAtIndex:i] matchesMD5:file.md5];
+        }
+
+        [completionQueue addOperationWithBlock:^{
+
+            for (NSUInteger i = 0; i < count; i++) {
+                if (matches[i]) {
+                    self.unchangedCount++;
+                } else {
+                    [self planUpload:[candidates objectAtIndex:i]];
+                }
+            }
+            free(matches);
+
+            self.hashedCount = count;
+            [self finishPlan];
+
+        }];
+
+    });
+
+}
+
+- (void)planUpload:(RSSyncFile *)file {
+
+    [self.uploads addObject:file];
+    self.uploadBytes += file.size;
+
+}
+
+- (void)finishPlan {
+
+    // whatever the listing didn't mention is new
+    for (RSSyncFile *file in [self.unmatchedFiles allValues]) {
+        [self planUpload:file];
+    }
+    self.unmatchedFiles = nil;
+
+    NSMutableArray *names = [[NSMutableArray alloc] initWithCapacity:[self.uploads count]];
+    for (RSSyncFile *file in self.uploads) {
+        [names addObject:file.name];
+    }
+    self.uploadNames = names;
+    self.deleteNames = [self.deletes copy];
+
+    if (self.dryRun) {
+        [self finish];
+    } else {
+        [self uploadNextFiles];
+    }
+
+}
+
+#pragma mark - Transfers
+
+- (void)uploadNextFiles {
+
+    if (self.failed) {
+        return;
+    }
+
+    if (self.nextUpload >= [self.uploads count] && self.activeUploads == 0) {
+        [self deleteObjects];
+        return;
+    }
+
+    // the client limits requests in flight too, but this keeps millions of uploads from
+    // waiting in its queue at once
+    while (self.activeUploads < self.maxConcurrentUploads && self.nextUpload < [self.uploads count]) {
+
+        RSSyncFile *file = [self.uploads objectAtIndex:self.nextUpload];
+        self.nextUpload++;
+        self.activeUploads++;
+        [self uploadFile:file];
+
+    }
+
+}
+
+- (void)uploadFile:(RSSyncFile *)file {
+
+    RSStorageObject *object = [[RSStorageObject alloc] init];
+    object.name = file.name;
+
+    NSString *path = [self.directory stringByAppendingPathComponent:file.name];
+    BOOL large = file.size > self.largeObjectThreshold;
+    __block unsigned long long fileBytesSent = 0;
+
+    void (^progress)(unsigned long long, unsigned long long) = ^(unsigned long long sent, unsigned long long totalBytes) {
+
+        // a retried upload starts over from zero
+        self.bytesSent = self.bytesSent - fileBytesSent + sent;
+        fileBytesSent = sent;
+
+        if (self.progressHandler) {
+            self.progressHandler(self.bytesSent, self.uploadBytes);
+        }
+
+    };
+
+    void (^success)() = ^{
+
+        self.activeUploads--;
+        self.bytesSent = self.bytesSent - fileBytesSent + file.size;
+
+        // the ETag of a simple upload is the MD5 of the file, so it doesn't have to be hashed next time
+        if (!large && object.etag) {
+            file.md5 = [object.etag lowercaseString];
+        }
+
+        [self uploadNextFiles];
+
+    };
+
+    void (^failure)(NSHTTPURLResponse*, NSData*, NSError*) = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        self.activeUploads--;
+
+        // the remaining files would all be cancelled too, so they aren't listed as errors
+        if ([[error domain] isEqualToString:NSURLErrorDomain] && [error code] == NSURLErrorCancelled) {
+            [self failWithResponse:response data:data error:error];
+            return;
+        }
+
+        // a 422 means the digest we sent is stale, so don't trust it next time
+        file.md5 = nil;
+
+        NSString *status = response ? $S(@"%ld %@", (long)[response statusCode], [NSHTTPURLResponse localizedStringForStatusCode:[response statusCode]]) : [error localizedDescription];
+        [self.errors addObject:[NSArray arrayWithObjects:$S(@"/%@/%@", self.container.name, file.name), status, nil]];
+
+        [self uploadNextFiles];
+
+    };
+
+    if (large) {
+        [self.operation addOperation:[self.container uploadLargeObject:object fromFile:path progress:progress success:success failure:failure]];
+    } else {
+        [self.operation addOperation:[self.container uploadObject:object fromFile:path md5:file.md5 progress:progress success:success failure:failure]];
+    }
+
+}
+
+- (void)deleteObjects {
+
+    if ([self.deleteNames count] == 0) {
+        [self finish];
+        return;
+    }
+
+    NSMutableArray *paths = [[NSMutableArray alloc] initWithCapacity:[self.deleteNames count]];
+    for (NSString *name in self.deleteNames) {
+        [paths addObject:$S(@"%@/%@", self.container.name, name)];
+    }
+
+    RSBulkDelete *bulkDelete = [[RSBulkDelete alloc] initWithClient:self.container.client paths:paths];
+
+    [self.operation addOperation:[bulkDelete start:^{
+
+        [self finish];
+
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        NSArray *bulkErrors = [[error userInfo] objectForKey:RSBulkErrorsKey];
+
+        if ([error code] == EBULKFAILURE && bulkErrors) {
+            [self.errors addObjectsFromArray:bulkErrors];
+            [self finish];
+        } else {
+            [self failWithResponse:response data:data error:error];
+        }
+
+    }]];
+
+}
+
+#pragma mark - Completion
+
+- (void)finish {
+
+    [self saveHashCache];
+
+    if ([self.errors count] > 0) {
+
+        NSString *description = $S(@"%lu of %lu files and objects could not be synced", (unsigned long)[self.errors count], (unsigned long)([self.uploadNames count] + [self.deleteNames count]));
+        NSDictionary *userInfo = [NSDictionary dictionaryWithObjectsAndKeys:description, NSLocalizedDescriptionKey, [self.errors copy], RSBulkErrorsKey, nil];
+
+        self.failed = YES;
+        if (self.failureHandler) {
+            self.failureHandler(nil, nil, [[NSError alloc] initWithDomain:RSErrorDomain code:EBULKFAILURE userInfo:userInfo]);
+        }
+        return;
+
+    }
+
+    if (self.successHandler) {
+        self.successHandler();
+    }
+
+}
+
+- (void)failWithResponse:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error {
+
+    if (self.failed) {
+        return;
+    }
+    self.failed = YES;
+
+    // stop the uploads still in flight rather than letting them run to completion
+    [self.operation cancel];
+
+    // hashes computed so far are still good
+    [self saveHashCache];
+
+    if (self.failureHandler) {
+        self.failureHandler(response, data, error);
+    }
+
+}
+
+@end
@@ -0,0 +1,46 @@
+//
+//  RSGzip.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kRSDefaultCompressionLevel 6
+
+/** The RSGzip class encodes and decodes data in the gzip format used for `Content-Encoding: gzip`.
+ *
+ *  An instance decodes a gzip stream incrementally, so a compressed download can be decoded as it
+ *  arrives.  The class methods encode and decode data held in memory.  Linking against libz is required.
+ */
+@interface RSGzip : NSObject
+
+/** Decodes the next part of a gzip stream.
+ *  @param data The next bytes of the stream
+ *  @param error Set if the stream is not valid gzip
+ *  @return The decoded bytes, which may be empty, or `nil` if the stream is not valid gzip
+ */
+- (NSData *)decodeData:(NSData *)data error:(NSError **)error;
+
+/** Returns `YES` once the end of the gzip stream has been decoded */
+- (BOOL)finished;
+
+/** Returns data encoded as gzip
+ *  @param data The data to encode
+ *  @param level The compression level, from 1 for fastest to 9 for smallest
+ */
++ (NSData *)gzipData:(NSData *)data level:(int)level;
+
+/** Returns gzip data decoded, or `nil` if it is not valid gzip */
++ (NSData *)gunzipData:(NSData *)data error:(NSError **)error;
+
+/** Returns `YES` if data begins with the gzip magic number */
++ (BOOL)isGzipData:(NSData *)data;
+
+/** Returns `YES` if a content type is in a set of types to compress.  An entry ending in `/` matches
+ *  every type under it, so `text/` matches `text/csv`.  Parameters such as `; charset=utf-8` are ignored.
+ */
++ (BOOL)contentType:(NSString *)contentType matchesTypes:(NSSet *)types;
+
+@end
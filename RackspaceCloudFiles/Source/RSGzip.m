@@ -0,0 +1,143 @@
+//
+//  RSGzip.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSGzip.h"
+#import "RSClient.h"
+#import <zlib.h>
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+#define kRSGzipWindowBits (15 + 16)
+#define kRSGzipBufferSize 65536
+
+@interface RSGzip () {
+    z_stream stream;
+    BOOL initialized;
+    BOOL finished;
+}
+
+@end
+
+@implementation RSGzip
+
+- (void)dealloc {
+
+    if (initialized) {
+        inflateEnd(&stream);
+    }
+
+}
+
+- (NSData *)decodeData:(NSData *)data error:(NSError **)error {
+
+    if (!initialized) {
+        memset(&stream, 0, sizeof(stream));
+        if (inflateInit2(&stream, kRSGzipWindowBits) != Z_OK) {
+            return nil;
+        }
+        initialized = YES;
+    }
+
+    NSMutableData *decoded = [[NSMutableData alloc] initWithCapacity:[data length] * 4];
+    uint8_t buffer[kRSGzipBufferSize];
+
+    stream.next_in = (Bytef *)[data bytes];
+    stream.avail_in = (uInt)[data length];
+
+    // keep going while there's input left, or while a full buffer suggests more output is waiting
+    do {
+
+        stream.next_out = buffer;
+        stream.avail_out = sizeof(buffer);
+
+        int result = inflate(&stream, Z_NO_FLUSH);
+
+        if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+            if (error) {
+                NSString *description = $S(@"Compressed data could not be decoded: %s", stream.msg ? stream.msg : "invalid gzip stream");
+                *error = [NSError errorWithDomain:RSErrorDomain code:EDECOMPRESSIONFAILURE userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]];
+            }
+            return nil;
+        }
+
+        [decoded appendBytes:buffer length:sizeof(buffer) - stream.avail_out];
+        finished = result == Z_STREAM_END;
+
+    } while (!finished && (stream.avail_in > 0 || stream.avail_out == 0));
+
+    return decoded;
+
+}
+
+- (BOOL)finished {
+
+    return finished;
+
+}
+
+#pragma mark - Data
+
++ (NSData *)gzipData:(NSData *)data level:(int)level {
+
+    z_stream zstream;
+    memset(&zstream, 0, sizeof(zstream));
+
+    if (deflateInit2(&zstream, level, Z_DEFLATED, kRSGzipWindowBits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return nil;
+    }
+
+    NSMutableData *encoded = [[NSMutableData alloc] initWithLength:deflateBound(&zstream, (uLong)[data length]) + 32];
+
+    zstream.next_in = (Bytef *)[data bytes];
+    zstream.avail_in = (uInt)[data length];
+    zstream.next_out = [encoded mutableBytes];
+    zstream.avail_out = (uInt)[encoded length];
+
+    int result = deflate(&zstream, Z_FINISH);
+    [encoded setLength:zstream.total_out];
+    deflateEnd(&zstream);
+
+    return result == Z_STREAM_END ? encoded : nil;
+
+}
+
++ (NSData *)gunzipData:(NSData *)data error:(NSError **)error {
+
+    RSGzip *decoder = [[RSGzip alloc] init];
+    return [decoder decodeData:data error:error];
+
+}
+
++ (BOOL)isGzipData:(NSData *)data {
+
+    const uint8_t *bytes = [data bytes];
+    return [data length] >= 2 && bytes[0] == 0x1f && bytes[1] == 0x8b;
+
+}
+
++ (BOOL)contentType:(NSString *)contentType matchesTypes:(NSSet *)types {
+
+    NSString *type = [[[contentType componentsSeparatedByString:@";"] objectAtIndex:0] stringByTrimmingCharactersInSet:[NSCharacterSet whitespaceCharacterSet]];
+
+    if ([type length] == 0) {
+        return NO;
+    }
+
+    type = [type lowercaseString];
+
+    for (NSString *candidate in types) {
+        NSString *lowercase = [candidate lowercaseString];
+        if ([lowercase isEqualToString:type] || ([lowercase hasSuffix:@"/"] && [type hasPrefix:lowercase])) {
+            return YES;
+        }
+    }
+
+    return NO;
+
+}
+
+@end
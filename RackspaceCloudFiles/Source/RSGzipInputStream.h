@@ -0,0 +1,39 @@
+//
+//  RSGzipInputStream.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** The RSGzipInputStream class is an input stream that gzip-encodes another stream as it is read.
+ *
+ *  It is used as the HTTP body stream for compressed uploads.  Each chunk read from the source stream
+ *  is compressed as the connection asks for more, so only one chunk of the file and its compressed
+ *  output are held in memory at a time.  The compressed length isn't known ahead of time, so the body
+ *  is sent with chunked transfer encoding.
+ */
+@interface RSGzipInputStream : NSInputStream
+
+/** The stream being compressed */
+@property (nonatomic, strong, readonly) NSInputStream *sourceStream;
+
+/** The compression level, from 1 for fastest to 9 for smallest */
+@property (nonatomic, readonly) int level;
+
+/** The number of compressed bytes produced so far */
+@property (nonatomic, readonly) unsigned long long bytesProduced;
+
+/** Executes each time a chunk of compressed output is produced, on the thread reading the stream.
+ *  The chunk is only valid for the duration of the call; copy it if you need to keep it.
+ */
+@property (nonatomic, copy) void (^chunkHandler)(NSData *chunk);
+
+/** Creates a stream that compresses another stream.
+ *  @param sourceStream The stream to compress.  It is opened and closed with this stream.
+ *  @param level The compression level, from 1 for fastest to 9 for smallest
+ */
+- (id)initWithStream:(NSInputStream *)sourceStream level:(int)level;
+
+@end
@@ -0,0 +1,219 @@
+//
+//  RSGzipInputStream.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSGzipInputStream.h"
+#import <zlib.h>
+
+#define kRSGzipInputBufferSize 65536
+#define kRSGzipOutputBufferSize 65536
+
+@interface RSGzipInputStream () {
+    z_stream zstream;
+    uint8_t *input;
+    uint8_t *output;
+    NSUInteger outputLength;
+    NSUInteger outputOffset;
+    BOOL sourceFinished;
+    BOOL encoderFinished;
+    NSStreamStatus status;
+    NSError *error;
+    __weak id <NSStreamDelegate> delegate;
+}
+
+@property (nonatomic, strong, readwrite) NSInputStream *sourceStream;
+
+- (BOOL)produceOutput;
+
+@end
+
+@implementation RSGzipInputStream
+
+@synthesize sourceStream, level, bytesProduced, chunkHandler;
+
+- (id)initWithStream:(NSInputStream *)aSourceStream level:(int)aLevel {
+
+    self = [super init];
+    if (self) {
+        self.sourceStream = aSourceStream;
+        level = aLevel;
+        input = malloc(kRSGzipInputBufferSize);
+        output = malloc(kRSGzipOutputBufferSize);
+        status = NSStreamStatusNotOpen;
+    }
+    return self;
+
+}
+
+- (void)dealloc {
+
+    if (status != NSStreamStatusNotOpen) {
+        deflateEnd(&zstream);
+    }
+    free(input);
+    free(output);
+
+}
+
+#pragma mark - Reading
+
+// compressed output is produced a buffer at a time and handed out in as many read:maxLength: calls
+// as the reader needs.  the source is only read when the encoder has consumed everything it was given.
+- (BOOL)produceOutput {
+
+    outputLength = 0;
+    outputOffset = 0;
+
+    while (outputLength == 0 && !encoderFinished) {
+
+        if (zstream.avail_in == 0 && !sourceFinished) {
+
+            NSInteger result = [self.sourceStream read:input maxLength:kRSGzipInputBufferSize];
+
+            if (result < 0) {
+                error = [self.sourceStream streamError];
+                status = NSStreamStatusError;
+                return NO;
+            }
+
+            sourceFinished = result == 0;
+            zstream.next_in = input;
+            zstream.avail_in = (uInt)result;
+
+        }
+
+        zstream.next_out = output;
+        zstream.avail_out = kRSGzipOutputBufferSize;
+
+        int result = deflate(&zstream, sourceFinished ? Z_FINISH : Z_NO_FLUSH);
+
+        if (result == Z_STREAM_ERROR) {
+            status = NSStreamStatusError;
+            return NO;
+        }
+
+        encoderFinished = result == Z_STREAM_END;
+        outputLength = kRSGzipOutputBufferSize - zstream.avail_out;
+
+    }
+
+    if (outputLength == 0) {
+        status = NSStreamStatusAtEnd;
+        return NO;
+    }
+
+    bytesProduced += outputLength;
+
+    if (self.chunkHandler) {
+        self.chunkHandler([NSData dataWithBytesNoCopy:output length:outputLength freeWhenDone:NO]);
+    }
+
+    return YES;
+
+}
+
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)len {
+
+    if (status != NSStreamStatusOpen) {
+        return status == NSStreamStatusError ? -1 : 0;
+    }
+
+    if (outputOffset >= outputLength && ![self produceOutput]) {
+        return status == NSStreamStatusError ? -1 : 0;
+    }
+
+    NSUInteger count = MIN(len, outputLength - outputOffset);
+    memcpy(buffer, output + outputOffset, count);
+    outputOffset += count;
+
+    return count;
+
+}
+
+- (BOOL)getBuffer:(uint8_t **)buffer length:(NSUInteger *)len {
+    return NO;
+}
+
+- (BOOL)hasBytesAvailable {
+    return status == NSStreamStatusOpen;
+}
+
+#pragma mark - NSStream
+
+- (void)open {
+
+    if (status != NSStreamStatusNotOpen) {
+        return;
+    }
+
+    memset(&zstream, 0, sizeof(zstream));
+
+    if (deflateInit2(&zstream, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        status = NSStreamStatusError;
+        return;
+    }
+
+    [self.sourceStream open];
+
+    if ([self.sourceStream streamStatus] == NSStreamStatusError) {
+        error = [self.sourceStream streamError];
+        status = NSStreamStatusError;
+    } else {
+        status = NSStreamStatusOpen;
+    }
+
+}
+
+- (void)close {
+    [self.sourceStream close];
+    status = NSStreamStatusClosed;
+}
+
+- (NSStreamStatus)streamStatus {
+    return status;
+}
+
+- (NSError *)streamError {
+    return error;
+}
+
+- (id <NSStreamDelegate>)delegate {
+    return delegate;
+}
+
+- (void)setDelegate:(id <NSStreamDelegate>)aDelegate {
+    delegate = aDelegate;
+}
+
+- (void)scheduleInRunLoop:(NSRunLoop *)runLoop forMode:(NSString *)mode {
+}
+
+- (void)removeFromRunLoop:(NSRunLoop *)runLoop forMode:(NSString *)mode {
+}
+
+- (id)propertyForKey:(NSString *)key {
+    return nil;
+}
+
+- (BOOL)setProperty:(id)property forKey:(NSString *)key {
+    return NO;
+}
+
+#pragma mark - CFReadStream bridging
+
+// see RSChunkedInputStream.  the source is always readable, so there is nothing to schedule.
+
+- (void)_scheduleInCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode {
+}
+
+- (void)_unscheduleFromCFRunLoop:(CFRunLoopRef)runLoop forMode:(CFStringRef)mode {
+}
+
+- (BOOL)_setCFClientFlags:(CFOptionFlags)flags callback:(CFReadStreamClientCallBack)callback context:(CFStreamClientContext *)context {
+    return NO;
+}
+
+@end
@@ -0,0 +1,110 @@
+//
+//  RSInstrumentation.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSLatencyHistogram;
+
+/** The kinds of request the SDK sends */
+typedef enum {
+    RSOperationTypeAuthenticate,    /* Authentication requests */
+    RSOperationTypeList,            /* Container and object listings */
+    RSOperationTypeHead,            /* Account, container, and object metadata */
+    RSOperationTypeGet,             /* Object downloads */
+    RSOperationTypePut,             /* Uploads, creates, copies, and metadata updates */
+    RSOperationTypeDelete,          /* Object and container deletes */
+    RSOperationTypeCDN,             /* Any request to the CDN management API */
+    RSOperationTypeCount
+} RSOperationType;
+
+/** The RSRequestRecord class describes one attempt at a request */
+@interface RSRequestRecord : NSObject
+
+/** The kind of request */
+@property (nonatomic) RSOperationType operationType;
+
+/** The request that was sent */
+@property (nonatomic, strong) NSURLRequest *request;
+
+/** The HTTP status code, or 0 if no response was received */
+@property (nonatomic) NSInteger statusCode;
+
+/** The transport error, if the request failed without a response */
+@property (nonatomic, strong) NSError *error;
+
+/** When the request was sent */
+@property (nonatomic, strong) NSDate *date;
+
+/** How long the request waited for a free slot, in seconds */
+@property (nonatomic) NSTimeInterval queueWaitTime;
+
+/** How long after it was sent the response headers arrived, in seconds */
+@property (nonatomic) NSTimeInterval timeToFirstByte;
+
+/** How long after it was sent the response finished arriving, in seconds */
+@property (nonatomic) NSTimeInterval latency;
+
+/** How long the success or failure handler took, including parsing, in seconds */
+@property (nonatomic) NSTimeInterval handlerTime;
+
+/** The number of body bytes sent */
+@property (nonatomic) unsigned long long bytesSent;
+
+/** The number of body bytes received */
+@property (nonatomic) unsigned long long bytesReceived;
+
+/** The number of times the request had already been retried */
+@property (nonatomic) NSUInteger retryCount;
+
+/** `YES` if the response came from the metadata cache without a request */
+@property (nonatomic) BOOL fromCache;
+
+@end
+
+/** The RSInstrumentation class collects timing and traffic statistics for every request a client sends.
+ *
+ *  Set a RSClient's instrumentation property to start collecting.  Each attempt at a request produces
+ *  a RSRequestRecord, which is passed to the recordHandler if one is set and added to per-operation
+ *  latency histograms.  The histograms separate time spent waiting for a free request slot, waiting for
+ *  the server, and running your handlers, so a slow operation can be traced to the network, the
+ *  authentication round trip, or client-side parsing.
+ */
+@interface RSInstrumentation : NSObject
+
+/** If set, executes with every record.  Executes on the client's completionQueue, so it should return quickly. */
+@property (nonatomic, copy) void (^recordHandler)(RSRequestRecord *record);
+
+/** Adds a record to the statistics and passes it to the recordHandler */
+- (void)recordRequest:(RSRequestRecord *)record;
+
+/** Returns the total latency histogram for an operation type */
+- (RSLatencyHistogram *)latencyHistogramForOperationType:(RSOperationType)operationType;
+
+/** Returns the queue wait histogram for an operation type */
+- (RSLatencyHistogram *)queueWaitHistogramForOperationType:(RSOperationType)operationType;
+
+/** Returns the time to first byte histogram for an operation type */
+- (RSLatencyHistogram *)timeToFirstByteHistogramForOperationType:(RSOperationType)operationType;
+
+/** Returns the handler time histogram for an operation type */
+- (RSLatencyHistogram *)handlerTimeHistogramForOperationType:(RSOperationType)operationType;
+
+/** Returns the statistics for every operation type that has been recorded, keyed by operation name,
+ *  in a dictionary that can be serialized as JSON.
+ */
+- (NSDictionary *)snapshot;
+
+/** Returns the snapshot serialized as JSON */
+- (NSData *)snapshotJSONData;
+
+/** Discards every recorded statistic */
+- (void)reset;
+
+/** Returns the name used for an operation type in snapshots, for example `list` */
++ (NSString *)nameForOperationType:(RSOperationType)operationType;
+
+@end
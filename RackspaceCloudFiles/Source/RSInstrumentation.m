@@ -0,0 +1,208 @@
+//
+//  RSInstrumentation.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSInstrumentation.h"
+#import "RSLatencyHistogram.h"
+#import <libkern/OSAtomic.h>
+
+@implementation RSRequestRecord
+
+@synthesize operationType, request, statusCode, error, date, queueWaitTime, timeToFirstByte, latency, handlerTime;
+@synthesize bytesSent, bytesReceived, retryCount, fromCache;
+
+@end
+
+@interface RSInstrumentation () {
+    volatile int64_t requestCounts[RSOperationTypeCount];
+    volatile int64_t failureCounts[RSOperationTypeCount];
+    volatile int64_t retryCounts[RSOperationTypeCount];
+    volatile int64_t cacheCounts[RSOperationTypeCount];
+    volatile int64_t bytesSentCounts[RSOperationTypeCount];
+    volatile int64_t bytesReceivedCounts[RSOperationTypeCount];
+}
+
+@property (nonatomic, strong) NSArray *latencyHistograms;
+@property (nonatomic, strong) NSArray *queueWaitHistograms;
+@property (nonatomic, strong) NSArray *timeToFirstByteHistograms;
+@property (nonatomic, strong) NSArray *handlerTimeHistograms;
+
+- (NSArray *)histograms;
+
+@end
+
+@implementation RSInstrumentation
+
+@synthesize recordHandler, latencyHistograms, queueWaitHistograms, timeToFirstByteHistograms, handlerTimeHistograms;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.latencyHistograms = [self histograms];
+        self.queueWaitHistograms = [self histograms];
+        self.timeToFirstByteHistograms = [self histograms];
+        self.handlerTimeHistograms = [self histograms];
+    }
+    return self;
+
+}
+
+- (NSArray *)histograms {
+
+    // created up front so recording never has to lock to add one
+    NSMutableArray *histograms = [[NSMutableArray alloc] initWithCapacity:RSOperationTypeCount];
+    for (NSUInteger i = 0; i < RSOperationTypeCount; i++) {
+        [histograms addObject:[[RSLatencyHistogram alloc] init]];
+    }
+    return histograms;
+
+}
+
++ (NSString *)nameForOperationType:(RSOperationType)operationType {
+
+    switch (operationType) {
+        case RSOperationTypeAuthenticate:
+            return @"auth";
+        case RSOperationTypeList:
+            return @"list";
+        case RSOperationTypeHead:
+            return @"head";
+        case RSOperationTypeGet:
+            return @"get";
+        case RSOperationTypePut:
+            return @"put";
+        case RSOperationTypeDelete:
+            return @"delete";
+        case RSOperationTypeCDN:
+            return @"cdn";
+        default:
+            return @"unknown";
+    }
+
+}
+
+#pragma mark - Recording
+
+- (void)recordRequest:(RSRequestRecord *)record {
+
+    RSOperationType type = record.operationType;
+
+    if (type < RSOperationTypeCount) {
+
+        OSAtomicIncrement64(&requestCounts[type]);
+        OSAtomicAdd64((int64_t)record.bytesSent, &bytesSentCounts[type]);
+        OSAtomicAdd64((int64_t)record.bytesReceived, &bytesReceivedCounts[type]);
+
+        if (record.error || record.statusCode >= 400) {
+            OSAtomicIncrement64(&failureCounts[type]);
+        }
+
+        if (record.retryCount > 0) {
+            OSAtomicIncrement64(&retryCounts[type]);
+        }
+
+        if (record.fromCache) {
+            OSAtomicIncrement64(&cacheCounts[type]);
+        } else {
+            // a cached answer would pull the network percentiles down
+            [[self.queueWaitHistograms objectAtIndex:type] recordValue:record.queueWaitTime];
+            [[self.timeToFirstByteHistograms objectAtIndex:type] recordValue:record.timeToFirstByte];
+            [[self.latencyHistograms objectAtIndex:type] recordValue:record.latency];
+        }
+
+        [[self.handlerTimeHistograms objectAtIndex:type] recordValue:record.handlerTime];
+
+    }
+
+    if (self.recordHandler) {
+        self.recordHandler(record);
+    }
+
+}
+
+- (RSLatencyHistogram *)latencyHistogramForOperationType:(RSOperationType)operationType {
+
+    return operationType < RSOperationTypeCount ? [self.latencyHistograms objectAtIndex:operationType] : nil;
+
+}
+
+- (RSLatencyHistogram *)queueWaitHistogramForOperationType:(RSOperationType)operationType {
+
+    return operationType < RSOperationTypeCount ? [self.queueWaitHistograms objectAtIndex:operationType] : nil;
+
+}
+
+- (RSLatencyHistogram *)timeToFirstByteHistogramForOperationType:(RSOperationType)operationType {
+
+    return operationType < RSOperationTypeCount ? [self.timeToFirstByteHistograms objectAtIndex:operationType] : nil;
+
+}
+
+- (RSLatencyHistogram *)handlerTimeHistogramForOperationType:(RSOperationType)operationType {
+
+    return operationType < RSOperationTypeCount ? [self.handlerTimeHistograms objectAtIndex:operationType] : nil;
+
+}
+
+#pragma mark - Snapshots
+
+- (NSDictionary *)snapshot {
+
+    NSMutableDictionary *snapshot = [[NSMutableDictionary alloc] init];
+
+    for (NSUInteger type = 0; type < RSOperationTypeCount; type++) {
+
+        if (requestCounts[type] == 0) {
+            continue;
+        }
+
+        NSDictionary *statistics = [NSDictionary dictionaryWithObjectsAndKeys:
+                                    [NSNumber numberWithLongLong:requestCounts[type]], @"requests",
+                                    [NSNumber numberWithLongLong:failureCounts[type]], @"failures",
+                                    [NSNumber numberWithLongLong:retryCounts[type]], @"retries",
+                                    [NSNumber numberWithLongLong:cacheCounts[type]], @"cached",
+                                    [NSNumber numberWithLongLong:bytesSentCounts[type]], @"bytesSent",
+                                    [NSNumber numberWithLongLong:bytesReceivedCounts[type]], @"bytesReceived",
+                                    [[self.queueWaitHistograms objectAtIndex:type] snapshot], @"queueWait",
+                                    [[self.timeToFirstByteHistograms objectAtIndex:type] snapshot], @"timeToFirstByte",
+                                    [[self.latencyHistograms objectAtIndex:type] snapshot], @"latency",
+                                    [[self.handlerTimeHistograms objectAtIndex:type] snapshot], @"handlerTime",
+                                    nil];
+
+        [snapshot setObject:statistics forKey:[RSInstrumentation nameForOperationType:type]];
+
+    }
+
+    return snapshot;
+
+}
+
+- (NSData *)snapshotJSONData {
+
+    return [NSJSONSerialization dataWithJSONObject:[self snapshot] options:0 error:nil];
+
+}
+
+- (void)reset {
+
+    for (NSUInteger type = 0; type < RSOperationTypeCount; type++) {
+        requestCounts[type] = 0;
+        failureCounts[type] = 0;
+        retryCounts[type] = 0;
+        cacheCounts[type] = 0;
+        bytesSentCounts[type] = 0;
+        bytesReceivedCounts[type] = 0;
+    }
+    OSMemoryBarrier();
+
+    for (NSArray *histograms in [NSArray arrayWithObjects:self.latencyHistograms, self.queueWaitHistograms, self.timeToFirstByteHistograms, self.handlerTimeHistograms, nil]) {
+        [histograms makeObjectsPerformSelector:@selector(reset)];
+    }
+
+}
+
+@end
@@ -0,0 +1,45 @@
+//
+//  RSLatencyHistogram.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kRSLatencyHistogramBucketCount 128
+
+/** The RSLatencyHistogram class counts durations in logarithmic buckets so percentiles can be read at any time.
+ *
+ *  Bucket boundaries grow by a factor of 2^(1/4) from one microsecond up to about 70 minutes, so a
+ *  percentile is accurate to within about 19%.  Recording is lock-free: each value is a single atomic
+ *  increment, so many threads can record while another reads.
+ */
+@interface RSLatencyHistogram : NSObject
+
+/** The number of values recorded */
+@property (nonatomic, readonly) unsigned long long count;
+
+/** The mean of the values recorded, in seconds */
+@property (nonatomic, readonly) NSTimeInterval mean;
+
+/** The largest value recorded, in seconds */
+@property (nonatomic, readonly) NSTimeInterval max;
+
+/** Records a duration.
+ *  @param value The duration in seconds
+ */
+- (void)recordValue:(NSTimeInterval)value;
+
+/** Returns the duration that the given fraction of the recorded values are at or below, in seconds.
+ *  @param percentile A fraction between 0 and 1, for example 0.95
+ */
+- (NSTimeInterval)valueAtPercentile:(double)percentile;
+
+/** Returns the count, mean, max, p50, p95, and p99 in a dictionary that can be serialized as JSON */
+- (NSDictionary *)snapshot;
+
+/** Discards every recorded value */
+- (void)reset;
+
+@end
@@ -0,0 +1,121 @@
+//
+//  RSLatencyHistogram.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSLatencyHistogram.h"
+#import <libkern/OSAtomic.h>
+
+#define kRSBucketsPerDoubling 4
+
+@interface RSLatencyHistogram () {
+    volatile int64_t buckets[kRSLatencyHistogramBucketCount];
+    volatile int64_t totalCount;
+    volatile int64_t totalMicroseconds;
+    volatile int64_t maxMicroseconds;
+}
+
+@end
+
+@implementation RSLatencyHistogram
+
+- (void)recordValue:(NSTimeInterval)value {
+
+    int64_t microseconds = (int64_t)(MAX(value, 0) * 1000000);
+
+    // bucket i holds values from 2^(i/4) up to 2^((i+1)/4) microseconds
+    NSInteger bucket = microseconds > 1 ? (NSInteger)floor(log2((double)microseconds) * kRSBucketsPerDoubling) : 0;
+    bucket = MIN(MAX(bucket, 0), kRSLatencyHistogramBucketCount - 1);
+
+    OSAtomicIncrement64(&buckets[bucket]);
+    OSAtomicAdd64(microseconds, &totalMicroseconds);
+    OSAtomicIncrement64Barrier(&totalCount);
+
+    int64_t currentMax = maxMicroseconds;
+    while (microseconds > currentMax && !OSAtomicCompareAndSwap64Barrier(currentMax, microseconds, &maxMicroseconds)) {
+        currentMax = maxMicroseconds;
+    }
+
+}
+
+- (unsigned long long)count {
+
+    return (unsigned long long)totalCount;
+
+}
+
+- (NSTimeInterval)mean {
+
+    int64_t currentCount = totalCount;
+    return currentCount > 0 ? (double)totalMicroseconds / currentCount / 1000000 : 0;
+
+}
+
+- (NSTimeInterval)max {
+
+    return (double)maxMicroseconds / 1000000;
+
+}
+
+- (NSTimeInterval)valueAtPercentile:(double)percentile {
+
+    // the buckets are read without a lock, so they're summed first rather than trusting totalCount
+    int64_t counts[kRSLatencyHistogramBucketCount];
+    int64_t total = 0;
+
+    for (NSUInteger i = 0; i < kRSLatencyHistogramBucketCount; i++) {
+        counts[i] = buckets[i];
+        total += counts[i];
+    }
+
+    if (total == 0) {
+        return 0;
+    }
+
+    int64_t target = (int64_t)ceil(MIN(MAX(percentile, 0), 1) * total);
+    int64_t seen = 0;
+
+    for (NSUInteger i = 0; i < kRSLatencyHistogramBucketCount; i++) {
+
+        seen += counts[i];
+
+        if (seen >= target && counts[i] > 0) {
+            // report the bucket's upper bound, but never more than the largest value seen
+            double upperBound = pow(2, (double)(i + 1) / kRSBucketsPerDoubling);
+            return MIN(upperBound, (double)maxMicroseconds) / 1000000;
+        }
+
+    }
+
+    return [self max];
+
+}
+
+- (NSDictionary *)snapshot {
+
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+            [NSNumber numberWithUnsignedLongLong:[self count]], @"count",
+            [NSNumber numberWithDouble:[self mean]], @"mean",
+            [NSNumber numberWithDouble:[self max]], @"max",
+            [NSNumber numberWithDouble:[self valueAtPercentile:0.50]], @"p50",
+            [NSNumber numberWithDouble:[self valueAtPercentile:0.95]], @"p95",
+            [NSNumber numberWithDouble:[self valueAtPercentile:0.99]], @"p99",
+            nil];
+
+}
+
+- (void)reset {
+
+    for (NSUInteger i = 0; i < kRSLatencyHistogramBucketCount; i++) {
+        buckets[i] = 0;
+    }
+    totalCount = 0;
+    totalMicroseconds = 0;
+    maxMicroseconds = 0;
+    OSMemoryBarrier();
+
+}
+
+@end
@@ -0,0 +1,47 @@
+//
+//  RSListingDecoder.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** Fields that appear in container, CDN container, and object listings */
+typedef enum {
+    RSListingKeyUnknown,
+    RSListingKeyName,
+    RSListingKeyCount,
+    RSListingKeyBytes,
+    RSListingKeyHash,
+    RSListingKeyContentType,
+    RSListingKeyLastModified,
+    RSListingKeySubdir,
+    RSListingKeyCDNEnabled,
+    RSListingKeyTTL,
+    RSListingKeyLogRetention,
+    RSListingKeyCDNURI,
+    RSListingKeyCDNSSLURI,
+    RSListingKeyCDNStreamingURI
+} RSListingKey;
+
+/** The RSListingDecoder class turns the JSON body of a listing request into model objects.
+ *
+ *  The decoder scans the JSON once and sets each known field directly on a new model object with
+ *  `-[RSModel setListingString:forKey:]` or `-[RSModel setListingNumber:forKey:]`.  No intermediate
+ *  dictionaries are built, strings are only created for known fields, and unknown fields are skipped.
+ *  Anything that isn't a flat array of objects is handed to NSJSONSerialization instead, and its entries
+ *  go through the same setters.  A known field whose number doesn't fit in 64 bits makes the listing
+ *  invalid rather than wrapping.
+ */
+@interface RSListingDecoder : NSObject
+
+/** Returns the model objects for a listing.  An empty body is an empty listing.
+ *  @param data The listing's JSON body
+ *  @param modelClass The RSModel subclass to create for each entry
+ *  @param parent The parent of the created objects
+ *  @param error Set if the body is not a valid listing
+ */
++ (NSArray *)decodeListing:(NSData *)data modelClass:(Class)modelClass parent:(id)parent error:(NSError **)error;
+
+@end
@@ -0,0 +1,541 @@
+//
+//  RSListingDecoder.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSListingDecoder.h"
+#import "RSModel.h"
+
+typedef struct {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint8_t *buffer;
+    size_t bufferCapacity;
+} RSListingScanner;
+
+#pragma mark - Scanning
+
+static void RSScanWhitespace(RSListingScanner *s) {
+
+    while (s->p < s->end && (*s->p == ' ' || *s->p == '\n' || *s->p == '\r' || *s->p == '\t')) {
+        s->p++;
+    }
+
+}
+
+static int RSScanByte(RSListingScanner *s, uint8_t c) {
+
+    RSScanWhitespace(s);
+    if (s->p < s->end && *s->p == c) {
+        s->p++;
+        return 1;
+    }
+    return 0;
+
+}
+
+static int RSAppendBytes(RSListingScanner *s, size_t *length, const uint8_t *bytes, size_t count) {
+
+    if (*length + count > s->bufferCapacity) {
+        size_t capacity = MAX(s->bufferCapacity * 2, *length + count + 64);
+        uint8_t *buffer = realloc(s->buffer, capacity);
+        if (!buffer) {
+            return 0;
+        }
+        s->buffer = buffer;
+        s->bufferCapacity = capacity;
+    }
+
+    memcpy(s->buffer + *length, bytes, count);
+    *length += count;
+    return 1;
+
+}
+
+static int RSScanHex4(const uint8_t *p, unsigned *value) {
+
+    *value = 0;
+    for (int i = 0; i < 4; i++) {
+        uint8_t c = p[i];
+        *value <<= 4;
+        if (c >= '0' && c <= '9') {
+            *value |= c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            *value |= c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            *value |= c - 'A' + 10;
+        } else {
+            return 0;
+        }
+    }
+    return 1;
+
+}
+
+static size_t RSEncodeUTF8(unsigned code, uint8_t *utf8) {
+
+    if (code < 0x80) {
+        utf8[0] = code;
+        return 1;
+    } else if (code < 0x800) {
+        utf8[0] = 0xC0 | (code >> 6);
+        utf8[1] = 0x80 | (code & 0x3F);
+        return 2;
+    } else if (code < 0x10000) {
+        utf8[0] = 0xE0 | (code >> 12);
+        utf8[1] = 0x80 | ((code >> 6) & 0x3F);
+        utf8[2] = 0x80 | (code & 0x3F);
+        return 3;
+    }
+    utf8[0] = 0xF0 | (code >> 18);
+    utf8[1] = 0x80 | ((code >> 12) & 0x3F);
+    utf8[2] = 0x80 | ((code >> 6) & 0x3F);
+    utf8[3] = 0x80 | (code & 0x3F);
+    return 4;
+
+}
+
+// scans a string.  bytes and length describe its unescaped contents, which point into the
+// input unless the string had escapes, in which case they point into the scanner's buffer
+// and are only valid until the next string is scanned.
+static int RSScanString(RSListingScanner *s, const uint8_t **bytes, size_t *length) {
+
+    RSScanWhitespace(s);
+    if (s->p >= s->end || *s->p != '"') {
+        return 0;
+    }
+    s->p++;
+
+    const uint8_t *start = s->p;
+    while (s->p < s->end && *s->p != '"' && *s->p != '\\') {
+        s->p++;
+    }
+    if (s->p >= s->end) {
+        return 0;
+    }
+
+    if (*s->p == '"') {
+        *bytes = start;
+        *length = s->p - start;
+        s->p++;
+        return 1;
+    }
+
+    size_t used = 0;
+    if (!RSAppendBytes(s, &used, start, s->p - start)) {
+        return 0;
+    }
+
+    while (s->p < s->end && *s->p != '"') {
+
+        if (*s->p != '\\') {
+            const uint8_t *run = s->p;
+            while (s->p < s->end && *s->p != '"' && *s->p != '\\') {
+                s->p++;
+            }
+            if (!RSAppendBytes(s, &used, run, s->p - run)) {
+                return 0;
+            }
+            continue;
+        }
+
+        s->p++;
+        if (s->p >= s->end) {
+            return 0;
+        }
+
+        uint8_t utf8[4];
+        size_t count = 1;
+
+        switch (*s->p++) {
+            case '"': utf8[0] = '"'; break;
+            case '\\': utf8[0] = '\\'; break;
+            case '/': utf8[0] = '/'; break;
+            case 'b': utf8[0] = '\b'; break;
+            case 'f': utf8[0] = '\f'; break;
+            case 'n': utf8[0] = '\n'; break;
+            case 'r': utf8[0] = '\r'; break;
+            case 't': utf8[0] = '\t'; break;
+            case 'u': {
+
+                unsigned code;
+                if (s->end - s->p < 4 || !RSScanHex4(s->p, &code)) {
+                    return 0;
+                }
+                s->p += 4;
+
+                // characters outside the basic multilingual plane arrive as surrogate pairs
+                if (code >= 0xD800 && code <= 0xDBFF) {
+                    unsigned low;
+                    if (s->end - s->p >= 6 && s->p[0] == '\\' && s->p[1] == 'u' && RSScanHex4(s->p + 2, &low) && low >= 0xDC00 && low <= 0xDFFF) {
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                        s->p += 6;
+                    } else {
+                        code = 0xFFFD;
+                    }
+                } else if (code >= 0xDC00 && code <= 0xDFFF) {
+                    code = 0xFFFD;
+                }
+
+                count = RSEncodeUTF8(code, utf8);
+                break;
+
+            }
+            default:
+                return 0;
+        }
+
+        if (!RSAppendBytes(s, &used, utf8, count)) {
+            return 0;
+        }
+
+    }
+
+    if (s->p >= s->end) {
+        return 0;
+    }
+    s->p++;
+
+    *bytes = s->buffer;
+    *length = used;
+    return 1;
+
+}
+
+static int RSIsNumberByte(uint8_t c) {
+
+    return (c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.' || c == 'e' || c == 'E';
+
+}
+
+static int RSScanNumber(RSListingScanner *s, long long *value) {
+
+    RSScanWhitespace(s);
+
+    const uint8_t *start = s->p;
+    int negative = 0;
+    long long result = 0;
+
+    if (s->p < s->end && *s->p == '-') {
+        negative = 1;
+        s->p++;
+    }
+
+    if (s->p >= s->end || *s->p < '0' || *s->p > '9') {
+        return 0;
+    }
+
+    int overflow = 0;
+
+    while (s->p < s->end && *s->p >= '0' && *s->p <= '9') {
+        int digit = *s->p - '0';
+        if (result > (LLONG_MAX - digit) / 10) {
+            overflow = 1;
+        } else {
+            result = result * 10 + digit;
+        }
+        s->p++;
+    }
+
+    // listings only contain integers, but fractions and exponents are truncated rather than rejected
+    if (s->p < s->end && (*s->p == '.' || *s->p == 'e' || *s->p == 'E')) {
+
+        while (s->p < s->end && RSIsNumberByte(*s->p)) {
+            s->p++;
+        }
+
+        char text[64];
+        size_t length = MIN((size_t)(s->p - start), sizeof(text) - 1);
+        memcpy(text, start, length);
+        text[length] = '\0';
+
+        double number = strtod(text, NULL);
+        if (!(number > -9223372036854775808.0 && number < 9223372036854775808.0)) {
+            return 0;
+        }
+        *value = (long long)number;
+        return 1;
+
+    }
+
+    // a value that doesn't fit is rejected rather than wrapped
+    if (overflow) {
+        return 0;
+    }
+
+    *value = negative ? -result : result;
+    return 1;
+
+}
+
+static int RSScanLiteral(RSListingScanner *s, const char *literal) {
+
+    size_t length = strlen(literal);
+
+    RSScanWhitespace(s);
+    if ((size_t)(s->end - s->p) < length || memcmp(s->p, literal, length) != 0) {
+        return 0;
+    }
+    s->p += length;
+    return 1;
+
+}
+
+static int RSSkipValue(RSListingScanner *s, int depth) {
+
+    const uint8_t *bytes;
+    size_t length;
+    long long number;
+
+    RSScanWhitespace(s);
+    if (s->p >= s->end || depth > 32) {
+        return 0;
+    }
+
+    switch (*s->p) {
+        case '"':
+            return RSScanString(s, &bytes, &length);
+        case '{':
+        case '[': {
+
+            uint8_t close = *s->p == '{' ? '}' : ']';
+            s->p++;
+
+            if (RSScanByte(s, close)) {
+                return 1;
+            }
+
+            do {
+                if (close == '}' && (!RSScanString(s, &bytes, &length) || !RSScanByte(s, ':'))) {
+                    return 0;
+                }
+                if (!RSSkipValue(s, depth + 1)) {
+                    return 0;
+                }
+            } while (RSScanByte(s, ','));
+
+            return RSScanByte(s, close);
+
+        }
+        case 't':
+            return RSScanLiteral(s, "true");
+        case 'f':
+            return RSScanLiteral(s, "false");
+        case 'n':
+            return RSScanLiteral(s, "null");
+        default:
+            return RSScanNumber(s, &number);
+    }
+
+}
+
+static RSListingKey RSListingKeyForBytes(const uint8_t *bytes, size_t length) {
+
+#define RSMatchKey(literal, key) if (length == sizeof(literal) - 1 && memcmp(bytes, literal, length) == 0) return key
+
+    RSMatchKey("name", RSListingKeyName);
+    RSMatchKey("bytes", RSListingKeyBytes);
+    RSMatchKey("hash", RSListingKeyHash);
+    RSMatchKey("content_type", RSListingKeyContentType);
+    RSMatchKey("last_modified", RSListingKeyLastModified);
+    RSMatchKey("count", RSListingKeyCount);
+    RSMatchKey("subdir", RSListingKeySubdir);
+    RSMatchKey("cdn_enabled", RSListingKeyCDNEnabled);
+    RSMatchKey("ttl", RSListingKeyTTL);
+    RSMatchKey("log_retention", RSListingKeyLogRetention);
+    RSMatchKey("cdn_uri", RSListingKeyCDNURI);
+    RSMatchKey("cdn_ssl_uri", RSListingKeyCDNSSLURI);
+    RSMatchKey("cdn_streaming_uri", RSListingKeyCDNStreamingURI);
+
+#undef RSMatchKey
+
+    return RSListingKeyUnknown;
+
+}
+
+#pragma mark - Decoding
+
+static BOOL RSDecodeJSONListing(NSArray *json, Class modelClass, id parent, NSMutableArray *objects) {
+
+    // entries NSJSONSerialization parsed go through the same setters as scanned ones, so both
+    // paths convert and range-check fields alike
+    for (NSDictionary *entry in json) {
+
+        if (![entry isKindOfClass:[NSDictionary class]]) {
+            return NO;
+        }
+
+        RSModel *object = [[modelClass alloc] init];
+        object.parent = parent;
+
+        for (NSString *name in entry) {
+
+            NSData *nameData = [name dataUsingEncoding:NSUTF8StringEncoding];
+            RSListingKey key = RSListingKeyForBytes([nameData bytes], [nameData length]);
+            id value = [entry objectForKey:name];
+
+            if (key == RSListingKeyUnknown) {
+                continue;
+            }
+
+            if ([value isKindOfClass:[NSString class]]) {
+                [object setListingString:value forKey:key];
+            } else if ([value isKindOfClass:[NSNumber class]]) {
+                double number = [value doubleValue];
+                if (!(number > -9223372036854775808.0 && number < 9223372036854775808.0)) {
+                    return NO;
+                }
+                [object setListingNumber:[value longLongValue] forKey:key];
+            }
+
+        }
+
+        [objects addObject:object];
+
+    }
+
+    return YES;
+
+}
+
+static BOOL RSDecodeListing(RSListingScanner *s, Class modelClass, id parent, NSMutableArray *objects) {
+
+    const uint8_t *bytes;
+    size_t length;
+    long long number;
+
+    if (!RSScanByte(s, '[')) {
+        return NO;
+    }
+
+    if (!RSScanByte(s, ']')) {
+
+        do {
+
+            if (!RSScanByte(s, '{')) {
+                return NO;
+            }
+
+            RSModel *object = [[modelClass alloc] init];
+            object.parent = parent;
+
+            if (!RSScanByte(s, '}')) {
+
+                do {
+
+                    if (!RSScanString(s, &bytes, &length) || !RSScanByte(s, ':')) {
+                        return NO;
+                    }
+
+                    RSListingKey key = RSListingKeyForBytes(bytes, length);
+                    RSScanWhitespace(s);
+
+                    if (key == RSListingKeyUnknown || s->p >= s->end) {
+
+                        if (!RSSkipValue(s, 0)) {
+                            return NO;
+                        }
+
+                    } else if (*s->p == '"') {
+
+                        if (!RSScanString(s, &bytes, &length)) {
+                            return NO;
+                        }
+                        NSString *value = [[NSString alloc] initWithBytes:bytes length:length encoding:NSUTF8StringEncoding];
+                        if (value) {
+                            [object setListingString:value forKey:key];
+                        }
+
+                    } else if (*s->p == '-' || (*s->p >= '0' && *s->p <= '9')) {
+
+                        if (!RSScanNumber(s, &number)) {
+                            return NO;
+                        }
+                        [object setListingNumber:number forKey:key];
+
+                    } else if (*s->p == 't' || *s->p == 'f') {
+
+                        BOOL value = *s->p == 't';
+                        if (!RSScanLiteral(s, value ? "true" : "false")) {
+                            return NO;
+                        }
+                        [object setListingNumber:value forKey:key];
+
+                    } else if (!RSSkipValue(s, 0)) {
+                        return NO;
+                    }
+
+                } while (RSScanByte(s, ','));
+
+                if (!RSScanByte(s, '}')) {
+                    return NO;
+                }
+
+            }
+
+            [objects addObject:object];
+
+        } while (RSScanByte(s, ','));
+
+        if (!RSScanByte(s, ']')) {
+            return NO;
+        }
+
+    }
+
+    RSScanWhitespace(s);
+    return s->p == s->end;
+
+}
+
+@implementation RSListingDecoder
+
++ (NSArray *)decodeListing:(NSData *)data modelClass:(Class)modelClass parent:(id)parent error:(NSError **)error {
+
+    // an empty container or account returns 204 No Content
+    if ([data length] == 0) {
+        return [NSArray array];
+    }
+
+    RSListingScanner scanner;
+    scanner.p = [data bytes];
+    scanner.end = scanner.p + [data length];
+    scanner.buffer = NULL;
+    scanner.bufferCapacity = 0;
+
+    NSMutableArray *objects = [[NSMutableArray alloc] init];
+    BOOL decoded = RSDecodeListing(&scanner, modelClass, parent, objects);
+    free(scanner.buffer);
+
+    if (decoded) {
+        return objects;
+    }
+
+    // let NSJSONSerialization sort out anything unusual, and report the error if it's invalid
+    NSError *jsonError = nil;
+    id json = [NSJSONSerialization JSONObjectWithData:data options:NSJSONReadingAllowFragments error:&jsonError];
+
+    if ([json isKindOfClass:[NSArray class]]) {
+
+        [objects removeAllObjects];
+
+        if (RSDecodeJSONListing(json, modelClass, parent, objects)) {
+            return objects;
+        }
+
+    }
+
+    if (!jsonError) {
+        jsonError = [[NSError alloc] initWithDomain:NSCocoaErrorDomain code:NSPropertyListReadCorruptError userInfo:[NSDictionary dictionaryWithObject:@"The listing is not an array of entries with valid fields" forKey:NSLocalizedDescriptionKey]];
+    }
+
+    if (error) {
+        *error = jsonError;
+    }
+    return nil;
+
+}
+
+@end
@@ -0,0 +1,92 @@
+//
+//  RSListingIndex.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSStorageObject;
+
+/** The RSListingIndex class keeps the object names of a container that have already been listed,
+ *  sorted the way the API sorts them, so prefix and range queries are answered without a request.
+ *
+ *  Besides individual objects, the index records the levels of pseudo-directories that were listed
+ *  with a delimiter, so a directory that has been opened once can be shown again from the index.
+ *  The index only knows what it has been given; it can't tell whether a name it doesn't have exists.
+ *
+ *  An index created with a path is read from it and written back with save.  Otherwise it is kept
+ *  in memory only.  All methods can be called from any thread.
+ */
+@interface RSListingIndex : NSObject
+
+/** The file the index is read from and saved to, or nil if it is only kept in memory */
+@property (nonatomic, strong, readonly) NSString *path;
+
+/** The number of objects in the index */
+@property (readonly) NSUInteger count;
+
+/** Creates an index that is kept in memory only */
+- (id)init;
+
+/** Creates an index that is read from and saved to a file.  If the file can't be read, the index starts empty.
+ *  @param path The file for the index
+ */
+- (id)initWithPath:(NSString *)path;
+
+/** Adds objects to the index, replacing any with the same names.  Pseudo-directory entries are ignored.
+ *  @param objects The RSStorageObject objects to add
+ */
+- (void)addObjects:(NSArray *)objects;
+
+/** Removes an object from the index, and forgets the directory levels it was listed in.
+ *  @param name The name of the object
+ */
+- (void)removeObjectNamed:(NSString *)name;
+
+/** Removes every object and directory level */
+- (void)removeAllObjects;
+
+/** Returns the object with the given name, or nil if it isn't in the index */
+- (RSStorageObject *)objectNamed:(NSString *)name;
+
+/** Returns the objects whose names begin with a prefix, in order.
+ *  @param prefix The prefix, or nil for every object
+ *  @param limit The maximum number of objects to return, or 0 for no limit
+ */
+- (NSArray *)objectsWithPrefix:(NSString *)prefix limit:(NSUInteger)limit;
+
+/** Returns the objects whose names are greater than marker and less than endMarker, in order, as the
+ *  API's marker and end_marker parameters do.
+ *  @param marker The name the objects come after, or nil to start at the first object
+ *  @param endMarker The name the objects come before, or nil to continue to the last object
+ *  @param limit The maximum number of objects to return, or 0 for no limit
+ */
+- (NSArray *)objectsAfterMarker:(NSString *)marker endMarker:(NSString *)endMarker limit:(NSUInteger)limit;
+
+/** Records the complete listing of one pseudo-directory level, and adds its objects to the index.
+ *  @param children The objects and pseudo-directories directly under the prefix, as listed with the delimiter
+ *  @param prefix The directory's prefix, ending with the delimiter, or an empty string for the top level
+ *  @param delimiter The delimiter the level was listed with
+ */
+- (void)setChildren:(NSArray *)children ofDirectory:(NSString *)prefix delimiter:(NSString *)delimiter;
+
+/** Returns the recorded objects and pseudo-directories directly under a prefix, in order, or nil if
+ *  that level hasn't been recorded.
+ *  @param prefix The directory's prefix, ending with the delimiter, or an empty string for the top level
+ *  @param delimiter The delimiter the level was listed with
+ */
+- (NSArray *)childrenOfDirectory:(NSString *)prefix delimiter:(NSString *)delimiter;
+
+/** Forgets a recorded directory level, so it is listed again the next time it is opened.  The
+ *  objects in it stay in the index.
+ *  @param prefix The directory's prefix
+ *  @param delimiter The delimiter the level was listed with
+ */
+- (void)removeDirectory:(NSString *)prefix delimiter:(NSString *)delimiter;
+
+/** Writes the index to its path.  Returns `NO` if it has no path or couldn't be written. */
+- (BOOL)save;
+
+@end
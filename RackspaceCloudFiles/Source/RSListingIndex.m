@@ -0,0 +1,495 @@
+//
+//  RSListingIndex.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSListingIndex.h"
+#import "RSClient.h"
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+// below this many new names, inserting each one is cheaper than merging the whole index
+#define kRSListingIndexInsertThreshold 8
+
+// the API sorts names by their UTF-8 bytes.  comparing UTF-16 code units gives the same order
+// except between characters above U+FFFF and those from U+E000 to U+FFFF, which is close enough
+// for an index that only answers from what the API has already returned.
+static NSComparisonResult RSCompareNames(NSString *a, NSString *b) {
+    return [a compare:b options:NSLiteralSearch];
+}
+
+// a saved object is an array of its name, size, hash, content type, and last modified date
+static BOOL RSIsValidRecord(id record) {
+
+    if (![record isKindOfClass:[NSArray class]] || [record count] != 5 || ![[record objectAtIndex:1] isKindOfClass:[NSNumber class]]) {
+        return NO;
+    }
+
+    for (NSUInteger i = 0; i < 5; i++) {
+        if (i != 1 && ![[record objectAtIndex:i] isKindOfClass:[NSString class]]) {
+            return NO;
+        }
+    }
+
+    return [[record objectAtIndex:0] length] > 0;
+
+}
+
+static BOOL RSIsArrayOfStrings(id array) {
+
+    if (![array isKindOfClass:[NSArray class]]) {
+        return NO;
+    }
+
+    for (id item in array) {
+        if (![item isKindOfClass:[NSString class]]) {
+            return NO;
+        }
+    }
+
+    return YES;
+
+}
+
+@interface RSListingIndex ()
+
+@property (nonatomic, strong, readwrite) NSString *path;
+
+@property (nonatomic, strong) NSMutableArray *names;
+@property (nonatomic, strong) NSMutableDictionary *objects;
+@property (nonatomic, strong) NSMutableDictionary *directories;
+
+- (NSUInteger)indexOfName:(NSString *)name options:(NSBinarySearchingOptions)options;
+- (void)insertNames:(NSArray *)newNames;
+- (RSStorageObject *)indexedObject:(RSStorageObject *)object;
+- (NSString *)keyForDirectory:(NSString *)prefix delimiter:(NSString *)delimiter;
+- (BOOL)load;
+
+@end
+
+@implementation RSListingIndex
+
+@synthesize path, names, objects, directories;
+
+- (id)init {
+
+    return [self initWithPath:nil];
+
+}
+
+- (id)initWithPath:(NSString *)aPath {
+
+    self = [super init];
+    if (self) {
+        self.path = aPath;
+        self.names = [[NSMutableArray alloc] init];
+        self.objects = [[NSMutableDictionary alloc] init];
+        self.directories = [[NSMutableDictionary alloc] init];
+        if (aPath) {
+            [self load];
+        }
+    }
+    return self;
+
+}
+
+- (NSUInteger)count {
+
+    @synchronized (self) {
+        return [self.names count];
+    }
+
+}
+
+#pragma mark - Sorted Names
+
+- (NSUInteger)indexOfName:(NSString *)name options:(NSBinarySearchingOptions)options {
+
+    return [self.names indexOfObject:name inSortedRange:NSMakeRange(0, [self.names count]) options:options | NSBinarySearchingInsertionIndex usingComparator:^NSComparisonResult(id a, id b) {
+        return RSCompareNames(a, b);
+    }];
+
+}
+
+- (void)insertNames:(NSArray *)newNames {
+
+    // pages of a listing arrive in order, so most names go on the end
+    if ([self.names count] == 0 || RSCompareNames([newNames objectAtIndex:0], [self.names lastObject]) == NSOrderedDescending) {
+        [self.names addObjectsFromArray:newNames];
+        return;
+    }
+
+    if ([newNames count] < kRSListingIndexInsertThreshold) {
+        for (NSString *name in newNames) {
+            [self.names insertObject:name atIndex:[self indexOfName:name options:NSBinarySearchingFirstEqual]];
+        }
+        return;
+    }
+
+    NSMutableArray *merged = [[NSMutableArray alloc] initWithCapacity:[self.names count] + [newNames count]];
+    NSUInteger i = 0;
+    NSUInteger j = 0;
+
+    while (i < [self.names count] && j < [newNames count]) {
+        if (RSCompareNames([self.names objectAtIndex:i], [newNames objectAtIndex:j]) == NSOrderedAscending) {
+            [merged addObject:[self.names objectAtIndex:i++]];
+        } else {
+            [merged addObject:[newNames objectAtIndex:j++]];
+        }
+    }
+
+    [merged addObjectsFromArray:[self.names subarrayWithRange:NSMakeRange(i, [self.names count] - i)]];
+    [merged addObjectsFromArray:[newNames subarrayWithRange:NSMakeRange(j, [newNames count] - j)]];
+    self.names = merged;
+
+}
+
+- (RSStorageObject *)indexedObject:(RSStorageObject *)object {
+
+    // only what a listing returns is kept, so an index of millions of names stays small
+    RSStorageObject *indexed = [[RSStorageObject alloc] init];
+    indexed.name = object.name;
+    indexed.hash = object.hash;
+    indexed.bytes = object.bytes;
+    indexed.subdirectory = object.subdirectory;
+    indexed.content_type = object.content_type;
+    indexed.last_modified = object.last_modified;
+    indexed.parent = object.parent;
+    indexed.metadata = nil;
+    return indexed;
+
+}
+
+#pragma mark - Objects
+
+- (void)addObjects:(NSArray *)someObjects {
+
+    NSMutableDictionary *added = [[NSMutableDictionary alloc] initWithCapacity:[someObjects count]];
+
+    for (RSStorageObject *object in someObjects) {
+        if (!object.subdirectory && object.name) {
+            [added setObject:[self indexedObject:object] forKey:object.name];
+        }
+    }
+
+    @synchronized (self) {
+
+        NSMutableArray *newNames = [[NSMutableArray alloc] init];
+
+        for (NSString *name in added) {
+            if (![self.objects objectForKey:name]) {
+                [newNames addObject:name];
+            }
+        }
+
+        [self.objects addEntriesFromDictionary:added];
+
+        if ([newNames count] > 0) {
+            [newNames sortUsingComparator:^NSComparisonResult(id a, id b) {
+                return RSCompareNames(a, b);
+            }];
+            [self insertNames:newNames];
+        }
+
+    }
+
+}
+
+- (void)removeObjectNamed:(NSString *)name {
+
+    @synchronized (self) {
+
+        if ([self.objects objectForKey:name]) {
+            [self.objects removeObjectForKey:name];
+            [self.names removeObjectAtIndex:[self indexOfName:name options:NSBinarySearchingFirstEqual]];
+        }
+
+        // a level that listed the object is no longer complete
+        for (NSString *key in [self.directories allKeys]) {
+
+            NSDictionary *directory = [self.directories objectForKey:key];
+            NSString *prefix = [directory objectForKey:@"prefix"];
+            NSString *delimiter = [directory objectForKey:@"delimiter"];
+
+            if ([name hasPrefix:prefix] && [[name substringFromIndex:[prefix length]] rangeOfString:delimiter].location == NSNotFound) {
+                [self.directories removeObjectForKey:key];
+            }
+
+        }
+
+    }
+
+}
+
+- (void)removeAllObjects {
+
+    @synchronized (self) {
+        [self.names removeAllObjects];
+        [self.objects removeAllObjects];
+        [self.directories removeAllObjects];
+    }
+
+}
+
+- (RSStorageObject *)objectNamed:(NSString *)name {
+
+    @synchronized (self) {
+        return [self.objects objectForKey:name];
+    }
+
+}
+
+- (NSArray *)objectsWithPrefix:(NSString *)prefix limit:(NSUInteger)limit {
+
+    NSMutableArray *found = [[NSMutableArray alloc] init];
+
+    @synchronized (self) {
+
+        NSUInteger start = [prefix length] > 0 ? [self indexOfName:prefix options:NSBinarySearchingFirstEqual] : 0;
+
+        for (NSUInteger i = start; i < [self.names count] && (limit == 0 || [found count] < limit); i++) {
+
+            NSString *name = [self.names objectAtIndex:i];
+            if ([prefix length] > 0 && ![name hasPrefix:prefix]) {
+                break;
+            }
+            [found addObject:[self.objects objectForKey:name]];
+
+        }
+
+    }
+
+    return found;
+
+}
+
+- (NSArray *)objectsAfterMarker:(NSString *)marker endMarker:(NSString *)endMarker limit:(NSUInteger)limit {
+
+    NSMutableArray *found = [[NSMutableArray alloc] init];
+
+    @synchronized (self) {
+
+        NSUInteger start = marker ? [self indexOfName:marker options:NSBinarySearchingLastEqual] : 0;
+        NSUInteger end = endMarker ? [self indexOfName:endMarker options:NSBinarySearchingFirstEqual] : [self.names count];
+
+        for (NSUInteger i = start; i < end && (limit == 0 || [found count] < limit); i++) {
+            [found addObject:[self.objects objectForKey:[self.names objectAtIndex:i]]];
+        }
+
+    }
+
+    return found;
+
+}
+
+#pragma mark - Directories
+
+- (NSString *)keyForDirectory:(NSString *)prefix delimiter:(NSString *)delimiter {
+
+    return $S(@"%@\n%@", delimiter, prefix);
+
+}
+
+- (void)setChildren:(NSArray *)children ofDirectory:(NSString *)prefix delimiter:(NSString *)delimiter {
+
+    [self addObjects:children];
+
+    NSMutableArray *objectNames = [[NSMutableArray alloc] init];
+    NSMutableArray *subdirectories = [[NSMutableArray alloc] init];
+
+    for (RSStorageObject *child in children) {
+        if (child.subdirectory) {
+            [subdirectories addObject:[self indexedObject:child]];
+        } else if (child.name) {
+            [objectNames addObject:child.name];
+        }
+    }
+
+    NSDictionary *directory = [NSDictionary dictionaryWithObjectsAndKeys:
+                               prefix, @"prefix",
+                               delimiter, @"delimiter",
+                               objectNames, @"objects",
+                               subdirectories, @"subdirectories",
+                               nil];
+
+    @synchronized (self) {
+        [self.directories setObject:directory forKey:[self keyForDirectory:prefix delimiter:delimiter]];
+    }
+
+}
+
+- (NSArray *)childrenOfDirectory:(NSString *)prefix delimiter:(NSString *)delimiter {
+
+    NSMutableArray *children = [[NSMutableArray alloc] init];
+
+    @synchronized (self) {
+
+        NSDictionary *directory = [self.directories objectForKey:[self keyForDirectory:prefix delimiter:delimiter]];
+
+        if (!directory) {
+            return nil;
+        }
+
+        for (NSString *name in [directory objectForKey:@"objects"]) {
+            [children addObject:[self.objects objectForKey:name]];
+        }
+        [children addObjectsFromArray:[directory objectForKey:@"subdirectories"]];
+
+    }
+
+    [children sortUsingComparator:^NSComparisonResult(id a, id b) {
+        return RSCompareNames([a name], [b name]);
+    }];
+
+    return children;
+
+}
+
+- (void)removeDirectory:(NSString *)prefix delimiter:(NSString *)delimiter {
+
+    @synchronized (self) {
+        [self.directories removeObjectForKey:[self keyForDirectory:prefix delimiter:delimiter]];
+    }
+
+}
+
+#pragma mark - Persistence
+
+// the file is a binary property list.  each object is an array of its name, size, hash, content
+// type, and last modified date, which is much smaller than archiving the objects themselves.
+
+- (BOOL)load {
+
+    NSData *data = [NSData dataWithContentsOfFile:self.path];
+    NSDictionary *plist = data ? [NSPropertyListSerialization propertyListWithData:data options:NSPropertyListImmutable format:NULL error:nil] : nil;
+
+    if (![plist isKindOfClass:[NSDictionary class]] || [[plist objectForKey:@"version"] integerValue] != 1) {
+        return NO;
+    }
+
+    // a file that was damaged or written by something else is discarded whole, so a bad record
+    // can't leave the index half loaded
+    NSArray *records = [plist objectForKey:@"objects"];
+    NSArray *savedDirectories = [plist objectForKey:@"directories"];
+
+    if (![records isKindOfClass:[NSArray class]] || (savedDirectories && ![savedDirectories isKindOfClass:[NSArray class]])) {
+        return NO;
+    }
+
+    NSMutableArray *loadedNames = [[NSMutableArray alloc] initWithCapacity:[records count]];
+    NSMutableDictionary *loadedObjects = [[NSMutableDictionary alloc] initWithCapacity:[records count]];
+    NSMutableDictionary *loadedDirectories = [[NSMutableDictionary alloc] initWithCapacity:[savedDirectories count]];
+
+    // records were saved in order
+    for (NSArray *record in records) {
+
+        if (!RSIsValidRecord(record) || ([loadedNames count] > 0 && RSCompareNames([loadedNames lastObject], [record objectAtIndex:0]) != NSOrderedAscending)) {
+            return NO;
+        }
+
+        RSStorageObject *object = [[RSStorageObject alloc] init];
+        object.name = [record objectAtIndex:0];
+        object.bytes = [[record objectAtIndex:1] unsignedLongLongValue];
+        object.hash = [[record objectAtIndex:2] length] > 0 ? [record objectAtIndex:2] : nil;
+        object.content_type = [[record objectAtIndex:3] length] > 0 ? [record objectAtIndex:3] : nil;
+        object.last_modified = [[record objectAtIndex:4] length] > 0 ? [record objectAtIndex:4] : nil;
+
+        [loadedNames addObject:object.name];
+        [loadedObjects setObject:object forKey:object.name];
+
+    }
+
+    for (NSDictionary *saved in savedDirectories) {
+
+        if (![saved isKindOfClass:[NSDictionary class]]) {
+            return NO;
+        }
+
+        NSString *prefix = [saved objectForKey:@"prefix"];
+        NSString *delimiter = [saved objectForKey:@"delimiter"];
+        NSArray *objectNames = [saved objectForKey:@"objects"];
+        NSArray *subdirectoryNames = [saved objectForKey:@"subdirectories"];
+
+        if (![prefix isKindOfClass:[NSString class]] || ![delimiter isKindOfClass:[NSString class]] || !RSIsArrayOfStrings(objectNames) || !RSIsArrayOfStrings(subdirectoryNames)) {
+            return NO;
+        }
+
+        NSMutableArray *subdirectories = [[NSMutableArray alloc] initWithCapacity:[subdirectoryNames count]];
+        for (NSString *name in subdirectoryNames) {
+            RSStorageObject *subdirectory = [[RSStorageObject alloc] init];
+            subdirectory.name = name;
+            subdirectory.subdirectory = YES;
+            [subdirectories addObject:subdirectory];
+        }
+
+        NSDictionary *directory = [NSDictionary dictionaryWithObjectsAndKeys:
+                                   prefix, @"prefix",
+                                   delimiter, @"delimiter",
+                                   objectNames, @"objects",
+                                   subdirectories, @"subdirectories",
+                                   nil];
+        [loadedDirectories setObject:directory forKey:[self keyForDirectory:prefix delimiter:delimiter]];
+
+    }
+
+    @synchronized (self) {
+        self.names = loadedNames;
+        self.objects = loadedObjects;
+        self.directories = loadedDirectories;
+    }
+
+    return YES;
+
+}
+
+- (BOOL)save {
+
+    if (!self.path) {
+        return NO;
+    }
+
+    NSMutableArray *records = nil;
+    NSMutableArray *savedDirectories = nil;
+
+    @synchronized (self) {
+
+        records = [[NSMutableArray alloc] initWithCapacity:[self.names count]];
+
+        for (NSString *name in self.names) {
+            RSStorageObject *object = [self.objects objectForKey:name];
+            [records addObject:[NSArray arrayWithObjects:
+                                object.name,
+                                [NSNumber numberWithUnsignedLongLong:object.bytes],
+                                object.hash ? object.hash : @"",
+                                object.content_type ? object.content_type : @"",
+                                object.last_modified ? object.last_modified : @"",
+                                nil]];
+        }
+
+        savedDirectories = [[NSMutableArray alloc] initWithCapacity:[self.directories count]];
+
+        for (NSDictionary *directory in [self.directories allValues]) {
+            [savedDirectories addObject:[NSDictionary dictionaryWithObjectsAndKeys:
+                                         [directory objectForKey:@"prefix"], @"prefix",
+                                         [directory objectForKey:@"delimiter"], @"delimiter",
+                                         [directory objectForKey:@"objects"], @"objects",
+                                         [[directory objectForKey:@"subdirectories"] valueForKey:@"name"], @"subdirectories",
+                                         nil]];
+        }
+
+    }
+
+    NSDictionary *plist = [NSDictionary dictionaryWithObjectsAndKeys:
+                           [NSNumber numberWithInteger:1], @"version",
+                           records, @"objects",
+                           savedDirectories, @"directories",
+                           nil];
+
+    NSData *data = [NSPropertyListSerialization dataWithPropertyList:plist format:NSPropertyListBinaryFormat_v1_0 options:0 error:nil];
+    return [data writeToFile:self.path atomically:YES];
+
+}
+
+@end
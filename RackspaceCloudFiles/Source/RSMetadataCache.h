@@ -0,0 +1,110 @@
+//
+//  RSMetadataCache.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kRSDefaultMetadataCacheCapacity 1000
+
+/** A response kept by RSMetadataCache */
+@interface RSMetadataCacheEntry : NSObject <NSCoding>
+
+/** The request's method and URL */
+@property (nonatomic, strong) NSString *key;
+
+/** The URL of the account, container, or object the response describes, without the query */
+@property (nonatomic, strong) NSString *resource;
+
+/** The cached response */
+@property (nonatomic, strong) NSHTTPURLResponse *response;
+
+/** The cached response body */
+@property (nonatomic, strong) NSData *data;
+
+/** When the response was received or last revalidated */
+@property (nonatomic, strong) NSDate *date;
+
+@end
+
+/** The RSMetadataCache class keeps responses to metadata (HEAD) and listing requests so they
+ *  don't have to be retrieved again.
+ *
+ *  Set a cache on RSClient's metadataCache property to use it.  Cached responses are kept in memory,
+ *  with the least recently used ones discarded once there are more than capacity, and optionally on
+ *  disk, where they last between launches.
+ *
+ *  A cached response younger than maxAge is returned without a request.  Otherwise the request is sent
+ *  with If-None-Match and If-Modified-Since headers from the cached response's ETag and Last-Modified,
+ *  and if the API answers 304 Not Modified, the cached response is returned in its place.
+ *
+ *  Any PUT, POST, COPY, or DELETE sent through the client removes the cached responses for the
+ *  affected account, container, and objects.
+ */
+@interface RSMetadataCache : NSObject
+
+/** The maximum number of responses kept in memory.  Defaults to `kRSDefaultMetadataCacheCapacity`. */
+@property (nonatomic) NSUInteger capacity;
+
+/** How long a cached response is used without revalidating it, in seconds.  Defaults to 0, which
+ *  revalidates every time.
+ */
+@property (nonatomic) NSTimeInterval maxAge;
+
+/** The directory cached responses are written to, or nil if they are only kept in memory */
+@property (nonatomic, strong, readonly) NSString *diskPath;
+
+/** The number of requests answered from the cache without contacting the API */
+@property (readonly) NSUInteger hitCount;
+
+/** The number of requests the API answered with 304 Not Modified */
+@property (readonly) NSUInteger revalidationCount;
+
+/** The number of cacheable requests the API answered with a full response */
+@property (readonly) NSUInteger missCount;
+
+/** The number of response body bytes that did not have to be downloaded */
+@property (readonly) unsigned long long bytesSaved;
+
+/** Creates a cache that keeps responses in memory only */
+- (id)init;
+
+/** Creates a cache that also writes responses to a directory on the local filesystem.
+ *  @param diskPath The directory for cached responses.  It is created if needed.
+ */
+- (id)initWithDiskPath:(NSString *)diskPath;
+
+/** Returns `YES` if responses to the request can be cached */
+- (BOOL)isCacheableRequest:(NSURLRequest *)request;
+
+/** Returns a cached response to the request that is younger than maxAge, or nil */
+- (RSMetadataCacheEntry *)freshEntryForRequest:(NSURLRequest *)request;
+
+/** Returns the request to send in place of the given one.  Cacheable requests get conditional
+ *  headers, and writes remove the cached responses they affect.
+ *  @param request The request about to be sent
+ */
+- (NSURLRequest *)prepareRequest:(NSURLRequest *)request;
+
+/** Records the response to a request.  Returns the entry to use in place of the response if the
+ *  API answered 304 Not Modified, or nil.
+ *  @param request The request that was sent
+ *  @param response The response
+ *  @param data The response body
+ */
+- (RSMetadataCacheEntry *)entryForRequest:(NSURLRequest *)request response:(NSHTTPURLResponse *)response data:(NSData *)data;
+
+/** Removes the cached responses for a URL, the account and container it belongs to, and anything in it
+ *  @param url The URL of an account, container, or object
+ */
+- (void)invalidateURL:(NSURL *)url;
+
+/** Removes every cached response */
+- (void)removeAllEntries;
+
+/** Sets the statistics back to 0 */
+- (void)resetStatistics;
+
+@end
@@ -0,0 +1,473 @@
+//
+//  RSMetadataCache.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSMetadataCache.h"
+#import <CommonCrypto/CommonDigest.h>
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+@interface RSMetadataCacheEntry ()
+
+// the entries kept in memory form a list from least to most recently used, so using or
+// evicting one doesn't mean searching for it
+@property (nonatomic, weak) RSMetadataCacheEntry *olderEntry;
+@property (nonatomic, weak) RSMetadataCacheEntry *newerEntry;
+
+@end
+
+@implementation RSMetadataCacheEntry
+
+@synthesize key, resource, response, data, date, olderEntry, newerEntry;
+
+- (id)initWithCoder:(NSCoder *)coder {
+
+    self = [super init];
+    if (self) {
+        self.key = [coder decodeObjectForKey:@"key"];
+        self.resource = [coder decodeObjectForKey:@"resource"];
+        self.response = [coder decodeObjectForKey:@"response"];
+        self.data = [coder decodeObjectForKey:@"data"];
+        self.date = [coder decodeObjectForKey:@"date"];
+    }
+    return self;
+
+}
+
+- (void)encodeWithCoder:(NSCoder *)coder {
+
+    [coder encodeObject:self.key forKey:@"key"];
+    [coder encodeObject:self.resource forKey:@"resource"];
+    [coder encodeObject:self.response forKey:@"response"];
+    [coder encodeObject:self.data forKey:@"data"];
+    [coder encodeObject:self.date forKey:@"date"];
+
+}
+
+@end
+
+@interface RSMetadataCache ()
+
+@property (nonatomic, strong, readwrite) NSString *diskPath;
+@property (readwrite) NSUInteger hitCount;
+@property (readwrite) NSUInteger revalidationCount;
+@property (readwrite) NSUInteger missCount;
+@property (readwrite) unsigned long long bytesSaved;
+
+@property (nonatomic, strong) NSMutableDictionary *entries;
+@property (nonatomic, weak) RSMetadataCacheEntry *oldestEntry;
+@property (nonatomic, weak) RSMetadataCacheEntry *newestEntry;
+@property (nonatomic, strong) NSMutableDictionary *diskResources;
+
+- (BOOL)isWriteRequest:(NSURLRequest *)request;
+- (NSString *)keyForRequest:(NSURLRequest *)request;
+- (NSString *)resourceForURL:(NSURL *)url;
+- (NSString *)diskPathForKey:(NSString *)key;
+- (void)loadDiskIndex;
+- (RSMetadataCacheEntry *)entryForKey:(NSString *)key;
+- (void)rememberEntry:(RSMetadataCacheEntry *)entry;
+- (void)unlinkEntry:(RSMetadataCacheEntry *)entry;
+- (void)forgetEntryForKey:(NSString *)key;
+- (void)setEntry:(RSMetadataCacheEntry *)entry;
+- (void)removeEntryForKey:(NSString *)key;
+
+@end
+
+@implementation RSMetadataCache
+
+@synthesize capacity, maxAge, diskPath, hitCount, revalidationCount, missCount, bytesSaved;
+@synthesize entries, oldestEntry, newestEntry, diskResources;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.capacity = kRSDefaultMetadataCacheCapacity;
+        self.entries = [[NSMutableDictionary alloc] init];
+        self.diskResources = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+
+}
+
+- (id)initWithDiskPath:(NSString *)aDiskPath {
+
+    self = [self init];
+    if (self) {
+        self.diskPath = aDiskPath;
+        [[NSFileManager defaultManager] createDirectoryAtPath:aDiskPath withIntermediateDirectories:YES attributes:nil error:nil];
+        [self loadDiskIndex];
+    }
+    return self;
+
+}
+
+#pragma mark - Keys
+
+- (BOOL)isCacheableRequest:(NSURLRequest *)request {
+
+    if ([request valueForHTTPHeaderField:@"Range"]) {
+        return NO;
+    }
+
+    if ([[request HTTPMethod] isEqualToString:@"HEAD"]) {
+        return YES;
+    }
+
+    // object data isn't cached, only listings
+    return [[request HTTPMethod] isEqualToString:@"GET"] && [[[request URL] query] rangeOfString:@"format=json"].location != NSNotFound;
+
+}
+
+- (BOOL)isWriteRequest:(NSURLRequest *)request {
+
+    NSString *method = [request HTTPMethod];
+    return [method isEqualToString:@"PUT"] || [method isEqualToString:@"POST"] || [method isEqualToString:@"COPY"] || [method isEqualToString:@"DELETE"];
+
+}
+
+- (NSString *)keyForRequest:(NSURLRequest *)request {
+
+    return $S(@"%@ %@", [request HTTPMethod], [[request URL] absoluteString]);
+
+}
+
+- (NSString *)resourceForURL:(NSURL *)url {
+
+    NSString *resource = [url absoluteString];
+    NSRange query = [resource rangeOfString:@"?"];
+
+    if (query.location != NSNotFound) {
+        resource = [resource substringToIndex:query.location];
+    }
+
+    while ([resource hasSuffix:@"/"]) {
+        resource = [resource substringToIndex:[resource length] - 1];
+    }
+
+    return resource;
+
+}
+
+#pragma mark - Storage
+
+- (NSString *)diskPathForKey:(NSString *)key {
+
+    const char *utf8 = [key UTF8String];
+    unsigned char digest[CC_MD5_DIGEST_LENGTH];
+    CC_MD5(utf8, (CC_LONG)strlen(utf8), digest);
+
+    NSMutableString *fileName = [[NSMutableString alloc] initWithCapacity:CC_MD5_DIGEST_LENGTH * 2];
+    for (NSUInteger i = 0; i < CC_MD5_DIGEST_LENGTH; i++) {
+        [fileName appendFormat:@"%02x", digest[i]];
+    }
+
+    return [self.diskPath stringByAppendingPathComponent:fileName];
+
+}
+
+- (void)loadDiskIndex {
+
+    // only the keys are kept in memory.  responses are read from disk when they're needed.
+    for (NSString *fileName in [[NSFileManager defaultManager] contentsOfDirectoryAtPath:self.diskPath error:nil]) {
+
+        NSString *path = [self.diskPath stringByAppendingPathComponent:fileName];
+        RSMetadataCacheEntry *entry = nil;
+
+        @try {
+            entry = [NSKeyedUnarchiver unarchiveObjectWithFile:path];
+        } @catch (NSException *exception) {
+            entry = nil;
+        }
+
+        if ([entry isKindOfClass:[RSMetadataCacheEntry class]] && entry.key) {
+            [self.diskResources setObject:entry.resource forKey:entry.key];
+        } else {
+            [[NSFileManager defaultManager] removeItemAtPath:path error:nil];
+        }
+
+    }
+
+}
+
+- (RSMetadataCacheEntry *)entryForKey:(NSString *)key {
+
+    RSMetadataCacheEntry *entry = [self.entries objectForKey:key];
+
+    if (entry) {
+        [self rememberEntry:entry];
+        return entry;
+    }
+
+    if ([self.diskResources objectForKey:key]) {
+
+        @try {
+            entry = [NSKeyedUnarchiver unarchiveObjectWithFile:[self diskPathForKey:key]];
+        } @catch (NSException *exception) {
+            entry = nil;
+        }
+
+        if ([entry isKindOfClass:[RSMetadataCacheEntry class]]) {
+            [self rememberEntry:entry];
+        } else {
+            [self removeEntryForKey:key];
+            entry = nil;
+        }
+
+    }
+
+    return entry;
+
+}
+
+- (void)rememberEntry:(RSMetadataCacheEntry *)entry {
+
+    RSMetadataCacheEntry *existing = [self.entries objectForKey:entry.key];
+    if (existing) {
+        [self unlinkEntry:existing];
+    }
+
+    [self.entries setObject:entry forKey:entry.key];
+
+    entry.olderEntry = self.newestEntry;
+    entry.newerEntry = nil;
+    self.newestEntry.newerEntry = entry;
+    self.newestEntry = entry;
+    if (!self.oldestEntry) {
+        self.oldestEntry = entry;
+    }
+
+    // evicted entries stay on disk
+    while ([self.entries count] > self.capacity && self.oldestEntry) {
+        [self forgetEntryForKey:self.oldestEntry.key];
+    }
+
+}
+
+- (void)unlinkEntry:(RSMetadataCacheEntry *)entry {
+
+    if (entry.olderEntry) {
+        entry.olderEntry.newerEntry = entry.newerEntry;
+    } else if (self.oldestEntry == entry) {
+        self.oldestEntry = entry.newerEntry;
+    }
+
+    if (entry.newerEntry) {
+        entry.newerEntry.olderEntry = entry.olderEntry;
+    } else if (self.newestEntry == entry) {
+        self.newestEntry = entry.olderEntry;
+    }
+
+    entry.olderEntry = nil;
+    entry.newerEntry = nil;
+
+}
+
+- (void)forgetEntryForKey:(NSString *)key {
+
+    RSMetadataCacheEntry *entry = [self.entries objectForKey:key];
+
+    if (entry) {
+        [self unlinkEntry:entry];
+        [self.entries removeObjectForKey:key];
+    }
+
+}
+
+- (void)setEntry:(RSMetadataCacheEntry *)entry {
+
+    [self rememberEntry:entry];
+
+    if (self.diskPath) {
+        [NSKeyedArchiver archiveRootObject:entry toFile:[self diskPathForKey:entry.key]];
+        [self.diskResources setObject:entry.resource forKey:entry.key];
+    }
+
+}
+
+- (void)removeEntryForKey:(NSString *)key {
+
+    [self forgetEntryForKey:key];
+
+    if ([self.diskResources objectForKey:key]) {
+        [[NSFileManager defaultManager] removeItemAtPath:[self diskPathForKey:key] error:nil];
+        [self.diskResources removeObjectForKey:key];
+    }
+
+}
+
+#pragma mark - Requests
+
+- (RSMetadataCacheEntry *)freshEntryForRequest:(NSURLRequest *)request {
+
+    if (self.maxAge <= 0 || ![self isCacheableRequest:request]) {
+        return nil;
+    }
+
+    @synchronized (self) {
+
+        RSMetadataCacheEntry *entry = [self entryForKey:[self keyForRequest:request]];
+
+        if (entry && -[entry.date timeIntervalSinceNow] < self.maxAge) {
+            self.hitCount++;
+            self.bytesSaved += [entry.data length];
+            return entry;
+        }
+
+    }
+
+    return nil;
+
+}
+
+- (NSURLRequest *)prepareRequest:(NSURLRequest *)request {
+
+    if ([self isWriteRequest:request]) {
+        [self invalidateURL:[request URL]];
+        return request;
+    }
+
+    if (![self isCacheableRequest:request]) {
+        return request;
+    }
+
+    RSMetadataCacheEntry *entry = nil;
+
+    @synchronized (self) {
+        entry = [self entryForKey:[self keyForRequest:request]];
+    }
+
+    if (!entry) {
+        return request;
+    }
+
+    NSDictionary *headers = [entry.response allHeaderFields];
+    NSMutableURLRequest *conditionalRequest = [request mutableCopy];
+
+    // the URL loading system must not answer the condition from its own cache
+    [conditionalRequest setCachePolicy:NSURLRequestReloadIgnoringLocalCacheData];
+
+    if ([headers valueForKey:@"ETag"]) {
+        [conditionalRequest setValue:[headers valueForKey:@"ETag"] forHTTPHeaderField:@"If-None-Match"];
+    }
+
+    if ([headers valueForKey:@"Last-Modified"]) {
+        [conditionalRequest setValue:[headers valueForKey:@"Last-Modified"] forHTTPHeaderField:@"If-Modified-Since"];
+    }
+
+    return conditionalRequest;
+
+}
+
+- (RSMetadataCacheEntry *)entryForRequest:(NSURLRequest *)request response:(NSHTTPURLResponse *)response data:(NSData *)data {
+
+    // a read that finished while the write was in flight may have cached the old state,
+    // so writes invalidate again once they finish
+    if ([self isWriteRequest:request]) {
+        [self invalidateURL:[request URL]];
+        return nil;
+    }
+
+    if (![self isCacheableRequest:request]) {
+        return nil;
+    }
+
+    NSString *key = [self keyForRequest:request];
+    NSInteger statusCode = [response statusCode];
+
+    @synchronized (self) {
+
+        if (statusCode == 304) {
+
+            RSMetadataCacheEntry *entry = [self entryForKey:key];
+
+            if (entry) {
+                entry.date = [NSDate date];
+                [self setEntry:entry];
+                self.revalidationCount++;
+                self.bytesSaved += [entry.data length];
+            }
+
+            return entry;
+
+        }
+
+        if (statusCode >= 200 && statusCode <= 299) {
+
+            RSMetadataCacheEntry *entry = [[RSMetadataCacheEntry alloc] init];
+            entry.key = key;
+            entry.resource = [self resourceForURL:[request URL]];
+            entry.response = response;
+            entry.data = [data copy];
+            entry.date = [NSDate date];
+
+            [self setEntry:entry];
+            self.missCount++;
+
+        } else if (statusCode == 404) {
+            [self removeEntryForKey:key];
+        }
+
+    }
+
+    return nil;
+
+}
+
+#pragma mark - Invalidation
+
+- (void)invalidateURL:(NSURL *)url {
+
+    NSString *resource = [self resourceForURL:url];
+    NSString *prefix = [resource stringByAppendingString:@"/"];
+
+    @synchronized (self) {
+
+        NSMutableDictionary *resources = [NSMutableDictionary dictionaryWithDictionary:self.diskResources];
+        for (RSMetadataCacheEntry *entry in [self.entries allValues]) {
+            [resources setObject:entry.resource forKey:entry.key];
+        }
+
+        for (NSString *key in resources) {
+
+            NSString *entryResource = [resources objectForKey:key];
+
+            // the resource itself, anything in it, and the container and account it's in
+            if ([entryResource isEqualToString:resource] || [entryResource hasPrefix:prefix] || [resource hasPrefix:[entryResource stringByAppendingString:@"/"]]) {
+                [self removeEntryForKey:key];
+            }
+
+        }
+
+    }
+
+}
+
+- (void)removeAllEntries {
+
+    @synchronized (self) {
+        for (NSString *key in [self.diskResources allKeys]) {
+            [self removeEntryForKey:key];
+        }
+        for (NSString *key in [self.entries allKeys]) {
+            [self forgetEntryForKey:key];
+        }
+    }
+
+}
+
+- (void)resetStatistics {
+
+    @synchronized (self) {
+        self.hitCount = 0;
+        self.revalidationCount = 0;
+        self.missCount = 0;
+        self.bytesSaved = 0;
+    }
+
+}
+
+@end
@@ -7,6 +7,7 @@
 //
 
 #import <Foundation/Foundation.h>
+#import "RSListingDecoder.h"
 
 @class RSClient;
 
@@ -18,5 +19,10 @@
 - (RSClient *)client;
 - (id)initWithJSONDictionary:(NSDictionary *)jsonDict;
 + (NSArray *)arrayFromJSONDictionaries:(NSArray *)jsonDictionaries parent:(id)parent;
++ (NSArray *)arrayFromJSONData:(NSData *)data parent:(id)parent error:(NSError **)error;
+
+// listing fields are set with these instead of KVC.  subclasses set the fields they know and ignore the rest.
+- (void)setListingString:(NSString *)value forKey:(RSListingKey)key;
+- (void)setListingNumber:(long long)value forKey:(RSListingKey)key;
 
 @end
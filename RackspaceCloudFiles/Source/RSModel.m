@@ -47,6 +47,24 @@
     
 }
 
++ (NSArray *)arrayFromJSONData:(NSData *)data parent:(id)parent error:(NSError **)error {
+    
+    return [RSListingDecoder decodeListing:data modelClass:[self class] parent:parent error:error];
+    
+}
+
+- (void)setListingString:(NSString *)value forKey:(RSListingKey)key {
+}
+
+- (void)setListingNumber:(long long)value forKey:(RSListingKey)key {
+}
+
+- (void)setValue:(id)value forUndefinedKey:(NSString *)key {
+    
+    // the API may add fields we don't know about yet
+    
+}
+
 #pragma mark - HTTP
 
 
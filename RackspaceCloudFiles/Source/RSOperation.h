@@ -0,0 +1,83 @@
+//
+//  RSOperation.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSClient, RSConnection;
+
+/** The RSOperation class is a handle to an API operation in progress.
+ *
+ *  Every asynchronous method of RSClient, RSContainer, RSStorageObject, and RSCDNContainer returns one.
+ *  An operation is made of the connections it sends, and of other operations it starts, such as the
+ *  pages of a listing or the segments of a large upload.  Cancelling it cancels all of them, including
+ *  connections waiting to be sent or waiting to be retried, and any sent later; the failure handler
+ *  then executes with a `NSURLErrorCancelled` error.
+ *
+ *  completedBytes and totalBytes can be observed with key-value observing.  They change on the
+ *  client's completion queue.
+ */
+@interface RSOperation : NSObject
+
+/** The client that sends the operation's requests */
+@property (nonatomic, strong, readonly) RSClient *client;
+
+/** `YES` once the operation has been cancelled */
+@property (nonatomic, readonly, getter=isCancelled) BOOL cancelled;
+
+/** The priority of the operation's requests among requests waiting to be sent.  Changing it moves
+ *  requests that are already waiting.  Defaults to `NSOperationQueuePriorityNormal`.
+ */
+@property (nonatomic) NSOperationQueuePriority queuePriority;
+
+/** The number of body bytes uploaded or downloaded so far */
+@property (nonatomic, readonly) unsigned long long completedBytes;
+
+/** The number of body bytes the operation will transfer, or 0 if that isn't known yet.  This is
+ *  expectedBytes if set, and otherwise the total of the requests sent so far.
+ */
+@property (nonatomic, readonly) unsigned long long totalBytes;
+
+/** The number of bytes the whole operation will transfer, if known before all of its requests are
+ *  sent, such as the length of a file uploaded in segments.  Defaults to 0.
+ */
+@property (nonatomic) unsigned long long expectedBytes;
+
+/** completedBytes as a fraction of totalBytes, or 0 if totalBytes isn't known */
+@property (nonatomic, readonly) double fractionCompleted;
+
+/** Creates an operation.
+ *  @param client The client that sends the operation's requests
+ */
+- (id)initWithClient:(RSClient *)client;
+
+/** Stops the operation and everything it has started.  Does nothing once the operation has finished. */
+- (void)cancel;
+
+/** Makes a connection part of the operation.  Call this before sending the connection.
+ *  @param connection The connection
+ */
+- (void)addConnection:(RSConnection *)connection;
+
+/** Makes another operation part of this one.  Once everything the child operation started has
+ *  finished, its counts are added to this operation's and it is let go of.
+ *  @param operation The operation
+ */
+- (void)addOperation:(RSOperation *)operation;
+
+/** Records the progress of one of the operation's connections or operations.  They call this themselves.
+ *  @param child The connection or operation
+ *  @param bytes The number of bytes it has transferred
+ *  @param total The number of bytes it will transfer, or 0 if not known
+ */
+- (void)child:(id)child didTransferBytes:(unsigned long long)bytes ofTotal:(unsigned long long)total;
+
+/** Lets go of a connection that has finished and won't be resent, keeping its progress.  RSConnection calls this.
+ *  @param connection The connection
+ */
+- (void)connectionFinished:(RSConnection *)connection;
+
+@end
@@ -0,0 +1,444 @@
+//
+//  RSOperation.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSOperation.h"
+#import "RSClient.h"
+
+@interface RSOperation ()
+
+@property (nonatomic, strong, readwrite) RSClient *client;
+@property (nonatomic, readwrite, getter=isCancelled) BOOL cancelled;
+@property (nonatomic, readwrite) unsigned long long completedBytes;
+@property (nonatomic, readwrite) unsigned long long totalBytes;
+@property (nonatomic, weak) RSOperation *parent;
+@property (nonatomic) BOOL prioritySet;
+@property (nonatomic, strong) NSMutableArray *connections;
+@property (nonatomic, strong) NSMutableArray *operations;
+
+// the progress of children still running, keyed by their addresses, and the totals of those that
+// have finished.  finished children are let go of, so their addresses may be reused.
+@property (nonatomic, strong) NSMutableDictionary *progress;
+@property (nonatomic) unsigned long long finishedBytes;
+@property (nonatomic) unsigned long long finishedTotal;
+
+// an operation is finished once everything it started has, and its parent then adds its last
+// counts to the parent's finished totals and lets go of it.  an operation that starts something
+// again takes back what its parent added.
+@property (nonatomic) BOOL started;
+@property (nonatomic) BOOL finished;
+@property (nonatomic) unsigned long long reportedBytes;
+@property (nonatomic) unsigned long long reportedTotal;
+@property (nonatomic) unsigned long long foldedBytes;
+@property (nonatomic) unsigned long long foldedTotal;
+
+// counts every update, so only the latest is posted to observers
+@property (nonatomic) NSUInteger progressSerial;
+
+- (NSValue *)progressKeyForChild:(id)child;
+- (void)updateProgress;
+- (void)finishIfIdle;
+- (void)operationFinished:(RSOperation *)operation;
+- (void)operationRevived:(RSOperation *)operation;
+
+@end
+
+@implementation RSOperation
+
+@synthesize client, cancelled, queuePriority, completedBytes, totalBytes, expectedBytes;
+@synthesize parent, prioritySet, connections, operations, progress, finishedBytes, finishedTotal;
+@synthesize started, finished, reportedBytes, reportedTotal, foldedBytes, foldedTotal, progressSerial;
+
++ (NSSet *)keyPathsForValuesAffectingFractionCompleted {
+    return [NSSet setWithObjects:@"completedBytes", @"totalBytes", nil];
+}
+
+- (id)initWithClient:(RSClient *)aClient {
+
+    self = [super init];
+    if (self) {
+        self.client = aClient;
+        self.queuePriority = NSOperationQueuePriorityNormal;
+        self.prioritySet = NO;
+        self.connections = [[NSMutableArray alloc] init];
+        self.operations = [[NSMutableArray alloc] init];
+        self.progress = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+
+}
+
+- (double)fractionCompleted {
+
+    unsigned long long total = self.totalBytes;
+    return total > 0 ? MIN((double)self.completedBytes / total, 1.0) : 0;
+
+}
+
+#pragma mark - Children
+
+- (void)addConnection:(RSConnection *)connection {
+
+    BOOL cancelNow = NO;
+    BOOL revived = NO;
+
+    @synchronized (self) {
+
+        connection.operation = self;
+
+        if (self.prioritySet) {
+            connection.queuePriority = self.queuePriority;
+        }
+
+        cancelNow = self.cancelled;
+
+        if (!cancelNow) {
+            [self.connections addObject:connection];
+            revived = self.finished;
+            self.started = YES;
+            self.finished = NO;
+        }
+
+    }
+
+    if (revived) {
+        [self.parent operationRevived:self];
+    }
+
+    // a connection that hasn't been sent yet is only marked, and fails as soon as it starts
+    if (cancelNow) {
+        [connection cancel];
+    }
+
+}
+
+- (void)addOperation:(RSOperation *)operation {
+
+    BOOL cancelNow = NO;
+    BOOL revived = NO;
+    BOOL childFinished = NO;
+
+    @synchronized (self) {
+
+        operation.parent = self;
+        cancelNow = self.cancelled;
+
+        if (!cancelNow) {
+
+            [self.operations addObject:operation];
+            revived = self.finished;
+            self.started = YES;
+            self.finished = NO;
+
+            // what the operation did before it had a parent counts from now on
+            @synchronized (operation) {
+                childFinished = operation.finished;
+                [self.progress setObject:[NSArray arrayWithObjects:[NSNumber numberWithUnsignedLongLong:operation.reportedBytes], [NSNumber numberWithUnsignedLongLong:operation.reportedTotal], nil]
+                                  forKey:[NSValue valueWithNonretainedObject:operation]];
+            }
+
+        }
+
+    }
+
+    if (revived) {
+        [self.parent operationRevived:self];
+    }
+
+    if (cancelNow) {
+        [operation cancel];
+    } else if (self.prioritySet) {
+        operation.queuePriority = self.queuePriority;
+    }
+
+    // an operation that was done before it was added is let go of right away
+    if (childFinished) {
+        [self operationFinished:operation];
+    }
+
+}
+
+- (void)connectionFinished:(RSConnection *)connection {
+
+    @synchronized (self) {
+
+        // a hedged request and its copy share one entry, which is kept until both have finished
+        NSValue *key = [self progressKeyForChild:connection];
+        RSConnection *partner = connection.hedgedConnection ? connection.hedgedConnection : connection.hedge;
+        BOOL partnerRunning = partner && [self.connections indexOfObjectIdenticalTo:partner] != NSNotFound;
+        NSArray *entry = partnerRunning ? nil : [self.progress objectForKey:key];
+
+        if (entry) {
+            self.finishedBytes += [[entry objectAtIndex:0] unsignedLongLongValue];
+            self.finishedTotal += [[entry objectAtIndex:1] unsignedLongLongValue];
+            [self.progress removeObjectForKey:key];
+        }
+
+        [self.connections removeObjectIdenticalTo:connection];
+
+    }
+
+    [self finishIfIdle];
+
+}
+
+- (void)finishIfIdle {
+
+    BOOL finishedNow = NO;
+
+    @synchronized (self) {
+        if (self.started && !self.finished && [self.connections count] == 0 && [self.operations count] == 0) {
+            self.finished = YES;
+            finishedNow = YES;
+        }
+    }
+
+    if (finishedNow) {
+        [self.parent operationFinished:self];
+    }
+
+}
+
+- (void)operationFinished:(RSOperation *)operation {
+
+    BOOL folded = NO;
+
+    @synchronized (self) {
+
+        NSUInteger index = [self.operations indexOfObjectIdenticalTo:operation];
+
+        @synchronized (operation) {
+
+            // it may have started something again since it said it was finished
+            if (index != NSNotFound && operation.finished) {
+
+                operation.foldedBytes = operation.reportedBytes;
+                operation.foldedTotal = operation.reportedTotal;
+                self.finishedBytes += operation.foldedBytes;
+                self.finishedTotal += operation.foldedTotal;
+
+                [self.progress removeObjectForKey:[NSValue valueWithNonretainedObject:operation]];
+                [self.operations removeObjectAtIndex:index];
+                folded = YES;
+
+            }
+
+        }
+
+    }
+
+    if (folded) {
+        [self updateProgress];
+        [self finishIfIdle];
+    }
+
+}
+
+- (void)operationRevived:(RSOperation *)operation {
+
+    BOOL revived = NO;
+    BOOL cancelNow = NO;
+
+    @synchronized (self) {
+
+        if ([self.operations indexOfObjectIdenticalTo:operation] != NSNotFound) {
+            return;
+        }
+
+        unsigned long long bytes = 0;
+        unsigned long long total = 0;
+
+        @synchronized (operation) {
+            bytes = operation.foldedBytes;
+            total = operation.foldedTotal;
+        }
+
+        self.finishedBytes -= bytes;
+        self.finishedTotal -= total;
+        [self.progress setObject:[NSArray arrayWithObjects:[NSNumber numberWithUnsignedLongLong:bytes], [NSNumber numberWithUnsignedLongLong:total], nil]
+                          forKey:[NSValue valueWithNonretainedObject:operation]];
+        [self.operations addObject:operation];
+
+        revived = self.finished;
+        self.finished = NO;
+        cancelNow = self.cancelled;
+
+    }
+
+    if (revived) {
+        [self.parent operationRevived:self];
+    }
+
+    if (cancelNow) {
+        [operation cancel];
+    }
+
+}
+
+#pragma mark - Cancelling and Priority
+
+- (void)cancel {
+
+    NSArray *cancelledConnections = nil;
+    NSArray *cancelledOperations = nil;
+
+    @synchronized (self) {
+
+        if (self.cancelled) {
+            return;
+        }
+
+        self.cancelled = YES;
+        cancelledConnections = [NSArray arrayWithArray:self.connections];
+        cancelledOperations = [NSArray arrayWithArray:self.operations];
+        [self.connections removeAllObjects];
+
+    }
+
+    // connections still waiting for a slot fail straight away instead of when their turn comes
+    for (RSConnection *connection in cancelledConnections) {
+        if (self.client) {
+            [self.client cancelConnection:connection];
+        } else {
+            [connection cancel];
+        }
+    }
+
+    for (RSOperation *operation in cancelledOperations) {
+        [operation cancel];
+    }
+
+}
+
+- (void)setQueuePriority:(NSOperationQueuePriority)aQueuePriority {
+
+    NSArray *waitingConnections = nil;
+    NSArray *childOperations = nil;
+
+    @synchronized (self) {
+        queuePriority = aQueuePriority;
+        self.prioritySet = YES;
+        waitingConnections = [NSArray arrayWithArray:self.connections];
+        childOperations = [NSArray arrayWithArray:self.operations];
+    }
+
+    for (RSConnection *connection in waitingConnections) {
+        [self.client setQueuePriority:aQueuePriority forConnection:connection];
+    }
+
+    for (RSOperation *operation in childOperations) {
+        operation.queuePriority = aQueuePriority;
+    }
+
+}
+
+#pragma mark - Progress
+
+- (void)setExpectedBytes:(unsigned long long)anExpectedBytes {
+
+    @synchronized (self) {
+        expectedBytes = anExpectedBytes;
+    }
+
+    [self updateProgress];
+
+}
+
+- (void)child:(id)child didTransferBytes:(unsigned long long)bytes ofTotal:(unsigned long long)total {
+
+    @synchronized (self) {
+
+        // a late report from an operation that has already been let go of is already in the totals
+        if ([child isKindOfClass:[RSOperation class]] && [self.operations indexOfObjectIdenticalTo:child] == NSNotFound) {
+            return;
+        }
+
+        NSValue *key = [self progressKeyForChild:child];
+        NSArray *entry = [self.progress objectForKey:key];
+
+        // the copy of a hedged request that's further along is the request's progress
+        if (entry && [child isKindOfClass:[RSConnection class]] && ([child hedgedConnection] || [child hedge])) {
+            bytes = MAX(bytes, [[entry objectAtIndex:0] unsignedLongLongValue]);
+            total = MAX(total, [[entry objectAtIndex:1] unsignedLongLongValue]);
+        }
+
+        [self.progress setObject:[NSArray arrayWithObjects:[NSNumber numberWithUnsignedLongLong:bytes], [NSNumber numberWithUnsignedLongLong:total], nil]
+                          forKey:key];
+
+    }
+
+    [self updateProgress];
+
+}
+
+- (NSValue *)progressKeyForChild:(id)child {
+
+    if ([child isKindOfClass:[RSConnection class]] && [child hedgedConnection]) {
+        return [NSValue valueWithNonretainedObject:[child hedgedConnection]];
+    }
+
+    return [NSValue valueWithNonretainedObject:child];
+
+}
+
+- (void)updateProgress {
+
+    unsigned long long bytes = 0;
+    unsigned long long total = 0;
+    NSUInteger serial = 0;
+
+    @synchronized (self) {
+
+        bytes = self.finishedBytes;
+        total = self.finishedTotal;
+
+        for (NSArray *entry in [self.progress allValues]) {
+            bytes += [[entry objectAtIndex:0] unsignedLongLongValue];
+            total += [[entry objectAtIndex:1] unsignedLongLongValue];
+        }
+
+        if (self.expectedBytes > 0) {
+            total = self.expectedBytes;
+        }
+
+        self.reportedBytes = bytes;
+        self.reportedTotal = total;
+        serial = ++self.progressSerial;
+
+    }
+
+    // observers hear of changes on the completion queue, and an update overtaken by a newer one is dropped
+    void (^post)() = ^{
+
+        @synchronized (self) {
+            if (serial != self.progressSerial) {
+                return;
+            }
+        }
+
+        if (bytes != self.completedBytes) {
+            self.completedBytes = bytes;
+        }
+
+        if (total != self.totalBytes) {
+            self.totalBytes = total;
+        }
+
+    };
+
+    NSOperationQueue *queue = self.client.completionQueue;
+
+    if (queue && [NSOperationQueue currentQueue] != queue) {
+        [queue addOperationWithBlock:post];
+    } else {
+        post();
+    }
+
+    [self.parent child:self didTransferBytes:bytes ofTotal:total];
+
+}
+
+@end
@@ -0,0 +1,51 @@
+//
+//  RSPagedListing.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSClient, RSOperation;
+
+#define kRSDefaultPageSize 10000
+
+/** The RSPagedListing class retrieves a listing of containers or objects one page at a time.
+ *
+ *  The API returns at most 10,000 entries per request.  RSPagedListing follows the marker from each
+ *  page to the next until the listing is complete, and passes each page to the page handler as soon
+ *  as it is parsed, so the full listing is never held in memory.  The request for the next page is
+ *  sent before the current page is handed to the page handler, so the network fetch overlaps with
+ *  your processing.
+ */
+@interface RSPagedListing : NSObject
+
+/** The client used to send requests */
+@property (nonatomic, strong, readonly) RSClient *client;
+
+/** The maximum number of entries per page.  Defaults to `kRSDefaultPageSize`. */
+@property (nonatomic) NSUInteger pageSize;
+
+/** The number of entries delivered so far */
+@property (nonatomic, readonly) NSUInteger count;
+
+/** The operation the page requests are part of.  Cancelling it ends the listing. */
+@property (nonatomic, strong, readonly) RSOperation *operation;
+
+/** Creates a paged listing.
+ *  @param client The client used to send requests
+ *  @param modelClass The RSModel subclass to create for each entry
+ *  @param parent The parent of the created objects
+ *  @param requestHandler Returns a request for at most limit entries after marker.  marker is nil for the first page.
+ */
+- (id)initWithClient:(RSClient *)client modelClass:(Class)modelClass parent:(id)parent requestHandler:(NSURLRequest *(^)(NSUInteger limit, NSString *marker))requestHandler;
+
+/** Retrieves the listing.
+ *  @param pageHandler Executes for each page, in order.  Set stop to `YES` to end the listing early.
+ *  @param successHandler Executes after the last page, or after the page handler sets stop
+ *  @param failureHandler Executes if a page could not be retrieved or parsed
+ */
+- (RSOperation *)start:(void (^)(NSArray *page, BOOL *stop))pageHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+@end
@@ -0,0 +1,131 @@
+//
+//  RSPagedListing.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSPagedListing.h"
+#import "RSClient.h"
+
+@interface RSPagedListing ()
+
+@property (nonatomic, strong, readwrite) RSClient *client;
+@property (nonatomic, readwrite) NSUInteger count;
+@property (nonatomic, strong, readwrite) RSOperation *operation;
+@property (nonatomic, assign) Class modelClass;
+@property (nonatomic, strong) id parent;
+@property (nonatomic, copy) NSURLRequest *(^requestHandler)(NSUInteger limit, NSString *marker);
+@property (nonatomic) BOOL finished;
+@property (nonatomic, copy) void (^pageHandler)(NSArray *page, BOOL *stop);
+@property (nonatomic, copy) void (^successHandler)();
+@property (nonatomic, copy) void (^failureHandler)(NSHTTPURLResponse*, NSData*, NSError*);
+
+- (void)fetchPageAfterMarker:(NSString *)marker;
+- (void)receivePage:(NSData *)data response:(NSHTTPURLResponse *)response;
+
+@end
+
+@implementation RSPagedListing
+
+@synthesize client, pageSize, count, operation, modelClass, parent, requestHandler, finished;
+@synthesize pageHandler, successHandler, failureHandler;
+
+- (id)initWithClient:(RSClient *)aClient modelClass:(Class)aModelClass parent:(id)aParent requestHandler:(NSURLRequest *(^)(NSUInteger limit, NSString *marker))aRequestHandler {
+
+    self = [super init];
+    if (self) {
+        self.client = aClient;
+        self.modelClass = aModelClass;
+        self.parent = aParent;
+        self.requestHandler = aRequestHandler;
+        self.pageSize = kRSDefaultPageSize;
+        self.operation = [[RSOperation alloc] initWithClient:aClient];
+    }
+    return self;
+
+}
+
+- (RSOperation *)start:(void (^)(NSArray *page, BOOL *stop))aPageHandler success:(void (^)())aSuccessHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))aFailureHandler {
+
+    self.pageHandler = aPageHandler;
+    self.successHandler = aSuccessHandler;
+    self.failureHandler = aFailureHandler;
+    self.finished = NO;
+    self.count = 0;
+
+    [self fetchPageAfterMarker:nil];
+    return self.operation;
+
+}
+
+- (void)fetchPageAfterMarker:(NSString *)marker {
+
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        return self.requestHandler(self.pageSize, marker);
+    }];
+
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self receivePage:data response:response];
+    };
+
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        if (!self.finished) {
+            self.finished = YES;
+            if (self.failureHandler) {
+                self.failureHandler(response, data, error);
+            }
+        }
+    };
+
+    [self.operation addConnection:connection];
+    [self.client sendConnection:connection];
+
+}
+
+- (void)receivePage:(NSData *)data response:(NSHTTPURLResponse *)response {
+
+    if (self.finished) {
+        return;
+    }
+
+    NSError *jsonError = nil;
+    NSArray *page = [self.modelClass arrayFromJSONData:data parent:self.parent error:&jsonError];
+
+    if (!page) {
+        self.finished = YES;
+        if (self.failureHandler) {
+            self.failureHandler(response, data, jsonError);
+        }
+        return;
+    }
+
+    // a full page means there may be more, so ask for the next one before handing this one
+    // to the caller.  handlers execute one at a time, so pages are still delivered in order.
+    BOOL more = [page count] > 0 && [page count] >= self.pageSize;
+
+    if (more) {
+        [self fetchPageAfterMarker:[[page lastObject] valueForKey:@"name"]];
+    }
+
+    self.count += [page count];
+
+    BOOL stop = NO;
+    if (self.pageHandler) {
+        self.pageHandler(page, &stop);
+    }
+
+    if (stop || !more) {
+        self.finished = YES;
+        // the next page may already be on its way
+        if (stop && more) {
+            [self.operation cancel];
+        }
+        if (self.successHandler) {
+            self.successHandler();
+        }
+    }
+
+}
+
+@end
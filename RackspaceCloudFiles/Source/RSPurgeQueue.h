@@ -0,0 +1,87 @@
+//
+//  RSPurgeQueue.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSClient, RSCDNContainer, RSStorageObject, RSRetryPolicy;
+
+#define kRSDefaultPurgeCoalescingWindow 5.0
+#define kRSDefaultPurgeContainerThreshold 100
+#define kRSDefaultMaxPurgesPerSecond 2.0
+#define kRSDefaultPurgeMaxRetries 5
+
+/** The RSPurgeQueue class sends CDN purges with as few requests as possible.
+ *
+ *  A purge isn't sent as soon as it's asked for.  Purges for a container are collected for
+ *  coalescingWindow seconds after the first one arrives, and a file purged several times in that
+ *  time is purged once.  If containerPurgeThreshold files of the same container are waiting, they
+ *  are replaced by a single purge of the whole container.
+ *
+ *  The purges that remain are sent one at a time, at most maxPurgesPerSecond of them.  A purge
+ *  refused because of the CDN's rate limits is put back at the front of the line, and nothing is
+ *  sent until the delay chosen by retryPolicy has passed, honoring the response's Retry-After header.
+ *
+ *  Every handler executes once the purge that covers it is done, on the client's completion queue.
+ */
+@interface RSPurgeQueue : NSObject
+
+/** The client used to send requests */
+@property (nonatomic, strong, readonly) RSClient *client;
+
+/** How long purges for a container are collected before they're sent, in seconds.  Defaults to `kRSDefaultPurgeCoalescingWindow`. */
+@property (nonatomic) NSTimeInterval coalescingWindow;
+
+/** The number of waiting file purges in a container that are replaced by a purge of the whole
+ *  container.  Defaults to `kRSDefaultPurgeContainerThreshold`; 0 means files are always purged one by one.
+ */
+@property (nonatomic) NSUInteger containerPurgeThreshold;
+
+/** The maximum number of purge requests sent per second.  Defaults to `kRSDefaultMaxPurgesPerSecond`; 0 means no limit. */
+@property (nonatomic) double maxPurgesPerSecond;
+
+/** The status codes the CDN uses to refuse a purge because of rate limits.  Defaults to 429 and 498. */
+@property (nonatomic, strong) NSSet *rateLimitStatusCodes;
+
+/** Decides how long the queue waits after a purge is refused because of rate limits, and how many
+ *  times it's tried.  Defaults to a RSRetryPolicy with maxRetries set to `kRSDefaultPurgeMaxRetries`;
+ *  nil fails rate limited purges right away.
+ */
+@property (nonatomic, strong) RSRetryPolicy *retryPolicy;
+
+/** The number of purges asked for */
+@property (nonatomic, readonly) NSUInteger purgesRequested;
+
+/** The number of purge requests sent, including those sent again after being rate limited */
+@property (nonatomic, readonly) NSUInteger purgeRequestsSent;
+
+/** The number of purges waiting to be sent */
+@property (nonatomic, readonly) NSUInteger pendingPurgeCount;
+
+/** Creates a purge queue.
+ *  @param client The client used to send requests
+ */
+- (id)initWithClient:(RSClient *)client;
+
+/** Purges a file from the CDN, together with any other purges of it that are waiting.
+ *  @param object The file to purge
+ *  @param container The CDN container of the file
+ *  @param successHandler Executes once the file, or its whole container, has been purged
+ *  @param failureHandler Executes if not successful
+ */
+- (void)purgeObject:(RSStorageObject *)object inContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Purges a container from the CDN.  Waiting purges of its files are replaced by this one.
+ *  @param container The container to purge
+ *  @param successHandler Executes once the container has been purged
+ *  @param failureHandler Executes if not successful
+ */
+- (void)purgeContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Ends the coalescing window of every waiting purge, so they're sent as soon as the rate allows */
+- (void)flush;
+
+@end
@@ -0,0 +1,417 @@
+//
+//  RSPurgeQueue.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSPurgeQueue.h"
+#import "RSClient.h"
+
+// one purge request, and everyone waiting on it.  object is nil for a purge of the whole container.
+@interface RSPurge : NSObject
+
+@property (nonatomic, strong) RSStorageObject *object;
+@property (nonatomic, strong) NSMutableArray *successHandlers;
+@property (nonatomic, strong) NSMutableArray *failureHandlers;
+@property (nonatomic) NSUInteger attempts;
+
+- (void)addSuccessHandler:(void (^)())successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (void)mergePurge:(RSPurge *)purge;
+
+@end
+
+@implementation RSPurge
+
+@synthesize object, successHandlers, failureHandlers, attempts;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.successHandlers = [[NSMutableArray alloc] init];
+        self.failureHandlers = [[NSMutableArray alloc] init];
+    }
+    return self;
+
+}
+
+- (void)addSuccessHandler:(void (^)())successHandler failureHandler:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+
+    if (successHandler) {
+        [self.successHandlers addObject:[successHandler copy]];
+    }
+    if (failureHandler) {
+        [self.failureHandlers addObject:[failureHandler copy]];
+    }
+
+}
+
+- (void)mergePurge:(RSPurge *)purge {
+
+    [self.successHandlers addObjectsFromArray:purge.successHandlers];
+    [self.failureHandlers addObjectsFromArray:purge.failureHandlers];
+
+    // a purge that was refused keeps counting its tries after it's merged
+    self.attempts = MAX(self.attempts, purge.attempts);
+
+}
+
+@end
+
+// the purges waiting for one container
+@interface RSPurgeBatch : NSObject
+
+@property (nonatomic, strong) RSCDNContainer *container;
+@property (nonatomic, strong) RSPurge *containerPurge;
+@property (nonatomic, strong) NSMutableDictionary *objectPurges;
+@property (nonatomic, strong) NSMutableArray *objectNames;
+@property (nonatomic, strong) NSDate *readyDate;
+
+- (NSUInteger)count;
+
+@end
+
+@implementation RSPurgeBatch
+
+@synthesize container, containerPurge, objectPurges, objectNames, readyDate;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.objectPurges = [[NSMutableDictionary alloc] init];
+        self.objectNames = [[NSMutableArray alloc] init];
+    }
+    return self;
+
+}
+
+- (NSUInteger)count {
+    return [self.objectNames count] + (self.containerPurge ? 1 : 0);
+}
+
+@end
+
+@interface RSPurgeQueue ()
+
+@property (nonatomic, strong, readwrite) RSClient *client;
+@property (nonatomic, readwrite) NSUInteger purgesRequested;
+@property (nonatomic, readwrite) NSUInteger purgeRequestsSent;
+
+// container names to batches, and the names in the order their batches were started
+@property (nonatomic, strong) NSMutableDictionary *batches;
+@property (nonatomic, strong) NSMutableArray *batchOrder;
+
+@property (nonatomic) BOOL purgeInFlight;
+@property (nonatomic, strong) NSDate *nextSendDate;
+@property (nonatomic) BOOL wakeupScheduled;
+
+- (RSPurgeBatch *)batchForContainer:(RSCDNContainer *)container readyDate:(NSDate *)readyDate first:(BOOL)first;
+- (void)addPurge:(RSPurge *)purge toBatch:(RSPurgeBatch *)batch first:(BOOL)first;
+- (void)sendNextPurge;
+- (void)sendPurge:(RSPurge *)purge container:(RSCDNContainer *)container;
+- (void)finishPurge:(RSPurge *)purge container:(RSCDNContainer *)container succeeded:(BOOL)succeeded response:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error;
+
+@end
+
+@implementation RSPurgeQueue
+
+@synthesize client, coalescingWindow, containerPurgeThreshold, maxPurgesPerSecond, rateLimitStatusCodes, retryPolicy, purgesRequested, purgeRequestsSent;
+@synthesize batches, batchOrder, purgeInFlight, nextSendDate, wakeupScheduled;
+
+- (id)initWithClient:(RSClient *)aClient {
+
+    self = [super init];
+    if (self) {
+        self.client = aClient;
+        self.coalescingWindow = kRSDefaultPurgeCoalescingWindow;
+        self.containerPurgeThreshold = kRSDefaultPurgeContainerThreshold;
+        self.maxPurgesPerSecond = kRSDefaultMaxPurgesPerSecond;
+        self.rateLimitStatusCodes = [NSSet setWithObjects:[NSNumber numberWithInteger:429], [NSNumber numberWithInteger:498], nil];
+        self.retryPolicy = [[RSRetryPolicy alloc] init];
+        self.retryPolicy.maxRetries = kRSDefaultPurgeMaxRetries;
+        self.batches = [[NSMutableDictionary alloc] init];
+        self.batchOrder = [[NSMutableArray alloc] init];
+    }
+    return self;
+
+}
+
+- (NSUInteger)pendingPurgeCount {
+
+    @synchronized (self) {
+
+        NSUInteger count = 0;
+
+        for (RSPurgeBatch *batch in [self.batches allValues]) {
+            count += [batch count];
+        }
+
+        return count;
+
+    }
+
+}
+
+#pragma mark - Coalescing
+
+- (RSPurgeBatch *)batchForContainer:(RSCDNContainer *)container readyDate:(NSDate *)readyDate first:(BOOL)first {
+
+    RSPurgeBatch *batch = [self.batches objectForKey:container.name];
+
+    if (!batch) {
+
+        batch = [[RSPurgeBatch alloc] init];
+        batch.container = container;
+        batch.readyDate = readyDate;
+        [self.batches setObject:batch forKey:container.name];
+
+        if (first) {
+            [self.batchOrder insertObject:container.name atIndex:0];
+        } else {
+            [self.batchOrder addObject:container.name];
+        }
+
+    } else if (first) {
+        [self.batchOrder removeObject:container.name];
+        [self.batchOrder insertObject:container.name atIndex:0];
+    }
+
+    return batch;
+
+}
+
+- (void)addPurge:(RSPurge *)purge toBatch:(RSPurgeBatch *)batch first:(BOOL)first {
+
+    // a purge of the whole container covers every file in it
+    if (batch.containerPurge) {
+        [batch.containerPurge mergePurge:purge];
+        return;
+    }
+
+    if (!purge.object) {
+
+        for (NSString *name in batch.objectNames) {
+            [purge mergePurge:[batch.objectPurges objectForKey:name]];
+        }
+
+        [batch.objectPurges removeAllObjects];
+        [batch.objectNames removeAllObjects];
+        batch.containerPurge = purge;
+        return;
+
+    }
+
+    RSPurge *waiting = [batch.objectPurges objectForKey:purge.object.name];
+
+    if (waiting) {
+        [waiting mergePurge:purge];
+        return;
+    }
+
+    [batch.objectPurges setObject:purge forKey:purge.object.name];
+
+    if (first) {
+        [batch.objectNames insertObject:purge.object.name atIndex:0];
+    } else {
+        [batch.objectNames addObject:purge.object.name];
+    }
+
+    if (self.containerPurgeThreshold > 0 && [batch.objectNames count] >= self.containerPurgeThreshold) {
+        [self addPurge:[[RSPurge alloc] init] toBatch:batch first:NO];
+    }
+
+}
+
+- (void)purgeObject:(RSStorageObject *)object inContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+
+    RSPurge *purge = [[RSPurge alloc] init];
+    purge.object = object;
+    [purge addSuccessHandler:successHandler failureHandler:failureHandler];
+
+    @synchronized (self) {
+        self.purgesRequested++;
+        RSPurgeBatch *batch = [self batchForContainer:container readyDate:[NSDate dateWithTimeIntervalSinceNow:self.coalescingWindow] first:NO];
+        [self addPurge:purge toBatch:batch first:NO];
+    }
+
+    [self sendNextPurge];
+
+}
+
+- (void)purgeContainer:(RSCDNContainer *)container success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+
+    RSPurge *purge = [[RSPurge alloc] init];
+    [purge addSuccessHandler:successHandler failureHandler:failureHandler];
+
+    @synchronized (self) {
+        self.purgesRequested++;
+        RSPurgeBatch *batch = [self batchForContainer:container readyDate:[NSDate dateWithTimeIntervalSinceNow:self.coalescingWindow] first:NO];
+        [self addPurge:purge toBatch:batch first:NO];
+    }
+
+    [self sendNextPurge];
+
+}
+
+- (void)flush {
+
+    @synchronized (self) {
+        NSDate *now = [NSDate date];
+        for (RSPurgeBatch *batch in [self.batches allValues]) {
+            batch.readyDate = now;
+        }
+    }
+
+    [self sendNextPurge];
+
+}
+
+#pragma mark - Sending
+
+- (void)sendNextPurge {
+
+    RSPurge *purge = nil;
+    RSCDNContainer *container = nil;
+
+    @synchronized (self) {
+
+        if (self.purgeInFlight) {
+            return;
+        }
+
+        NSTimeInterval wait = [self.nextSendDate timeIntervalSinceNow];
+
+        if (wait <= 0) {
+
+            wait = 0;
+
+            // the batch started first goes first, once its window has passed
+            for (NSString *name in self.batchOrder) {
+
+                RSPurgeBatch *batch = [self.batches objectForKey:name];
+                NSTimeInterval untilReady = [batch.readyDate timeIntervalSinceNow];
+
+                if (untilReady > 0) {
+                    wait = wait > 0 ? MIN(wait, untilReady) : untilReady;
+                    continue;
+                }
+
+                container = batch.container;
+
+                if (batch.containerPurge) {
+                    purge = batch.containerPurge;
+                    batch.containerPurge = nil;
+                } else {
+                    NSString *objectName = [batch.objectNames objectAtIndex:0];
+                    purge = [batch.objectPurges objectForKey:objectName];
+                    [batch.objectPurges removeObjectForKey:objectName];
+                    [batch.objectNames removeObjectAtIndex:0];
+                }
+
+                if ([batch count] == 0) {
+                    [self.batches removeObjectForKey:name];
+                    [self.batchOrder removeObject:name];
+                }
+
+                break;
+
+            }
+
+        }
+
+        if (!purge) {
+
+            if (wait > 0 && !self.wakeupScheduled) {
+
+                self.wakeupScheduled = YES;
+
+                dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)(wait * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+                    @synchronized (self) {
+                        self.wakeupScheduled = NO;
+                    }
+                    [self sendNextPurge];
+                });
+
+            }
+
+            return;
+
+        }
+
+        self.purgeInFlight = YES;
+        self.purgeRequestsSent++;
+        self.nextSendDate = self.maxPurgesPerSecond > 0 ? [NSDate dateWithTimeIntervalSinceNow:1.0 / self.maxPurgesPerSecond] : nil;
+
+    }
+
+    [self sendPurge:purge container:container];
+
+}
+
+- (void)sendPurge:(RSPurge *)purge container:(RSCDNContainer *)container {
+
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        return purge.object ? [container purgeCDNObjectRequest:purge.object] : [self.client purgeCDNContainerRequest:container];
+    }];
+
+    // the queue owns the backoff for rate limited purges, so the client doesn't resend them behind
+    // its back and every purge request that goes out is counted
+    connection.retriesDisabled = YES;
+
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self finishPurge:purge container:container succeeded:YES response:nil data:nil error:nil];
+    };
+
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self finishPurge:purge container:container succeeded:NO response:response data:data error:error];
+    };
+
+    [self.client sendConnection:connection];
+
+}
+
+- (void)finishPurge:(RSPurge *)purge container:(RSCDNContainer *)container succeeded:(BOOL)succeeded response:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error {
+
+    BOOL rateLimited = !succeeded && response && [self.rateLimitStatusCodes containsObject:[NSNumber numberWithInteger:response.statusCode]];
+
+    if (rateLimited && self.retryPolicy && purge.attempts < self.retryPolicy.maxRetries) {
+
+        NSTimeInterval delay = [self.retryPolicy delayForResponse:response attempt:purge.attempts];
+        purge.attempts++;
+
+        // it goes back to the front of the line, taking in anything that was asked for meanwhile,
+        // and nothing else is sent until the CDN is ready for more.  a batch that is still
+        // collecting keeps its window, and the purge goes out with it.
+        @synchronized (self) {
+            RSPurgeBatch *batch = [self batchForContainer:container readyDate:[NSDate date] first:YES];
+            [self addPurge:purge toBatch:batch first:YES];
+            self.nextSendDate = [NSDate dateWithTimeIntervalSinceNow:MAX(delay, [self.nextSendDate timeIntervalSinceNow])];
+            self.purgeInFlight = NO;
+        }
+
+        [self sendNextPurge];
+        return;
+
+    }
+
+    @synchronized (self) {
+        self.purgeInFlight = NO;
+    }
+
+    if (!succeeded) {
+        for (void (^failureHandler)(NSHTTPURLResponse*, NSData*, NSError*) in purge.failureHandlers) {
+            failureHandler(response, data, error);
+        }
+    } else {
+        for (void (^successHandler)() in purge.successHandlers) {
+            successHandler();
+        }
+    }
+
+    [self sendNextPurge];
+
+}
+
+@end
@@ -0,0 +1,65 @@
+//
+//  RSRangedDownload.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSStorageObject, RSOperation;
+
+#define kRSDefaultRangeSize 8388608
+#define kRSDefaultMaxConcurrentRanges 4
+
+/** The RSRangedDownload class downloads an object to a file on the local filesystem as a series
+ *  of byte ranges fetched in parallel.
+ *
+ *  The object's size is read with a HEAD request, a file next to the destination is preallocated, and
+ *  each range is written at its offset in that file as it arrives.  Completed ranges are recorded in a
+ *  journal file next to the destination, so if a download is interrupted, starting it again only
+ *  fetches the ranges that are missing.  Once every range is in, the file's MD5 is checked against
+ *  the object's ETag, the file is moved to the destination, and the journal is removed.  A file that
+ *  doesn't match fails with an `ECHECKSUMFAILURE` error and is discarded along with its journal.
+ */
+@interface RSRangedDownload : NSObject
+
+/** The object to download */
+@property (nonatomic, strong, readonly) RSStorageObject *object;
+
+/** The path on the local filesystem to write the object's data to */
+@property (nonatomic, strong, readonly) NSString *path;
+
+/** The path of the journal that records completed ranges */
+@property (nonatomic, strong, readonly) NSString *journalPath;
+
+/** The path ranges are written to before the finished file is moved to path */
+@property (nonatomic, strong, readonly) NSString *downloadPath;
+
+/** The size of each range in bytes.  Defaults to `kRSDefaultRangeSize`. */
+@property (nonatomic) unsigned long long rangeSize;
+
+/** The maximum number of ranges fetched at once.  Defaults to `kRSDefaultMaxConcurrentRanges`. */
+@property (nonatomic) NSUInteger maxConcurrentRanges;
+
+/** The operation the download's requests are part of.  Cancelling it stops the download; the file and
+ *  journal are kept, so starting again resumes.
+ */
+@property (nonatomic, strong, readonly) RSOperation *operation;
+
+/** Executes as data is received */
+@property (nonatomic, copy) void (^progressHandler)(unsigned long long bytesReceived, unsigned long long totalBytes);
+
+/** Creates a ranged download.
+ *  @param object The object to download
+ *  @param path The path on the local filesystem to write the object's data to
+ */
+- (id)initWithObject:(RSStorageObject *)object path:(NSString *)path;
+
+/** Downloads any ranges that are not recorded in the journal yet.
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)start:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+@end
@@ -0,0 +1,437 @@
+//
+//  RSRangedDownload.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSRangedDownload.h"
+#import "RSClient.h"
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+@interface RSRangedDownload ()
+
+@property (nonatomic, strong, readwrite) RSStorageObject *object;
+@property (nonatomic, strong, readwrite) NSString *path;
+@property (nonatomic, strong, readwrite) NSString *journalPath;
+@property (nonatomic, strong, readwrite) NSString *downloadPath;
+@property (nonatomic, strong, readwrite) RSOperation *operation;
+
+@property (nonatomic, strong) NSString *etag;
+@property (nonatomic) unsigned long long objectSize;
+@property (nonatomic) BOOL manifest;
+@property (nonatomic, strong) NSFileHandle *fileHandle;
+@property (nonatomic, strong) NSFileHandle *journalHandle;
+@property (nonatomic, strong) NSMutableArray *pendingRanges;
+@property (nonatomic, strong) NSMutableDictionary *inFlightBytes;
+@property (nonatomic) unsigned long long completedBytes;
+@property (nonatomic) NSUInteger activeRanges;
+@property (nonatomic) BOOL failed;
+@property (nonatomic, strong) RSTokenBucket *tokenBucket;
+@property (nonatomic, copy) void (^successHandler)();
+@property (nonatomic, copy) void (^failureHandler)(NSHTTPURLResponse*, NSData*, NSError*);
+
+- (NSUInteger)rangeCount;
+- (unsigned long long)lengthOfRange:(NSUInteger)index;
+- (NSURLRequest *)rangeRequest:(NSUInteger)index;
+- (NSString *)journalHeader;
+- (NSIndexSet *)completedRangesFromJournal;
+- (void)prepareFiles;
+- (void)downloadNextRanges;
+- (void)downloadRange:(NSUInteger)index;
+- (void)finish;
+- (void)moveIntoPlace;
+- (void)reportProgress;
+- (void)failWithResponse:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error;
+
+@end
+
+@implementation RSRangedDownload
+
+@synthesize object, path, journalPath, downloadPath, operation, rangeSize, maxConcurrentRanges, progressHandler;
+@synthesize etag, objectSize, manifest, fileHandle, journalHandle, pendingRanges, inFlightBytes, completedBytes, activeRanges, failed, tokenBucket;
+@synthesize successHandler, failureHandler;
+
+- (id)initWithObject:(RSStorageObject *)anObject path:(NSString *)aPath {
+
+    self = [super init];
+    if (self) {
+        self.object = anObject;
+        self.path = aPath;
+        self.journalPath = $S(@"%@.rsjournal", aPath);
+        self.downloadPath = $S(@"%@.download", aPath);
+        self.rangeSize = kRSDefaultRangeSize;
+        self.maxConcurrentRanges = kRSDefaultMaxConcurrentRanges;
+        self.operation = [[RSOperation alloc] initWithClient:anObject.client];
+    }
+    return self;
+
+}
+
+#pragma mark - Ranges
+
+- (NSUInteger)rangeCount {
+
+    return (NSUInteger)((self.objectSize + self.rangeSize - 1) / self.rangeSize);
+
+}
+
+- (unsigned long long)lengthOfRange:(NSUInteger)index {
+
+    unsigned long long offset = index * self.rangeSize;
+    return MIN(self.rangeSize, self.objectSize - offset);
+
+}
+
+- (NSURLRequest *)rangeRequest:(NSUInteger)index {
+
+    unsigned long long offset = index * self.rangeSize;
+
+    NSMutableURLRequest *request = [[self.object getObjectDataRequest] mutableCopy];
+    [request setValue:$S(@"bytes=%llu-%llu", offset, offset + [self lengthOfRange:index] - 1) forHTTPHeaderField:@"Range"];
+
+    // if the object changes while we're downloading it, the ranges would no longer fit together
+    if (self.etag) {
+        [request setValue:self.etag forHTTPHeaderField:@"If-Match"];
+    }
+
+    return request;
+
+}
+
+#pragma mark - Journal
+
+// the journal is a header line identifying the object version and range size, followed by
+// one line per completed range.  it is only appended to, so a crash can at worst tear the
+// last line.  a line only counts once its newline is written, so a torn line just means
+// that range is fetched again.
+
+- (NSString *)journalHeader {
+
+    return $S(@"%@ %llu %llu\n", self.etag, self.objectSize, self.rangeSize);
+
+}
+
+- (NSIndexSet *)completedRangesFromJournal {
+
+    NSMutableIndexSet *completed = [[NSMutableIndexSet alloc] init];
+
+    if (![[NSFileManager defaultManager] fileExistsAtPath:self.downloadPath]) {
+        return completed;
+    }
+
+    NSString *journal = [NSString stringWithContentsOfFile:self.journalPath encoding:NSUTF8StringEncoding error:nil];
+
+    if (![journal hasPrefix:[self journalHeader]]) {
+        return completed;
+    }
+
+    NSArray *lines = [[journal substringFromIndex:[[self journalHeader] length]] componentsSeparatedByString:@"\n"];
+    NSCharacterSet *nonDigits = [[NSCharacterSet characterSetWithCharactersInString:@"0123456789"] invertedSet];
+    NSUInteger count = [self rangeCount];
+
+    // the last component is whatever follows the last newline: empty, or a torn line
+    for (NSUInteger i = 0; i + 1 < [lines count]; i++) {
+
+        NSString *line = [lines objectAtIndex:i];
+
+        if ([line length] == 0 || [line length] > 18 || [line rangeOfCharacterFromSet:nonDigits].location != NSNotFound) {
+            continue;
+        }
+
+        long long index = [line longLongValue];
+        if (index < count) {
+            [completed addIndex:(NSUInteger)index];
+        }
+
+    }
+
+    return completed;
+
+}
+
+- (void)prepareFiles {
+
+    NSIndexSet *completed = [self completedRangesFromJournal];
+
+    if ([completed count] == 0) {
+        [[NSFileManager defaultManager] createFileAtPath:self.downloadPath contents:nil attributes:nil];
+        [[self journalHeader] writeToFile:self.journalPath atomically:YES encoding:NSUTF8StringEncoding error:nil];
+    }
+
+    self.fileHandle = [NSFileHandle fileHandleForUpdatingAtPath:self.downloadPath];
+    [self.fileHandle truncateFileAtOffset:self.objectSize];
+
+    self.journalHandle = [NSFileHandle fileHandleForWritingAtPath:self.journalPath];
+    [self.journalHandle seekToEndOfFile];
+
+    for (NSUInteger i = 0; i < [self rangeCount]; i++) {
+        if ([completed containsIndex:i]) {
+            self.completedBytes += [self lengthOfRange:i];
+        } else {
+            [self.pendingRanges addObject:[NSNumber numberWithUnsignedInteger:i]];
+        }
+    }
+
+}
+
+#pragma mark - Download
+
+- (RSOperation *)start:(void (^)())aSuccessHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))aFailureHandler {
+
+    self.successHandler = aSuccessHandler;
+    self.failureHandler = aFailureHandler;
+    self.failed = NO;
+    self.tokenBucket = [self.object.client.bandwidthScheduler tokenBucketForTransfer];
+    self.completedBytes = 0;
+    self.activeRanges = 0;
+    self.pendingRanges = [[NSMutableArray alloc] init];
+    self.inFlightBytes = [[NSMutableDictionary alloc] init];
+
+    // a cancelled operation stays cancelled, so starting again needs a new one
+    if (self.operation.isCancelled) {
+        self.operation = [[RSOperation alloc] initWithClient:self.object.client];
+    }
+
+    [self.operation addOperation:[self.object.client sendAsynchronousRequest:@selector(getObjectMetadataRequest) sender:self.object successHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        NSDictionary *headers = [response allHeaderFields];
+        self.etag = [headers valueForKey:@"ETag"];
+        self.objectSize = [[headers valueForKey:@"Content-Length"] longLongValue];
+        self.manifest = [headers valueForKey:@"X-Object-Manifest"] || [[headers valueForKey:@"X-Static-Large-Object"] boolValue];
+
+        // ranges of a compressed object are ranges of its compressed bytes, which can't be decoded
+        // independently, so it's fetched in one request and decoded as it arrives
+        if ([[headers valueForKey:@"Content-Encoding"] isEqualToString:@"gzip"]) {
+            [self.operation addOperation:[self.object writeObjectDataToFile:self.path atomically:YES progress:self.progressHandler success:self.successHandler failure:self.failureHandler]];
+            return;
+        }
+
+        [self prepareFiles];
+
+        // ranges recorded in the journal count towards the operation's progress too
+        self.operation.expectedBytes = self.objectSize;
+        [self.operation child:self didTransferBytes:self.completedBytes ofTotal:0];
+
+        [self reportProgress];
+        [self downloadNextRanges];
+
+    } failureHandler:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self failWithResponse:response data:data error:error];
+    }]];
+
+    return self.operation;
+
+}
+
+- (void)downloadNextRanges {
+
+    if (self.failed) {
+
+        // the file and journal are left in place so the download can be resumed, but they're only
+        // closed once the ranges still in flight have been cancelled
+        if (self.activeRanges == 0) {
+            [self.fileHandle closeFile];
+            [self.journalHandle closeFile];
+            self.fileHandle = nil;
+            self.journalHandle = nil;
+        }
+        return;
+
+    }
+
+    if ([self.pendingRanges count] == 0 && self.activeRanges == 0) {
+        [self finish];
+        return;
+    }
+
+    while (self.activeRanges < self.maxConcurrentRanges && [self.pendingRanges count] > 0) {
+
+        NSNumber *index = [self.pendingRanges objectAtIndex:0];
+        [self.pendingRanges removeObjectAtIndex:0];
+        self.activeRanges++;
+        [self downloadRange:[index unsignedIntegerValue]];
+
+    }
+
+}
+
+- (void)downloadRange:(NSUInteger)index {
+
+    NSNumber *key = [NSNumber numberWithUnsignedInteger:index];
+    unsigned long long start = index * self.rangeSize;
+    unsigned long long length = [self lengthOfRange:index];
+    __block unsigned long long offset = start;
+
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        offset = start;
+        return [self rangeRequest:index];
+    }];
+    connection.bulk = YES;
+    connection.tokenBucket = self.tokenBucket;
+
+    connection.dataHandler = ^(NSData *data) {
+
+        // all ranges share one file handle.  handlers run one at a time, so the seek and
+        // write can't be interleaved with another range's.
+        [self.fileHandle seekToFileOffset:offset];
+        [self.fileHandle writeData:data];
+        offset += [data length];
+
+        [self.inFlightBytes setObject:[NSNumber numberWithUnsignedLongLong:offset - start] forKey:key];
+        [self reportProgress];
+
+    };
+
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        self.activeRanges--;
+        [self.inFlightBytes removeObjectForKey:key];
+
+        // a server that ignores the Range header sends the whole object with a 200
+        BOOL partial = [response statusCode] == 206 || (start == 0 && length == self.objectSize);
+
+        if (!partial || offset - start != length) {
+
+            NSString *description = $S(@"Range %llu-%llu of %@ returned %llu bytes", start, start + length - 1, self.object.name, offset - start);
+            NSError *rangeError = [[NSError alloc] initWithDomain:RSErrorDomain code:ERANGEFAILURE userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]];
+            [self failWithResponse:response data:nil error:rangeError];
+            [self downloadNextRanges];
+            return;
+
+        }
+
+        // make sure the range is on disk before the journal says it is
+        [self.fileHandle synchronizeFile];
+        [self.journalHandle writeData:[$S(@"%lu\n", (unsigned long)index) dataUsingEncoding:NSUTF8StringEncoding]];
+
+        self.completedBytes += length;
+        [self reportProgress];
+        [self downloadNextRanges];
+
+    };
+
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        self.activeRanges--;
+        [self.inFlightBytes removeObjectForKey:key];
+        [self failWithResponse:response data:data error:error];
+        [self downloadNextRanges];
+
+    };
+
+    [self.operation addConnection:connection];
+    [self.object.client sendConnection:connection];
+
+}
+
+- (void)finish {
+
+    [self.fileHandle closeFile];
+    [self.journalHandle closeFile];
+    self.fileHandle = nil;
+    self.journalHandle = nil;
+
+    // the ETag of a large object manifest is not the MD5 of its data, so it can't be checked
+    if (self.manifest) {
+        [self moveIntoPlace];
+        return;
+    }
+
+    // each range was only checked for length, so the whole file is checked against the ETag
+    // before it replaces anything
+    NSOperationQueue *completionQueue = self.object.client.completionQueue;
+    NSString *filePath = self.downloadPath;
+
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+
+        NSString *md5 = [RSChecksum MD5OfFileAtPath:filePath];
+
+        [completionQueue addOperationWithBlock:^{
+
+            if (self.operation.isCancelled) {
+                [self failWithResponse:nil data:nil error:[NSError errorWithDomain:NSURLErrorDomain code:NSURLErrorCancelled userInfo:nil]];
+                return;
+            }
+
+            if (![RSChecksum ETag:self.etag matchesMD5:md5]) {
+
+                // a journal that led to a corrupt file can't be trusted to resume from
+                [[NSFileManager defaultManager] removeItemAtPath:self.downloadPath error:nil];
+                [[NSFileManager defaultManager] removeItemAtPath:self.journalPath error:nil];
+
+                NSString *description = $S(@"Checksum mismatch for %@: expected %@, downloaded %@", self.object.name, self.etag, md5);
+                [self failWithResponse:nil data:nil error:[NSError errorWithDomain:RSErrorDomain code:ECHECKSUMFAILURE userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]]];
+                return;
+
+            }
+
+            [self moveIntoPlace];
+
+        }];
+
+    });
+
+}
+
+- (void)moveIntoPlace {
+
+    NSFileManager *fileManager = [NSFileManager defaultManager];
+    NSError *moveError = nil;
+    BOOL moved;
+
+    if ([fileManager fileExistsAtPath:self.path]) {
+        moved = [fileManager replaceItemAtURL:[NSURL fileURLWithPath:self.path] withItemAtURL:[NSURL fileURLWithPath:self.downloadPath] backupItemName:nil options:0 resultingItemURL:nil error:&moveError];
+    } else {
+        moved = [fileManager moveItemAtPath:self.downloadPath toPath:self.path error:&moveError];
+    }
+
+    if (!moved) {
+        [self failWithResponse:nil data:nil error:moveError];
+        return;
+    }
+
+    [fileManager removeItemAtPath:self.journalPath error:nil];
+
+    self.object.etag = self.etag;
+    self.object.bytes = self.objectSize;
+
+    if (self.successHandler) {
+        self.successHandler();
+    }
+
+}
+
+- (void)reportProgress {
+
+    if (!self.progressHandler) {
+        return;
+    }
+
+    unsigned long long bytesReceived = self.completedBytes;
+    for (NSNumber *bytes in [self.inFlightBytes allValues]) {
+        bytesReceived += [bytes unsignedLongLongValue];
+    }
+
+    self.progressHandler(bytesReceived, self.objectSize);
+
+}
+
+- (void)failWithResponse:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error {
+
+    if (self.failed) {
+        return;
+    }
+    self.failed = YES;
+
+    // stop the other ranges rather than letting them run to completion
+    [self.operation cancel];
+
+    if (self.failureHandler) {
+        self.failureHandler(response, data, error);
+    }
+
+}
+
+@end
@@ -0,0 +1,70 @@
+//
+//  RSRetryPolicy.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kRSDefaultMaxRetries 3
+#define kRSDefaultRetryBaseDelay 0.5
+#define kRSDefaultRetryMaxDelay 30.0
+#define kRSDefaultMinimumHedgeDelay 0.05
+
+/** The RSRetryPolicy class decides when a failed request is sent again, and when a slow read is hedged.
+ *
+ *  Idempotent requests (GET, HEAD, PUT, and DELETE) that fail with a transport error or a retryable
+ *  status code are retried up to maxRetries times.  The delay before each retry is chosen at random
+ *  between zero and baseDelay * 2^attempt, capped at maxDelay, so that many clients failing at once
+ *  don't all come back at once.  A Retry-After header on the response is honored instead when present.
+ *
+ *  When hedgesReads is set, a GET that hasn't answered by the 95th percentile of recent GET latencies
+ *  is sent a second time, and whichever copy answers first is used.
+ */
+@interface RSRetryPolicy : NSObject
+
+/** The maximum number of times a request is retried.  Defaults to `kRSDefaultMaxRetries`. */
+@property (nonatomic) NSUInteger maxRetries;
+
+/** The delay the backoff starts from, in seconds.  Defaults to `kRSDefaultRetryBaseDelay`. */
+@property (nonatomic) NSTimeInterval baseDelay;
+
+/** The longest delay before a retry, in seconds.  Defaults to `kRSDefaultRetryMaxDelay`. */
+@property (nonatomic) NSTimeInterval maxDelay;
+
+/** The status codes that are retried.  Defaults to 408, 429, 500, 502, 503, and 504. */
+@property (nonatomic, strong) NSSet *retryableStatusCodes;
+
+/** The HTTP methods that are safe to retry.  Defaults to GET, HEAD, PUT, and DELETE. */
+@property (nonatomic, strong) NSSet *idempotentMethods;
+
+/** Whether slow GET requests are hedged with a second copy.  Only buffered requests that aren't bulk
+ *  transfers, such as metadata and listing requests, are hedged.  Defaults to `NO`.
+ */
+@property (nonatomic) BOOL hedgesReads;
+
+/** The shortest time a GET is given before it is hedged, in seconds.  Defaults to `kRSDefaultMinimumHedgeDelay`. */
+@property (nonatomic) NSTimeInterval minimumHedgeDelay;
+
+/** Returns `YES` if the request should be sent again.
+ *  @param request The request that failed
+ *  @param response The response, or nil if none was received
+ *  @param error The transport error, or nil
+ *  @param attempt The number of times the request has already been retried
+ */
+- (BOOL)shouldRetryRequest:(NSURLRequest *)request response:(NSHTTPURLResponse *)response error:(NSError *)error attempt:(NSUInteger)attempt;
+
+/** Returns the number of seconds to wait before the retry.
+ *  @param response The response, or nil if none was received
+ *  @param attempt The number of times the request has already been retried
+ */
+- (NSTimeInterval)delayForResponse:(NSHTTPURLResponse *)response attempt:(NSUInteger)attempt;
+
+/** Records how long a successful GET that could have been hedged took, for choosing the hedge delay */
+- (void)recordLatency:(NSTimeInterval)latency;
+
+/** Returns how long a GET is given before it is hedged, or 0 if there aren't enough samples yet */
+- (NSTimeInterval)hedgeDelay;
+
+@end
@@ -0,0 +1,135 @@
+//
+//  RSRetryPolicy.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSRetryPolicy.h"
+
+#define kRSLatencySampleCount 200
+#define kRSMinimumLatencySamples 20
+
+@interface RSRetryPolicy ()
+
+@property (nonatomic, strong) NSMutableArray *latencies;
+@property (nonatomic) NSUInteger nextLatency;
+
+- (NSTimeInterval)retryAfterForResponse:(NSHTTPURLResponse *)response;
+
+@end
+
+@implementation RSRetryPolicy
+
+@synthesize maxRetries, baseDelay, maxDelay, retryableStatusCodes, idempotentMethods, hedgesReads, minimumHedgeDelay;
+@synthesize latencies, nextLatency;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.maxRetries = kRSDefaultMaxRetries;
+        self.baseDelay = kRSDefaultRetryBaseDelay;
+        self.maxDelay = kRSDefaultRetryMaxDelay;
+        self.retryableStatusCodes = [NSSet setWithObjects:[NSNumber numberWithInteger:408], [NSNumber numberWithInteger:429],
+                                     [NSNumber numberWithInteger:500], [NSNumber numberWithInteger:502],
+                                     [NSNumber numberWithInteger:503], [NSNumber numberWithInteger:504], nil];
+        self.idempotentMethods = [NSSet setWithObjects:@"GET", @"HEAD", @"PUT", @"DELETE", nil];
+        self.minimumHedgeDelay = kRSDefaultMinimumHedgeDelay;
+        self.latencies = [[NSMutableArray alloc] initWithCapacity:kRSLatencySampleCount];
+    }
+    return self;
+
+}
+
+#pragma mark - Retries
+
+- (BOOL)shouldRetryRequest:(NSURLRequest *)request response:(NSHTTPURLResponse *)response error:(NSError *)error attempt:(NSUInteger)attempt {
+
+    if (attempt >= self.maxRetries || ![self.idempotentMethods containsObject:[request HTTPMethod]]) {
+        return NO;
+    }
+
+    if (error && !response) {
+        return [[error domain] isEqualToString:NSURLErrorDomain] && [error code] != NSURLErrorCancelled;
+    }
+
+    return [self.retryableStatusCodes containsObject:[NSNumber numberWithInteger:[response statusCode]]];
+
+}
+
+- (NSTimeInterval)retryAfterForResponse:(NSHTTPURLResponse *)response {
+
+    NSString *retryAfter = [[response allHeaderFields] valueForKey:@"Retry-After"];
+
+    if (!retryAfter) {
+        return -1;
+    }
+
+    NSScanner *scanner = [NSScanner scannerWithString:retryAfter];
+    double seconds = 0;
+
+    if ([scanner scanDouble:&seconds] && [scanner isAtEnd]) {
+        return MAX(seconds, 0);
+    }
+
+    NSDateFormatter *formatter = [[NSDateFormatter alloc] init];
+    [formatter setLocale:[[NSLocale alloc] initWithLocaleIdentifier:@"en_US_POSIX"]];
+    [formatter setDateFormat:@"EEE, dd MMM yyyy HH:mm:ss zzz"];
+    NSDate *date = [formatter dateFromString:retryAfter];
+
+    return date ? MAX([date timeIntervalSinceNow], 0) : -1;
+
+}
+
+- (NSTimeInterval)delayForResponse:(NSHTTPURLResponse *)response attempt:(NSUInteger)attempt {
+
+    NSTimeInterval retryAfter = [self retryAfterForResponse:response];
+
+    if (retryAfter >= 0) {
+        return MIN(retryAfter, self.maxDelay);
+    }
+
+    // full jitter
+    NSTimeInterval ceiling = MIN(self.maxDelay, self.baseDelay * pow(2, attempt));
+    return ceiling * ((double)arc4random() / UINT32_MAX);
+
+}
+
+#pragma mark - Hedging
+
+- (void)recordLatency:(NSTimeInterval)latency {
+
+    @synchronized (self) {
+
+        NSNumber *sample = [NSNumber numberWithDouble:latency];
+
+        if ([self.latencies count] < kRSLatencySampleCount) {
+            [self.latencies addObject:sample];
+        } else {
+            [self.latencies replaceObjectAtIndex:self.nextLatency withObject:sample];
+        }
+
+        self.nextLatency = (self.nextLatency + 1) % kRSLatencySampleCount;
+
+    }
+
+}
+
+- (NSTimeInterval)hedgeDelay {
+
+    NSArray *samples = nil;
+
+    @synchronized (self) {
+        if ([self.latencies count] < kRSMinimumLatencySamples) {
+            return 0;
+        }
+        samples = [self.latencies sortedArrayUsingSelector:@selector(compare:)];
+    }
+
+    NSTimeInterval p95 = [[samples objectAtIndex:([samples count] * 95) / 100] doubleValue];
+    return MAX(p95, self.minimumHedgeDelay);
+
+}
+
+@end
@@ -0,0 +1,89 @@
+//
+//  RSSegmentedUpload.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSContainer, RSStorageObject, RSOperation;
+
+#define kRSDefaultSegmentSize 104857600
+#define kRSDefaultMaxConcurrentSegments 4
+
+/** Large object manifest types */
+typedef enum {
+    RSManifestTypeDynamic,  /* X-Object-Manifest header pointing to a segment prefix */
+    RSManifestTypeStatic    /* JSON list of segments with their sizes and ETags */
+} RSManifestType;
+
+/** The RSSegmentedUpload class uploads a file from the local filesystem as a large object.
+ *
+ *  Cloud Files limits the size of a single uploaded object, so larger files must be uploaded as a
+ *  series of segments followed by a manifest object that ties them together.  RSSegmentedUpload
+ *  splits the file into segments of segmentSize bytes, uploads up to maxConcurrentSegments of them
+ *  at once, and then writes the manifest.
+ *
+ *  Segments are named after the file's size and modification date, so if an upload is interrupted,
+ *  starting a new upload of the same file skips the segments that are already in the segment container.
+ *
+ *  In content-addressed mode, segments are named after the MD5 of their contents instead.  Any segment
+ *  already in the segment container, from this object or any other, is reused rather than sent again, so
+ *  uploading a new version of a file that differs in a few segments only sends those segments.
+ */
+@interface RSSegmentedUpload : NSObject
+
+/** The container the large object is uploaded to */
+@property (nonatomic, strong, readonly) RSContainer *container;
+
+/** The large object to upload */
+@property (nonatomic, strong, readonly) RSStorageObject *object;
+
+/** The path for the file's data on the local filesystem */
+@property (nonatomic, strong, readonly) NSString *path;
+
+/** The size of each segment in bytes.  Defaults to `kRSDefaultSegmentSize`. */
+@property (nonatomic) unsigned long long segmentSize;
+
+/** The maximum number of segments uploaded at once.  Defaults to `kRSDefaultMaxConcurrentSegments`. */
+@property (nonatomic) NSUInteger maxConcurrentSegments;
+
+/** The type of manifest to write.  Defaults to `RSManifestTypeDynamic`. */
+@property (nonatomic) RSManifestType manifestType;
+
+/** Whether segments are named after the MD5 of their contents and shared across objects and versions.
+ *  The file is hashed before anything is sent, and each segment is checked with a HEAD request before
+ *  it is uploaded.  Content-addressed uploads always write a static manifest, since their segments don't
+ *  share a prefix.  Segments are never deleted with the objects that use them.  Defaults to `NO`.
+ */
+@property (nonatomic) BOOL contentAddressed;
+
+/** The number of bytes in segments that were already in the segment container and weren't sent again */
+@property (nonatomic, readonly) unsigned long long reusedBytes;
+
+/** The operation the upload's requests are part of.  Cancelling it stops the upload; segments already
+ *  uploaded are kept, so starting again resumes.
+ */
+@property (nonatomic, strong, readonly) RSOperation *operation;
+
+/** The name of the container segments are stored in.  Defaults to the container's name followed by `_segments`. */
+@property (nonatomic, strong) NSString *segmentContainerName;
+
+/** Executes as the file is sent */
+@property (nonatomic, copy) void (^progressHandler)(unsigned long long bytesSent, unsigned long long totalBytes);
+
+/** Creates a segmented upload.
+ *  @param container The container to upload to
+ *  @param object The large object to upload
+ *  @param path The path for the file's data on the local filesystem
+ */
+- (id)initWithContainer:(RSContainer *)container object:(RSStorageObject *)object path:(NSString *)path;
+
+/** Uploads any segments that are not in the segment container yet, and then writes the manifest.
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)start:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+@end
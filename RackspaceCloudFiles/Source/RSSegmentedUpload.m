@@ -0,0 +1,500 @@
+//
+//  RSSegmentedUpload.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSSegmentedUpload.h"
+#import "RSClient.h"
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+#define kRSContentAddressedSegmentPrefix @"md5/"
+
+@interface RSSegmentedUpload ()
+
+@property (nonatomic, strong, readwrite) RSContainer *container;
+@property (nonatomic, strong, readwrite) RSStorageObject *object;
+@property (nonatomic, strong, readwrite) NSString *path;
+@property (nonatomic, readwrite) unsigned long long reusedBytes;
+@property (nonatomic, strong, readwrite) RSOperation *operation;
+
+@property (nonatomic, strong) RSContainer *segmentContainer;
+@property (nonatomic, strong) NSString *segmentPrefix;
+@property (nonatomic) unsigned long long fileSize;
+@property (nonatomic, strong) NSArray *segmentHashes;
+@property (nonatomic, strong) NSMutableArray *pendingSegments;
+@property (nonatomic, strong) NSMutableDictionary *segmentETags;
+@property (nonatomic, strong) NSMutableDictionary *inFlightBytes;
+@property (nonatomic) unsigned long long completedBytes;
+@property (nonatomic) NSUInteger activeSegments;
+@property (nonatomic) BOOL failed;
+@property (nonatomic, strong) RSTokenBucket *tokenBucket;
+@property (nonatomic, copy) void (^successHandler)();
+@property (nonatomic, copy) void (^failureHandler)(NSHTTPURLResponse*, NSData*, NSError*);
+
+- (NSUInteger)segmentCount;
+- (unsigned long long)lengthOfSegment:(NSUInteger)index;
+- (NSString *)nameOfSegment:(NSUInteger)index;
+- (NSURLRequest *)segmentRequest:(NSUInteger)index;
+- (void)loadExistingSegments;
+- (void)hashSegments;
+- (void)uploadNextSegments;
+- (void)uploadSegment:(NSUInteger)index;
+- (void)sendSegment:(NSUInteger)index;
+- (void)segmentCompleted:(NSUInteger)index etag:(NSString *)etag;
+- (void)writeManifest;
+- (void)reportProgress;
+- (void)failWithResponse:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error;
+
+@end
+
+@implementation RSSegmentedUpload
+
+@synthesize container, object, path, segmentSize, maxConcurrentSegments, manifestType, contentAddressed, reusedBytes, operation, segmentContainerName, progressHandler;
+@synthesize segmentContainer, segmentPrefix, fileSize, segmentHashes, pendingSegments, segmentETags, inFlightBytes, completedBytes, activeSegments, failed, tokenBucket;
+@synthesize successHandler, failureHandler;
+
+- (id)initWithContainer:(RSContainer *)aContainer object:(RSStorageObject *)anObject path:(NSString *)aPath {
+
+    self = [super init];
+    if (self) {
+        self.container = aContainer;
+        self.object = anObject;
+        self.path = aPath;
+        self.segmentSize = kRSDefaultSegmentSize;
+        self.maxConcurrentSegments = kRSDefaultMaxConcurrentSegments;
+        self.manifestType = RSManifestTypeDynamic;
+        self.segmentContainerName = $S(@"%@_segments", aContainer.name);
+        self.operation = [[RSOperation alloc] initWithClient:aContainer.client];
+    }
+    return self;
+
+}
+
+#pragma mark - Segments
+
+- (NSUInteger)segmentCount {
+
+    if (self.fileSize == 0) {
+        return 1;
+    }
+    return (NSUInteger)((self.fileSize + self.segmentSize - 1) / self.segmentSize);
+
+}
+
+- (unsigned long long)lengthOfSegment:(NSUInteger)index {
+
+    unsigned long long offset = index * self.segmentSize;
+    return MIN(self.segmentSize, self.fileSize - offset);
+
+}
+
+- (NSString *)nameOfSegment:(NSUInteger)index {
+
+    // the length is part of a content-addressed name, so a short final segment can't collide with a full one
+    if (self.contentAddressed) {
+        return $S(@"%@%@/%llu", kRSContentAddressedSegmentPrefix, [self.segmentHashes objectAtIndex:index], [self lengthOfSegment:index]);
+    }
+    return $S(@"%@%08lu", self.segmentPrefix, (unsigned long)index);
+
+}
+
+- (NSURLRequest *)segmentRequest:(NSUInteger)index {
+
+    RSClient *client = self.container.client;
+    unsigned long long length = [self lengthOfSegment:index];
+
+    RSChunkedInputStream *stream = [[RSChunkedInputStream alloc] initWithFileAtPath:self.path offset:index * self.segmentSize length:length chunkSize:client.chunkSize];
+
+    NSMutableURLRequest *request = [client storageRequest:$S(@"/%@/%@", self.segmentContainerName, [self nameOfSegment:index]) httpMethod:@"PUT"];
+    [request addValue:$S(@"%llu", length) forHTTPHeaderField:@"Content-Length"];
+    if (self.contentAddressed) {
+        [request addValue:[self.segmentHashes objectAtIndex:index] forHTTPHeaderField:@"ETag"];
+    }
+    [request setHTTPBodyStream:stream];
+
+    return request;
+
+}
+
+#pragma mark - Upload
+
+- (RSOperation *)start:(void (^)())aSuccessHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))aFailureHandler {
+
+    self.successHandler = aSuccessHandler;
+    self.failureHandler = aFailureHandler;
+    self.failed = NO;
+    self.tokenBucket = [self.container.client.bandwidthScheduler tokenBucketForTransfer];
+    self.completedBytes = 0;
+    self.reusedBytes = 0;
+    self.activeSegments = 0;
+    self.pendingSegments = [[NSMutableArray alloc] init];
+    self.segmentETags = [[NSMutableDictionary alloc] init];
+    self.inFlightBytes = [[NSMutableDictionary alloc] init];
+
+    // segment names include the file's size and modification date so that an interrupted upload
+    // only reuses segments from the same version of the file
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:self.path error:nil];
+    self.fileSize = [attributes fileSize];
+    self.segmentPrefix = $S(@"%@/%.0f/%llu/%llu/", self.object.name, [[attributes fileModificationDate] timeIntervalSince1970], self.fileSize, self.segmentSize);
+
+    self.segmentContainer = [[RSContainer alloc] init];
+    self.segmentContainer.name = self.segmentContainerName;
+    self.segmentContainer.parent = self.container.client;
+
+    // a cancelled operation stays cancelled, so starting again needs a new one
+    if (self.operation.isCancelled) {
+        self.operation = [[RSOperation alloc] initWithClient:self.container.client];
+    }
+
+    self.operation.expectedBytes = self.fileSize;
+
+    [self.operation addOperation:[self.container.client createContainer:self.segmentContainer success:^{
+        if (self.contentAddressed) {
+            [self hashSegments];
+        } else {
+            [self loadExistingSegments];
+        }
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self failWithResponse:response data:data error:error];
+    }]];
+
+    return self.operation;
+
+}
+
+- (void)loadExistingSegments {
+
+    // an interrupted upload can have left more segments than fit in one page of a listing
+    NSDictionary *params = [NSDictionary dictionaryWithObject:self.segmentPrefix forKey:@"prefix"];
+    NSMutableDictionary *existing = [[NSMutableDictionary alloc] init];
+
+    [self.operation addOperation:[self.segmentContainer getAllObjects:params page:^(NSArray *objects, BOOL *stop) {
+
+        for (RSStorageObject *segment in objects) {
+            [existing setObject:segment forKey:segment.name];
+        }
+
+    } success:^{
+
+        for (NSUInteger i = 0; i < [self segmentCount]; i++) {
+
+            RSStorageObject *segment = [existing objectForKey:[self nameOfSegment:i]];
+
+            // a segment without a hash can't go in a manifest, so it's sent again
+            if (segment.hash && segment.bytes == [self lengthOfSegment:i]) {
+                [self.segmentETags setObject:segment.hash forKey:[NSNumber numberWithUnsignedInteger:i]];
+                self.completedBytes += segment.bytes;
+                self.reusedBytes += segment.bytes;
+            } else {
+                [self.pendingSegments addObject:[NSNumber numberWithUnsignedInteger:i]];
+            }
+
+        }
+
+        [self reportProgress];
+        [self uploadNextSegments];
+
+    } failure:^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self failWithResponse:response data:data error:error];
+    }]];
+
+}
+
+- (void)hashSegments {
+
+    NSOperationQueue *completionQueue = self.container.client.completionQueue;
+    NSUInteger count = [self segmentCount];
+
+    // every segment has to be hashed before its name is known, so the whole file is read up front,
+    // a segment per core at a time
+    dispatch_async(dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+
+        __strong NSString **digests = (__strong NSString **)calloc(count, sizeof(NSString *));
+
+        dispatch_apply(count, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            @autoreleasepool {
+                digests[i] = [RSChecksum MD5OfFileAtPath:self.path offset:i * self.segmentSize length:[self lengthOfSegment:i]];
+            }
+        });
+
+        NSMutableArray *hashes = [[NSMutableArray alloc] initWithCapacity:count];
+
+        for (NSUInteger i = 0; i < count; i++) {
+            if (digests[i]) {
+                [hashes addObject:digests[i]];
+            }
+            digests[i] = nil;
+        }
+
+        free(digests);
+
+        [completionQueue addOperationWithBlock:^{
+
+            if ([hashes count] < count) {
+                [self failWithResponse:nil data:nil error:[NSError errorWithDomain:NSCocoaErrorDomain code:NSFileReadUnknownError userInfo:[NSDictionary dictionaryWithObject:self.path forKey:NSFilePathErrorKey]]];
+                return;
+            }
+
+            self.segmentHashes = hashes;
+
+            for (NSUInteger i = 0; i < count; i++) {
+                [self.pendingSegments addObject:[NSNumber numberWithUnsignedInteger:i]];
+            }
+
+            [self reportProgress];
+            [self uploadNextSegments];
+
+        }];
+
+    });
+
+}
+
+- (void)uploadNextSegments {
+
+    if (self.failed) {
+        return;
+    }
+
+    if ([self.pendingSegments count] == 0 && self.activeSegments == 0) {
+        [self writeManifest];
+        return;
+    }
+
+    while (self.activeSegments < self.maxConcurrentSegments && [self.pendingSegments count] > 0) {
+
+        NSNumber *index = [self.pendingSegments objectAtIndex:0];
+        [self.pendingSegments removeObjectAtIndex:0];
+        self.activeSegments++;
+        [self uploadSegment:[index unsignedIntegerValue]];
+
+    }
+
+}
+
+- (void)uploadSegment:(NSUInteger)index {
+
+    if (!self.contentAddressed) {
+        [self sendSegment:index];
+        return;
+    }
+
+    // a segment with this name has these exact contents, so if it's there it doesn't need sending
+    RSClient *client = self.container.client;
+    NSString *segmentPath = $S(@"/%@/%@", self.segmentContainerName, [self nameOfSegment:index]);
+
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        return [client storageRequest:segmentPath httpMethod:@"HEAD"];
+    }];
+
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        NSString *etag = [[response allHeaderFields] valueForKey:@"ETag"];
+
+        if (![RSChecksum ETag:etag matchesMD5:[self.segmentHashes objectAtIndex:index]]) {
+            [self sendSegment:index];
+            return;
+        }
+
+        self.reusedBytes += [self lengthOfSegment:index];
+        [self segmentCompleted:index etag:etag];
+
+    };
+
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        if (response.statusCode == 404) {
+            [self sendSegment:index];
+            return;
+        }
+
+        self.activeSegments--;
+        [self failWithResponse:response data:data error:error];
+
+    };
+
+    [self.operation addConnection:connection];
+    [client sendConnection:connection];
+
+}
+
+- (void)sendSegment:(NSUInteger)index {
+
+    NSNumber *key = [NSNumber numberWithUnsignedInteger:index];
+    __block RSChecksum *checksum = nil;
+
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+
+        NSURLRequest *request = [self segmentRequest:index];
+
+        // each segment is hashed as it's sent, so its ETag can be checked without reading it again
+        RSChecksum *running = [[RSChecksum alloc] init];
+        [(RSChunkedInputStream *)[request HTTPBodyStream] setChunkHandler:^(NSData *chunk) {
+            [running updateWithData:chunk];
+        }];
+        checksum = running;
+
+        return request;
+
+    }];
+    connection.bulk = YES;
+    connection.tokenBucket = self.tokenBucket;
+
+    connection.uploadProgressHandler = ^(unsigned long long bytesSent, unsigned long long totalBytes) {
+        [self.inFlightBytes setObject:[NSNumber numberWithUnsignedLongLong:bytesSent] forKey:key];
+        [self reportProgress];
+    };
+
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        NSString *etag = [[response allHeaderFields] valueForKey:@"ETag"];
+
+        [self.inFlightBytes removeObjectForKey:key];
+
+        if (![RSChecksum ETag:etag matchesMD5:[checksum hexDigest]]) {
+            self.activeSegments--;
+            NSString *description = $S(@"Checksum mismatch for segment %@: sent %@, stored %@", [self nameOfSegment:index], [checksum hexDigest], etag);
+            [self failWithResponse:response data:data error:[NSError errorWithDomain:RSErrorDomain code:ECHECKSUMFAILURE userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]]];
+            return;
+        }
+
+        [self segmentCompleted:index etag:etag];
+
+    };
+
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        self.activeSegments--;
+        [self.inFlightBytes removeObjectForKey:key];
+        [self failWithResponse:response data:data error:error];
+
+    };
+
+    [self.operation addConnection:connection];
+    [self.container.client sendConnection:connection];
+
+}
+
+- (void)segmentCompleted:(NSUInteger)index etag:(NSString *)etag {
+
+    self.activeSegments--;
+
+    // the manifest lists every segment's ETag, so a segment without one has failed
+    if (!etag) {
+        NSString *description = $S(@"No ETag for segment %@", [self nameOfSegment:index]);
+        [self failWithResponse:nil data:nil error:[NSError errorWithDomain:RSErrorDomain code:ECHECKSUMFAILURE userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]]];
+        return;
+    }
+
+    self.completedBytes += [self lengthOfSegment:index];
+    [self.segmentETags setObject:etag forKey:[NSNumber numberWithUnsignedInteger:index]];
+
+    [self reportProgress];
+    [self uploadNextSegments];
+
+}
+
+- (void)writeManifest {
+
+    RSClient *client = self.container.client;
+
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+
+        NSMutableURLRequest *request = nil;
+
+        if (self.manifestType == RSManifestTypeStatic || self.contentAddressed) {
+
+            NSMutableArray *segments = [[NSMutableArray alloc] initWithCapacity:[self segmentCount]];
+
+            for (NSUInteger i = 0; i < [self segmentCount]; i++) {
+                NSDictionary *segment = [NSDictionary dictionaryWithObjectsAndKeys:
+                                         $S(@"/%@/%@", self.segmentContainerName, [self nameOfSegment:i]), @"path",
+                                         [self.segmentETags objectForKey:[NSNumber numberWithUnsignedInteger:i]], @"etag",
+                                         [NSNumber numberWithUnsignedLongLong:[self lengthOfSegment:i]], @"size_bytes", nil];
+                [segments addObject:segment];
+            }
+
+            NSData *body = [NSJSONSerialization dataWithJSONObject:segments options:0 error:nil];
+
+            request = [client storageRequest:$S(@"/%@/%@", self.container.name, self.object.name) parameters:[NSDictionary dictionaryWithObject:@"put" forKey:@"multipart-manifest"] httpMethod:@"PUT"];
+            [request addValue:$S(@"%lu", (unsigned long)[body length]) forHTTPHeaderField:@"Content-Length"];
+            [request setHTTPBody:body];
+
+        } else {
+
+            request = [client storageRequest:$S(@"/%@/%@", self.container.name, self.object.name) httpMethod:@"PUT"];
+            [request addValue:$S(@"%@/%@", self.segmentContainerName, self.segmentPrefix) forHTTPHeaderField:@"X-Object-Manifest"];
+            [request addValue:@"0" forHTTPHeaderField:@"Content-Length"];
+
+        }
+
+        for (NSString *key in self.object.metadata) {
+            [request addValue:[self.object.metadata valueForKey:key] forHTTPHeaderField:$S(@"X-Object-Meta-%@", key)];
+        }
+
+        return request;
+
+    }];
+
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+
+        self.object.etag = [[response allHeaderFields] valueForKey:@"ETag"];
+        self.object.bytes = self.fileSize;
+        self.object.parent = self.container;
+
+        if (self.successHandler) {
+            self.successHandler();
+        }
+
+    };
+
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self failWithResponse:response data:data error:error];
+    };
+
+    [self.operation addConnection:connection];
+    [client sendConnection:connection];
+
+}
+
+- (void)reportProgress {
+
+    // segments that were already uploaded count towards the operation's progress too
+    [self.operation child:self didTransferBytes:self.reusedBytes ofTotal:0];
+
+    if (!self.progressHandler) {
+        return;
+    }
+
+    unsigned long long bytesSent = self.completedBytes;
+    for (NSNumber *bytes in [self.inFlightBytes allValues]) {
+        bytesSent += [bytes unsignedLongLongValue];
+    }
+
+    self.progressHandler(bytesSent, self.fileSize);
+
+}
+
+- (void)failWithResponse:(NSHTTPURLResponse *)response data:(NSData *)data error:(NSError *)error {
+
+    // segments already uploaded stay in the segment container, so starting again resumes
+    // where this attempt stopped
+
+    if (self.failed) {
+        return;
+    }
+    self.failed = YES;
+
+    // the other segments in flight are no use now
+    [self.operation cancel];
+
+    if (self.failureHandler) {
+        self.failureHandler(response, data, error);
+    }
+
+}
+
+@end
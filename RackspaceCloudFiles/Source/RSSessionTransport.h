@@ -0,0 +1,28 @@
+//
+//  RSSessionTransport.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSTransport.h"
+
+/** The RSSessionTransport class sends a client's requests through a single NSURLSession.
+ *
+ *  The session keeps a pool of keep-alive connections per host, limited to maxConnectionsPerHost,
+ *  and resumes TLS sessions when it opens a new connection to a host it has talked to before.  On
+ *  iOS 10 and later the transport counts how many requests went out on a reused connection.
+ *
+ *  NSURLSession requires iOS 7.  On earlier systems this transport sends requests the way RSTransport does.
+ */
+@interface RSSessionTransport : RSTransport
+
+/** Custom NSURLProtocol classes to consult before the system's own, for example to stub the
+ *  service in tests.  Set this before the first request is sent.
+ */
+@property (nonatomic, strong) NSArray *protocolClasses;
+
+/** Returns `YES` if NSURLSession is available */
++ (BOOL)isAvailable;
+
+@end
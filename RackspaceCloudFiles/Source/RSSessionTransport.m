@@ -0,0 +1,253 @@
+//
+//  RSSessionTransport.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSSessionTransport.h"
+#import "RSConnection.h"
+
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 70000
+#define RS_SESSION_TRANSPORT 1
+#endif
+
+#ifdef RS_SESSION_TRANSPORT
+
+// the session retains its delegate until it's invalidated, so the callbacks are handled by this
+// object rather than the transport, which invalidates the session once it's released itself
+@interface RSSessionTransportDelegate : NSObject <NSURLSessionDataDelegate>
+
+@property (nonatomic, weak) RSSessionTransport *transport;
+
+// NSURLSessionTask identifiers to the RSTransportTasks they belong to
+@property (nonatomic, strong) NSMutableDictionary *tasks;
+
+- (void)addTask:(RSTransportTask *)task forSessionTask:(NSURLSessionTask *)sessionTask;
+- (RSTransportTask *)taskForSessionTask:(NSURLSessionTask *)sessionTask remove:(BOOL)remove;
+
+@end
+
+@interface RSSessionTransport ()
+
+@property (nonatomic, strong) NSURLSession *session;
+@property (nonatomic, strong) RSSessionTransportDelegate *sessionDelegate;
+
+- (NSURLSession *)sessionForTasks;
+
+@end
+
+#endif
+
+@implementation RSSessionTransport
+
+@synthesize protocolClasses;
+
+#ifdef RS_SESSION_TRANSPORT
+@synthesize session, sessionDelegate;
+#endif
+
++ (BOOL)isAvailable {
+
+#ifdef RS_SESSION_TRANSPORT
+    return NSClassFromString(@"NSURLSession") != nil;
+#else
+    return NO;
+#endif
+
+}
+
+#ifdef RS_SESSION_TRANSPORT
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.sessionDelegate = [[RSSessionTransportDelegate alloc] init];
+        self.sessionDelegate.transport = self;
+    }
+    return self;
+
+}
+
+- (void)dealloc {
+
+    [session finishTasksAndInvalidate];
+
+}
+
+- (NSURLSession *)sessionForTasks {
+
+    @synchronized (self) {
+
+        if (!self.session) {
+
+            NSURLSessionConfiguration *configuration = [NSURLSessionConfiguration defaultSessionConfiguration];
+            configuration.HTTPMaximumConnectionsPerHost = self.maxConnectionsPerHost > 0 ? self.maxConnectionsPerHost : NSIntegerMax;
+            configuration.HTTPShouldUsePipelining = self.pipelinesRequests;
+            configuration.URLCache = nil;
+
+            if (self.protocolClasses) {
+                configuration.protocolClasses = [self.protocolClasses arrayByAddingObjectsFromArray:configuration.protocolClasses];
+            }
+
+            // callbacks are handed on to each task's own queue, so the session's queue only has to keep them in order
+            NSOperationQueue *delegateQueue = [[NSOperationQueue alloc] init];
+            delegateQueue.maxConcurrentOperationCount = 1;
+
+            self.session = [NSURLSession sessionWithConfiguration:configuration delegate:self.sessionDelegate delegateQueue:delegateQueue];
+
+        }
+
+        return self.session;
+
+    }
+
+}
+
+- (void)resumeTask:(RSTransportTask *)task {
+
+    if (![RSSessionTransport isAvailable]) {
+        [super resumeTask:task];
+        return;
+    }
+
+    NSURLSessionDataTask *sessionTask = [[self sessionForTasks] dataTaskWithRequest:task.request];
+    task.handle = sessionTask;
+
+    [self.sessionDelegate addTask:task forSessionTask:sessionTask];
+    [sessionTask resume];
+
+}
+
+#endif
+
+@end
+
+#ifdef RS_SESSION_TRANSPORT
+
+@implementation RSSessionTransportDelegate
+
+@synthesize transport, tasks;
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.tasks = [[NSMutableDictionary alloc] init];
+    }
+    return self;
+
+}
+
+- (void)addTask:(RSTransportTask *)task forSessionTask:(NSURLSessionTask *)sessionTask {
+
+    @synchronized (self) {
+        [self.tasks setObject:task forKey:[NSNumber numberWithUnsignedInteger:sessionTask.taskIdentifier]];
+    }
+
+}
+
+- (RSTransportTask *)taskForSessionTask:(NSURLSessionTask *)sessionTask remove:(BOOL)remove {
+
+    NSNumber *key = [NSNumber numberWithUnsignedInteger:sessionTask.taskIdentifier];
+
+    @synchronized (self) {
+        RSTransportTask *task = [self.tasks objectForKey:key];
+        if (remove) {
+            [self.tasks removeObjectForKey:key];
+        }
+        return task;
+    }
+
+}
+
+#pragma mark - NSURLSessionDataDelegate
+
+// the session's callbacks are passed to the connection as the NSURLConnectionDataDelegate
+// callbacks it already handles, on the queue the connection was started on
+
+- (void)URLSession:(NSURLSession *)aSession dataTask:(NSURLSessionDataTask *)dataTask didReceiveResponse:(NSURLResponse *)urlResponse completionHandler:(void (^)(NSURLSessionResponseDisposition))completionHandler {
+
+    RSTransportTask *task = [self taskForSessionTask:dataTask remove:NO];
+    RSConnection *connection = task.connection;
+
+    [task.queue addOperationWithBlock:^{
+        [connection connection:nil didReceiveResponse:urlResponse];
+    }];
+
+    completionHandler(NSURLSessionResponseAllow);
+
+}
+
+- (void)URLSession:(NSURLSession *)aSession dataTask:(NSURLSessionDataTask *)dataTask didReceiveData:(NSData *)data {
+
+    RSTransportTask *task = [self taskForSessionTask:dataTask remove:NO];
+    RSConnection *connection = task.connection;
+
+    [task.queue addOperationWithBlock:^{
+        [connection connection:nil didReceiveData:data];
+    }];
+
+}
+
+- (void)URLSession:(NSURLSession *)aSession task:(NSURLSessionTask *)sessionTask didSendBodyData:(int64_t)bytesSent totalBytesSent:(int64_t)totalBytesSent totalBytesExpectedToSend:(int64_t)totalBytesExpectedToSend {
+
+    RSTransportTask *task = [self taskForSessionTask:sessionTask remove:NO];
+    RSConnection *connection = task.connection;
+
+    [task.queue addOperationWithBlock:^{
+        [connection connection:nil didSendBodyData:(NSInteger)bytesSent totalBytesWritten:(NSInteger)totalBytesSent totalBytesExpectedToWrite:(NSInteger)totalBytesExpectedToSend];
+    }];
+
+}
+
+- (void)URLSession:(NSURLSession *)aSession task:(NSURLSessionTask *)sessionTask needNewBodyStream:(void (^)(NSInputStream *))completionHandler {
+
+    RSTransportTask *task = [self taskForSessionTask:sessionTask remove:NO];
+    RSConnection *connection = task.connection;
+
+    [task.queue addOperationWithBlock:^{
+        completionHandler([connection connection:nil needNewBodyStream:task.request]);
+    }];
+
+}
+
+- (void)URLSession:(NSURLSession *)aSession dataTask:(NSURLSessionDataTask *)dataTask willCacheResponse:(NSCachedURLResponse *)proposedResponse completionHandler:(void (^)(NSCachedURLResponse *))completionHandler {
+
+    completionHandler(nil);
+
+}
+
+#if __IPHONE_OS_VERSION_MAX_ALLOWED >= 100000
+
+- (void)URLSession:(NSURLSession *)aSession task:(NSURLSessionTask *)sessionTask didFinishCollectingMetrics:(NSURLSessionTaskMetrics *)metrics {
+
+    for (NSURLSessionTaskTransactionMetrics *transaction in metrics.transactionMetrics) {
+        if (transaction.resourceFetchType == NSURLSessionTaskMetricsResourceFetchTypeNetworkLoad) {
+            [self.transport recordConnectionReused:transaction.reusedConnection];
+        }
+    }
+
+}
+
+#endif
+
+- (void)URLSession:(NSURLSession *)aSession task:(NSURLSessionTask *)sessionTask didCompleteWithError:(NSError *)error {
+
+    RSTransportTask *task = [self taskForSessionTask:sessionTask remove:YES];
+    RSConnection *connection = task.connection;
+
+    [task.queue addOperationWithBlock:^{
+        if (error) {
+            [connection connection:nil didFailWithError:error];
+        } else {
+            [connection connectionDidFinishLoading:nil];
+        }
+    }];
+
+}
+
+@end
+
+#endif
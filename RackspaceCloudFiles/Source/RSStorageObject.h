@@ -8,6 +8,9 @@
 
 #import "RSModel.h"
 
+// the metadata key a compressed object's uncompressed MD5 is stored under
+#define kRSUncompressedMD5MetadataKey @"Uncompressed-Md5"
+
 /** The RSStorageObject class represents an object in a container.  An object is the basic
  *  storage entity and any optional metadata that represents the files you store in the
  *  Cloud Files system.
@@ -25,11 +28,16 @@
 @property (nonatomic, strong) NSString *hash;
 
 /** The number of bytes in the file */
-@property (nonatomic) NSUInteger bytes;
+@property (nonatomic) unsigned long long bytes;
 
 /** The content type of the file.  Example: text/plain */
 @property (nonatomic, strong) NSString *content_type;
 
+/** `YES` if this is a pseudo-directory from a listing made with a delimiter rather than an object.
+ *  Its name is the directory's prefix, ending with the delimiter.
+ */
+@property (nonatomic) BOOL subdirectory;
+
 /** The last modified date string returned in the API */
 @property (nonatomic, strong) NSString *last_modified;
 
@@ -54,15 +62,40 @@
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)getObjectData:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)getObjectData:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Writes an object's data to a file on the local filesystem.  The data is written to the file as it
+ *  arrives, so only a small part of the object is held in memory at any time.  The MD5 checksum of
+ *  the data is checked against the object's ETag, and the failureHandler executes with an
+ *  `ECHECKSUMFAILURE` error if they do not match.  The data of a compressed object is checked against
+ *  the uncompressed MD5 stored in its metadata instead, and is not verified if it has none.  If the file can't be written or moved into place,
+ *  the failureHandler executes with the file error.  A failed download never leaves a partial file
+ *  behind, and when writing atomically an existing file at path is kept until the new one replaces it.
+ *  @param path The path on the local filesystem
+ *  @param atomically If `YES`, the data is written to a backup file, and then—assuming no errors occur—the backup file is renamed to the name specified by path; otherwise, the data is written directly to path.
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)writeObjectDataToFile:(NSString *)path atomically:(BOOL)atomically success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
-/** Writes an object's data to a file on the local filesystem.
+/** Writes an object's data to a file on the local filesystem, reporting progress as the data arrives.
  *  @param path The path on the local filesystem
  *  @param atomically If `YES`, the data is written to a backup file, and then—assuming no errors occur—the backup file is renamed to the name specified by path; otherwise, the data is written directly to path.
+ *  @param progressHandler Executes as data is received
+ *  @param successHandler Executes if successful
+ *  @param failureHandler Executes if not successful
+ */
+- (RSOperation *)writeObjectDataToFile:(NSString *)path atomically:(BOOL)atomically progress:(void (^)(unsigned long long bytesReceived, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+
+/** Downloads an object's data to a file on the local filesystem by fetching several byte ranges at once.
+ *  If the download is interrupted, calling this method again with the same path resumes it.  Use
+ *  RSRangedDownload directly to configure the range size or concurrency.
+ *  @param path The path on the local filesystem
+ *  @param progressHandler Executes as data is received
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)writeObjectDataToFile:(NSString *)path atomically:(BOOL)atomically success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)downloadObjectDataToFile:(NSString *)path progress:(void (^)(unsigned long long bytesReceived, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 /** Returns a request object that represents a request to retrieve an object's metadata */
 - (NSURLRequest *)getObjectMetadataRequest;
@@ -71,7 +104,7 @@
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)getMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)getMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 /** Returns a request object that represents a request to update an object's metadata */
 - (NSURLRequest *)updateMetadataRequest;
@@ -80,6 +113,6 @@
  *  @param successHandler Executes if successful
  *  @param failureHandler Executes if not successful
  */
-- (void)updateMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
+- (RSOperation *)updateMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler;
 
 @end
@@ -13,7 +13,7 @@
 
 @implementation RSStorageObject
 
-@synthesize name, hash, bytes, content_type, last_modified, metadata, etag, data;
+@synthesize name, hash, bytes, subdirectory, content_type, last_modified, metadata, etag, data;
 
 - (id)init {
     self = [super init];
@@ -23,6 +23,41 @@
     return self;
 }
 
+#pragma mark - Listing
+
+- (void)setListingString:(NSString *)value forKey:(RSListingKey)key {
+    
+    switch (key) {
+        case RSListingKeyName:
+            self.name = value;
+            break;
+        case RSListingKeySubdir:
+            self.name = value;
+            self.subdirectory = YES;
+            break;
+        case RSListingKeyHash:
+            self.hash = value;
+            break;
+        case RSListingKeyContentType:
+            self.content_type = value;
+            break;
+        case RSListingKeyLastModified:
+            self.last_modified = value;
+            break;
+        default:
+            break;
+    }
+    
+}
+
+- (void)setListingNumber:(long long)value forKey:(RSListingKey)key {
+    
+    if (key == RSListingKeyBytes) {
+        self.bytes = (unsigned long long)MAX(value, 0);
+    }
+    
+}
+
 - (NSDate *)last_modified_date {
     
 	NSDateFormatter *dateFormatter = [[NSDateFormatter alloc] init];
@@ -34,16 +69,33 @@
 
 - (NSURLRequest *)getObjectDataRequest {
 
-    return [self.client storageRequest:$S(@"/%@/%@", [self.parent valueForKey:@"name"], self.name)];
+    NSMutableURLRequest *request = [self.client storageRequest:$S(@"/%@/%@", [self.parent valueForKey:@"name"], self.name)];
+    [request setValue:@"gzip" forHTTPHeaderField:@"Accept-Encoding"];
+    return request;
     
 }
 
-- (void)getObjectData:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)getObjectData:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self.client sendAsynchronousRequest:@selector(getObjectDataRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
+    return [self.client sendAsynchronousRequest:@selector(getObjectDataRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
 
         self.etag = [[response allHeaderFields] valueForKey:@"ETag"];
         self.data = responseData;
+        
+        // NSURLConnection and NSURLSession decode gzip themselves, so only decode what a transport left encoded
+        if ([[[response allHeaderFields] valueForKey:@"Content-Encoding"] isEqualToString:@"gzip"] && [RSGzip isGzipData:responseData]) {
+            
+            NSError *decodeError = nil;
+            self.data = [RSGzip gunzipData:responseData error:&decodeError];
+            
+            if (!self.data) {
+                if (failureHandler) {
+                    failureHandler(response, responseData, decodeError);
+                }
+                return;
+            }
+            
+        }
 
         if (successHandler) {
             successHandler();
@@ -53,18 +105,175 @@
     
 }
 
-- (void)writeObjectDataToFile:(NSString *)path atomically:(BOOL)atomically success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
-
-    [self.client sendAsynchronousRequest:@selector(getObjectDataRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
+- (RSOperation *)writeObjectDataToFile:(NSString *)path atomically:(BOOL)atomically success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
 
-        self.etag = [[response allHeaderFields] valueForKey:@"ETag"];
-        [responseData writeToFile:path atomically:atomically];
+    return [self writeObjectDataToFile:path atomically:atomically progress:nil success:successHandler failure:failureHandler];
+    
+}
 
+- (RSOperation *)writeObjectDataToFile:(NSString *)path atomically:(BOOL)atomically progress:(void (^)(unsigned long long bytesReceived, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    // the response body is written to disk as it arrives and hashed along the way, so we
+    // never hold more than one network buffer of the object in memory.  what's hashed is what's
+    // written, so a compressed object is hashed once it has been decoded.
+    
+    NSString *writePath = atomically ? $S(@"%@.download", path) : path;
+    __block NSFileHandle *fileHandle = nil;
+    __block RSGzip *decoder = nil;
+    __block NSError *decodeError = nil;
+    __block BOOL compressed = NO;
+    RSChecksum *checksum = [[RSChecksum alloc] init];
+    
+    RSConnection *connection = [[RSConnection alloc] initWithRequestHandler:^NSURLRequest *{
+        return [self getObjectDataRequest];
+    }];
+    __weak RSConnection *weakConnection = connection;
+    
+    connection.bulk = YES;
+    connection.downloadProgressHandler = progressHandler;
+    
+    connection.dataHandler = ^(NSData *data) {
+        
+        if (decodeError) {
+            return;
+        }
+        
+        if (!fileHandle) {
+            
+            [[NSFileManager defaultManager] createFileAtPath:writePath contents:nil attributes:nil];
+            fileHandle = [NSFileHandle fileHandleForWritingAtPath:writePath];
+            
+            if (!fileHandle) {
+                decodeError = [NSError errorWithDomain:NSCocoaErrorDomain code:NSFileWriteUnknownError userInfo:[NSDictionary dictionaryWithObject:writePath forKey:NSFilePathErrorKey]];
+                return;
+            }
+            
+            // NSURLConnection and NSURLSession decode gzip themselves.  a transport that hands over
+            // the encoded bytes, such as a custom URL protocol, leaves the decoding to us.
+            if ([[[weakConnection.response allHeaderFields] valueForKey:@"Content-Encoding"] isEqualToString:@"gzip"]) {
+                compressed = YES;
+                if ([RSGzip isGzipData:data]) {
+                    decoder = [[RSGzip alloc] init];
+                }
+            }
+            
+        }
+        
+        if (decoder) {
+            data = [decoder decodeData:data error:&decodeError];
+        }
+        
+        [checksum updateWithData:data];
+        [fileHandle writeData:data];
+        
+    };
+    
+    connection.successHandler = ^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
+        
+        NSDictionary *headers = [response allHeaderFields];
+        self.etag = [headers valueForKey:@"ETag"];
+        
+        if (fileHandle) {
+            [fileHandle closeFile];
+        } else {
+            // empty objects never send any data
+            [[NSFileManager defaultManager] createFileAtPath:writePath contents:nil attributes:nil];
+        }
+        
+        if (decodeError) {
+            
+            if (fileHandle) {
+                [[NSFileManager defaultManager] removeItemAtPath:writePath error:nil];
+            }
+            
+            if (failureHandler) {
+                failureHandler(response, nil, decodeError);
+            }
+            return;
+            
+        }
+        
+        // the ETag of a large object manifest is not the MD5 of its data, so we can only
+        // verify objects that were uploaded in a single request.  the ETag of a compressed object
+        // is the MD5 of its compressed bytes, so its data is checked against the uncompressed MD5
+        // stored with it, if there is one.
+        BOOL manifest = [headers valueForKey:@"X-Object-Manifest"] || [[headers valueForKey:@"X-Static-Large-Object"] boolValue];
+        NSString *expected = compressed ? [headers valueForKey:$S(@"X-Object-Meta-%@", kRSUncompressedMD5MetadataKey)] : self.etag;
+        
+        if (!manifest && expected && ![RSChecksum ETag:expected matchesMD5:[checksum hexDigest]]) {
+            
+            [[NSFileManager defaultManager] removeItemAtPath:writePath error:nil];
+            
+            NSString *description = $S(@"Checksum mismatch for %@: expected %@", self.name, expected);
+            NSError *checksumError = [[NSError alloc] initWithDomain:RSErrorDomain code:ECHECKSUMFAILURE userInfo:[NSDictionary dictionaryWithObject:description forKey:NSLocalizedDescriptionKey]];
+            
+            if (failureHandler) {
+                failureHandler(response, nil, checksumError);
+            }
+            return;
+            
+        }
+        
+        if (atomically) {
+            
+            // the old file is only replaced once the new one is in place, so a failed rename keeps it
+            NSFileManager *fileManager = [NSFileManager defaultManager];
+            NSError *moveError = nil;
+            BOOL moved;
+            
+            if ([fileManager fileExistsAtPath:path]) {
+                moved = [fileManager replaceItemAtURL:[NSURL fileURLWithPath:path] withItemAtURL:[NSURL fileURLWithPath:writePath] backupItemName:nil options:0 resultingItemURL:nil error:&moveError];
+            } else {
+                moved = [fileManager moveItemAtPath:writePath toPath:path error:&moveError];
+            }
+            
+            if (!moved) {
+                
+                [fileManager removeItemAtPath:writePath error:nil];
+                
+                if (failureHandler) {
+                    failureHandler(response, nil, moveError);
+                }
+                return;
+                
+            }
+            
+        }
+        
         if (successHandler) {
             successHandler();
         }
         
-    } failureHandler:failureHandler];    
+    };
+    
+    connection.failureHandler = ^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
+        
+        [fileHandle closeFile];
+        
+        // don't leave a partial file behind, but never remove a file we didn't write to
+        if (atomically || fileHandle) {
+            [[NSFileManager defaultManager] removeItemAtPath:writePath error:nil];
+        }
+        
+        if (failureHandler) {
+            failureHandler(response, responseData, error);
+        }
+        
+    };
+    
+    RSOperation *operation = [[RSOperation alloc] initWithClient:self.client];
+    [operation addConnection:connection];
+    [self.client sendConnection:connection];
+    
+    return operation;
+    
+}
+
+- (RSOperation *)downloadObjectDataToFile:(NSString *)path progress:(void (^)(unsigned long long bytesReceived, unsigned long long totalBytes))progressHandler success:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+    
+    RSRangedDownload *download = [[RSRangedDownload alloc] initWithObject:self path:path];
+    download.progressHandler = progressHandler;
+    return [download start:successHandler failure:failureHandler];
     
 }
 
@@ -74,9 +283,9 @@
 
 }
 
-- (void)getMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)getMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self.client sendAsynchronousRequest:@selector(getObjectMetadataRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
+    return [self.client sendAsynchronousRequest:@selector(getObjectMetadataRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
         
         NSDictionary *headers = [response allHeaderFields];
         self.etag = [headers valueForKey:@"ETag"];
@@ -112,9 +321,9 @@
     
 }
 
-- (void)updateMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
+- (RSOperation *)updateMetadata:(void (^)())successHandler failure:(void (^)(NSHTTPURLResponse*, NSData*, NSError*))failureHandler {
     
-    [self.client sendAsynchronousRequest:@selector(updateMetadataRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
+    return [self.client sendAsynchronousRequest:@selector(updateMetadataRequest) sender:self successHandler:^(NSHTTPURLResponse *response, NSData *responseData, NSError *error) {
         if (successHandler) {
             successHandler();
         }
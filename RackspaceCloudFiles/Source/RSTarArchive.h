@@ -0,0 +1,42 @@
+//
+//  RSTarArchive.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+/** The RSTarArchive class writes a tar archive to a file on the local filesystem.
+ *
+ *  Archives written by this class can be uploaded with `-[RSContainer uploadArchive:success:failure:]`,
+ *  which creates an object for every file in the archive with a single request.  Names longer than
+ *  100 bytes are written with GNU long name entries.
+ */
+@interface RSTarArchive : NSObject
+
+/** The path of the archive on the local filesystem */
+@property (nonatomic, strong, readonly) NSString *path;
+
+/** Creates an empty archive, replacing any file already at the path.
+ *  @param path The path of the archive on the local filesystem
+ */
+- (id)initWithPath:(NSString *)path;
+
+/** Adds a file from the local filesystem to the archive.
+ *  @param filePath The path for the file's data on the local filesystem
+ *  @param name The name of the file in the archive
+ *  @return `NO` if the file could not be read
+ */
+- (BOOL)addFileAtPath:(NSString *)filePath name:(NSString *)name;
+
+/** Adds data to the archive.
+ *  @param data The file's data
+ *  @param name The name of the file in the archive
+ */
+- (void)addData:(NSData *)data name:(NSString *)name;
+
+/** Writes the end of archive marker and closes the file.  No files can be added after this. */
+- (void)close;
+
+@end
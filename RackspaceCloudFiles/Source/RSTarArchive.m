@@ -0,0 +1,143 @@
+//
+//  RSTarArchive.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSTarArchive.h"
+#import "RSChunkedInputStream.h"
+
+#define kRSTarBlockSize 512
+
+@interface RSTarArchive ()
+
+@property (nonatomic, strong, readwrite) NSString *path;
+@property (nonatomic, strong) NSFileHandle *fileHandle;
+
+- (void)writeHeaderForName:(NSString *)name size:(unsigned long long)size type:(char)type modificationDate:(NSDate *)date;
+- (void)writePaddingForSize:(unsigned long long)size;
+
+@end
+
+@implementation RSTarArchive
+
+@synthesize path, fileHandle;
+
+- (id)initWithPath:(NSString *)aPath {
+
+    self = [super init];
+    if (self) {
+        self.path = aPath;
+        [[NSFileManager defaultManager] createFileAtPath:aPath contents:nil attributes:nil];
+        self.fileHandle = [NSFileHandle fileHandleForWritingAtPath:aPath];
+    }
+    return self;
+
+}
+
+- (void)writeHeaderForName:(NSString *)name size:(unsigned long long)size type:(char)type modificationDate:(NSDate *)date {
+
+    char header[kRSTarBlockSize];
+    memset(header, 0, kRSTarBlockSize);
+
+    NSData *nameData = [name dataUsingEncoding:NSUTF8StringEncoding];
+
+    // ustar only has room for 100 bytes of name, so longer names go in a GNU long name
+    // entry right before the file's own header
+    if ([nameData length] > 100) {
+        NSMutableData *longName = [nameData mutableCopy];
+        [longName increaseLengthBy:1];
+        [self writeHeaderForName:@"././@LongLink" size:[longName length] type:'L' modificationDate:nil];
+        [self.fileHandle writeData:longName];
+        [self writePaddingForSize:[longName length]];
+    }
+
+    memcpy(header, [nameData bytes], MIN([nameData length], 100));
+    snprintf(header + 100, 8, "%07o", 0644);
+    snprintf(header + 108, 8, "%07o", 0);
+    snprintf(header + 116, 8, "%07o", 0);
+    snprintf(header + 124, 12, "%011llo", size);
+    snprintf(header + 136, 12, "%011lo", (unsigned long)[date timeIntervalSince1970]);
+    header[156] = type;
+    memcpy(header + 257, "ustar", 6);
+    memcpy(header + 263, "00", 2);
+
+    // the checksum is computed with its own field filled with spaces
+    memset(header + 148, ' ', 8);
+    unsigned int checksum = 0;
+    for (NSUInteger i = 0; i < kRSTarBlockSize; i++) {
+        checksum += (unsigned char)header[i];
+    }
+    snprintf(header + 148, 7, "%06o", checksum);
+
+    [self.fileHandle writeData:[NSData dataWithBytes:header length:kRSTarBlockSize]];
+
+}
+
+- (void)writePaddingForSize:(unsigned long long)size {
+
+    NSUInteger remainder = (NSUInteger)(size % kRSTarBlockSize);
+
+    if (remainder > 0) {
+        [self.fileHandle writeData:[NSMutableData dataWithLength:kRSTarBlockSize - remainder]];
+    }
+
+}
+
+- (BOOL)addFileAtPath:(NSString *)filePath name:(NSString *)name {
+
+    NSDictionary *attributes = [[NSFileManager defaultManager] attributesOfItemAtPath:filePath error:nil];
+    NSFileHandle *input = [NSFileHandle fileHandleForReadingAtPath:filePath];
+
+    if (!attributes || !input) {
+        return NO;
+    }
+
+    unsigned long long size = [attributes fileSize];
+    [self writeHeaderForName:name size:size type:'0' modificationDate:[attributes fileModificationDate]];
+
+    unsigned long long remaining = size;
+
+    while (remaining > 0) {
+
+        @autoreleasepool {
+            NSData *chunk = [input readDataOfLength:(NSUInteger)MIN(remaining, kRSDefaultChunkSize)];
+            if ([chunk length] == 0) {
+                break;
+            }
+            [self.fileHandle writeData:chunk];
+            remaining -= [chunk length];
+        }
+
+    }
+
+    // keep the header's size honest if the file shrank while we were reading it
+    if (remaining > 0) {
+        [self.fileHandle writeData:[NSMutableData dataWithLength:(NSUInteger)remaining]];
+    }
+
+    [input closeFile];
+    [self writePaddingForSize:size];
+
+    return YES;
+
+}
+
+- (void)addData:(NSData *)data name:(NSString *)name {
+
+    [self writeHeaderForName:name size:[data length] type:'0' modificationDate:[NSDate date]];
+    [self.fileHandle writeData:data];
+    [self writePaddingForSize:[data length]];
+
+}
+
+- (void)close {
+
+    [self.fileHandle writeData:[NSMutableData dataWithLength:kRSTarBlockSize * 2]];
+    [self.fileHandle closeFile];
+    self.fileHandle = nil;
+
+}
+
+@end
@@ -0,0 +1,35 @@
+//
+//  RSThrottledInputStream.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kRSThrottledInputStreamQuantum 16384
+
+/** The RSThrottledInputStream class is an input stream that paces another stream with token buckets.
+ *
+ *  RSBandwidthScheduler wraps the body streams of bulk uploads in it.  Each read hands out at most
+ *  16 KB and charges it to every bucket.  A reader that schedules the stream on a run loop, as the
+ *  URL loading system does, is only told the stream has bytes available once every bucket holds
+ *  tokens for another 16 KB, so the connection reading the body can only send as fast as the buckets
+ *  allow without ever blocking the thread it shares with other requests.  A reader that doesn't
+ *  schedule the stream waits for the buckets in each read instead.
+ */
+@interface RSThrottledInputStream : NSInputStream
+
+/** The stream being paced */
+@property (nonatomic, strong, readonly) NSInputStream *sourceStream;
+
+/** The RSTokenBucket objects every read is charged to, in order */
+@property (nonatomic, strong, readonly) NSArray *tokenBuckets;
+
+/** Creates a stream that paces another stream.
+ *  @param sourceStream The stream to pace.  It is opened and closed with this stream.
+ *  @param tokenBuckets The RSTokenBucket objects every read is charged to, in order
+ */
+- (id)initWithStream:(NSInputStream *)sourceStream tokenBuckets:(NSArray *)tokenBuckets;
+
+@end
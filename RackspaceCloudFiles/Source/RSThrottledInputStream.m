@@ -0,0 +1,299 @@
+//
+//  RSThrottledInputStream.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSThrottledInputStream.h"
+#import "RSTokenBucket.h"
+
+@interface RSThrottledInputStream () {
+    __weak id <NSStreamDelegate> delegate;
+    CFReadStreamClientCallBack clientCallback;
+    CFStreamClientContext clientContext;
+    CFOptionFlags clientFlags;
+    CFRunLoopRef runLoop;
+    CFStringRef runLoopMode;
+    BOOL eventScheduled;
+}
+
+@property (nonatomic, strong, readwrite) NSInputStream *sourceStream;
+@property (nonatomic, strong, readwrite) NSArray *tokenBuckets;
+
+- (NSTimeInterval)delayUntilReadable;
+- (void)scheduleEvent;
+- (void)postEvent;
+- (void)setClientCallback:(CFReadStreamClientCallBack)callback context:(CFStreamClientContext *)context;
+
+@end
+
+@implementation RSThrottledInputStream
+
+@synthesize sourceStream, tokenBuckets;
+
+- (id)initWithStream:(NSInputStream *)aSourceStream tokenBuckets:(NSArray *)someTokenBuckets {
+
+    self = [super init];
+    if (self) {
+        self.sourceStream = aSourceStream;
+        self.tokenBuckets = someTokenBuckets;
+    }
+    return self;
+
+}
+
+- (void)dealloc {
+
+    [self setClientCallback:NULL context:NULL];
+
+    if (runLoop) {
+        CFRelease(runLoop);
+        CFRelease(runLoopMode);
+    }
+
+}
+
+#pragma mark - Reading
+
+// the bytes are read before they are charged so that a short read at the end of the stream is only
+// charged for what it returns.  a reader that scheduled the stream, like the URL loading system,
+// is told when the buckets have refilled and never waits here, since its thread sends every other
+// request too.  a reader that didn't waits for the buckets on its own thread.
+- (NSInteger)read:(uint8_t *)buffer maxLength:(NSUInteger)len {
+
+    BOOL scheduled = NO;
+
+    @synchronized (self) {
+        scheduled = runLoop != NULL;
+    }
+
+    NSInteger result = [self.sourceStream read:buffer maxLength:MIN(len, kRSThrottledInputStreamQuantum)];
+
+    if (result > 0) {
+        for (RSTokenBucket *bucket in self.tokenBuckets) {
+            if (scheduled) {
+                [bucket charge:result];
+            } else {
+                [bucket consume:result];
+            }
+        }
+    }
+
+    if (scheduled) {
+        [self scheduleEvent];
+    }
+
+    return result;
+
+}
+
+- (BOOL)getBuffer:(uint8_t **)buffer length:(NSUInteger *)len {
+    return NO;
+}
+
+- (BOOL)hasBytesAvailable {
+    return [self delayUntilReadable] == 0 && [self.sourceStream hasBytesAvailable];
+}
+
+- (NSTimeInterval)delayUntilReadable {
+
+    NSTimeInterval delay = 0;
+    for (RSTokenBucket *bucket in self.tokenBuckets) {
+        delay = MAX(delay, [bucket delayForBytes:kRSThrottledInputStreamQuantum]);
+    }
+    return delay;
+
+}
+
+#pragma mark - Events
+
+// the next event is posted on the reader's run loop once every bucket holds tokens for another
+// piece.  only one is outstanding at a time.
+- (void)scheduleEvent {
+
+    @synchronized (self) {
+        if (!runLoop || eventScheduled) {
+            return;
+        }
+        eventScheduled = YES;
+    }
+
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, (int64_t)([self delayUntilReadable] * NSEC_PER_SEC)), dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+
+        @synchronized (self) {
+
+            eventScheduled = NO;
+
+            if (runLoop) {
+                CFRunLoopPerformBlock(runLoop, runLoopMode, ^{
+                    [self postEvent];
+                });
+                CFRunLoopWakeUp(runLoop);
+            }
+
+        }
+
+    });
+
+}
+
+- (void)postEvent {
+
+    NSStreamStatus sourceStatus = [self.sourceStream streamStatus];
+
+    if (sourceStatus == NSStreamStatusNotOpen || sourceStatus == NSStreamStatusClosed) {
+        return;
+    }
+
+    // the limit may have been lowered since the event was scheduled
+    if (sourceStatus != NSStreamStatusAtEnd && sourceStatus != NSStreamStatusError && [self delayUntilReadable] > 0) {
+        [self scheduleEvent];
+        return;
+    }
+
+    NSStreamEvent event = NSStreamEventHasBytesAvailable;
+    if (sourceStatus == NSStreamStatusAtEnd) {
+        event = NSStreamEventEndEncountered;
+    } else if (sourceStatus == NSStreamStatusError) {
+        event = NSStreamEventErrorOccurred;
+    }
+
+    CFReadStreamClientCallBack callback = NULL;
+    void *info = NULL;
+
+    @synchronized (self) {
+        if (clientFlags & event) {
+            callback = clientCallback;
+            info = clientContext.info;
+        }
+    }
+
+    if (callback) {
+        callback((__bridge CFReadStreamRef)self, (CFStreamEventType)event, info);
+    }
+
+    id <NSStreamDelegate> streamDelegate = delegate;
+    if ([streamDelegate respondsToSelector:@selector(stream:handleEvent:)]) {
+        [streamDelegate stream:self handleEvent:event];
+    }
+
+}
+
+- (void)setClientCallback:(CFReadStreamClientCallBack)callback context:(CFStreamClientContext *)context {
+
+    @synchronized (self) {
+
+        if (clientContext.info && clientContext.release) {
+            clientContext.release(clientContext.info);
+        }
+
+        memset(&clientContext, 0, sizeof(clientContext));
+        clientCallback = callback;
+
+        if (callback && context) {
+            memcpy(&clientContext, context, sizeof(clientContext));
+            if (clientContext.info && clientContext.retain) {
+                clientContext.info = (void *)clientContext.retain(clientContext.info);
+            }
+        }
+
+    }
+
+}
+
+#pragma mark - NSStream
+
+- (void)open {
+    [self.sourceStream open];
+    [self scheduleEvent];
+}
+
+- (void)close {
+    [self.sourceStream close];
+}
+
+- (NSStreamStatus)streamStatus {
+    return [self.sourceStream streamStatus];
+}
+
+- (NSError *)streamError {
+    return [self.sourceStream streamError];
+}
+
+- (id <NSStreamDelegate>)delegate {
+    return delegate;
+}
+
+- (void)setDelegate:(id <NSStreamDelegate>)aDelegate {
+    delegate = aDelegate;
+}
+
+- (void)scheduleInRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode {
+    [self _scheduleInCFRunLoop:[aRunLoop getCFRunLoop] forMode:(__bridge CFStringRef)mode];
+}
+
+- (void)removeFromRunLoop:(NSRunLoop *)aRunLoop forMode:(NSString *)mode {
+    [self _unscheduleFromCFRunLoop:[aRunLoop getCFRunLoop] forMode:(__bridge CFStringRef)mode];
+}
+
+- (id)propertyForKey:(NSString *)key {
+    return [self.sourceStream propertyForKey:key];
+}
+
+- (BOOL)setProperty:(id)property forKey:(NSString *)key {
+    return NO;
+}
+
+#pragma mark - CFReadStream bridging
+
+// see RSChunkedInputStream.  unlike the streams there, this one isn't always readable, so it takes
+// a client callback and tells it on its run loop when it can be read again.  it is scheduled on one
+// run loop and mode at a time, which is all the URL loading system uses.
+
+- (void)_scheduleInCFRunLoop:(CFRunLoopRef)aRunLoop forMode:(CFStringRef)mode {
+
+    @synchronized (self) {
+
+        if (runLoop) {
+            CFRelease(runLoop);
+            CFRelease(runLoopMode);
+        }
+
+        runLoop = (CFRunLoopRef)CFRetain(aRunLoop);
+        runLoopMode = CFStringCreateCopy(NULL, mode);
+
+    }
+
+    [self scheduleEvent];
+
+}
+
+- (void)_unscheduleFromCFRunLoop:(CFRunLoopRef)aRunLoop forMode:(CFStringRef)mode {
+
+    @synchronized (self) {
+
+        if (runLoop == aRunLoop && CFEqual(runLoopMode, mode)) {
+            CFRelease(runLoop);
+            CFRelease(runLoopMode);
+            runLoop = NULL;
+            runLoopMode = NULL;
+        }
+
+    }
+
+}
+
+- (BOOL)_setCFClientFlags:(CFOptionFlags)flags callback:(CFReadStreamClientCallBack)callback context:(CFStreamClientContext *)context {
+
+    [self setClientCallback:callback context:context];
+
+    @synchronized (self) {
+        clientFlags = callback ? flags : 0;
+    }
+
+    return YES;
+
+}
+
+@end
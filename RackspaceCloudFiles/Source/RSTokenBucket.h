@@ -0,0 +1,53 @@
+//
+//  RSTokenBucket.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+#define kRSTokenBucketBurstInterval 0.25
+#define kRSTokenBucketMinimumBurst 65536
+
+/** The RSTokenBucket class limits the rate at which bytes are sent or received.
+ *
+ *  The bucket fills at rate bytes per second, up to a quarter second's worth, and every byte
+ *  transferred takes a token out of it.  Callers that consume tokens wait their turn in the order
+ *  they arrived, so streams that consume in small pieces share the rate evenly.  Bytes that have
+ *  already arrived can be charged without waiting, which may leave the bucket in debt until it
+ *  refills.  All methods are thread safe.
+ */
+@interface RSTokenBucket : NSObject
+
+/** The number of bytes per second the bucket allows.  0 means no limit.  Can be changed at any
+ *  time, and callers already waiting pick up the new rate.
+ */
+@property (nonatomic) unsigned long long rate;
+
+/** Creates a bucket that starts out full.
+ *  @param rate The number of bytes per second to allow, or 0 for no limit
+ */
+- (id)initWithRate:(unsigned long long)rate;
+
+/** Waits until the bucket has tokens for bytes, then takes them.  Requests larger than the bucket
+ *  wait for a full bucket and leave it in debt.
+ *  @param bytes The number of bytes about to be transferred
+ */
+- (void)consume:(NSUInteger)bytes;
+
+/** Takes tokens for bytes without waiting, leaving the bucket in debt if there aren't enough.
+ *  @param bytes The number of bytes already transferred
+ */
+- (void)charge:(NSUInteger)bytes;
+
+/** Returns how long until the bucket is out of debt, in seconds, or 0 if it isn't in debt */
+- (NSTimeInterval)delay;
+
+/** Returns how long until the bucket holds tokens for bytes, in seconds, or 0 if it already does.
+ *  Requests larger than the bucket are treated as a full bucket.
+ *  @param bytes The number of bytes about to be transferred
+ */
+- (NSTimeInterval)delayForBytes:(NSUInteger)bytes;
+
+@end
@@ -0,0 +1,148 @@
+//
+//  RSTokenBucket.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSTokenBucket.h"
+
+@interface RSTokenBucket () {
+    NSCondition *condition;
+    double tokens;
+    CFAbsoluteTime refillTime;
+    unsigned long long nextTicket;
+    unsigned long long servingTicket;
+}
+
+- (double)capacity;
+- (void)refill;
+
+@end
+
+@implementation RSTokenBucket
+
+@synthesize rate;
+
+- (id)initWithRate:(unsigned long long)aRate {
+
+    self = [super init];
+    if (self) {
+        condition = [[NSCondition alloc] init];
+        rate = aRate;
+        tokens = [self capacity];
+        refillTime = CFAbsoluteTimeGetCurrent();
+    }
+    return self;
+
+}
+
+- (id)init {
+
+    return [self initWithRate:0];
+
+}
+
+#pragma mark - Tokens
+
+// these expect the condition to be locked
+
+- (double)capacity {
+
+    return MAX(rate * kRSTokenBucketBurstInterval, kRSTokenBucketMinimumBurst);
+
+}
+
+- (void)refill {
+
+    CFAbsoluteTime now = CFAbsoluteTimeGetCurrent();
+    tokens = MIN(tokens + (now - refillTime) * rate, [self capacity]);
+    refillTime = now;
+
+}
+
+- (unsigned long long)rate {
+
+    [condition lock];
+    unsigned long long currentRate = rate;
+    [condition unlock];
+    return currentRate;
+
+}
+
+- (void)setRate:(unsigned long long)aRate {
+
+    [condition lock];
+    [self refill];
+    rate = aRate;
+    tokens = MIN(tokens, [self capacity]);
+    [condition broadcast];
+    [condition unlock];
+
+}
+
+- (void)consume:(NSUInteger)bytes {
+
+    [condition lock];
+
+    // each caller takes a ticket, so waiters are served in the order they arrived
+    unsigned long long ticket = nextTicket++;
+
+    while (YES) {
+
+        [self refill];
+
+        if (ticket != servingTicket) {
+            [condition wait];
+            continue;
+        }
+
+        double needed = MIN(bytes, [self capacity]);
+
+        if (rate == 0 || tokens >= needed) {
+            break;
+        }
+
+        [condition waitUntilDate:[NSDate dateWithTimeIntervalSinceNow:(needed - tokens) / rate]];
+
+    }
+
+    if (rate > 0) {
+        tokens -= bytes;
+    }
+
+    servingTicket++;
+    [condition broadcast];
+    [condition unlock];
+
+}
+
+- (void)charge:(NSUInteger)bytes {
+
+    [condition lock];
+    [self refill];
+    if (rate > 0) {
+        tokens -= bytes;
+    }
+    [condition unlock];
+
+}
+
+- (NSTimeInterval)delay {
+
+    return [self delayForBytes:0];
+
+}
+
+- (NSTimeInterval)delayForBytes:(NSUInteger)bytes {
+
+    [condition lock];
+    [self refill];
+    double needed = MIN(bytes, [self capacity]);
+    NSTimeInterval delay = (rate == 0 || tokens >= needed) ? 0 : (needed - tokens) / rate;
+    [condition unlock];
+    return delay;
+
+}
+
+@end
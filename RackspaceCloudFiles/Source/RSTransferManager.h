@@ -0,0 +1,143 @@
+//
+//  RSTransferManager.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSClient;
+
+#define kRSDefaultMaxConcurrentTransfers 2
+#define kRSTransferJournalProgressInterval 1048576
+
+/** Transfer directions */
+typedef enum {
+    RSTransferTypeUpload,
+    RSTransferTypeDownload
+} RSTransferType;
+
+/** Transfer states */
+typedef enum {
+    RSTransferStatePending,     /* Waiting for a free slot */
+    RSTransferStateActive,      /* Being sent or received */
+    RSTransferStateCompleted,   /* Finished and removed from the journal */
+    RSTransferStateFailed,      /* Failed after the client's retries, but still in the journal */
+    RSTransferStateCancelled    /* Cancelled and removed from the journal */
+} RSTransferState;
+
+/** The RSTransfer class describes one upload or download queued in a RSTransferManager */
+@interface RSTransfer : NSObject
+
+/** A unique identifier that stays the same across launches */
+@property (nonatomic, strong, readonly) NSString *identifier;
+
+/** Whether the file is uploaded or downloaded */
+@property (nonatomic, readonly) RSTransferType type;
+
+/** The name of the container */
+@property (nonatomic, strong, readonly) NSString *containerName;
+
+/** The name of the object */
+@property (nonatomic, strong, readonly) NSString *objectName;
+
+/** The path for the file on the local filesystem */
+@property (nonatomic, strong, readonly) NSString *path;
+
+/** Transfers with a higher priority start first.  Transfers with the same priority start in the order they were added. */
+@property (nonatomic, readonly) NSInteger priority;
+
+/** The transfer's state */
+@property (nonatomic, readonly) RSTransferState state;
+
+/** The number of bytes transferred so far.  After a relaunch, this is the progress last recorded in the journal. */
+@property (nonatomic, readonly) unsigned long long bytesTransferred;
+
+/** The total number of bytes to transfer, once known */
+@property (nonatomic, readonly) unsigned long long totalBytes;
+
+/** The error from the last attempt, if it failed */
+@property (nonatomic, strong, readonly) NSError *error;
+
+/** The HTTP status code of the last attempt, if it failed with a response */
+@property (nonatomic, readonly) NSInteger statusCode;
+
+@end
+
+/** The RSTransferManager class runs a queue of uploads and downloads that survives the process exiting.
+ *
+ *  Every transfer is written to an append-only journal before it is queued, and its progress is appended
+ *  as it goes.  When a manager is created with the same journal after a crash or relaunch, the
+ *  unfinished transfers are read back, and resume starts them again.  Uploads of files larger than
+ *  largeObjectThreshold go through RSSegmentedUpload, which skips the segments already in the segment
+ *  container, and downloads go through RSRangedDownload, which skips the ranges in its own journal, so
+ *  a resumed transfer only sends what's missing.
+ *
+ *  At most maxConcurrentTransfers run at once, highest priority first.  A transfer that fails after the
+ *  client's own retries stays in the journal in the failed state, and runs again after retryFailedTransfers
+ *  or the next launch.  The journal is rewritten without finished transfers when the manager is created
+ *  and whenever it has grown well past its live contents.
+ *
+ *  Handlers execute on the client's completionQueue.
+ */
+@interface RSTransferManager : NSObject
+
+/** The client transfers are sent with */
+@property (nonatomic, strong, readonly) RSClient *client;
+
+/** The path of the journal on the local filesystem */
+@property (nonatomic, strong, readonly) NSString *journalPath;
+
+/** The maximum number of transfers that run at once.  Defaults to `kRSDefaultMaxConcurrentTransfers`. */
+@property (nonatomic) NSUInteger maxConcurrentTransfers;
+
+/** Uploads of files larger than this many bytes are sent as segmented large objects.  Defaults to `kRSDefaultLargeObjectThreshold`. */
+@property (nonatomic) unsigned long long largeObjectThreshold;
+
+/** Executes as a transfer makes progress */
+@property (nonatomic, copy) void (^progressHandler)(RSTransfer *transfer);
+
+/** Executes when a transfer completes or fails */
+@property (nonatomic, copy) void (^completionHandler)(RSTransfer *transfer);
+
+/** Creates a manager and reads back any unfinished transfers from the journal.  Nothing starts until resume is called.
+ *  @param client The client to send transfers with
+ *  @param journalPath The path of the journal on the local filesystem.  It is created if it doesn't exist.
+ */
+- (id)initWithClient:(RSClient *)client journalPath:(NSString *)journalPath;
+
+/** Returns the transfers that haven't completed or been cancelled, in the order they will start */
+- (NSArray *)transfers;
+
+/** Queues an upload and records it in the journal
+ *  @param path The path for the file on the local filesystem
+ *  @param objectName The name of the object to create
+ *  @param containerName The name of the container to upload to
+ *  @param priority Transfers with a higher priority start first
+ */
+- (RSTransfer *)uploadFile:(NSString *)path toObject:(NSString *)objectName inContainer:(NSString *)containerName priority:(NSInteger)priority;
+
+/** Queues a download and records it in the journal
+ *  @param objectName The name of the object to download
+ *  @param containerName The name of the container the object is in
+ *  @param path The path on the local filesystem to write the object's data to
+ *  @param priority Transfers with a higher priority start first
+ */
+- (RSTransfer *)downloadObject:(NSString *)objectName inContainer:(NSString *)containerName toFile:(NSString *)path priority:(NSInteger)priority;
+
+/** Starts pending transfers, up to maxConcurrentTransfers at a time */
+- (void)resume;
+
+/** Stops starting pending transfers.  Transfers already running finish. */
+- (void)suspend;
+
+/** Moves every failed transfer back to pending, and starts them if the manager isn't suspended */
+- (void)retryFailedTransfers;
+
+/** Removes a transfer from the queue and the journal.  If it is already running, its requests are
+ *  cancelled, and the completionHandler doesn't execute for it.
+ */
+- (void)cancelTransfer:(RSTransfer *)transfer;
+
+@end
@@ -0,0 +1,493 @@
+//
+//  RSTransferManager.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSTransferManager.h"
+#import "RSClient.h"
+
+#define $S(format, ...) [NSString stringWithFormat:format, ## __VA_ARGS__]
+
+#define kRSTransferJournalCompactionThreshold 1024
+
+@interface RSTransfer ()
+
+@property (nonatomic, strong, readwrite) NSString *identifier;
+@property (nonatomic, readwrite) RSTransferType type;
+@property (nonatomic, strong, readwrite) NSString *containerName;
+@property (nonatomic, strong, readwrite) NSString *objectName;
+@property (nonatomic, strong, readwrite) NSString *path;
+@property (nonatomic, readwrite) NSInteger priority;
+@property (nonatomic, readwrite) RSTransferState state;
+@property (nonatomic, readwrite) unsigned long long bytesTransferred;
+@property (nonatomic, readwrite) unsigned long long totalBytes;
+@property (nonatomic, strong, readwrite) NSError *error;
+@property (nonatomic, readwrite) NSInteger statusCode;
+@property (nonatomic) unsigned long long sequence;
+@property (nonatomic) unsigned long long journaledBytes;
+@property (nonatomic, strong) RSOperation *operation;
+
+- (id)initWithJournalEntry:(NSDictionary *)entry;
+- (NSDictionary *)journalEntry;
+- (NSDictionary *)progressEntry;
+
+@end
+
+@implementation RSTransfer
+
+@synthesize identifier, type, containerName, objectName, path, priority, state, bytesTransferred, totalBytes, error, statusCode;
+@synthesize sequence, journaledBytes, operation;
+
+- (id)initWithJournalEntry:(NSDictionary *)entry {
+
+    self = [super init];
+    if (self) {
+        self.identifier = [entry objectForKey:@"id"];
+        self.type = [[entry objectForKey:@"type"] isEqualToString:@"download"] ? RSTransferTypeDownload : RSTransferTypeUpload;
+        self.containerName = [entry objectForKey:@"container"];
+        self.objectName = [entry objectForKey:@"object"];
+        self.path = [entry objectForKey:@"path"];
+        self.priority = [[entry objectForKey:@"priority"] integerValue];
+        self.sequence = [[entry objectForKey:@"sequence"] unsignedLongLongValue];
+        self.totalBytes = [[entry objectForKey:@"total"] unsignedLongLongValue];
+        self.state = RSTransferStatePending;
+    }
+    return self;
+
+}
+
+- (NSDictionary *)journalEntry {
+
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+            @"add", @"op",
+            self.identifier, @"id",
+            self.type == RSTransferTypeDownload ? @"download" : @"upload", @"type",
+            self.containerName, @"container",
+            self.objectName, @"object",
+            self.path, @"path",
+            [NSNumber numberWithInteger:self.priority], @"priority",
+            [NSNumber numberWithUnsignedLongLong:self.sequence], @"sequence",
+            [NSNumber numberWithUnsignedLongLong:self.totalBytes], @"total",
+            nil];
+
+}
+
+- (NSDictionary *)progressEntry {
+
+    return [NSDictionary dictionaryWithObjectsAndKeys:
+            @"progress", @"op",
+            self.identifier, @"id",
+            [NSNumber numberWithUnsignedLongLong:self.bytesTransferred], @"bytes",
+            [NSNumber numberWithUnsignedLongLong:self.totalBytes], @"total",
+            nil];
+
+}
+
+@end
+
+@interface RSTransferManager ()
+
+@property (nonatomic, strong, readwrite) RSClient *client;
+@property (nonatomic, strong, readwrite) NSString *journalPath;
+@property (nonatomic, strong) NSFileHandle *journalHandle;
+@property (nonatomic) NSUInteger journalEntryCount;
+@property (nonatomic, strong) NSMutableArray *queuedTransfers;
+@property (nonatomic) NSUInteger activeTransfers;
+@property (nonatomic) unsigned long long nextSequence;
+@property (nonatomic) BOOL suspended;
+
+- (void)loadJournal;
+- (void)compactJournal;
+- (void)appendJournalEntry:(NSDictionary *)entry synchronously:(BOOL)synchronously;
+- (void)addTransfer:(RSTransfer *)transfer;
+- (RSTransfer *)queueTransferOfType:(RSTransferType)type containerName:(NSString *)containerName objectName:(NSString *)objectName path:(NSString *)path priority:(NSInteger)priority totalBytes:(unsigned long long)totalBytes;
+- (void)startNextTransfers;
+- (void)startTransfer:(RSTransfer *)transfer;
+- (void)transfer:(RSTransfer *)transfer didSendBytes:(unsigned long long)bytes totalBytes:(unsigned long long)total;
+- (void)finishTransfer:(RSTransfer *)transfer response:(NSHTTPURLResponse *)response error:(NSError *)error;
+
+@end
+
+@implementation RSTransferManager
+
+@synthesize client, journalPath, maxConcurrentTransfers, largeObjectThreshold, progressHandler, completionHandler;
+@synthesize journalHandle, journalEntryCount, queuedTransfers, activeTransfers, nextSequence, suspended;
+
+- (id)initWithClient:(RSClient *)aClient journalPath:(NSString *)aJournalPath {
+
+    self = [super init];
+    if (self) {
+        self.client = aClient;
+        self.journalPath = aJournalPath;
+        self.maxConcurrentTransfers = kRSDefaultMaxConcurrentTransfers;
+        self.largeObjectThreshold = kRSDefaultLargeObjectThreshold;
+        self.queuedTransfers = [[NSMutableArray alloc] init];
+        self.suspended = YES;
+        [self loadJournal];
+    }
+    return self;
+
+}
+
+- (void)dealloc {
+    [journalHandle closeFile];
+}
+
+#pragma mark - Journal
+
+// the journal is one JSON object per line.  "add" lines describe a transfer, "progress" lines record
+// how far it got, and "remove" lines mark it finished.  a line cut short by a crash fails to parse
+// and is skipped, so at worst the last bit of progress is forgotten.
+- (void)loadJournal {
+
+    NSString *contents = [NSString stringWithContentsOfFile:self.journalPath encoding:NSUTF8StringEncoding error:nil];
+    NSMutableDictionary *transfers = [[NSMutableDictionary alloc] init];
+
+    for (NSString *line in [contents componentsSeparatedByString:@"\n"]) {
+
+        NSDictionary *entry = [line length] > 0 ? [NSJSONSerialization JSONObjectWithData:[line dataUsingEncoding:NSUTF8StringEncoding] options:0 error:nil] : nil;
+
+        if (![entry isKindOfClass:[NSDictionary class]] || ![entry objectForKey:@"id"]) {
+            continue;
+        }
+
+        NSString *op = [entry objectForKey:@"op"];
+        NSString *transferID = [entry objectForKey:@"id"];
+
+        if ([op isEqualToString:@"add"]) {
+            RSTransfer *transfer = [[RSTransfer alloc] initWithJournalEntry:entry];
+            [transfers setObject:transfer forKey:transferID];
+            self.nextSequence = MAX(self.nextSequence, transfer.sequence + 1);
+        } else if ([op isEqualToString:@"progress"]) {
+            RSTransfer *transfer = [transfers objectForKey:transferID];
+            transfer.bytesTransferred = [[entry objectForKey:@"bytes"] unsignedLongLongValue];
+            transfer.journaledBytes = transfer.bytesTransferred;
+            transfer.totalBytes = [[entry objectForKey:@"total"] unsignedLongLongValue];
+        } else if ([op isEqualToString:@"remove"]) {
+            [transfers removeObjectForKey:transferID];
+        }
+
+    }
+
+    for (RSTransfer *transfer in [transfers allValues]) {
+        [self addTransfer:transfer];
+    }
+
+    [self compactJournal];
+
+}
+
+- (void)compactJournal {
+
+    NSMutableData *data = [[NSMutableData alloc] init];
+    NSData *newline = [@"\n" dataUsingEncoding:NSUTF8StringEncoding];
+    NSUInteger count = 0;
+
+    for (RSTransfer *transfer in self.queuedTransfers) {
+
+        [data appendData:[NSJSONSerialization dataWithJSONObject:[transfer journalEntry] options:0 error:nil]];
+        [data appendData:newline];
+        count++;
+
+        if (transfer.journaledBytes > 0) {
+            [data appendData:[NSJSONSerialization dataWithJSONObject:[transfer progressEntry] options:0 error:nil]];
+            [data appendData:newline];
+            count++;
+        }
+
+    }
+
+    // written to a new file and renamed over the old one, so a crash leaves one or the other intact
+    [self.journalHandle closeFile];
+    [data writeToFile:self.journalPath atomically:YES];
+
+    self.journalHandle = [NSFileHandle fileHandleForWritingAtPath:self.journalPath];
+    [self.journalHandle seekToEndOfFile];
+    self.journalEntryCount = count;
+
+}
+
+- (void)appendJournalEntry:(NSDictionary *)entry synchronously:(BOOL)synchronously {
+
+    NSMutableData *data = [NSMutableData dataWithData:[NSJSONSerialization dataWithJSONObject:entry options:0 error:nil]];
+    [data appendData:[@"\n" dataUsingEncoding:NSUTF8StringEncoding]];
+
+    [self.journalHandle writeData:data];
+    self.journalEntryCount++;
+
+    // adding and removing transfers has to survive a crash; a lost progress entry only costs a little progress
+    if (synchronously) {
+        [self.journalHandle synchronizeFile];
+    }
+
+    if (self.journalEntryCount > kRSTransferJournalCompactionThreshold && self.journalEntryCount > [self.queuedTransfers count] * 4) {
+        [self compactJournal];
+    }
+
+}
+
+#pragma mark - Queue
+
+- (NSArray *)transfers {
+
+    @synchronized (self) {
+        return [self.queuedTransfers copy];
+    }
+
+}
+
+- (void)addTransfer:(RSTransfer *)transfer {
+
+    // kept in start order, so the next transfer to start is always the first pending one
+    NSUInteger index = [self.queuedTransfers indexOfObject:transfer inSortedRange:NSMakeRange(0, [self.queuedTransfers count]) options:NSBinarySearchingInsertionIndex usingComparator:^NSComparisonResult(RSTransfer *a, RSTransfer *b) {
+        if (a.priority != b.priority) {
+            return a.priority > b.priority ? NSOrderedAscending : NSOrderedDescending;
+        }
+        if (a.sequence != b.sequence) {
+            return a.sequence < b.sequence ? NSOrderedAscending : NSOrderedDescending;
+        }
+        return NSOrderedSame;
+    }];
+
+    [self.queuedTransfers insertObject:transfer atIndex:index];
+
+}
+
+- (RSTransfer *)queueTransferOfType:(RSTransferType)type containerName:(NSString *)containerName objectName:(NSString *)objectName path:(NSString *)path priority:(NSInteger)priority totalBytes:(unsigned long long)totalBytes {
+
+    CFUUIDRef uuid = CFUUIDCreate(NULL);
+    RSTransfer *transfer = [[RSTransfer alloc] init];
+    transfer.identifier = CFBridgingRelease(CFUUIDCreateString(NULL, uuid));
+    CFRelease(uuid);
+
+    transfer.type = type;
+    transfer.containerName = containerName;
+    transfer.objectName = objectName;
+    transfer.path = path;
+    transfer.priority = priority;
+    transfer.totalBytes = totalBytes;
+    transfer.state = RSTransferStatePending;
+
+    @synchronized (self) {
+        transfer.sequence = self.nextSequence++;
+        [self appendJournalEntry:[transfer journalEntry] synchronously:YES];
+        [self addTransfer:transfer];
+    }
+
+    [self startNextTransfers];
+    return transfer;
+
+}
+
+- (RSTransfer *)uploadFile:(NSString *)path toObject:(NSString *)objectName inContainer:(NSString *)containerName priority:(NSInteger)priority {
+
+    unsigned long long size = [[[NSFileManager defaultManager] attributesOfItemAtPath:path error:nil] fileSize];
+    return [self queueTransferOfType:RSTransferTypeUpload containerName:containerName objectName:objectName path:path priority:priority totalBytes:size];
+
+}
+
+- (RSTransfer *)downloadObject:(NSString *)objectName inContainer:(NSString *)containerName toFile:(NSString *)path priority:(NSInteger)priority {
+
+    return [self queueTransferOfType:RSTransferTypeDownload containerName:containerName objectName:objectName path:path priority:priority totalBytes:0];
+
+}
+
+- (void)resume {
+
+    @synchronized (self) {
+        self.suspended = NO;
+    }
+    [self startNextTransfers];
+
+}
+
+- (void)suspend {
+
+    @synchronized (self) {
+        self.suspended = YES;
+    }
+
+}
+
+- (void)retryFailedTransfers {
+
+    @synchronized (self) {
+        for (RSTransfer *transfer in self.queuedTransfers) {
+            if (transfer.state == RSTransferStateFailed) {
+                transfer.state = RSTransferStatePending;
+                transfer.error = nil;
+                transfer.statusCode = 0;
+            }
+        }
+    }
+    [self startNextTransfers];
+
+}
+
+- (void)cancelTransfer:(RSTransfer *)transfer {
+
+    RSOperation *operation = nil;
+
+    @synchronized (self) {
+
+        if (![self.queuedTransfers containsObject:transfer]) {
+            return;
+        }
+
+        // an active transfer fails with a cancellation error; finishTransfer sees the state and ignores it
+        transfer.state = RSTransferStateCancelled;
+        operation = transfer.operation;
+        [self.queuedTransfers removeObject:transfer];
+        [self appendJournalEntry:[NSDictionary dictionaryWithObjectsAndKeys:@"remove", @"op", transfer.identifier, @"id", nil] synchronously:YES];
+
+    }
+
+    [operation cancel];
+
+}
+
+#pragma mark - Transfers
+
+- (void)startNextTransfers {
+
+    [self.client.completionQueue addOperationWithBlock:^{
+
+        NSMutableArray *starting = [[NSMutableArray alloc] init];
+
+        @synchronized (self) {
+
+            for (RSTransfer *transfer in self.queuedTransfers) {
+
+                if (self.suspended || self.activeTransfers + [starting count] >= self.maxConcurrentTransfers) {
+                    break;
+                }
+
+                if (transfer.state == RSTransferStatePending) {
+                    transfer.state = RSTransferStateActive;
+                    [starting addObject:transfer];
+                }
+
+            }
+
+            self.activeTransfers += [starting count];
+
+        }
+
+        for (RSTransfer *transfer in starting) {
+            [self startTransfer:transfer];
+        }
+
+    }];
+
+}
+
+- (void)startTransfer:(RSTransfer *)transfer {
+
+    RSContainer *container = [[RSContainer alloc] init];
+    container.name = transfer.containerName;
+    container.parent = self.client;
+
+    RSStorageObject *object = [[RSStorageObject alloc] init];
+    object.name = transfer.objectName;
+    object.parent = container;
+
+    void (^progress)(unsigned long long, unsigned long long) = ^(unsigned long long bytes, unsigned long long total) {
+        [self transfer:transfer didSendBytes:bytes totalBytes:total];
+    };
+
+    void (^success)() = ^{
+        [self finishTransfer:transfer response:nil error:nil];
+    };
+
+    void (^failure)(NSHTTPURLResponse*, NSData*, NSError*) = ^(NSHTTPURLResponse *response, NSData *data, NSError *error) {
+        [self finishTransfer:transfer response:response error:error];
+    };
+
+    if (transfer.type == RSTransferTypeDownload) {
+
+        RSRangedDownload *download = [[RSRangedDownload alloc] initWithObject:object path:transfer.path];
+        download.progressHandler = progress;
+        transfer.operation = [download start:success failure:failure];
+
+    } else if (transfer.totalBytes > self.largeObjectThreshold) {
+
+        transfer.operation = [container uploadLargeObject:object fromFile:transfer.path progress:progress success:success failure:failure];
+
+    } else {
+
+        transfer.operation = [container uploadObject:object fromFile:transfer.path progress:progress success:success failure:failure];
+
+    }
+
+    // the transfer may have been cancelled while it was starting
+    @synchronized (self) {
+        if (transfer.state == RSTransferStateCancelled) {
+            [transfer.operation cancel];
+        }
+    }
+
+}
+
+- (void)transfer:(RSTransfer *)transfer didSendBytes:(unsigned long long)bytes totalBytes:(unsigned long long)total {
+
+    @synchronized (self) {
+
+        if (transfer.state != RSTransferStateActive) {
+            return;
+        }
+
+        transfer.bytesTransferred = bytes;
+        transfer.totalBytes = total;
+
+        // progress can go backwards when a request is retried, and that's worth recording too
+        if (bytes >= transfer.journaledBytes + kRSTransferJournalProgressInterval || bytes < transfer.journaledBytes) {
+            transfer.journaledBytes = bytes;
+            [self appendJournalEntry:[transfer progressEntry] synchronously:NO];
+        }
+
+    }
+
+    if (self.progressHandler) {
+        self.progressHandler(transfer);
+    }
+
+}
+
+- (void)finishTransfer:(RSTransfer *)transfer response:(NSHTTPURLResponse *)response error:(NSError *)error {
+
+    BOOL cancelled = NO;
+
+    @synchronized (self) {
+
+        self.activeTransfers--;
+        transfer.operation = nil;
+        cancelled = transfer.state == RSTransferStateCancelled;
+
+        if (!cancelled && !response && !error) {
+
+            transfer.state = RSTransferStateCompleted;
+            transfer.bytesTransferred = transfer.totalBytes;
+            [self.queuedTransfers removeObject:transfer];
+            [self appendJournalEntry:[NSDictionary dictionaryWithObjectsAndKeys:@"remove", @"op", transfer.identifier, @"id", nil] synchronously:YES];
+
+        } else if (!cancelled) {
+
+            transfer.state = RSTransferStateFailed;
+            transfer.error = error;
+            transfer.statusCode = [response statusCode];
+
+        }
+
+    }
+
+    if (!cancelled && self.completionHandler) {
+        self.completionHandler(transfer);
+    }
+
+    [self startNextTransfers];
+
+}
+
+@end
@@ -0,0 +1,104 @@
+//
+//  RSTransport.h
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+@class RSConnection;
+
+#define kRSDefaultMaxConnectionsPerHost 8
+
+/** The RSTransportTask class represents one request handed to a RSTransport. */
+@interface RSTransportTask : NSObject
+
+/** The request being sent */
+@property (nonatomic, strong, readonly) NSURLRequest *request;
+
+/** The connection the request's delegate callbacks go to */
+@property (nonatomic, strong, readonly) RSConnection *connection;
+
+/** The queue the delegate callbacks execute on */
+@property (nonatomic, strong, readonly) NSOperationQueue *queue;
+
+/** The object doing the work, such as a NSURLConnection or a NSURLSessionTask.  Set by the transport
+ *  once the request is sent; anything that responds to `cancel` will do.
+ */
+@property (nonatomic, strong) id handle;
+
+/** Stops the request, or takes it out of line if it hasn't been sent yet */
+- (void)cancel;
+
+/** Tells the transport the request is done, so the next request to its host can go.  RSConnection
+ *  calls this once it has finished; calling it again does nothing.
+ */
+- (void)finish;
+
+@end
+
+/** The RSTransport class sends a client's requests over the network.
+ *
+ *  A client hands each request to its transport along with the RSConnection that receives its
+ *  delegate callbacks, which are the `NSURLConnectionDataDelegate` methods.  The transport keeps at
+ *  most maxConnectionsPerHost requests in flight to each host and holds the rest in line in the
+ *  order they arrived, so keep-alive connections to the storage and CDN hosts are reused instead of
+ *  new ones being opened.
+ *
+ *  This class sends requests with NSURLConnection.  RSSessionTransport sends them through a
+ *  NSURLSession instead, and is the default where it's available.  To plug in another engine,
+ *  subclass RSTransport and override resumeTask:.
+ */
+@interface RSTransport : NSObject
+
+/** The maximum number of requests in flight to a single host.  Defaults to `kRSDefaultMaxConnectionsPerHost`; 0 means no limit. */
+@property (nonatomic) NSUInteger maxConnectionsPerHost;
+
+/** Whether GET and HEAD requests may be pipelined on a keep-alive connection.  Some proxies mishandle
+ *  pipelined requests, so this defaults to `NO`.
+ */
+@property (nonatomic) BOOL pipelinesRequests;
+
+/** The number of requests sent */
+@property (nonatomic, readonly) NSUInteger requestCount;
+
+/** The number of requests sent on a newly opened connection.  Only counted by transports that can
+ *  tell, which NSURLConnection can't.
+ */
+@property (nonatomic, readonly) NSUInteger newConnectionCount;
+
+/** The number of requests sent on a connection kept alive from an earlier request.  Only counted by
+ *  transports that can tell, which NSURLConnection can't.
+ */
+@property (nonatomic, readonly) NSUInteger reusedConnectionCount;
+
+/** Returns a new transport of the best kind the system supports: a RSSessionTransport if NSURLSession
+ *  is available, and a RSTransport otherwise.
+ */
++ (RSTransport *)defaultTransport;
+
+/** Returns a transport shared by connections that weren't given one */
++ (RSTransport *)sharedTransport;
+
+/** Sends a request once its host has a free slot.
+ *  @param request The request to send
+ *  @param connection The connection that receives the delegate callbacks
+ *  @param queue The queue the delegate callbacks execute on
+ */
+- (RSTransportTask *)startRequest:(NSURLRequest *)request connection:(RSConnection *)connection queue:(NSOperationQueue *)queue;
+
+/** Sends a task's request over the network and sets its handle.  Subclasses override this to use a
+ *  different engine, and must deliver the `NSURLConnectionDataDelegate` callbacks to the task's
+ *  connection on the task's queue.
+ *  @param task The task to send
+ */
+- (void)resumeTask:(RSTransportTask *)task;
+
+/** Records whether a request went out on a new or a reused connection.  Subclasses call this. */
+- (void)recordConnectionReused:(BOOL)reused;
+
+/** Resets the statistics to zero */
+- (void)resetStatistics;
+
+@end
@@ -0,0 +1,291 @@
+//
+//  RSTransport.m
+//  RackspaceCloudFiles
+//
+//  Copyright (c) 2011 Rackspace. All rights reserved.
+//
+
+#import "RSTransport.h"
+#import "RSSessionTransport.h"
+#import "RSConnection.h"
+
+@interface RSTransportTask ()
+
+@property (nonatomic, strong, readwrite) NSURLRequest *request;
+@property (nonatomic, strong, readwrite) RSConnection *connection;
+@property (nonatomic, strong, readwrite) NSOperationQueue *queue;
+@property (nonatomic, strong) RSTransport *transport;
+@property (nonatomic, copy) NSString *hostKey;
+@property (nonatomic) BOOL started;
+@property (nonatomic) BOOL resuming;
+@property (nonatomic) BOOL cancelled;
+@property (nonatomic) BOOL finished;
+
+@end
+
+@interface RSTransport ()
+
+@property (nonatomic, readwrite) NSUInteger requestCount;
+@property (nonatomic, readwrite) NSUInteger newConnectionCount;
+@property (nonatomic, readwrite) NSUInteger reusedConnectionCount;
+@property (nonatomic, strong) NSMutableDictionary *waitingTasks;
+@property (nonatomic, strong) NSCountedSet *activeHosts;
+
++ (NSString *)hostKeyForURL:(NSURL *)url;
+- (void)sendTasks:(NSArray *)tasks;
+- (void)cancelTask:(RSTransportTask *)task;
+- (void)finishTask:(RSTransportTask *)task;
+- (void)releaseSlotOfTask:(RSTransportTask *)task;
+
+@end
+
+@implementation RSTransportTask
+
+@synthesize request, connection, queue, handle, transport, hostKey, started, resuming, cancelled, finished;
+
+- (void)cancel {
+    [self.transport cancelTask:self];
+}
+
+- (void)finish {
+    [self.transport finishTask:self];
+}
+
+@end
+
+@implementation RSTransport
+
+@synthesize maxConnectionsPerHost, pipelinesRequests, requestCount, newConnectionCount, reusedConnectionCount, waitingTasks, activeHosts;
+
++ (RSTransport *)defaultTransport {
+
+    if ([RSSessionTransport isAvailable]) {
+        return [[RSSessionTransport alloc] init];
+    }
+    return [[RSTransport alloc] init];
+
+}
+
++ (RSTransport *)sharedTransport {
+
+    static RSTransport *sharedTransport = nil;
+    static dispatch_once_t once;
+    dispatch_once(&once, ^{
+        sharedTransport = [[RSTransport alloc] init];
+    });
+    return sharedTransport;
+
+}
+
+- (id)init {
+
+    self = [super init];
+    if (self) {
+        self.maxConnectionsPerHost = kRSDefaultMaxConnectionsPerHost;
+        self.waitingTasks = [[NSMutableDictionary alloc] init];
+        self.activeHosts = [[NSCountedSet alloc] init];
+    }
+    return self;
+
+}
+
++ (NSString *)hostKeyForURL:(NSURL *)url {
+
+    // connections are kept alive per scheme, host and port
+    return [[NSString stringWithFormat:@"%@://%@:%@", [url scheme], [url host], [url port] ? [url port] : @""] lowercaseString];
+
+}
+
+#pragma mark - Tasks
+
+- (RSTransportTask *)startRequest:(NSURLRequest *)aRequest connection:(RSConnection *)aConnection queue:(NSOperationQueue *)aQueue {
+
+    NSString *method = [aRequest HTTPMethod];
+
+    if (self.pipelinesRequests && ([method isEqualToString:@"GET"] || [method isEqualToString:@"HEAD"])) {
+        NSMutableURLRequest *pipelined = [aRequest mutableCopy];
+        [pipelined setHTTPShouldUsePipelining:YES];
+        aRequest = pipelined;
+    }
+
+    RSTransportTask *task = [[RSTransportTask alloc] init];
+    task.request = aRequest;
+    task.connection = aConnection;
+    task.queue = aQueue;
+    task.transport = self;
+    task.hostKey = [RSTransport hostKeyForURL:[aRequest URL]];
+
+    BOOL startNow = NO;
+
+    @synchronized (self) {
+
+        if (self.maxConnectionsPerHost == 0 || [self.activeHosts countForObject:task.hostKey] < self.maxConnectionsPerHost) {
+            [self.activeHosts addObject:task.hostKey];
+            task.started = YES;
+            startNow = YES;
+        } else {
+            NSMutableArray *waiting = [self.waitingTasks objectForKey:task.hostKey];
+            if (!waiting) {
+                waiting = [[NSMutableArray alloc] init];
+                [self.waitingTasks setObject:waiting forKey:task.hostKey];
+            }
+            [waiting addObject:task];
+        }
+
+    }
+
+    if (startNow) {
+        [self sendTasks:[NSArray arrayWithObject:task]];
+    }
+
+    return task;
+
+}
+
+- (void)sendTasks:(NSArray *)tasks {
+
+    for (RSTransportTask *task in tasks) {
+
+        @synchronized (self) {
+            if (task.cancelled) {
+                continue;
+            }
+            task.resuming = YES;
+            self.requestCount++;
+        }
+
+        [self resumeTask:task];
+
+        // a cancel or finish that came while the request was being handed over has no handle to
+        // act on, so it is carried out here, and the slot is held until the request is really gone
+        BOOL cancelNow, releaseNow;
+
+        @synchronized (self) {
+            task.resuming = NO;
+            cancelNow = task.cancelled;
+            releaseNow = task.finished;
+        }
+
+        if (cancelNow) {
+            [task.handle cancel];
+        }
+        if (releaseNow) {
+            [self releaseSlotOfTask:task];
+        }
+
+    }
+
+}
+
+- (void)resumeTask:(RSTransportTask *)task {
+
+    // the NSURLConnection retains the connection as its delegate until it finishes, and the task
+    // holds on to the NSURLConnection until then, so the request keeps itself alive
+    NSURLConnection *urlConnection = [[NSURLConnection alloc] initWithRequest:task.request delegate:task.connection startImmediately:NO];
+    [urlConnection setDelegateQueue:task.queue];
+    task.handle = urlConnection;
+    [urlConnection start];
+
+}
+
+- (void)cancelTask:(RSTransportTask *)task {
+
+    BOOL cancelHandle = NO;
+
+    @synchronized (self) {
+        task.cancelled = YES;
+        if (!task.started) {
+            [[self.waitingTasks objectForKey:task.hostKey] removeObjectIdenticalTo:task];
+        } else if (!task.resuming) {
+            cancelHandle = YES;
+        }
+    }
+
+    if (cancelHandle) {
+        [task.handle cancel];
+    }
+
+}
+
+- (void)finishTask:(RSTransportTask *)task {
+
+    @synchronized (self) {
+
+        if (task.finished) {
+            return;
+        }
+        task.finished = YES;
+
+        if (!task.started) {
+            [[self.waitingTasks objectForKey:task.hostKey] removeObjectIdenticalTo:task];
+            return;
+        }
+
+        // sendTasks: releases the slot once the request has been handed over
+        if (task.resuming) {
+            return;
+        }
+
+    }
+
+    [self releaseSlotOfTask:task];
+
+}
+
+- (void)releaseSlotOfTask:(RSTransportTask *)task {
+
+    NSMutableArray *next = [[NSMutableArray alloc] init];
+
+    @synchronized (self) {
+
+        [self.activeHosts removeObject:task.hostKey];
+
+        // the freed slot goes to the request that has waited longest for this host
+        NSMutableArray *waiting = [self.waitingTasks objectForKey:task.hostKey];
+
+        while ([waiting count] > 0 && (self.maxConnectionsPerHost == 0 || [self.activeHosts countForObject:task.hostKey] < self.maxConnectionsPerHost)) {
+            RSTransportTask *nextTask = [waiting objectAtIndex:0];
+            [waiting removeObjectAtIndex:0];
+            [self.activeHosts addObject:nextTask.hostKey];
+            nextTask.started = YES;
+            [next addObject:nextTask];
+        }
+
+        if (waiting && [waiting count] == 0) {
+            [self.waitingTasks removeObjectForKey:task.hostKey];
+        }
+
+    }
+
+    task.handle = nil;
+    task.connection = nil;
+
+    [self sendTasks:next];
+
+}
+
+#pragma mark - Statistics
+
+- (void)recordConnectionReused:(BOOL)reused {
+
+    @synchronized (self) {
+        if (reused) {
+            self.reusedConnectionCount++;
+        } else {
+            self.newConnectionCount++;
+        }
+    }
+
+}
+
+- (void)resetStatistics {
+
+    @synchronized (self) {
+        self.requestCount = 0;
+        self.newConnectionCount = 0;
+        self.reusedConnectionCount = 0;
+    }
+
+}
+
+@end